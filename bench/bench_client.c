@@ -0,0 +1,180 @@
+/**
+ * @file bench_client.c
+ * @brief Benchmark for control protocol throughput in commands/sec
+ *
+ * Starts ./fss_manager with one source and sends it "status <source>"
+ * commands three ways:
+ * - one fss_console process per command, as scripts that shell out do,
+ * - one libfss connection, one command at a time (fss_call()),
+ * - one libfss connection, pipelined (fss_submit() + fss_wait()).
+ *
+ * Run it from the directory holding fss_manager, worker and fss_console.
+ *
+ * Usage: ./bench_client [commands] [console_runs]
+ */
+
+ #include "../include/libfss.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <string.h>
+ #include <errno.h>
+ #include <fcntl.h>
+ #include <signal.h>
+ #include <unistd.h>
+ #include <time.h>
+ #include <sys/stat.h>
+ #include <sys/wait.h>
+
+ #define BENCH_SRC_DIR "/tmp/fss_bench_client_src"
+ #define BENCH_DST_DIR "/tmp/fss_bench_client_dst"
+ #define BENCH_CONFIG  "/tmp/fss_bench_client.conf"
+ #define BENCH_LOG     "/tmp/fss_bench_client.log"
+ #define STATUS_CMD    "status " BENCH_SRC_DIR
+
+ /**
+  * @brief Current monotonic time in seconds
+  *
+  * @return Seconds as a double
+  */
+ static double now_sec() {
+     struct timespec ts;
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return ts.tv_sec + ts.tv_nsec / 1e9;
+ }
+
+ /**
+  * @brief Start the manager on a one-source config
+  *
+  * @return Manager's process ID, or -1 on error
+  */
+ static pid_t start_manager() {
+     mkdir(BENCH_SRC_DIR, 0755);
+     mkdir(BENCH_DST_DIR, 0755);
+     FILE* f = fopen(BENCH_CONFIG, "w");
+     if (!f) return -1;
+     fprintf(f, "%s %s\n", BENCH_SRC_DIR, BENCH_DST_DIR);
+     fclose(f);
+
+     pid_t pid = fork();
+     if (pid == 0) {
+         int null = open("/dev/null", O_WRONLY);
+         dup2(null, STDOUT_FILENO);
+         execl("./fss_manager", "fss_manager", "-l", BENCH_LOG, "-c", BENCH_CONFIG, (char*)NULL);
+         _exit(127);
+     }
+     return pid;
+ }
+
+ /**
+  * @brief Count a reply
+  *
+  * @param status Outcome
+  * @param reply Reply text
+  * @param ctx Counter of good replies
+  */
+ static void count_reply(fss_reply_status_t status, const char* reply, void* ctx) {
+     if (status == FSS_REPLY_OK && strstr(reply, "Directory:")) (*(int*)ctx)++;
+ }
+
+ /**
+  * @brief Run one fss_console per command
+  *
+  * @param runs Commands
+  * @return Commands/sec
+  */
+ static double bench_console(int runs) {
+     double t0 = now_sec();
+     for (int i = 0; i < runs; i++) {
+         int in[2];
+         if (pipe(in) < 0) return 0;
+         pid_t pid = fork();
+         if (pid == 0) {
+             int null = open("/dev/null", O_WRONLY);
+             dup2(in[0], STDIN_FILENO);
+             dup2(null, STDOUT_FILENO);
+             close(in[1]);
+             execl("./fss_console", "fss_console", "-l", "/dev/null", (char*)NULL);
+             _exit(127);
+         }
+         close(in[0]);
+         dprintf(in[1], "%s\nexit\n", STATUS_CMD);
+         close(in[1]);
+         waitpid(pid, NULL, 0);
+     }
+     return runs / (now_sec() - t0);
+ }
+
+ /**
+  * @brief Send commands one at a time over one connection
+  *
+  * @param c Connection
+  * @param n Commands
+  * @return Commands/sec, 0 if a reply was missing
+  */
+ static double bench_sequential(fss_client_t* c, int n) {
+     int good = 0;
+     double t0 = now_sec();
+     for (int i = 0; i < n; i++) {
+         char* r = fss_call(c, STATUS_CMD, 5000);
+         if (r && strstr(r, "Directory:")) good++;
+         free(r);
+     }
+     double rate = n / (now_sec() - t0);
+     return good == n ? rate : 0;
+ }
+
+ /**
+  * @brief Send all commands pipelined over one connection
+  *
+  * @param c Connection
+  * @param n Commands
+  * @return Commands/sec, 0 if a reply was missing
+  */
+ static double bench_pipelined(fss_client_t* c, int n) {
+     int good = 0;
+     double t0 = now_sec();
+     for (int i = 0; i < n; i++) fss_submit(c, STATUS_CMD, 10000, count_reply, &good);
+     fss_wait(c, -1);
+     double rate = n / (now_sec() - t0);
+     return good == n ? rate : 0;
+ }
+
+ /**
+  * @brief Main entry point for the benchmark
+  *
+  * @param argc Argument count
+  * @param argv Argument vector
+  * @return 0 on success, 1 if the manager could not be reached
+  */
+ int main(int argc, char* argv[]) {
+     int n = argc > 1 ? atoi(argv[1]) : 20000;
+     int runs = argc > 2 ? atoi(argv[2]) : 200;
+     if (n < 1) n = 20000;
+     if (runs < 1) runs = 200;
+
+     signal(SIGPIPE, SIG_IGN);
+     pid_t manager = start_manager();
+     fss_client_t* c = manager > 0 ? fss_connect(NULL, 5000) : NULL;
+     if (!c) {
+         fprintf(stderr, "bench_client: cannot reach ./fss_manager: %s\n", strerror(errno));
+         if (manager > 0) kill(manager, SIGTERM);
+         return 1;
+     }
+
+     /* Let the initial full sync finish */
+     free(fss_call(c, STATUS_CMD, 5000));
+     usleep(200000);
+
+     printf("%-32s %12s\n", "mode", "commands/sec");
+     fss_close(c);
+     printf("%-32s %12.0f\n", "fss_console per command", bench_console(runs));
+
+     c = fss_connect(NULL, 5000);
+     printf("%-32s %12.0f\n", "libfss, one at a time", bench_sequential(c, n));
+     printf("%-32s %12.0f\n", "libfss, pipelined", bench_pipelined(c, n));
+
+     free(fss_call(c, "shutdown", -1));
+     fss_close(c);
+     waitpid(manager, NULL, 0);
+     return 0;
+ }
@@ -0,0 +1,221 @@
+/**
+ * @file bench_copy.c
+ * @brief Benchmark for full-sync copy throughput, NUMA placement and huge pages
+ *
+ * Copies a generated tree with full_sync() in several configurations:
+ * - once unpinned and once per placement (numa_node=auto and every node),
+ *   next to the change in the kernel's per-node allocation counters
+ *   (/sys/devices/system/node/nodeN/numastat); numa_miss and other_node
+ *   count pages allocated away from the CPU's node, i.e. cross-node traffic,
+ * - with growing copy buffers, each on regular and on huge pages,
+ * - re-syncing after one byte of every file changed, rewriting each file
+ *   and with in_place=1, which writes only the blocks that differ.
+ *
+ * Usage: ./bench_copy [files] [file_kb] [walk_threads]
+ */
+
+ #define _GNU_SOURCE  /* cpu_set_t */
+ #include "../include/sync_ops.h"
+ #include "../include/placement.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <string.h>
+ #include <unistd.h>
+ #include <fcntl.h>
+ #include <time.h>
+ #include <sys/stat.h>
+
+ #define BENCH_SRC_DIR "/tmp/fss_bench_copy_src"
+ #define BENCH_DST_DIR "/tmp/fss_bench_copy_dst"
+
+ /**
+  * @struct numastat
+  * @brief Allocation counters summed over all nodes
+  */
+ typedef struct numastat {
+     unsigned long long hit;     /**< Pages allocated on the intended node */
+     unsigned long long miss;    /**< Pages allocated here though another node was intended */
+     unsigned long long other;   /**< Pages allocated here for a process running elsewhere */
+ } numastat_t;
+
+ /**
+  * @brief Current monotonic time in seconds
+  *
+  * @return Seconds as a double
+  */
+ static double now_sec() {
+     struct timespec ts;
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return ts.tv_sec + ts.tv_nsec / 1e9;
+ }
+
+ /**
+  * @brief Sum the numastat counters of every node
+  *
+  * @param s Counters to fill (all zero without sysfs)
+  */
+ static void read_numastat(numastat_t* s) {
+     memset(s, 0, sizeof(*s));
+     for (int node = 0; node < placement_nodes(); node++) {
+         char path[96], key[32];
+         unsigned long long v;
+         snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/numastat", node);
+         FILE* f = fopen(path, "r");
+         if (!f) continue;
+         while (fscanf(f, "%31s %llu", key, &v) == 2) {
+             if (!strcmp(key, "numa_hit")) s->hit += v;
+             else if (!strcmp(key, "numa_miss")) s->miss += v;
+             else if (!strcmp(key, "other_node")) s->other += v;
+         }
+         fclose(f);
+     }
+ }
+
+ /**
+  * @brief Create the source tree
+  *
+  * @param files Number of files
+  * @param file_kb Size of each file in KiB
+  */
+ static void make_tree(int files, int file_kb) {
+     char path[256];
+     char* block = malloc(1024);
+     memset(block, 'x', 1024);
+
+     if (system("rm -rf " BENCH_SRC_DIR " && mkdir -p " BENCH_SRC_DIR) != 0)
+         fprintf(stderr, "setup failed\n");
+     for (int i = 0; i < files; i++) {
+         snprintf(path, sizeof(path), "%s/f%d", BENCH_SRC_DIR, i);
+         int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+         if (fd < 0) continue;
+         for (int k = 0; k < file_kb; k++)
+             if (write(fd, block, 1024) != 1024) break;
+         close(fd);
+     }
+     free(block);
+ }
+
+ /**
+  * @brief Time one full sync with the given options
+  *
+  * @param label Row label
+  * @param spec Option string ("key=value,...")
+  * @param total_mb Data size in MiB
+  */
+ static void bench_sync(const char* label, const char* spec, double total_mb) {
+     sync_options_t o;
+     sync_result_t r;
+     numastat_t before, after;
+
+     if (system("rm -rf " BENCH_DST_DIR) != 0) fprintf(stderr, "cleanup failed\n");
+     sync_options_init(&o);
+     if (sync_options_parse(spec, &o) < 0) {
+         fprintf(stderr, "bad options: %s\n", spec);
+         return;
+     }
+     sync_result_init(&r, NULL);
+
+     read_numastat(&before);
+     double t0 = now_sec();
+     sync_run_task(BENCH_SRC_DIR, BENCH_DST_DIR, "ALL", "FULL", &o, &r);
+     double dt = now_sec() - t0;
+     read_numastat(&after);
+
+     printf("%-14s %8.1f MB/s  files=%-6d numa_hit=%-8llu numa_miss=%-8llu other_node=%llu\n",
+            label, total_mb / dt, r.files_processed,
+            after.hit - before.hit, after.miss - before.miss, after.other - before.other);
+ }
+
+ /**
+  * @brief Time a re-sync after one byte of every file changed
+  *
+  * @param label Row label
+  * @param files Number of files
+  * @param file_kb Size of each file in KiB
+  * @param spec Option string of the re-sync ("key=value,...")
+  * @param total_mb Data size in MiB
+  */
+ static void bench_resync(const char* label, int files, int file_kb, const char* spec, double total_mb) {
+     sync_options_t o;
+     sync_result_t r;
+     char path[256];
+
+     if (system("rm -rf " BENCH_DST_DIR) != 0) fprintf(stderr, "cleanup failed\n");
+     sync_options_init(&o);
+     sync_result_init(&r, NULL);
+     sync_run_task(BENCH_SRC_DIR, BENCH_DST_DIR, "ALL", "FULL", &o, &r);
+
+     /* Flip a byte in the middle of every file; the new mtime marks it changed */
+     for (int i = 0; i < files; i++) {
+         snprintf(path, sizeof(path), "%s/f%d", BENCH_SRC_DIR, i);
+         int fd = open(path, O_RDWR);
+         char c;
+         off_t mid = (off_t)file_kb * 512;
+         if (fd < 0) continue;
+         if (pread(fd, &c, 1, mid) == 1) {
+             c = c == 'x' ? 'y' : 'x';
+             if (pwrite(fd, &c, 1, mid) != 1) fprintf(stderr, "update failed\n");
+         }
+         close(fd);
+     }
+
+     if (sync_options_parse(spec, &o) < 0) {
+         fprintf(stderr, "bad options: %s\n", spec);
+         return;
+     }
+     sync_result_init(&r, NULL);
+     double t0 = now_sec();
+     sync_run_task(BENCH_SRC_DIR, BENCH_DST_DIR, "ALL", "FULL", &o, &r);
+     double dt = now_sec() - t0;
+
+     printf("%-14s %8.1f MB/s  files=%-6d compared=%.1fMB written=%.1fMB\n",
+            label, total_mb / dt, r.files_processed,
+            r.bytes_compared / 1048576.0, r.bytes_written / 1048576.0);
+ }
+
+ int main(int argc, char* argv[]) {
+     int files = argc > 1 ? atoi(argv[1]) : 2000;
+     int file_kb = argc > 2 ? atoi(argv[2]) : 64;
+     int walk_threads = argc > 3 ? atoi(argv[3]) : 4;
+     if (files < 1) files = 2000;
+     if (file_kb < 1) file_kb = 64;
+     if (walk_threads < 1 || walk_threads > 64) walk_threads = 4;
+
+     double total_mb = files * (double)file_kb / 1024.0;
+     make_tree(files, file_kb);
+     printf("copy       files=%d size=%dKB threads=%d nodes=%d\n",
+            files, file_kb, walk_threads, placement_nodes());
+
+     char spec[128], label[32];
+     printf("-- placement\n");
+     snprintf(spec, sizeof(spec), "walk_threads=%d,numa_node=off", walk_threads);
+     bench_sync("unpinned", spec, total_mb);
+     snprintf(spec, sizeof(spec), "walk_threads=%d,numa_node=auto", walk_threads);
+     bench_sync("auto", spec, total_mb);
+     for (int node = 0; node < placement_nodes(); node++) {
+         snprintf(label, sizeof(label), "node%d", node);
+         snprintf(spec, sizeof(spec), "walk_threads=%d,numa_node=%d", walk_threads, node);
+         bench_sync(label, spec, total_mb);
+     }
+
+     /* Buffer sizes in KiB; 4 is the default */
+     static const int buffers[] = { 4, 256, 2048, 8192 };
+     printf("-- copy buffer\n");
+     for (size_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++) {
+         for (int huge = 0; huge <= 1; huge++) {
+             snprintf(label, sizeof(label), "%dK%s", buffers[i], huge ? " huge" : "");
+             snprintf(spec, sizeof(spec), "walk_threads=%d,copy_buffer=%d,huge_pages=%d",
+                      walk_threads, buffers[i], huge);
+             bench_sync(label, spec, total_mb);
+         }
+     }
+
+     printf("-- one byte changed per file\n");
+     snprintf(spec, sizeof(spec), "walk_threads=%d,copy_buffer=256", walk_threads);
+     bench_resync("rewrite", files, file_kb, spec, total_mb);
+     snprintf(spec, sizeof(spec), "walk_threads=%d,copy_buffer=256,in_place=1", walk_threads);
+     bench_resync("in place", files, file_kb, spec, total_mb);
+
+     if (system("rm -rf " BENCH_SRC_DIR " " BENCH_DST_DIR) != 0) fprintf(stderr, "cleanup failed\n");
+     return 0;
+ }
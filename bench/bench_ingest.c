@@ -0,0 +1,154 @@
+/**
+ * @file bench_ingest.c
+ * @brief Benchmarks for the manager's event ingestion path
+ *
+ * Measures two things:
+ * - raw MPSC queue throughput with several producers and one consumer,
+ * - sustained inotify events/sec through the ingestion threads while writer
+ *   threads keep modifying files, each in its own watched directory, with
+ *   1, 2, 4 ... inotify instances (directories spread round-robin over them).
+ *
+ * Usage: ./bench_ingest [seconds] [writer_threads]
+ */
+
+ #include "../include/mpsc_queue.h"
+ #include "../include/fss_pipeline.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <string.h>
+ #include <unistd.h>
+ #include <fcntl.h>
+ #include <poll.h>
+ #include <pthread.h>
+ #include <time.h>
+ #include <sys/stat.h>
+ #include <sys/inotify.h>
+
+ #define QUEUE_ITEMS   2000000   /**< Items pushed per queue benchmark run */
+ #define FILES_PER_WRITER 16     /**< Files each writer thread cycles through */
+ #define BENCH_DIR     "/tmp/fss_bench_ingest"
+
+ static mpsc_queue_t queue;
+ static mpsc_node_t* nodes;
+ static int per_producer;
+ static volatile int writers_running;
+
+ /**
+  * @brief Current monotonic time in seconds
+  *
+  * @return Seconds as a double
+  */
+ static double now_sec() {
+     struct timespec ts;
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return ts.tv_sec + ts.tv_nsec / 1e9;
+ }
+
+ /**
+  * @brief Queue producer: push a preallocated slice of nodes
+  */
+ static void* queue_producer(void* arg) {
+     mpsc_node_t* base = nodes + (long)arg * per_producer;
+     for (int i = 0; i < per_producer; i++) mpsc_push(&queue, &base[i]);
+     return NULL;
+ }
+
+ /**
+  * @brief Measure MPSC queue throughput
+  *
+  * @param producers Number of producer threads
+  */
+ static void bench_queue(int producers) {
+     pthread_t th[64];
+     per_producer = QUEUE_ITEMS / producers;
+     nodes = malloc(sizeof(*nodes) * per_producer * producers);
+     mpsc_init(&queue);
+
+     double start = now_sec();
+     for (long i = 0; i < producers; i++) pthread_create(&th[i], NULL, queue_producer, (void*)i);
+
+     long got = 0, total = (long)per_producer * producers;
+     while (got < total) if (mpsc_pop(&queue)) got++;
+     double elapsed = now_sec() - start;
+
+     for (int i = 0; i < producers; i++) pthread_join(th[i], NULL);
+     printf("queue      producers=%-2d items=%ld  %.2f M items/sec\n",
+            producers, total, total / elapsed / 1e6);
+     free(nodes);
+ }
+
+ /**
+  * @brief Writer thread: keep modifying a set of files in its own directory
+  */
+ static void* writer(void* arg) {
+     int fds[FILES_PER_WRITER];
+     for (int i = 0; i < FILES_PER_WRITER; i++) {
+         char path[256];
+         snprintf(path, sizeof(path), "%s/w%ld/f%d", BENCH_DIR, (long)arg, i);
+         fds[i] = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+     }
+     for (unsigned long n = 0; writers_running; n++) {
+         if (write(fds[n % FILES_PER_WRITER], "x", 1) < 0) break;
+     }
+     for (int i = 0; i < FILES_PER_WRITER; i++) close(fds[i]);
+     return NULL;
+ }
+
+ /**
+  * @brief Measure sustained inotify events/sec through the ingestion threads
+  *
+  * @param seconds Duration of the run
+  * @param writers Number of writer threads
+  * @param shards Number of inotify instances
+  */
+ static void bench_pipeline(int seconds, int writers, int shards) {
+     int fds[PIPELINE_MAX_SHARDS];
+     unsigned long overflows_before = pipeline_overflows();
+     mkdir(BENCH_DIR, 0755);
+     for (int i = 0; i < shards; i++) fds[i] = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+     for (int w = 0; w < writers; w++) {
+         char dir[256];
+         snprintf(dir, sizeof(dir), "%s/w%d", BENCH_DIR, w);
+         mkdir(dir, 0755);
+         inotify_add_watch(fds[w % shards], dir, IN_CREATE | IN_MODIFY | IN_DELETE);
+     }
+     pipeline_start(fds, shards, NULL);
+
+     pthread_t th[64];
+     writers_running = 1;
+     for (long i = 0; i < writers; i++) pthread_create(&th[i], NULL, writer, (void*)i);
+
+     /* Consume like the scheduler does: wait on the wake fd, then drain */
+     unsigned long consumed = 0;
+     double start = now_sec(), end = start + seconds;
+     struct pollfd pfd = { .fd = pipeline_wake_fd(), .events = POLLIN };
+     while (now_sec() < end) {
+         if (poll(&pfd, 1, 100) > 0) pipeline_clear_wake();
+         fss_event_t* ev;
+         while ((ev = pipeline_next_event())) {
+             consumed++;
+             pipeline_release_event(ev);
+         }
+     }
+     double elapsed = now_sec() - start;
+
+     writers_running = 0;
+     for (int i = 0; i < writers; i++) pthread_join(th[i], NULL);
+
+     printf("pipeline   writers=%-2d instances=%-2d seconds=%d  %.0f events/sec  (overflows: %lu)\n",
+            writers, shards, seconds, consumed / elapsed, pipeline_overflows() - overflows_before);
+
+     pipeline_stop();
+     for (int i = 0; i < shards; i++) close(fds[i]);
+     if (system("rm -rf " BENCH_DIR) != 0) fprintf(stderr, "cleanup failed\n");
+ }
+
+ int main(int argc, char* argv[]) {
+     int seconds = argc > 1 ? atoi(argv[1]) : 3;
+     int writers = argc > 2 ? atoi(argv[2]) : 4;
+     if (writers < 1 || writers > 64) writers = 4;
+
+     for (int p = 1; p <= 8; p *= 2) bench_queue(p);
+     for (int shards = 1; shards <= writers; shards *= 2) bench_pipeline(seconds, writers, shards);
+     return 0;
+ }
@@ -129,7 +129,13 @@ purge() {
     if [ -d "$tgt" ]; then
         echo "Purging backup directory:"
         echo "Deleting $tgt..."
-        rm -rf "$tgt"
+        # Αν υπάρχει το fss_purge: μετονομασία και παράλληλη διαγραφή στο παρασκήνιο
+        local purger="$(dirname "$0")/fss_purge"
+        if [ -x "$purger" ]; then
+            "$purger" -b -t 8 "$tgt" > /dev/null || exit 1
+        else
+            rm -rf "$tgt"
+        fi
         echo "Purge complete."
     elif [ -f "$tgt" ]; then
         echo "Purging a log-file:"
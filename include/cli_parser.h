@@ -25,13 +25,16 @@
      char* logfile;     /**< Path to the log file (-l option) */
      char* config_file; /**< Path to the configuration file (-c option) */
      int worker_limit;  /**< Maximum number of worker processes (-n option, default: 5) */
+     char* executor;    /**< Executor mode: "process" or "thread" (-e option, default: process) */
+     int huge_pages;    /**< Back the manager's event arena with huge pages (-H flag) */
+     int inotify_instances;  /**< inotify instances, one ingestion thread each (-i option, default: 1) */
  };
  
  /**
   * @brief Parse command-line arguments for the FSS manager
   * 
   * Parses the command-line arguments and returns a filled args structure.
-  * Expected format: ./fss_manager -l <logfile> -c <config_file> [-n <worker_limit>]
+  * Expected format: ./fss_manager -l <logfile> -c <config_file> [-n <worker_limit>] [-e <executor>] [-H] [-i <instances>]
   * 
   * @param argc Argument count from main()
   * @param argv Argument vector from main()
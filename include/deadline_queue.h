@@ -0,0 +1,75 @@
+/**
+ * @file deadline_queue.h
+ * @brief Earliest-deadline-first queue of pending tasks
+ *
+ * A binary min-heap of opaque items keyed by an absolute deadline. Items
+ * with equal deadlines come out in the order they were pushed, so a queue
+ * whose deadlines never decrease behaves like a FIFO. Used by the
+ * scheduler thread only; not thread-safe.
+ */
+
+ #ifndef DEADLINE_QUEUE_H
+ #define DEADLINE_QUEUE_H
+
+ #include <stddef.h>
+
+ typedef struct deadline_queue deadline_queue_t;  /**< Opaque queue */
+
+ /**
+  * @brief Create an empty queue
+  *
+  * @return New queue
+  */
+ deadline_queue_t* deadline_queue_create(void);
+
+ /**
+  * @brief Free a queue (items are not freed)
+  *
+  * @param q Queue to destroy (may be NULL)
+  */
+ void deadline_queue_destroy(deadline_queue_t* q);
+
+ /**
+  * @brief Add an item
+  *
+  * @param q Queue
+  * @param deadline Absolute deadline (any monotonic unit)
+  * @param item Caller's item (not NULL)
+  */
+ void deadline_queue_push(deadline_queue_t* q, long long deadline, void* item);
+
+ /**
+  * @brief Remove the item with the earliest deadline
+  *
+  * @param q Queue
+  * @return Item, or NULL if the queue is empty
+  */
+ void* deadline_queue_pop(deadline_queue_t* q);
+
+ /**
+  * @brief Look at the earliest deadline without removing its item
+  *
+  * @param q Queue
+  * @param deadline Set to the earliest deadline
+  * @return 1 if the queue has an item, 0 if it is empty
+  */
+ int deadline_queue_peek(const deadline_queue_t* q, long long* deadline);
+
+ /**
+  * @brief Number of items in the queue
+  *
+  * @param q Queue
+  * @return Items
+  */
+ size_t deadline_queue_size(const deadline_queue_t* q);
+
+ /**
+  * @brief Item at a heap position, for walking all items in no particular order
+  *
+  * @param q Queue
+  * @param i Position, below deadline_queue_size()
+  * @return Item
+  */
+ void* deadline_queue_at(const deadline_queue_t* q, size_t i);
+
+ #endif /* DEADLINE_QUEUE_H */
@@ -0,0 +1,69 @@
+/**
+ * @file dir_walk.h
+ * @brief Parallel recursive directory walker
+ *
+ * This header declares a reusable directory-walk engine. Directories are
+ * scheduled on per-thread deques with work stealing; each directory is read
+ * with getdents64() through an fd that stays open until its subdirectories
+ * have been opened with openat(), so no path is ever re-resolved from the
+ * root. Entries are delivered to the consumer in batches.
+ */
+
+ #ifndef DIR_WALK_H
+ #define DIR_WALK_H
+
+ #include <stddef.h>
+ #include <sys/types.h>
+
+ /**
+  * @struct dir_walk_entry
+  * @brief One directory entry delivered to the consumer
+  *
+  * dirfd, relpath and name are only valid for the duration of the callback.
+  */
+ typedef struct dir_walk_entry {
+     int dirfd;             /**< Open fd of the containing directory (for *at() calls) */
+     const char* relpath;   /**< Containing directory relative to the root ("" for the root) */
+     const char* name;      /**< Entry name */
+     unsigned char d_type;  /**< DT_REG, DT_DIR, DT_LNK, ... (never DT_UNKNOWN) */
+     ino_t ino;             /**< Inode number */
+     int depth;             /**< Depth of the containing directory (root = 0) */
+ } dir_walk_entry_t;
+
+ /**
+  * @brief Consumer callback
+  *
+  * All entries of a batch come from the same directory. With more than one
+  * thread the callback runs concurrently and must be thread-safe.
+  *
+  * @param batch Entries
+  * @param n Number of entries
+  * @param ctx Consumer context passed to dir_walk()
+  */
+ typedef void (*dir_walk_fn)(const dir_walk_entry_t* batch, size_t n, void* ctx);
+
+ /**
+  * @struct dir_walk_opts
+  * @brief Walk options
+  */
+ typedef struct dir_walk_opts {
+     int threads;        /**< Walker threads (<= 1 walks on the calling thread) */
+     int max_depth;      /**< Directory levels to list (1 = root only, 0 = unlimited) */
+     size_t batch_size;  /**< Maximum entries per callback (0 = default) */
+ } dir_walk_opts_t;
+
+ /**
+  * @brief Walk a directory tree
+  *
+  * Symbolic links are reported but never followed.
+  *
+  * @param root Directory to walk
+  * @param opts Options (NULL for single-threaded, unlimited depth)
+  * @param fn Consumer callback
+  * @param ctx Consumer context
+  * @return Number of subdirectories that could not be read, or -1 (errno set)
+  *         if the root itself could not be opened
+  */
+ int dir_walk(const char* root, const dir_walk_opts_t* opts, dir_walk_fn fn, void* ctx);
+
+ #endif /* DIR_WALK_H */
@@ -0,0 +1,67 @@
+/**
+ * @file event_stream.h
+ * @brief Push notifications for consoles in watch mode
+ *
+ * A console that sends "watch [source]" subscribes its output FIFO to task
+ * events. Events are formatted as single "EVENT ..." lines and buffered per
+ * subscriber; the manager flushes all buffers once per loop iteration, so a
+ * burst of events costs one write() per subscriber. A subscriber that does
+ * not keep up loses events once its buffer is full; the number lost is
+ * reported in an "EVENT [ts] [DROPPED] [n]" line as soon as there is room.
+ * All functions are called from the manager's main thread only.
+ */
+
+ #ifndef EVENT_STREAM_H
+ #define EVENT_STREAM_H
+
+ #include <sys/select.h>
+
+ #define EVENT_STREAM_MAX_SUBSCRIBERS 16          /**< Concurrent subscriptions */
+ #define EVENT_STREAM_BUFSIZE (64 * 1024)         /**< Pending bytes per subscriber */
+
+ /**
+  * @brief Subscribe an output fd to events
+  *
+  * Re-subscribing an fd replaces its filter and keeps its buffer.
+  *
+  * @param fd Non-blocking output fd
+  * @param source Only events for this source (NULL for all)
+  * @return 0 on success, -1 if the subscriber table is full
+  */
+ int event_stream_subscribe(int fd, const char* source);
+
+ /**
+  * @brief Cancel a subscription, discarding anything still buffered
+  *
+  * @param fd Subscribed fd
+  * @return Events dropped over the subscription's lifetime, or -1 if fd
+  *         was not subscribed
+  */
+ long event_stream_unsubscribe(int fd);
+
+ /**
+  * @brief Queue an event for every matching subscriber
+  *
+  * @param source Source the event concerns (NULL reaches every subscriber)
+  * @param fmt printf-style body, appended after "EVENT [timestamp] "
+  */
+ void event_stream_publish(const char* source, const char* fmt, ...)
+     __attribute__((format(printf, 2, 3)));
+
+ /**
+  * @brief Write buffered events without blocking
+  *
+  * Subscribers whose reader went away are dropped.
+  */
+ void event_stream_flush(void);
+
+ /**
+  * @brief Add fds with buffered events to a select() write set
+  *
+  * @param wfds Write set to extend
+  * @param maxfd Current highest fd + 1
+  * @return New highest fd + 1
+  */
+ int event_stream_fill_wfds(fd_set* wfds, int maxfd);
+
+ #endif /* EVENT_STREAM_H */
@@ -28,13 +28,22 @@
  do { if (DEBUG) fprintf(stderr, "[DEBUG] " fmt, ##__VA_ARGS__); } while(0)
  
  /* Global variables */
- extern int inotify_fd;             /**< File descriptor for inotify instance */
+ extern int inotify_fds[];          /**< inotify instances (see setup_inotify()) */
+ extern int inotify_shards;         /**< Number of inotify instances */
  extern int* watch_descriptors;     /**< Array of inotify watch descriptors */
  extern int watch_count;            /**< Count of active watch descriptors */
  extern volatile int running;       /**< Flag indicating if main loop should continue */
  extern int global_fd_out;          /**< File descriptor for console output pipe */
  extern FILE* global_log_file;      /**< File pointer for manager log file */
  
+ /**
+  * @brief How synchronization tasks are executed
+  */
+ typedef enum {
+     EXECUTOR_PROCESS,  /**< Fork and exec ./worker per task (default) */
+     EXECUTOR_THREAD    /**< Run tasks on an in-process thread pool */
+ } executor_mode_t;
+ 
  /* Function declarations */
  
  /**
@@ -46,6 +55,21 @@
   */
  void init_globals(FILE* log_file, int fd_out, int worker_limit);
  
+ /**
+  * @brief Select how synchronization tasks are executed
+  *
+  * Must be called after init_globals(); thread mode sizes its pool
+  * by the worker limit.
+  *
+  * @param mode Executor mode
+  */
+ void set_executor_mode(executor_mode_t mode);
+ 
+ /**
+  * @brief Stop the executor, waiting for in-process tasks to finish
+  */
+ void shutdown_executor();
+ 
  /**
   * @brief Read configuration file and start monitoring directories
   *
@@ -61,15 +85,17 @@
  /**
   * @brief Set up inotify for directory monitoring
   *
-  * Initializes the inotify instance for monitoring file system events
+  * Initializes the inotify instances for monitoring file system events
+  *
+  * @param shards Number of inotify instances (1 to PIPELINE_MAX_SHARDS)
   */
- void setup_inotify();
+ void setup_inotify(int shards);
  
  /**
   * @brief Handle inotify events
   *
-  * Processes file system events (create, modify, delete) and
-  * spawns worker processes to synchronize changes.
+  * Processes file system events (create, modify, delete) queued by the
+  * ingestion thread and spawns worker processes to synchronize changes.
   *
   * @param log_file Pointer to log file
   */
@@ -79,7 +105,8 @@
   * @brief Process commands from the console
   *
   * Parses and dispatches commands received from the fss_console
-  * to the appropriate handler functions.
+  * to the appropriate handler functions. A command prefixed with a
+  * request tag ("@<tag> ") gets its reply ended by "@<tag> END".
   *
   * @param cmdline Command line string to process
   * @param fd_out File descriptor for console output
@@ -90,14 +117,18 @@
  /**
   * @brief Handle 'add' command
   *
-  * Adds a new directory pair for monitoring and synchronization.
+  * Adds a new directory pair for monitoring and synchronization. Pairs
+  * whose source and target would feed events back into each other are
+  * rejected.
   *
   * @param source Source directory path
   * @param target Target directory path
+  * @param options Whitespace-separated key=value options (may be empty)
   * @param fd_out File descriptor for console output
   * @param log_file Pointer to log file
   */
- void handle_command_add(const char* source, const char* target, int fd_out, FILE* log_file);
+ void handle_command_add(const char* source, const char* target, const char* options,
+                         int fd_out, FILE* log_file);
  
  /**
   * @brief Handle 'cancel' command
@@ -121,6 +152,17 @@
   */
  void handle_command_status(const char* source, int fd_out, FILE* log_file);
  
+ /**
+  * @brief Handle 'status --all' command
+  *
+  * Streams one machine-readable record per source (see status_stream.h).
+  *
+  * @param end Line that ends the reply of a tagged request (NULL if untagged)
+  * @param fd_out File descriptor for console output
+  * @param log_file Pointer to log file
+  */
+ void handle_command_status_all(const char* end, int fd_out, FILE* log_file);
+ 
  /**
   * @brief Handle 'sync' command
   *
@@ -132,6 +174,28 @@
   */
  void handle_command_sync(const char* source, int fd_out, FILE* log_file);
  
+ /**
+  * @brief Handle 'verify' command
+  *
+  * Compares a digest=1 source with its target by their hash trees.
+  *
+  * @param source Source directory path to verify
+  * @param fd_out File descriptor for console output
+  * @param log_file Pointer to log file
+  */
+ void handle_command_verify(const char* source, int fd_out, FILE* log_file);
+ 
+ /**
+  * @brief Handle 'reconcile' command
+  *
+  * Queues tasks for the differences 'verify' would report.
+  *
+  * @param source Source directory path to reconcile
+  * @param fd_out File descriptor for console output
+  * @param log_file Pointer to log file
+  */
+ void handle_command_reconcile(const char* source, int fd_out, FILE* log_file);
+ 
  /**
   * @brief Handle 'shutdown' command
   *
@@ -143,13 +207,72 @@
  void handle_command_shutdown(int fd_out, FILE* log_file);
  
  /**
-  * @brief SIGCHLD signal handler
+  * @brief Handle 'watch' command
   *
-  * Handles the termination of worker processes.
+  * Subscribes the console to pushed task events.
   *
-  * @param signum Signal number (SIGCHLD)
+  * @param source Source to watch (NULL for all sources)
+  * @param fd_out File descriptor for console output
+  * @param log_file Pointer to log file
+  */
+ void handle_command_watch(const char* source, int fd_out, FILE* log_file);
+ 
+ /**
+  * @brief Handle 'unwatch' command
+  *
+  * Ends the console's subscription.
+  *
+  * @param fd_out File descriptor for console output
+  * @param log_file Pointer to log file
+  */
+ void handle_command_unwatch(int fd_out, FILE* log_file);
+ 
+ /**
+  * @brief Handle finished workers
+  *
+  * Processes the worker completions reported by the completion thread
+  * and starts queued tasks as worker slots free up.
+  *
+  * @param log_file Pointer to log file
+  */
+ void handle_worker_completions(FILE* log_file);
+ 
+ /**
+  * @brief Run the sync policy timers that are due
+  *
+  * Flushes the changes of interval sources whose period elapsed and
+  * opens or closes the windows of window sources.
+  *
+  * @param log_file Pointer to log file
+  */
+ void handle_timers(FILE* log_file);
+
+ /**
+  * @brief Create the shared status table
+  *
+  * Readers map it to see every source's state without going through
+  * the FIFOs (see status_shm.h).
+  *
+  * @param path Table file
+  * @param log_file Pointer to log file
+  */
+ void open_status_table(const char* path, FILE* log_file);
+ 
+ /**
+  * @brief Publish the sources that changed into the shared status table
+  *
+  * Does work at most every 100 ms; the caller should come back within
+  * that time while it returns 1.
+  *
+  * @param log_file Pointer to log file
+  * @return 1 if changes are left for a later call, 0 otherwise
+  */
+ int publish_status(FILE* log_file);
+ 
+ /**
+  * @brief Remove the shared status table
   */
- void sigchld_handler(int signum);
+ void close_status_table();
  
  /**
   * @brief Start a worker process for synchronization
@@ -0,0 +1,187 @@
+/**
+ * @file fss_pipeline.h
+ * @brief Ingestion and completion threads for the FSS manager
+ *
+ * The manager is split into three threads that talk through lock-free MPSC
+ * queues:
+ * - one ingestion thread per inotify instance drains it into the event queue,
+ * - the scheduler (the manager's main thread) owns the hashmap, the worker
+ *   lists and the task queue, and handles console commands,
+ * - the completion/logging thread collects worker output, reaps workers and
+ *   writes the log file, so slow flushes never stall event ingestion.
+ */
+
+ #ifndef FSS_PIPELINE_H
+ #define FSS_PIPELINE_H
+
+ #include "mpsc_queue.h"
+ #include <stdio.h>
+ #include <stdint.h>
+ #include <sys/types.h>
+ #include <linux/limits.h>
+
+ #define PIPELINE_MAX_SHARDS 64  /**< Most inotify instances (and ingestion threads) */
+
+ /**
+  * @struct fss_event
+  * @brief A raw inotify event handed from the ingestion thread to the scheduler
+  */
+ typedef struct fss_event {
+     mpsc_node_t node;          /**< Queue link */
+     int shard;                 /**< inotify instance it came from (-1 if synthetic) */
+     int wd;                    /**< Watch descriptor the event was reported on */
+     uint32_t mask;             /**< inotify event mask */
+     uint32_t cookie;           /**< Cookie pairing rename halves */
+     char name[NAME_MAX + 1];   /**< Name of the affected entry ("" if none) */
+ } fss_event_t;
+
+ /**
+  * @struct worker_completion
+  * @brief Result of a finished worker handed back to the scheduler
+  */
+ typedef struct worker_completion {
+     mpsc_node_t node;          /**< Queue link */
+     pid_t pid;                 /**< Process ID of the finished worker */
+     char status[16];           /**< STATUS field of the EXEC_REPORT */
+     char details[128];         /**< DETAILS field of the EXEC_REPORT */
+     unsigned long long bytes;  /**< BYTES field of the EXEC_REPORT */
+ } worker_completion_t;
+
+ /**
+  * @brief Start the ingestion and completion/logging threads
+  *
+  * Watch descriptors are only unique within one instance, so events carry
+  * the index of the instance they came from. Events of one instance stay
+  * in order; events of different instances may interleave.
+  *
+  * @param inotify_fds Non-blocking inotify instances to drain, one thread each
+  * @param n Number of instances (1 to PIPELINE_MAX_SHARDS)
+  * @param log_file Log file written by the logging thread (may be NULL)
+  */
+ void pipeline_start(const int* inotify_fds, int n, FILE* log_file);
+
+ /**
+  * @brief Stop both threads and flush any pending log lines
+  */
+ void pipeline_stop(void);
+
+ /**
+  * @brief Get the descriptor the scheduler should wait on
+  *
+  * Becomes readable whenever new events or completions are queued.
+  *
+  * @return eventfd descriptor
+  */
+ int pipeline_wake_fd(void);
+
+ /**
+  * @brief Reset the scheduler's wake descriptor after it fired
+  */
+ void pipeline_clear_wake(void);
+
+ /**
+  * @brief Pop the next inotify event (scheduler thread only)
+  *
+  * @return Event to process and release, or NULL if none is queued
+  */
+ fss_event_t* pipeline_next_event(void);
+
+ /**
+  * @brief Give a processed event back to the event arena (scheduler thread only)
+  *
+  * @param e Event from pipeline_next_event()
+  */
+ void pipeline_release_event(fss_event_t* e);
+
+ /**
+  * @brief Queue an event that did not come from inotify (any thread)
+  *
+  * Lets other change detectors feed the scheduler through the same path
+  * as the ingestion thread. Call pipeline_wake_scheduler() after a batch.
+  *
+  * @param wd Watch descriptor the scheduler maps the event to
+  * @param mask inotify-style event mask
+  * @param name Name of the affected entry ("" if none)
+  */
+ void pipeline_post_event(int wd, uint32_t mask, const char* name);
+
+ /**
+  * @brief Wake the scheduler to drain what was queued (any thread)
+  */
+ void pipeline_wake_scheduler(void);
+
+ /**
+  * @brief Back the event arena with huge pages (call before pipeline_start)
+  *
+  * @param on Non-zero to request huge pages
+  */
+ void pipeline_use_huge_pages(int on);
+
+ /**
+  * @brief Pop the next worker completion (scheduler thread only)
+  *
+  * @return Completion to process and free, or NULL if none is queued
+  */
+ worker_completion_t* pipeline_next_completion(void);
+
+ /**
+  * @brief Hand a freshly started worker to the completion thread
+  *
+  * The completion thread takes ownership of pipe_fd, collects the worker's
+  * output while it runs, reaps it and logs the result.
+  *
+  * @param pid Process ID of the worker
+  * @param pipe_fd Read end of the worker's stdout pipe
+  * @param src Source directory path
+  * @param dst Target directory path
+  * @param op Operation type
+  */
+ void pipeline_watch_worker(pid_t pid, int pipe_fd, const char* src,
+                            const char* dst, const char* op);
+
+ /**
+  * @brief Report a finished task to the scheduler
+  *
+  * Logs the result line and queues a completion. Used by the completion
+  * thread for worker processes and by executor threads for in-process tasks;
+  * safe to call from any thread.
+  *
+  * @param id Worker process ID (or in-process task ID)
+  * @param src Source directory path
+  * @param dst Target directory path
+  * @param op Operation type
+  * @param status Result status ("SUCCESS", "PARTIAL", "ERROR", ...)
+  * @param details Result details
+  * @param bytes Bytes written into the target
+  */
+ void pipeline_post_completion(pid_t id, const char* src, const char* dst,
+                               const char* op, const char* status, const char* details,
+                               unsigned long long bytes);
+
+ /**
+  * @brief Write a line to the log file
+  *
+  * When the logging thread is running for log_file the line is queued and
+  * written in the background; otherwise it is written and flushed directly.
+  *
+  * @param log_file Log file to write to
+  * @param fmt printf-style format string
+  */
+ void fss_log(FILE* log_file, const char* fmt, ...)
+     __attribute__((format(printf, 2, 3)));
+
+ /**
+  * @brief Total number of inotify events ingested so far
+  *
+  * @return Event count
+  */
+ unsigned long pipeline_events_ingested(void);
+
+ /**
+  * @brief Number of inotify queue overflows seen so far
+  *
+  * @return Overflow count
+  */
+ unsigned long pipeline_overflows(void);
+
+ #endif /* FSS_PIPELINE_H */
@@ -0,0 +1,157 @@
+/**
+ * @file libfss.h
+ * @brief Client library for the manager's control protocol
+ *
+ * A connection opens the manager's FIFOs once and is reused for any number
+ * of requests. Requests are asynchronous: fss_submit() queues a command and
+ * returns at once, fss_poll() writes queued commands and reads replies,
+ * and each reply is handed to the request's callback. Up to
+ * FSS_CLIENT_WINDOW requests are in flight at a time, so a batch of
+ * commands costs a few FIFO round trips instead of one per command.
+ *
+ * Every command is sent with a request tag ("@<pid>.<seq> <command>"), and
+ * the manager ends its reply with "@<pid>.<seq> END"; replies come back in
+ * request order. "EVENT ..." lines pushed to a watching client are passed
+ * to the event handler instead, whatever request is in flight. A
+ * "status --all" request is sent alone: its records are written after the
+ * replies to later commands would be, so nothing is pipelined behind it.
+ *
+ * The manager has one output FIFO, so only one client can be connected at
+ * a time. A process using the library should ignore SIGPIPE; a manager
+ * that went away is then reported as a closed connection.
+ */
+
+ #ifndef LIBFSS_H
+ #define LIBFSS_H
+
+ #include <stddef.h>
+
+ #define FSS_CLIENT_WINDOW 32      /**< Requests in flight at once */
+ #define FSS_MAX_COMMAND 960       /**< Longest command accepted by fss_submit() */
+
+ /**
+  * @enum fss_reply_status
+  * @brief Outcome of a request, passed to its callback
+  */
+ typedef enum fss_reply_status {
+     FSS_REPLY_OK = 0,             /**< The reply is complete */
+     FSS_REPLY_TIMEOUT,            /**< No complete reply within the request's timeout */
+     FSS_REPLY_CLOSED              /**< The connection was lost or closed first */
+ } fss_reply_status_t;
+
+ /**
+  * @brief Called once per request when it completes or fails
+  *
+  * @param status Outcome
+  * @param reply Reply lines, newline-terminated ("" unless status is FSS_REPLY_OK);
+  *              valid only during the call
+  * @param ctx Context given to fss_submit()
+  */
+ typedef void (*fss_reply_fn)(fss_reply_status_t status, const char* reply, void* ctx);
+
+ /**
+  * @brief Called for each pushed event line, and for lines no request owns
+  *
+  * @param line Line without its newline
+  * @param ctx Context given to fss_on_event()
+  */
+ typedef void (*fss_event_fn)(const char* line, void* ctx);
+
+ /** Opaque connection to the manager */
+ typedef struct fss_client fss_client_t;
+
+ /**
+  * @brief Connect to the manager
+  *
+  * Waits for the manager to create its FIFOs if they do not exist yet.
+  *
+  * @param dir Directory holding fss_in and fss_out (NULL for the current one)
+  * @param timeout_ms How long to wait for the FIFOs (negative = forever)
+  * @return Connection, or NULL on error (errno set, ETIMEDOUT if the FIFOs never appeared)
+  */
+ fss_client_t* fss_connect(const char* dir, int timeout_ms);
+
+ /**
+  * @brief Close a connection
+  *
+  * Requests still pending complete with FSS_REPLY_CLOSED.
+  *
+  * @param c Connection (may be NULL)
+  */
+ void fss_close(fss_client_t* c);
+
+ /**
+  * @brief Set the handler for pushed events and unowned lines
+  *
+  * Without one, such lines are dropped.
+  *
+  * @param c Connection
+  * @param fn Handler (NULL to drop)
+  * @param ctx Context passed to fn
+  */
+ void fss_on_event(fss_client_t* c, fss_event_fn fn, void* ctx);
+
+ /**
+  * @brief Queue a command
+  *
+  * Nothing is written until the next fss_poll(), fss_wait() or fss_call().
+  *
+  * @param c Connection
+  * @param command Command line without newline (e.g. "status /data")
+  * @param timeout_ms Time from now the reply may take (negative = no limit)
+  * @param fn Reply callback (NULL to ignore the reply)
+  * @param ctx Context passed to fn
+  * @return 0 on success, -1 on error (errno EINVAL for a bad command, EPIPE if closed)
+  */
+ int fss_submit(fss_client_t* c, const char* command, int timeout_ms, fss_reply_fn fn, void* ctx);
+
+ /**
+  * @brief Send queued commands, read replies and run callbacks
+  *
+  * @param c Connection
+  * @param timeout_ms Longest time to wait for progress (0 = don't wait, negative = forever)
+  * @return Number of callbacks run, or -1 if the connection is lost
+  */
+ int fss_poll(fss_client_t* c, int timeout_ms);
+
+ /**
+  * @brief Run fss_poll() until no request is pending
+  *
+  * @param c Connection
+  * @param timeout_ms Longest time to wait (negative = forever)
+  * @return 0 when idle, -1 on timeout (ETIMEDOUT) or a lost connection (EPIPE)
+  */
+ int fss_wait(fss_client_t* c, int timeout_ms);
+
+ /**
+  * @brief Send one command and wait for its reply
+  *
+  * Other pending requests make progress meanwhile.
+  *
+  * @param c Connection
+  * @param command Command line without newline
+  * @param timeout_ms Time the reply may take (negative = no limit)
+  * @return Reply (free() it), or NULL on error (errno ETIMEDOUT, EPIPE or EINVAL)
+  */
+ char* fss_call(fss_client_t* c, const char* command, int timeout_ms);
+
+ /**
+  * @brief Requests submitted and not completed yet
+  *
+  * @param c Connection
+  * @return Pending requests
+  */
+ size_t fss_pending(const fss_client_t* c);
+
+ /**
+  * @brief File descriptor that becomes readable when replies or events arrive
+  *
+  * For callers with their own select()/poll() loop: call fss_poll(c, 0)
+  * when it is readable, and after submitting commands.
+  *
+  * @param c Connection
+  * @return Read end of the manager's output FIFO
+  */
+ int fss_fd(const fss_client_t* c);
+
+ #endif /* LIBFSS_H */
@@ -0,0 +1,126 @@
+/**
+ * @file merkle.h
+ * @brief Hash trees of directory trees, for comparing replicas by digest
+ *
+ * A tree mirrors a directory tree. Each file gets a digest of its name,
+ * type, size and mtime (the same test for "unchanged" that skip_unchanged
+ * uses), and each directory a digest of its name and of its entries'
+ * digests. Two trees are compared top-down, descending only into
+ * directories whose digests differ, so comparing two replicas costs time
+ * proportional to where they diverge rather than to their size.
+ *
+ * A directory combines its entries' digests by addition, which does not
+ * depend on their order: changing one entry adjusts the sums along its
+ * path to the root, O(depth), and nothing is re-read or re-sorted.
+ * Trees are not thread-safe; callers serialize access to each one.
+ */
+
+ #ifndef MERKLE_H
+ #define MERKLE_H
+
+ #include <stddef.h>
+ #include <stdint.h>
+ #include <sys/stat.h>
+
+ #define MERKLE_NO_SIZE  0x1   /**< Leave sizes out of file digests (compressed targets) */
+ #define MERKLE_NO_MTIME 0x2   /**< Leave mtimes out of file digests (copies without preserve_times) */
+
+ /** Opaque hash tree */
+ typedef struct merkle_tree merkle_tree_t;
+
+ /**
+  * @enum merkle_diff_kind
+  * @brief How an entry differs between two trees
+  */
+ typedef enum merkle_diff_kind {
+     MERKLE_ONLY_A,            /**< Only in the first tree */
+     MERKLE_ONLY_B,            /**< Only in the second tree */
+     MERKLE_DIFFERS            /**< In both, with different contents or types */
+ } merkle_diff_kind_t;
+
+ /**
+  * @brief Called for each difference found by merkle_diff()
+  *
+  * A directory present in one tree only is reported once, not entry by entry.
+  *
+  * @param path Entry path relative to the root
+  * @param kind How it differs
+  * @param is_dir The entry is a directory (in the first tree, for MERKLE_DIFFERS)
+  * @param ctx Context passed to merkle_diff()
+  * @return 0 to continue, nonzero to stop the comparison
+  */
+ typedef int (*merkle_diff_fn)(const char* path, merkle_diff_kind_t kind, int is_dir, void* ctx);
+
+ /**
+  * @brief Create an empty tree
+  *
+  * @param flags MERKLE_NO_SIZE and/or MERKLE_NO_MTIME
+  * @return New tree
+  */
+ merkle_tree_t* merkle_create(unsigned flags);
+
+ /**
+  * @brief Free a tree
+  *
+  * @param t Tree to destroy (may be NULL)
+  */
+ void merkle_destroy(merkle_tree_t* t);
+
+ /**
+  * @brief Set or remove one entry
+  *
+  * Missing parent directories are added. A directory entry keeps its
+  * children; removing an entry removes everything below it.
+  *
+  * @param t Tree
+  * @param path Path relative to the root ("a/b/c")
+  * @param st Entry's lstat() data, or NULL to remove it
+  * @return 0 on success, -1 if path is empty
+  */
+ int merkle_update(merkle_tree_t* t, const char* path, const struct stat* st);
+
+ /**
+  * @brief Bring the part of a tree under path in line with the filesystem
+  *
+  * Stats root/path; a directory is walked, and entries of the tree below
+  * it that the walk did not find are removed.
+  *
+  * @param t Tree
+  * @param root Directory the tree mirrors
+  * @param path Path relative to root ("" for the whole tree)
+  * @param threads Walker threads for directories
+  * @return Entries stat'ed, or -1 if root itself cannot be read (the tree is then emptied)
+  */
+ long merkle_scan(merkle_tree_t* t, const char* root, const char* path, int threads);
+
+ /**
+  * @brief Digest of an entry
+  *
+  * @param t Tree
+  * @param path Path relative to the root ("" for the root)
+  * @return Digest, or 0 if the tree has no such entry
+  */
+ uint64_t merkle_digest(const merkle_tree_t* t, const char* path);
+
+ /**
+  * @brief Number of entries below the root
+  *
+  * @param t Tree
+  * @return Files, directories and other entries
+  */
+ size_t merkle_size(const merkle_tree_t* t);
+
+ /**
+  * @brief Compare two trees
+  *
+  * Subtrees with equal digests are skipped without being visited.
+  *
+  * @param a First tree
+  * @param b Second tree
+  * @param fn Callback for each difference
+  * @param ctx Context passed to fn
+  * @return Entries visited
+  */
+ long merkle_diff(const merkle_tree_t* a, const merkle_tree_t* b, merkle_diff_fn fn, void* ctx);
+
+ #endif /* MERKLE_H */
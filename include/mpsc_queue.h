@@ -0,0 +1,73 @@
+/**
+ * @file mpsc_queue.h
+ * @brief Lock-free multi-producer single-consumer queue
+ *
+ * This header defines an intrusive, unbounded MPSC queue (Vyukov style) used
+ * to hand work between the manager's threads without taking locks. Producers
+ * may push from any thread; only one thread may pop.
+ */
+
+ #ifndef MPSC_QUEUE_H
+ #define MPSC_QUEUE_H
+
+ #include <stddef.h>
+ #include <stdatomic.h>
+
+ /**
+  * @brief Recover the enclosing structure from an embedded queue node
+  *
+  * @param ptr Pointer to the mpsc_node_t member
+  * @param type Type of the enclosing structure
+  * @param member Name of the mpsc_node_t member inside the structure
+  */
+ #define mpsc_entry(ptr, type, member) \
+     ((type*)((char*)(ptr) - offsetof(type, member)))
+
+ /**
+  * @struct mpsc_node
+  * @brief Link embedded in every item that travels through a queue
+  */
+ typedef struct mpsc_node {
+     _Atomic(struct mpsc_node*) next; /**< Next node (written by producers) */
+ } mpsc_node_t;
+
+ /**
+  * @struct mpsc_queue_t
+  * @brief Queue state
+  *
+  * Producers only touch head; the consumer owns tail. The stub node keeps
+  * the list non-empty so push never has to special-case an empty queue.
+  */
+ typedef struct {
+     _Atomic(mpsc_node_t*) head; /**< Most recently pushed node */
+     mpsc_node_t* tail;          /**< Next node to pop (consumer only) */
+     mpsc_node_t stub;           /**< Sentinel node */
+ } mpsc_queue_t;
+
+ /**
+  * @brief Initialize an empty queue
+  *
+  * @param q Queue to initialize
+  */
+ void mpsc_init(mpsc_queue_t* q);
+
+ /**
+  * @brief Push a node (safe from any thread)
+  *
+  * @param q Queue to push to
+  * @param n Node to push; must stay valid until popped
+  */
+ void mpsc_push(mpsc_queue_t* q, mpsc_node_t* n);
+
+ /**
+  * @brief Pop the oldest node (consumer thread only)
+  *
+  * May return NULL while a producer is halfway through a push; the producer
+  * is expected to signal the consumer again once its push completes.
+  *
+  * @param q Queue to pop from
+  * @return Oldest node, or NULL if none is available
+  */
+ mpsc_node_t* mpsc_pop(mpsc_queue_t* q);
+
+ #endif /* MPSC_QUEUE_H */
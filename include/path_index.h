@@ -0,0 +1,102 @@
+/**
+ * @file path_index.h
+ * @brief Compressed radix tree keyed by directory paths
+ *
+ * This header declares an index from paths to arbitrary values. Edges carry
+ * whole path fragments, so lookups cost one comparison per branching point
+ * rather than per character. Unlike the hashmap it answers prefix queries:
+ * "which indexed directory contains this path" and "is anything indexed
+ * below this directory". Prefix matches always end on a '/' boundary, so
+ * "/data/a" never contains "/data/ab".
+ */
+
+ #ifndef PATH_INDEX_H
+ #define PATH_INDEX_H
+
+ #include <stddef.h>
+
+ typedef struct path_index path_index_t;  /**< Opaque index */
+
+ /**
+  * @brief Create an empty index
+  *
+  * @return New index
+  */
+ path_index_t* path_index_create(void);
+
+ /**
+  * @brief Free an index (values are not freed)
+  *
+  * @param idx Index to destroy (may be NULL)
+  */
+ void path_index_destroy(path_index_t* idx);
+
+ /**
+  * @brief Insert or replace a path
+  *
+  * @param idx Index
+  * @param path Normalized path (see path_index_canonical())
+  * @param value Value to store (must not be NULL)
+  * @return Previous value for path, or NULL if it was not indexed
+  */
+ void* path_index_insert(path_index_t* idx, const char* path, void* value);
+
+ /**
+  * @brief Remove a path
+  *
+  * @param idx Index
+  * @param path Path to remove
+  * @return Removed value, or NULL if path was not indexed
+  */
+ void* path_index_remove(path_index_t* idx, const char* path);
+
+ /**
+  * @brief Exact lookup
+  *
+  * @param idx Index
+  * @param path Path to look up
+  * @return Value, or NULL if path is not indexed
+  */
+ void* path_index_find(const path_index_t* idx, const char* path);
+
+ /**
+  * @brief Find the deepest indexed directory containing path (or equal to it)
+  *
+  * @param idx Index
+  * @param path Path to route
+  * @param matched If not NULL, receives the length of the matching key
+  * @return Value of the longest matching key, or NULL if none contains path
+  */
+ void* path_index_longest_prefix(const path_index_t* idx, const char* path, size_t* matched);
+
+ /**
+  * @brief Find any indexed path strictly below dir
+  *
+  * @param idx Index
+  * @param dir Directory to look under
+  * @return Value of some key inside dir, or NULL if there is none
+  */
+ void* path_index_find_under(const path_index_t* idx, const char* dir);
+
+ /**
+  * @brief Number of indexed paths
+  *
+  * @param idx Index
+  * @return Number of keys
+  */
+ size_t path_index_size(const path_index_t* idx);
+
+ /**
+  * @brief Normalize a path for use as a key
+  *
+  * Resolves the path with realpath() when it exists (or its parent does),
+  * so different spellings of one directory share a key; otherwise only
+  * collapses repeated slashes and strips the trailing one.
+  *
+  * @param path Path as configured
+  * @param out Buffer for the key
+  * @param outlen Size of out
+  */
+ void path_index_canonical(const char* path, char* out, size_t outlen);
+
+ #endif /* PATH_INDEX_H */
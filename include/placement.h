@@ -0,0 +1,135 @@
+/**
+ * @file placement.h
+ * @brief CPU and NUMA placement for synchronization tasks
+ *
+ * This header declares a small placement layer built on sysfs and
+ * sched_setaffinity(), with no libnuma dependency. Nodes and their CPU
+ * lists are read from /sys/devices/system/node; a machine without that
+ * directory is treated as a single node holding every CPU. A block device
+ * is mapped to the node its controller reports in sysfs.
+ *
+ * A task bound to a node runs, and allocates its copy buffers, on that
+ * node's CPUs; buffers from placement_buf_alloc() are first touched there,
+ * so the kernel's default local allocation puts their pages on that node too.
+ * Buffers can also be backed by huge pages to cut TLB misses on large copies.
+ */
+
+ #ifndef PLACEMENT_H
+ #define PLACEMENT_H
+
+ #include <sched.h>   /* cpu_set_t: includers define _GNU_SOURCE */
+ #include <stddef.h>
+
+ #define PLACEMENT_MAX_NODES 64   /**< Highest node count supported */
+ #define PLACEMENT_OFF  (-1)      /**< numa_node=off: leave the task unpinned */
+ #define PLACEMENT_AUTO (-2)      /**< numa_node=auto: use the target's (or source's) device node */
+
+ #define PLACEMENT_HUGE_PAGE (2UL * 1024 * 1024)  /**< Huge page size assumed for rounding */
+
+ /**
+  * @enum placement_pages
+  * @brief Kind of pages backing a buffer
+  */
+ typedef enum placement_pages {
+     PLACEMENT_PAGES_SMALL = 0,   /**< Regular pages */
+     PLACEMENT_PAGES_HUGETLB,     /**< Reserved huge pages (MAP_HUGETLB) */
+     PLACEMENT_PAGES_THP          /**< Transparent huge pages (MADV_HUGEPAGE) */
+ } placement_pages_t;
+
+ /**
+  * @struct placement_buf
+  * @brief A buffer from placement_buf_alloc()
+  */
+ typedef struct placement_buf {
+     void* data;                /**< Usable memory (NULL if unallocated) */
+     size_t size;               /**< Bytes requested */
+     size_t mapped;             /**< Bytes mapped (size rounded for huge pages) */
+     placement_pages_t pages;   /**< Pages actually obtained */
+ } placement_buf_t;
+
+ /**
+  * @brief Number of NUMA nodes (at least 1)
+  *
+  * Discovers the topology on first use; safe to call from any thread.
+  *
+  * @return Node count
+  */
+ int placement_nodes(void);
+
+ /**
+  * @brief CPUs of a node
+  *
+  * @param node Node number
+  * @param set Filled with the node's CPUs
+  * @return 0 on success, -1 if the node does not exist
+  */
+ int placement_node_cpus(int node, cpu_set_t* set);
+
+ /**
+  * @brief NUMA node of the block device holding a path
+  *
+  * Results are cached per device.
+  *
+  * @param path Any path on the device
+  * @return Node number, or -1 if unknown (non-block filesystems, no sysfs)
+  */
+ int placement_node_of_path(const char* path);
+
+ /**
+  * @brief Resolve a numa_node option for a source/target pair
+  *
+  * @param numa_node Node number, PLACEMENT_AUTO or PLACEMENT_OFF
+  * @param source_dir Source directory
+  * @param target_dir Target directory
+  * @return Node to bind to, or -1 for no binding
+  */
+ int placement_resolve(int numa_node, const char* source_dir, const char* target_dir);
+
+ /**
+  * @brief Pin the calling thread to a node's CPUs
+  *
+  * Threads the caller creates afterwards inherit the binding.
+  *
+  * @param node Node number
+  * @param saved Filled with the previous affinity (may be NULL)
+  * @return 0 on success, -1 on error
+  */
+ int placement_bind(int node, cpu_set_t* saved);
+
+ /**
+  * @brief Undo placement_bind()
+  *
+  * @param saved Affinity returned by placement_bind()
+  */
+ void placement_unbind(const cpu_set_t* saved);
+
+ /**
+  * @brief Node the calling thread is bound to
+  *
+  * @return Node number, or -1 if the thread is not bound
+  */
+ int placement_current_node(void);
+
+ /**
+  * @brief Allocate a buffer whose pages live on the calling thread's node
+  *
+  * The pages are mapped fresh and first touched here. With huge set the
+  * size is rounded up to whole huge pages; reserved huge pages are tried
+  * first, then a huge-page-aligned mapping advised with MADV_HUGEPAGE,
+  * then regular pages. b->pages says which one was obtained.
+  *
+  * @param b Buffer to fill in
+  * @param size Bytes needed
+  * @param huge Back the buffer with huge pages if possible
+  * @return 0 on success, -1 on error
+  */
+ int placement_buf_alloc(placement_buf_t* b, size_t size, int huge);
+
+ /**
+  * @brief Free a buffer from placement_buf_alloc()
+  *
+  * @param b Buffer (freeing an unallocated one does nothing)
+  */
+ void placement_buf_free(placement_buf_t* b);
+
+ #endif /* PLACEMENT_H */
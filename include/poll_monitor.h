@@ -0,0 +1,136 @@
+/**
+ * @file poll_monitor.h
+ * @brief Polling change detection for filesystems without inotify
+ *
+ * On NFS, FUSE and SMB mounts inotify_add_watch() succeeds but only sees
+ * changes made through the local mount. A source may instead be polled:
+ *
+ *   monitor=inotify|poll  How changes are detected (default inotify)
+ *   poll_min=SECONDS      Shortest polling interval (default 2)
+ *   poll_max=SECONDS      Longest polling interval (default 60)
+ *
+ * Each scan lists the directory once and stats every entry relative to the
+ * listing's directory fd, then diffs the result against an in-memory
+ * manifest of the previous scan and reports the differences as inotify
+ * masks, so polled changes are routed exactly like watched ones. Like the
+ * inotify watch, a scan covers the top level of the source only.
+ */
+
+ #ifndef POLL_MONITOR_H
+ #define POLL_MONITOR_H
+
+ #include <stddef.h>
+ #include <stdint.h>
+
+ /**
+  * @brief How a source's changes are detected
+  */
+ typedef enum {
+     MONITOR_INOTIFY,  /**< inotify watch (default) */
+     MONITOR_POLL      /**< Periodic rescans */
+ } monitor_kind_t;
+
+ /**
+  * @struct poll_options
+  * @brief Configured change detection of a source
+  */
+ typedef struct poll_options {
+     monitor_kind_t monitor;  /**< Backend */
+     int min_interval;        /**< Shortest polling interval in seconds */
+     int max_interval;        /**< Longest polling interval in seconds */
+ } poll_options_t;
+
+ /**
+  * @brief Fill in the defaults (inotify)
+  *
+  * @param o Options to initialize
+  */
+ void poll_options_init(poll_options_t* o);
+
+ /**
+  * @brief Set one monitor option
+  *
+  * @param o Options to update
+  * @param key Option name
+  * @param value Option value
+  * @return 0 if set, -1 if the value is invalid, 1 if key is not a monitor option
+  */
+ int poll_options_set(poll_options_t* o, const char* key, const char* value);
+
+ /**
+  * @brief Check the options once all of them are set
+  *
+  * @param o Options
+  * @return 0 if usable, -1 if poll_min exceeds poll_max
+  */
+ int poll_options_validate(const poll_options_t* o);
+
+ /**
+  * @brief Pick the interval until the next scan
+  *
+  * Halves the interval after a scan that found changes and doubles it after
+  * a quiet one, within [min_interval, max_interval]. A slow scan also keeps
+  * the interval at four times its duration or more, so polling a large or
+  * slow directory never takes more than a quarter of the time.
+  *
+  * @param o Options
+  * @param cur Current interval in seconds
+  * @param changes Changes the last scan found
+  * @param scan_ms How long the last scan took
+  * @return Next interval in seconds
+  */
+ int poll_next_interval(const poll_options_t* o, int cur, size_t changes, long long scan_ms);
+
+ /** Opaque manifest of one directory's entries */
+ typedef struct poll_manifest poll_manifest_t;
+
+ /**
+  * @brief Change callback
+  *
+  * @param name Entry name
+  * @param mask IN_CREATE, IN_MODIFY or IN_DELETE, with IN_ISDIR for directories
+  * @param ctx Context passed to poll_scan()
+  */
+ typedef void (*poll_change_fn)(const char* name, uint32_t mask, void* ctx);
+
+ /**
+  * @brief Create an empty manifest
+  *
+  * @return New manifest
+  */
+ poll_manifest_t* poll_manifest_create(void);
+
+ /**
+  * @brief Free a manifest
+  *
+  * @param m Manifest to destroy (may be NULL)
+  */
+ void poll_manifest_destroy(poll_manifest_t* m);
+
+ /**
+  * @brief Number of entries the last scan found
+  *
+  * @param m Manifest
+  * @return Entries
+  */
+ size_t poll_manifest_size(const poll_manifest_t* m);
+
+ /**
+  * @brief Rescan a directory and report what changed since the last scan
+  *
+  * The first successful scan only records the baseline. A file whose size,
+  * modification time or inode changed is reported modified, one whose type
+  * changed is reported deleted and created again. Directories are only
+  * reported when they appear or disappear. A scan that cannot open the
+  * directory reports nothing and leaves the manifest as it was, so an
+  * unreachable mount never looks like a mass deletion.
+  *
+  * @param m Manifest of the directory (not shared between threads)
+  * @param dir Directory to scan
+  * @param fn Callback for each change
+  * @param ctx Context passed to fn
+  * @return Number of changes reported, or -1 if dir could not be read
+  */
+ long poll_scan(poll_manifest_t* m, const char* dir, poll_change_fn fn, void* ctx);
+
+ #endif /* POLL_MONITOR_H */
@@ -0,0 +1,60 @@
+/**
+ * @file purge.h
+ * @brief Parallel tree deletion
+ *
+ * This header declares the engine behind fss_purge. Files are unlinked with
+ * unlinkat() by parallel directory walker threads, relative to the fd of the
+ * directory being listed; directories are removed afterwards, deepest first.
+ * An optional rate limit keeps a background purge from starving the disk.
+ */
+
+ #ifndef PURGE_H
+ #define PURGE_H
+
+ #include <stddef.h>
+
+ /**
+  * @struct purge_opts
+  * @brief Purge options
+  */
+ typedef struct purge_opts {
+     int threads;  /**< Walker threads (<= 1 for single-threaded) */
+     long rate;    /**< Maximum unlinks per second (0 = unlimited) */
+ } purge_opts_t;
+
+ /**
+  * @struct purge_stats
+  * @brief What a purge removed
+  */
+ typedef struct purge_stats {
+     unsigned long files;   /**< Non-directory entries unlinked */
+     unsigned long dirs;    /**< Directories removed */
+     unsigned long errors;  /**< Entries that could not be removed */
+ } purge_stats_t;
+
+ /**
+  * @brief Delete a file or a whole directory tree
+  *
+  * @param path File or directory to delete
+  * @param opts Options (NULL for single-threaded, unlimited rate)
+  * @param stats Receives counters (may be NULL)
+  * @return 0 if everything was removed, -1 otherwise (errno set if path
+  *         itself could not be accessed)
+  */
+ int purge_tree(const char* path, const purge_opts_t* opts, purge_stats_t* stats);
+
+ /**
+  * @brief Rename a path aside so it disappears immediately
+  *
+  * The new name is a hidden sibling (".fss_purge.<name>.<pid>.<time>") on
+  * the same filesystem, so the rename is atomic and the tree can be deleted
+  * at leisure.
+  *
+  * @param path Path to move
+  * @param aside Buffer for the new path
+  * @param len Size of aside
+  * @return 0 on success, -1 on error (errno set)
+  */
+ int purge_rename_aside(const char* path, char* aside, size_t len);
+
+ #endif /* PURGE_H */
@@ -0,0 +1,31 @@
+/**
+ * @file source_options.h
+ * @brief Per-source options from the configuration file
+ *
+ * A config line may follow "source target" with any number of "key=value"
+ * options. Options the worker understands (see sync_options_t) are kept as
+ * a string in sync_info_t and handed to every task for that source;
+ * priority options (see task_priority.h) are kept in sync_info_t.priority,
+ * policy options (see sync_policy.h) in sync_info_t.policy, monitor
+ * options (see poll_monitor.h) in sync_info_t.poll, max_lag=SECONDS in
+ * sync_info_t.max_lag and digest=0|1 in sync_info_t.digest.
+ */
+
+ #ifndef SOURCE_OPTIONS_H
+ #define SOURCE_OPTIONS_H
+
+ #include <stddef.h>
+ #include "sync_info.h"
+
+ /**
+  * @brief Parse the option part of a config line into a sync_info_t
+  *
+  * @param text Whitespace-separated "key=value" options (may be empty)
+  * @param info Source to configure
+  * @param err Buffer for an error message
+  * @param errlen Size of err
+  * @return 0 on success, -1 on the first invalid option (err filled in)
+  */
+ int source_options_parse(const char* text, sync_info_t* info, char* err, size_t errlen);
+
+ #endif /* SOURCE_OPTIONS_H */
@@ -0,0 +1,167 @@
+/**
+ * @file status_shm.h
+ * @brief Shared-memory status table
+ *
+ * The manager publishes the state of every source into a file it maps
+ * shared (STATUS_SHM_FILE, next to the FIFOs). Any process can map it
+ * read-only and read the state without a round trip through fss_in and
+ * the manager thread, so status reads cost the manager nothing and scale
+ * to any number of readers.
+ *
+ * Each slot is guarded by a sequence counter (a seqlock): the manager, the
+ * only writer, makes it odd while it updates the record and even again
+ * after. Readers copy the record and retry if the counter was odd or
+ * changed meanwhile. Slots are never reused for another source; a cancelled
+ * source keeps its slot with active = 0.
+ */
+
+ #ifndef STATUS_SHM_H
+ #define STATUS_SHM_H
+
+ #include <stddef.h>
+ #include <stdint.h>
+ #include <linux/limits.h>
+
+ #define STATUS_SHM_FILE "fss_status"  /**< Default table file */
+ #define STATUS_SHM_SLOTS 1024         /**< Sources the manager's table holds */
+
+ /**
+  * @struct status_record
+  * @brief Published state of one source
+  *
+  * Times in milliseconds are on CLOCK_MONOTONIC, which every process on
+  * the machine shares: a reader computes the replication lag itself as
+  * now - oldest_change_ms, so it stays current between updates.
+  */
+ typedef struct status_record {
+     char source[PATH_MAX];            /**< Source directory */
+     char target[PATH_MAX];            /**< Target directory */
+     int32_t active;                   /**< Monitored (1) or cancelled (0) */
+     int32_t errors;                   /**< Failed or partial tasks */
+     int32_t queued;                   /**< Tasks waiting in the task queue */
+     int32_t in_flight;                /**< Tasks running */
+     int32_t max_lag;                  /**< Configured max_lag in seconds (0 = none) */
+     int64_t last_sync;                /**< Wall-clock time of the last finished task (0 = never) */
+     int64_t oldest_change_ms;         /**< When the oldest unsynced change was seen (-1 = none) */
+     uint64_t bytes_synced;            /**< Bytes written into the target */
+     uint64_t held_changes;            /**< Changes held back by the sync policy */
+     uint64_t deadline_misses;         /**< Changes synced later than max_lag allowed */
+     uint64_t suppressed_events;       /**< Events dropped as caused by our own writes */
+     int64_t updated_ms;               /**< When the manager last published this record */
+ } status_record_t;
+
+ /** Opaque mapping of a status table */
+ typedef struct status_shm status_shm_t;
+
+ /**
+  * @brief Create a status table and map it for writing (manager only)
+  *
+  * @param path Table file (replaced if it exists)
+  * @param slots Number of sources it can hold
+  * @return Table, or NULL on error (errno set)
+  */
+ status_shm_t* status_shm_create(const char* path, unsigned slots);
+
+ /**
+  * @brief Map an existing status table for reading
+  *
+  * @param path Table file
+  * @return Table, or NULL if it is missing or not a status table
+  */
+ status_shm_t* status_shm_open(const char* path);
+
+ /**
+  * @brief Unmap a table
+  *
+  * @param t Table (may be NULL)
+  * @param remove Also delete the file (the manager does on shutdown)
+  */
+ void status_shm_close(status_shm_t* t, int remove);
+
+ /**
+  * @brief Claim the next free slot (writer only)
+  *
+  * @param t Table
+  * @return Slot index, or -1 if the table is full
+  */
+ int status_shm_claim(status_shm_t* t);
+
+ /**
+  * @brief Publish a record into a slot (writer only)
+  *
+  * @param t Table
+  * @param slot Slot from status_shm_claim()
+  * @param rec Record
+  */
+ void status_shm_publish(status_shm_t* t, int slot, const status_record_t* rec);
+
+ /**
+  * @brief Record that the writer is alive (writer only)
+  *
+  * @param t Table
+  * @param now_ms Current CLOCK_MONOTONIC time in milliseconds
+  */
+ void status_shm_heartbeat(status_shm_t* t, int64_t now_ms);
+
+ /**
+  * @brief Number of slots claimed so far
+  *
+  * @param t Table
+  * @return Slots
+  */
+ unsigned status_shm_count(const status_shm_t* t);
+
+ /**
+  * @brief Milliseconds since the writer's last heartbeat
+  *
+  * @param t Table
+  * @return Age, or -1 if the writer never published
+  */
+ int64_t status_shm_age_ms(const status_shm_t* t);
+
+ /**
+  * @brief Read a consistent copy of one slot
+  *
+  * @param t Table
+  * @param slot Slot index (below status_shm_count())
+  * @param out Record copy
+  * @return 0 on success, -1 if slot is out of range
+  */
+ int status_shm_read(const status_shm_t* t, unsigned slot, status_record_t* out);
+
+ /**
+  * @brief Read the record of a source
+  *
+  * @param t Table
+  * @param source Source directory, as given to the manager
+  * @param out Record copy
+  * @return 0 on success, -1 if the table has no such source
+  */
+ int status_shm_find(const status_shm_t* t, const char* source, status_record_t* out);
+
+ /**
+  * @brief Header line naming the fields of status_shm_format()
+  *
+  * @return Tab-separated field names, newline-terminated
+  */
+ const char* status_shm_fields(void);
+
+ /**
+  * @brief Format a record as one tab-separated line
+  *
+  * @param rec Record
+  * @param now_ms Current CLOCK_MONOTONIC time in milliseconds
+  * @param out Output buffer
+  * @param len Size of out
+  * @return Length of the line
+  */
+ int status_shm_format(const status_record_t* rec, int64_t now_ms, char* out, size_t len);
+
+ /**
+  * @brief Current CLOCK_MONOTONIC time in milliseconds
+  *
+  * @return Milliseconds
+  */
+ int64_t status_shm_now_ms(void);
+
+ #endif /* STATUS_SHM_H */
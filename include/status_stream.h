@@ -0,0 +1,56 @@
+/**
+ * @file status_stream.h
+ * @brief Streamed bulk status ("status --all") for the console FIFO
+ *
+ * A bulk status walks the hashmap once with a HashIterator, formatting
+ * records only as fast as the console drains its FIFO, so memory stays
+ * bounded and the manager never blocks however many sources there are.
+ * The response is framed by a header and a trailer line:
+ *
+ *   BEGIN STATUS_ALL fields=source,target,active,...
+ *   <one tab-separated record per source>
+ *   END STATUS_ALL count=<records>
+ *
+ * Times are seconds since the epoch and absent values are "-". Paths and
+ * error details never contain tabs or newlines (the config and the worker
+ * report are both whitespace/line oriented), so no escaping is needed.
+ * All functions are called from the manager's main thread only.
+ */
+
+ #ifndef STATUS_STREAM_H
+ #define STATUS_STREAM_H
+
+ #include <sys/select.h>
+
+ #define STATUS_STREAM_MAX 4                  /**< Concurrent bulk responses */
+ #define STATUS_STREAM_BUFSIZE (64 * 1024)    /**< Formatted bytes held per response */
+
+ /**
+  * @brief Start a bulk status response on an output fd
+  *
+  * The header is queued at once; records follow on each status_stream_pump().
+  *
+  * @param fd Non-blocking output fd
+  * @param end Line written after the trailer, e.g. a request tag (NULL for none)
+  * @return 0 on success, -1 if too many responses are in progress or one
+  *         is already in progress on fd
+  */
+ int status_stream_start(int fd, const char* end);
+
+ /**
+  * @brief Format and write as much of each response as its fd accepts
+  *
+  * Finished responses, and those whose reader went away, are released.
+  */
+ void status_stream_pump(void);
+
+ /**
+  * @brief Add fds of unfinished responses to a select() write set
+  *
+  * @param wfds Write set to extend
+  * @param maxfd Current highest fd + 1
+  * @return New highest fd + 1
+  */
+ int status_stream_fill_wfds(fd_set* wfds, int maxfd);
+
+ #endif /* STATUS_STREAM_H */
@@ -13,6 +13,10 @@
  #include <stdbool.h>
  #include <time.h>
  #include <linux/limits.h>
+ #include "task_priority.h"
+ #include "sync_policy.h"
+ #include "timer_wheel.h"
+ #include "poll_monitor.h"
  
  /**
   * @struct sync_info
@@ -24,11 +28,38 @@
  typedef struct sync_info {
      char source_dir[PATH_MAX];   /**< Path to the source directory being monitored */
      char target_dir[PATH_MAX];   /**< Path to the target directory for synchronization */
+     char canonical_target[PATH_MAX];  /**< target_dir resolved once, when the source was added */
      int active;                  /**< Flag indicating if monitoring is active (1) or stopped (0) */
      time_t last_sync_time;       /**< Timestamp of the most recent synchronization */
      int error_count;             /**< Number of errors encountered during synchronization */
      struct sync_info* next;      /**< Pointer to next item (for linked list implementation) */
      bool syncing;                /**< Flag indicating if synchronization is currently in progress */
+     char sync_opts[256];         /**< Worker options from the config line ("key=value,...") */
+     unsigned long suppressed_events;  /**< Events dropped as caused by our own writes */
+     int queued;                  /**< Tasks waiting in the task queue */
+     int in_flight;               /**< Tasks currently running */
+     unsigned long long bytes_synced;  /**< Bytes written into the target by finished tasks */
+     time_t last_error_time;      /**< When the last failed or partial task finished (0 if none) */
+     char last_error[160];        /**< "STATUS:details" of the last failed or partial task */
+     task_priority_t priority;    /**< CPU and I/O priority of this source's tasks */
+     int max_lag;                 /**< Recovery point objective: seconds a change may stay unsynced (0 = none) */
+     unsigned long deadline_misses;  /**< Changes synced later than max_lag allowed */
+     long long last_deadline;     /**< Latest queue deadline handed out (keeps the source's tasks in order) */
+     sync_policy_t policy;        /**< When changes are synced (see sync_policy.h) */
+     tw_timer_t policy_timer;     /**< Next interval flush or window boundary */
+     int holding;                 /**< The policy holds changes back right now */
+     int held_full;               /**< A held change needs a full sync at the next flush */
+     unsigned long held_changes;  /**< Changes held back since the last flush */
+     struct held_delete* held_deletes;  /**< Deletions to replay at the next flush, newest first */
+     poll_options_t poll;         /**< How changes are detected (see poll_monitor.h) */
+     struct poll_state* poller;   /**< Polling monitor of a monitor=poll source (NULL otherwise) */
+     int status_slot;             /**< Slot in the shared status table (-1 if none) */
+     int status_dirty;            /**< Changed since it was last published there (and on the dirty list) */
+     struct sync_info* status_next;  /**< Next source on the dirty list */
+     struct deadline_queue* changes;       /**< When each change not yet synced was seen */
+     struct deadline_queue* changes_done;  /**< Entries of changes since synced, dropped lazily */
+     int digest;                  /**< Keep replica digests (digest=1) for verify and reconcile */
+     struct digest_state* digests;  /**< Hash trees of the source and target (NULL if not kept) */
  } sync_info_t;
  
  /**
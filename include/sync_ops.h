@@ -0,0 +1,211 @@
+/**
+ * @file sync_ops.h
+ * @brief File synchronization operations shared by the worker and the manager
+ *
+ * This header declares the copy/delete/full-sync logic that used to live in
+ * the worker binary. The worker calls it after exec; the manager's threaded
+ * executor calls it directly on pool threads, avoiding fork, exec and the
+ * text report on the hot path.
+ */
+
+ #ifndef SYNC_OPS_H
+ #define SYNC_OPS_H
+
+ #include <stdio.h>
+ #include <sys/stat.h>
+
+ /**
+  * @struct sync_result
+  * @brief Outcome of one synchronization operation
+  *
+  * Per-file messages ("SUCCESS: ...", "ERROR: ...") are written to out when
+  * it is set; the worker points it at stdout, in-process callers leave it NULL.
+  */
+ typedef struct sync_result {
+     FILE* out;              /**< Stream for per-file messages (may be NULL) */
+     int files_processed;    /**< Files copied or deleted successfully */
+     int files_skipped;      /**< Entries skipped */
+     int files_unchanged;    /**< Files left alone because the target was up to date */
+     int files_deleted;      /**< Target entries removed by mirror mode */
+     int errors;             /**< Errors encountered */
+     unsigned long long bytes_written;  /**< Bytes copied into target files */
+     unsigned long long bytes_compared; /**< Target bytes read back and compared by in_place updates */
+     char status[16];        /**< "SUCCESS", "PARTIAL" or "ERROR" */
+     char details[128];      /**< Human-readable summary */
+     void (*on_write)(const struct stat* st, void* ctx);  /**< Called for each file written (may be NULL) */
+     void* on_write_ctx;     /**< Context for on_write */
+ } sync_result_t;
+
+ /**
+  * @struct sync_options
+  * @brief Per-source tuning passed to the worker
+  *
+  * Options travel as a comma-separated "key=value" string: the worker
+  * receives it as an optional fifth argument, and the threaded executor
+  * parses it in-process.
+  */
+ typedef struct sync_options {
+     int walk_threads;       /**< Directory walker threads for FULL syncs (walk_threads=N) */
+     int recursive;          /**< Mirror subdirectories on FULL syncs (recursive=0|1) */
+     int report_writes;      /**< Print a WROTE line per file written (report_writes=0|1) */
+     int numa_node;          /**< Node to run on (numa_node=N|auto|off, see placement.h) */
+     int copy_buffer_kb;     /**< Copy buffer size in KiB (copy_buffer=N, default 4) */
+     int huge_pages;         /**< Back copy buffers with huge pages (huge_pages=0|1) */
+     int preserve_mode;      /**< Give copies the source's permission bits (preserve_mode=0|1, default 1) */
+     int preserve_times;     /**< Give copies the source's atime and mtime (preserve_times=0|1, default 1) */
+     int preserve_owner;     /**< Give copies the source's owner and group (preserve_owner=0|1) */
+     int preserve_xattrs;    /**< Copy extended attributes, POSIX ACLs included (preserve_xattrs=0|1) */
+     int skip_unchanged;     /**< FULL syncs skip targets with the source's size and mtime (skip_unchanged=0|1, default 1) */
+     int follow_links;       /**< Copy what symlinks point at instead of recreating them (follow_links=0|1) */
+     int special_files;      /**< Recreate FIFOs and device nodes with mknodat() (special_files=0|1) */
+     int mirror;             /**< FULL syncs delete target entries missing from the source (mirror=0|1) */
+     long mirror_max_delete; /**< Refuse a mirror pass planning more deletions (0 = no limit, default 1000) */
+     int compress;           /**< Store targets in the chunked compressed format of zfile.h (compress=0|1) */
+     int compress_chunk_kb;  /**< Raw chunk size of compressed targets in KiB (compress_chunk=N, default 64) */
+     long inline_copy_max;   /**< Files up to this size are copied with copy_file_range() by the manager itself (inline_copy_max=BYTES, 0 = off) */
+     int in_place;           /**< Rewrite only the blocks of an existing target that differ (in_place=0|1) */
+ } sync_options_t;
+
+ /**
+  * @brief Fill in default options
+  *
+  * @param o Options to initialize
+  */
+ void sync_options_init(sync_options_t* o);
+
+ /**
+  * @brief Set a single option
+  *
+  * @param o Options to update
+  * @param key Option name
+  * @param value Option value
+  * @return 0 on success, -1 if the key is unknown or the value invalid
+  */
+ int sync_options_set(sync_options_t* o, const char* key, const char* value);
+
+ /**
+  * @brief Parse a comma-separated "key=value,..." option string
+  *
+  * @param spec Option string (NULL or "" leaves the defaults)
+  * @param o Options to update
+  * @return 0 on success, -1 on the first invalid option
+  */
+ int sync_options_parse(const char* spec, sync_options_t* o);
+
+ /**
+  * @brief Reset a result before running an operation
+  *
+  * @param r Result to initialize
+  * @param out Stream for per-file messages (may be NULL)
+  */
+ void sync_result_init(sync_result_t* r, FILE* out);
+
+ /**
+  * @brief Copy a file from source to target using low-level I/O syscalls
+  *
+  * The target gets the source's mode and times, and optionally its owner
+  * and extended attributes, through fd-based calls before it is closed.
+  * Files of at most inline_copy_max bytes are copied with copy_file_range().
+  * on_write sees the target as it is after futimens(). With compress the
+  * target is kept in the zfile format and only updated from the first
+  * changed chunk on.
+  *
+  * @param source_path Path to the source file
+  * @param target_path Path to the target file (will be created or overwritten)
+  * @param opts Options (NULL for defaults)
+  * @param r Result to update
+  * @return 0 on success, -1 on error
+  */
+ int copy_file(const char* source_path, const char* target_path,
+               const sync_options_t* opts, sync_result_t* r);
+
+ /**
+  * @brief Delete a file from the target directory
+  *
+  * A directory is removed with everything in it. A target that does not
+  * exist counts as deleted (skipped, not an error).
+  *
+  * @param target_path Path to the file to delete
+  * @param r Result to update
+  * @return 0 on success, -1 on error
+  */
+ int delete_file(const char* target_path, sync_result_t* r);
+
+ /**
+  * @brief Copy every regular file of source_dir into target_dir
+  *
+  * The source is listed with the parallel directory walker. In recursive
+  * mode subdirectories are listed, and their files copied, concurrently
+  * by walk_threads threads. Files whose target already has the same size
+  * and mtime are skipped (skip_unchanged). Entries are handled by d_type
+  * and lstat(): symlinks are recreated, not followed, and FIFOs and device
+  * nodes are recreated with special_files. In mirror mode both trees are
+  * then diffed with sorted merges of their listings, and target entries
+  * the source lacks are deleted, one batch per directory, unless there are
+  * more than mirror_max_delete of them.
+  *
+  * @param source_dir Path to the source directory
+  * @param target_dir Path to the target directory
+  * @param opts Options (NULL for defaults)
+  * @param r Result to update (status and details are filled in)
+  */
+ void full_sync(const char* source_dir, const char* target_dir,
+                const sync_options_t* opts, sync_result_t* r);
+
+ /**
+  * @brief Run one task exactly as the worker binary would
+  *
+  * With a numa_node option the calling thread (and any walker threads it
+  * starts) is pinned to that node's CPUs for the duration of the task.
+  *
+  * @param source_dir Source directory path
+  * @param target_dir Target directory path
+  * @param filename File to process (or "ALL" for full sync)
+  * @param operation Operation type ("FULL", "ADDED", "MODIFIED", "DELETED")
+  * @param opts Options (NULL for defaults)
+  * @param r Result to fill in
+  * @return 0 if the operation is known, -1 otherwise
+  */
+ int sync_run_task(const char* source_dir, const char* target_dir,
+                   const char* filename, const char* operation,
+                   const sync_options_t* opts, sync_result_t* r);
+
+ /**
+  * @brief Apply a rename within the source to the target
+  *
+  * The target's old entry is renamed when it still is an up-to-date copy
+  * (same size and mtime, or both directories); otherwise the new name is
+  * copied like an ADDED file. The old name is left to a DELETED task,
+  * which then finds nothing to delete.
+  *
+  * @param source_dir Source directory path
+  * @param target_dir Target directory path
+  * @param from Old name
+  * @param to New name
+  * @param opts Options (NULL for defaults)
+  * @param r Result to fill in
+  */
+ void sync_run_rename(const char* source_dir, const char* target_dir,
+                      const char* from, const char* to,
+                      const sync_options_t* opts, sync_result_t* r);
+
+ /**
+  * @brief on_write callback printing "WROTE: <dev> <ino> <sec> <nsec>"
+  *
+  * The manager records these to recognise events caused by the worker's
+  * own writes (see write_tracker.h).
+  *
+  * @param st Stat of the file just written
+  * @param ctx FILE* to print to
+  */
+ void sync_print_write(const struct stat* st, void* ctx);
+
+ /**
+  * @brief Print the EXEC_REPORT block the manager parses
+  *
+  * @param r Completed result
+  * @param out Stream to write to
+  */
+ void sync_print_report(const sync_result_t* r, FILE* out);
+
+ #endif /* SYNC_OPS_H */
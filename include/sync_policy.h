@@ -0,0 +1,96 @@
+/**
+ * @file sync_policy.h
+ * @brief Per-source policy for when changes are synced
+ *
+ * A source may carry policy options on its config line:
+ *
+ *   policy=realtime|interval|window  When changes are synced (default realtime)
+ *   interval=SECONDS                 Flush period of policy=interval (default 3600)
+ *   window=HH:MM-HH:MM               Local time window of policy=window
+ *
+ * With policy=interval the manager holds changes back and syncs them once
+ * per interval. With policy=window it syncs in real time inside the window
+ * (which may wrap past midnight) and holds changes back outside it, syncing
+ * them when the window next opens. The manager drives both from a timer
+ * wheel; this module only parses the options and does the clock arithmetic.
+ */
+
+ #ifndef SYNC_POLICY_H
+ #define SYNC_POLICY_H
+
+ #include <stddef.h>
+ #include <time.h>
+
+ /**
+  * @brief How a source's changes are scheduled
+  */
+ typedef enum {
+     SYNC_POLICY_REALTIME,  /**< As they happen (default) */
+     SYNC_POLICY_INTERVAL,  /**< Held, flushed every interval seconds */
+     SYNC_POLICY_WINDOW     /**< As they happen inside the window, held outside it */
+ } sync_policy_kind_t;
+
+ /**
+  * @struct sync_policy
+  * @brief Configured sync policy of a source
+  */
+ typedef struct sync_policy {
+     sync_policy_kind_t kind;  /**< Policy */
+     int interval;             /**< Flush period in seconds */
+     int window_start;         /**< Window opening, minutes after local midnight (-1 if unset) */
+     int window_end;           /**< Window closing, minutes after local midnight */
+ } sync_policy_t;
+
+ /**
+  * @brief Fill in the defaults (realtime)
+  *
+  * @param p Policy to initialize
+  */
+ void sync_policy_init(sync_policy_t* p);
+
+ /**
+  * @brief Set one policy option
+  *
+  * @param p Policy to update
+  * @param key Option name
+  * @param value Option value
+  * @return 0 if set, -1 if the value is invalid, 1 if key is not a policy option
+  */
+ int sync_policy_set(sync_policy_t* p, const char* key, const char* value);
+
+ /**
+  * @brief Check a policy once all its options are set
+  *
+  * @param p Policy
+  * @return 0 if usable, -1 if policy=window has no window
+  */
+ int sync_policy_validate(const sync_policy_t* p);
+
+ /**
+  * @brief Check whether a time falls inside the window
+  *
+  * @param p Policy with a window
+  * @param now Time to check
+  * @return 1 if inside (a window that closes when it opens is always open), 0 otherwise
+  */
+ int sync_policy_in_window(const sync_policy_t* p, time_t now);
+
+ /**
+  * @brief Seconds until the window next opens or closes
+  *
+  * @param p Policy with a window
+  * @param now Current time
+  * @return Seconds, at least 1
+  */
+ long sync_policy_next_boundary(const sync_policy_t* p, time_t now);
+
+ /**
+  * @brief Describe a policy as text ("realtime", "interval 3600s", "window 22:00-06:00")
+  *
+  * @param p Policy
+  * @param out Output buffer
+  * @param len Size of out
+  */
+ void sync_policy_describe(const sync_policy_t* p, char* out, size_t len);
+
+ #endif /* SYNC_POLICY_H */
@@ -0,0 +1,137 @@
+/**
+ * @file task_priority.h
+ * @brief Per-source CPU and I/O priority for synchronization tasks
+ *
+ * A source may carry priority options on its config line:
+ *
+ *   io_class=rt|be|idle   I/O scheduling class (ioprio_set)
+ *   io_level=0..7         Level within the class (0 is highest)
+ *   cpu_sched=normal|idle SCHED_OTHER or SCHED_IDLE
+ *   nice=-20..19          CPU nice value
+ *   cpu_limit=SECONDS     RLIMIT_CPU for the worker process
+ *
+ * The manager passes them to each worker on its command line (see
+ * task_priority_options()) and the worker applies them to itself, so the
+ * forked child runs nothing but exec() in between. In
+ * thread mode a prioritized task runs on a thread of its own that exits
+ * with the task, because lowering a shared pool thread cannot be undone
+ * without CAP_SYS_NICE; RLIMIT_CPU is process-wide, so it only applies
+ * to worker processes.
+ */
+
+ #ifndef TASK_PRIORITY_H
+ #define TASK_PRIORITY_H
+
+ #include <stddef.h>
+ #include <sys/types.h>
+
+ #define TASK_PRIORITY_UNSET (-100)   /**< Field not configured: inherit the manager's */
+
+ /**
+  * @struct task_priority
+  * @brief Configured priority of a source's tasks
+  */
+ typedef struct task_priority {
+     int io_class;     /**< 1 = rt, 2 = be, 3 = idle, or TASK_PRIORITY_UNSET */
+     int io_level;     /**< 0..7 (default 4) */
+     int sched_idle;   /**< Run under SCHED_IDLE */
+     int nice;         /**< Nice value, or TASK_PRIORITY_UNSET */
+     long cpu_limit;   /**< RLIMIT_CPU seconds (0 = none) */
+ } task_priority_t;
+
+ /**
+  * @struct task_priority_saved
+  * @brief A thread's priority before task_priority_apply()
+  */
+ typedef struct task_priority_saved {
+     int ioprio;   /**< Previous ioprio value */
+     int policy;   /**< Previous scheduling policy */
+     int nice;     /**< Previous nice value */
+ } task_priority_saved_t;
+
+ /**
+  * @brief Fill in "inherit everything"
+  *
+  * @param p Priority to initialize
+  */
+ void task_priority_init(task_priority_t* p);
+
+ /**
+  * @brief Set one priority option
+  *
+  * @param p Priority to update
+  * @param key Option name
+  * @param value Option value
+  * @return 0 on success, -1 if the value is invalid, 1 if the key is not a
+  *         priority option
+  */
+ int task_priority_set(task_priority_t* p, const char* key, const char* value);
+
+ /**
+  * @brief Check whether any field is configured
+  *
+  * @param p Priority
+  * @return 1 if nothing would be changed, 0 otherwise
+  */
+ int task_priority_is_default(const task_priority_t* p);
+
+ /**
+  * @brief Format the configured fields as options ("io_class=idle,nice=19")
+  *
+  * The result parses back with task_priority_set().
+  *
+  * @param p Priority
+  * @param out Output buffer ("" when nothing is configured)
+  * @param len Size of out
+  */
+ void task_priority_options(const task_priority_t* p, char* out, size_t len);
+
+ /**
+  * @brief Apply a priority to the calling thread
+  *
+  * Every field is attempted even if an earlier one fails.
+  *
+  * @param p Priority to apply
+  * @param process_wide Also set RLIMIT_CPU (only for a worker process)
+  * @param saved Filled with the previous values for task_priority_restore() (may be NULL)
+  * @param err Buffer for a description of what failed
+  * @param errlen Size of err
+  * @return 0 if everything was applied, -1 otherwise
+  */
+ int task_priority_apply(const task_priority_t* p, int process_wide,
+                         task_priority_saved_t* saved, char* err, size_t errlen);
+
+ /**
+  * @brief Restore the calling thread's priority
+  *
+  * Raising priority back (lower nice, SCHED_IDLE to SCHED_OTHER) may need
+  * CAP_SYS_NICE or a suitable RLIMIT_NICE; without them the thread keeps
+  * the lowered values and -1 is returned.
+  *
+  * @param saved Values from task_priority_apply()
+  * @param err Buffer for a description of what failed (may be NULL)
+  * @param errlen Size of err
+  * @return 0 if every previous value is back, -1 otherwise
+  */
+ int task_priority_restore(const task_priority_saved_t* saved, char* err, size_t errlen);
+
+ /**
+  * @brief Format a configured priority ("io=be/7 sched=idle nice=19 cpu_limit=60s")
+  *
+  * @param p Priority
+  * @param out Output buffer
+  * @param len Size of out
+  */
+ void task_priority_describe(const task_priority_t* p, char* out, size_t len);
+
+ /**
+  * @brief Read back the priority a running task actually has
+  *
+  * @param pid Process (or thread) ID
+  * @param out Output buffer, in the task_priority_describe() format
+  * @param len Size of out
+  * @return 0 on success, -1 if the task is gone
+  */
+ int task_priority_query(pid_t pid, char* out, size_t len);
+
+ #endif /* TASK_PRIORITY_H */
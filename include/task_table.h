@@ -0,0 +1,131 @@
+/**
+ * @file task_table.h
+ * @brief In-flight and deferred tasks keyed by (source, filename)
+ *
+ * Tasks for different files of one source run concurrently; the table
+ * decides when a task has to wait instead. A per-file task waits while a
+ * task for the same file or a FULL sync of its source is running, and a
+ * FULL sync waits until nothing of its source is running. Waiting tasks
+ * are kept per source in arrival order and handed back once they can
+ * start; a task never overtakes an older waiting task for the same file
+ * or an older waiting FULL sync of its source. Tasks are opaque pointers
+ * owned by the caller. The table is used by the scheduler thread only and
+ * is not thread-safe.
+ */
+
+ #ifndef TASK_TABLE_H
+ #define TASK_TABLE_H
+
+ #include <stddef.h>
+
+ #define TASK_TABLE_ALL "ALL"  /**< Filename of a FULL sync */
+
+ typedef struct task_table task_table_t;  /**< Opaque table */
+
+ /**
+  * @brief Create an empty table
+  *
+  * @return New table
+  */
+ task_table_t* task_table_create(void);
+
+ /**
+  * @brief Free a table (deferred tasks are not freed)
+  *
+  * @param t Table to destroy (may be NULL)
+  */
+ void task_table_destroy(task_table_t* t);
+
+ /**
+  * @brief Check whether a task has to wait
+  *
+  * @param t Table
+  * @param source Source directory
+  * @param filename File, or TASK_TABLE_ALL for a FULL sync
+  * @return 1 if the task must be deferred, 0 if it may start now
+  */
+ int task_table_busy(task_table_t* t, const char* source, const char* filename);
+
+ /**
+  * @brief Record a task as running
+  *
+  * @param t Table
+  * @param source Source directory
+  * @param filename File, or TASK_TABLE_ALL
+  */
+ void task_table_start(task_table_t* t, const char* source, const char* filename);
+
+ /**
+  * @brief Record a running task as finished
+  *
+  * @param t Table
+  * @param source Source directory
+  * @param filename File, or TASK_TABLE_ALL
+  */
+ void task_table_finish(task_table_t* t, const char* source, const char* filename);
+
+ /**
+  * @brief Queue a task behind the ones it conflicts with
+  *
+  * At most one task per (source, filename) waits; see task_table_deferred().
+  *
+  * @param t Table
+  * @param source Source directory
+  * @param filename File, or TASK_TABLE_ALL
+  * @param task Caller's task (not NULL)
+  */
+ void task_table_defer(task_table_t* t, const char* source, const char* filename, void* task);
+
+ /**
+  * @brief The task waiting for a key, for coalescing a newer one into it
+  *
+  * @param t Table
+  * @param source Source directory
+  * @param filename File, or TASK_TABLE_ALL
+  * @return Waiting task, or NULL
+  */
+ void* task_table_deferred(task_table_t* t, const char* source, const char* filename);
+
+ /**
+  * @brief Take the oldest waiting task of a source that may start now
+  *
+  * Call after task_table_finish() until it returns NULL. The task comes
+  * back recorded as running, so nothing can overtake it before the caller
+  * starts it; call task_table_finish() when it is done.
+  *
+  * @param t Table
+  * @param source Source directory
+  * @return Task, or NULL if none can start
+  */
+ void* task_table_take_ready(task_table_t* t, const char* source);
+
+ /**
+  * @brief Call fn for every waiting task of a source, oldest first
+  *
+  * @param t Table
+  * @param source Source directory
+  * @param fn Callback (must not modify the table)
+  * @param ctx Context passed to fn
+  */
+ void task_table_walk_deferred(task_table_t* t, const char* source,
+                               void (*fn)(void* task, void* ctx), void* ctx);
+
+ /**
+  * @brief Number of running tasks of a source
+  *
+  * @param t Table
+  * @param source Source directory
+  * @return Running tasks
+  */
+ int task_table_running(task_table_t* t, const char* source);
+
+ /**
+  * @brief Check whether a FULL sync of a source is running or waiting
+  *
+  * @param t Table
+  * @param source Source directory
+  * @return 1 if so, 0 otherwise
+  */
+ int task_table_full_pending(task_table_t* t, const char* source);
+
+ #endif /* TASK_TABLE_H */
@@ -0,0 +1,59 @@
+/**
+ * @file thread_pool.h
+ * @brief Work-stealing thread pool used by the manager's in-process executor
+ *
+ * Each pool thread owns a deque of tasks. Tasks submitted from outside the
+ * pool are spread round-robin over the deques; tasks submitted from a pool
+ * thread go to that thread's own deque. An idle thread first drains its own
+ * deque from the front and then steals from the back of the others.
+ */
+
+ #ifndef THREAD_POOL_H
+ #define THREAD_POOL_H
+
+ /** Function run by a pool thread */
+ typedef void (*pool_fn_t)(void* arg);
+
+ /** Opaque pool handle */
+ typedef struct thread_pool thread_pool_t;
+
+ /**
+  * @brief Create a pool and start its threads
+  *
+  * @param nthreads Number of threads (at least 1)
+  * @return New pool, or NULL on failure
+  */
+ thread_pool_t* pool_create(int nthreads);
+
+ /**
+  * @brief Queue a task for execution
+  *
+  * @param pool Pool to submit to
+  * @param fn Function to run
+  * @param arg Argument passed to fn
+  */
+ void pool_submit(thread_pool_t* pool, pool_fn_t fn, void* arg);
+
+ /**
+  * @brief Get the number of threads in a pool
+  *
+  * @param pool Pool to query
+  * @return Thread count
+  */
+ int pool_size(thread_pool_t* pool);
+
+ /**
+  * @brief Index of the calling pool thread
+  *
+  * @return Index in [0, pool_size) or -1 when not called from a pool thread
+  */
+ int pool_thread_index(void);
+
+ /**
+  * @brief Run every queued task, stop the threads and free the pool
+  *
+  * @param pool Pool to destroy
+  */
+ void pool_destroy(thread_pool_t* pool);
+
+ #endif /* THREAD_POOL_H */
@@ -0,0 +1,97 @@
+/**
+ * @file timer_wheel.h
+ * @brief Hierarchical timer wheel
+ *
+ * Timers are intrusive (embedded in the caller's structures) and expire at
+ * an absolute tick. Four levels of 64 slots cover 2^24 ticks; a timer is
+ * filed by how far away it is and moved to a finer level when its coarse
+ * slot comes up, so adding, cancelling and advancing by one tick are O(1)
+ * no matter how many timers are armed. Timers further away than the wheel
+ * covers fire at its horizon and can be re-armed from the callback. Not
+ * thread-safe.
+ */
+
+ #ifndef TIMER_WHEEL_H
+ #define TIMER_WHEEL_H
+
+ #include <stddef.h>
+
+ /**
+  * @struct tw_timer
+  * @brief One timer (zero-initialised means not armed)
+  */
+ typedef struct tw_timer {
+     unsigned long long expires;  /**< Tick it fires at */
+     void* data;                  /**< Caller's data */
+     struct tw_timer* next;       /**< Next timer in its slot */
+     struct tw_timer** pprev;     /**< Link pointing at this timer (NULL if not armed) */
+ } tw_timer_t;
+
+ typedef struct timer_wheel timer_wheel_t;  /**< Opaque wheel */
+
+ /**
+  * @brief Create an empty wheel
+  *
+  * @param now Current tick
+  * @return New wheel
+  */
+ timer_wheel_t* timer_wheel_create(unsigned long long now);
+
+ /**
+  * @brief Free a wheel (armed timers are left dangling, not freed)
+  *
+  * @param w Wheel to destroy (may be NULL)
+  */
+ void timer_wheel_destroy(timer_wheel_t* w);
+
+ /**
+  * @brief Arm a timer, re-arming it if it already is
+  *
+  * A tick that has already passed fires on the next advance.
+  *
+  * @param w Wheel
+  * @param t Timer
+  * @param expires Tick to fire at
+  */
+ void timer_wheel_add(timer_wheel_t* w, tw_timer_t* t, unsigned long long expires);
+
+ /**
+  * @brief Disarm a timer (no-op if it is not armed)
+  *
+  * @param w Wheel
+  * @param t Timer
+  */
+ void timer_wheel_cancel(timer_wheel_t* w, tw_timer_t* t);
+
+ /**
+  * @brief Check whether a timer is armed
+  *
+  * @param t Timer
+  * @return 1 if armed, 0 otherwise
+  */
+ int timer_wheel_pending(const tw_timer_t* t);
+
+ /**
+  * @brief Number of armed timers
+  *
+  * @param w Wheel
+  * @return Timers
+  */
+ size_t timer_wheel_count(const timer_wheel_t* w);
+
+ /**
+  * @brief Fire every timer due up to and including a tick
+  *
+  * Timers are disarmed before their callback runs, so the callback may
+  * re-arm (or free) them.
+  *
+  * @param w Wheel
+  * @param now Current tick
+  * @param fire Callback for each expired timer
+  * @param ctx Context passed to fire
+  * @return Number of timers fired
+  */
+ size_t timer_wheel_advance(timer_wheel_t* w, unsigned long long now,
+                            void (*fire)(tw_timer_t* t, void* ctx), void* ctx);
+
+ #endif /* TIMER_WHEEL_H */
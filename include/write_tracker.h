@@ -0,0 +1,55 @@
+/**
+ * @file write_tracker.h
+ * @brief Record of the manager's own writes, for feedback-loop suppression
+ *
+ * When a target directory is itself watched, every file a task writes
+ * there comes back as inotify events. Tasks record each file they write
+ * as (dev, inode, mtime), and each file they delete by path; an event
+ * whose file still matches a record was caused by the manager and can be
+ * dropped. A later change by anyone else moves the mtime, so it no longer
+ * matches. Records expire after WRITE_TRACKER_TTL seconds. All functions
+ * are thread-safe.
+ */
+
+ #ifndef WRITE_TRACKER_H
+ #define WRITE_TRACKER_H
+
+ #include <sys/types.h>
+ #include <sys/stat.h>
+ #include <time.h>
+
+ #define WRITE_TRACKER_TTL 60  /**< Seconds a record stays valid */
+
+ /**
+  * @brief Record a file the manager (or one of its workers) just wrote
+  *
+  * @param dev Device of the written file
+  * @param ino Inode of the written file
+  * @param mtime Modification time after the write
+  */
+ void write_tracker_record(dev_t dev, ino_t ino, const struct timespec* mtime);
+
+ /**
+  * @brief Check whether a file is exactly as the manager last wrote it
+  *
+  * @param st Current stat of the file
+  * @return 1 if the file matches a record, 0 otherwise
+  */
+ int write_tracker_is_own(const struct stat* st);
+
+ /**
+  * @brief Record a file the manager just deleted
+  *
+  * @param path Canonical path of the deleted file
+  */
+ void write_tracker_record_unlink(const char* path);
+
+ /**
+  * @brief Consume a deletion record
+  *
+  * @param path Canonical path from a delete event
+  * @return 1 if the manager deleted path recently, 0 otherwise
+  */
+ int write_tracker_take_unlink(const char* path);
+
+ #endif /* WRITE_TRACKER_H */
@@ -0,0 +1,165 @@
+/**
+ * @file zfile.h
+ * @brief Chunked compressed file format for archive targets
+ *
+ * A target synced with compress=1 holds the source's bytes in fixed-size
+ * chunks, each compressed on its own with a small in-tree LZ77 codec (no
+ * external library), followed by an index and a footer:
+ *
+ *   [chunk 0][chunk 1]...[index: one zfile_chunk_t per chunk][zfile_footer_t]
+ *
+ * Any byte range can be read back by decompressing only the chunks that
+ * cover it. Each index entry carries a hash of the chunk's raw bytes, so a
+ * later sync keeps every leading chunk whose source bytes are unchanged,
+ * and only compresses from the first changed chunk on. Appending to a
+ * source recompresses just its last, partial chunk. Integers are stored in
+ * host byte order.
+ */
+
+ #ifndef ZFILE_H
+ #define ZFILE_H
+
+ #include <stddef.h>
+ #include <stdint.h>
+ #include <sys/types.h>
+
+ #define ZFILE_MAGIC 0x315a5346u          /**< "FSZ1" */
+ #define ZFILE_CHUNK_DEFAULT (64 * 1024)  /**< Default raw chunk size */
+ #define ZFILE_CHUNK_MAX (1024 * 1024)    /**< Largest raw chunk size */
+ #define ZFILE_STORED 0x80000000u         /**< zfile_chunk_t.clen flag: chunk kept uncompressed */
+
+ /**
+  * @struct zfile_chunk
+  * @brief Index entry of one chunk
+  */
+ typedef struct zfile_chunk {
+     uint64_t offset;   /**< Where the chunk's bytes start in the file */
+     uint32_t clen;     /**< Stored length, ZFILE_STORED set if not compressed */
+     uint32_t rlen;     /**< Raw length (chunk size, less for the last chunk) */
+     uint64_t hash;     /**< Hash of the raw bytes */
+ } zfile_chunk_t;
+
+ /**
+  * @struct zfile_footer
+  * @brief Last bytes of a compressed file
+  */
+ typedef struct zfile_footer {
+     uint32_t magic;        /**< ZFILE_MAGIC */
+     uint32_t chunk_size;   /**< Raw chunk size */
+     uint64_t size;         /**< Uncompressed file size */
+     uint64_t index_off;    /**< Offset of the index (= end of chunk data) */
+     uint64_t chunks;       /**< Number of index entries */
+ } zfile_footer_t;
+
+ /**
+  * @struct zfile
+  * @brief An open compressed file for random-access reads
+  */
+ typedef struct zfile {
+     int fd;                  /**< File (not owned) */
+     zfile_footer_t footer;   /**< Its footer */
+     zfile_chunk_t* index;    /**< Its index */
+     unsigned char* raw;      /**< Last decompressed chunk */
+     unsigned char* comp;     /**< Read buffer for a stored chunk */
+     long cached;             /**< Chunk held in raw (-1 for none) */
+ } zfile_t;
+
+ /**
+  * @struct zfile_stats
+  * @brief What a zfile_sync() did
+  */
+ typedef struct zfile_stats {
+     unsigned long chunks_kept;        /**< Chunks reused as they were */
+     unsigned long chunks_written;     /**< Chunks compressed and written */
+     unsigned long long bytes_read;    /**< Source bytes read */
+     unsigned long long bytes_written; /**< Bytes written to the target (chunks, index, footer) */
+ } zfile_stats_t;
+
+ /**
+  * @brief Worst-case compressed size of a block
+  *
+  * @param n Raw size
+  * @return Size an output buffer needs
+  */
+ size_t zfile_bound(size_t n);
+
+ /**
+  * @brief Compress a block
+  *
+  * @param src Raw bytes
+  * @param n Number of raw bytes
+  * @param dst Output buffer
+  * @param cap Size of dst
+  * @return Compressed size, or 0 if it would not fit in cap
+  */
+ size_t zfile_compress_block(const void* src, size_t n, void* dst, size_t cap);
+
+ /**
+  * @brief Decompress a block
+  *
+  * Malformed input is rejected, never read or written out of bounds.
+  *
+  * @param src Compressed bytes
+  * @param n Number of compressed bytes
+  * @param dst Output buffer
+  * @param cap Size of dst
+  * @return Raw size, or -1 if the input is malformed or too large for cap
+  */
+ ssize_t zfile_decompress_block(const void* src, size_t n, void* dst, size_t cap);
+
+ /**
+  * @brief Bring a compressed target up to date with a source file
+  *
+  * Leading chunks whose raw bytes hash the same as in the target's index
+  * are kept; everything from the first difference on is compressed and
+  * written over the old data, followed by a new index and footer. A target
+  * that is empty, not in this format or using another chunk size is
+  * rewritten completely.
+  *
+  * @param src_fd Source file, read from offset 0
+  * @param dst_fd Target file, opened read-write
+  * @param chunk_size Raw chunk size (0 = ZFILE_CHUNK_DEFAULT)
+  * @param stats Filled in (may be NULL)
+  * @return 0 on success, -1 on error (errno set)
+  */
+ int zfile_sync(int src_fd, int dst_fd, size_t chunk_size, zfile_stats_t* stats);
+
+ /**
+  * @brief Read the footer of a compressed file
+  *
+  * @param fd File
+  * @param footer Filled in
+  * @return 0 on success, -1 if the file is not in this format
+  */
+ int zfile_read_footer(int fd, zfile_footer_t* footer);
+
+ /**
+  * @brief Open a compressed file for reading
+  *
+  * @param z Handle to fill in
+  * @param fd File (stays owned by the caller)
+  * @return 0 on success, -1 on error (errno set; EINVAL if not in this format)
+  */
+ int zfile_open(zfile_t* z, int fd);
+
+ /**
+  * @brief Read uncompressed bytes at an offset
+  *
+  * Only the chunks covering the range are read and decompressed.
+  *
+  * @param z Open file
+  * @param buf Output buffer
+  * @param len Bytes wanted
+  * @param off Uncompressed offset
+  * @return Bytes read (short at end of file), or -1 on error
+  */
+ ssize_t zfile_pread(zfile_t* z, void* buf, size_t len, off_t off);
+
+ /**
+  * @brief Release a handle from zfile_open()
+  *
+  * @param z Handle
+  */
+ void zfile_close(zfile_t* z);
+
+ #endif /* ZFILE_H */
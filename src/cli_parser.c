@@ -7,6 +7,7 @@
  */
 
  #include "../include/cli_parser.h"
+ #include "../include/fss_pipeline.h"
 
  /**
   * @brief Parse command-line arguments for the FSS manager
@@ -17,6 +18,11 @@
   *   -l <logfile>      : Path to the log file (required)
   *   -c <config_file>  : Path to the configuration file (required)
   *   -n <worker_limit> : Maximum number of concurrent worker processes (optional, default: 5)
+  *   -e <executor>     : "process" to fork workers or "thread" to run tasks
+  *                       in-process (optional, default: process)
+  *   -H                : Allocate the manager's event arena from huge pages (optional)
+  *   -i <instances>    : inotify instances, each drained by its own thread
+  *                       (optional, default: 1, at most PIPELINE_MAX_SHARDS)
   *
   * If required options are missing, the function prints usage information and exits.
   *
@@ -26,7 +32,8 @@
   */
  struct args parseArgsManager(int argc, char* argv[]) {
      /* Initialize return struct with default values */
-     struct args ret = { .logfile = NULL, .config_file = NULL, .worker_limit = 5 };
+     struct args ret = { .logfile = NULL, .config_file = NULL, .worker_limit = 5,
+                         .executor = "process", .huge_pages = 0, .inotify_instances = 1 };
      
      /* Skip program name */
      argv++; 
@@ -60,6 +67,33 @@
                      exit(EXIT_FAILURE);
                  }
              } 
+             /* Process -e option (executor mode) */
+             else if (strcmp(*argv, "-e") == 0 && argc > 1) {
+                 argv++; 
+                 argc--;
+                 if (strcmp(*argv, "process") != 0 && strcmp(*argv, "thread") != 0) {
+                     fprintf(stderr, "Invalid executor: %s (use process or thread)\n", *argv);
+                     exit(EXIT_FAILURE);
+                 }
+                 ret.executor = *argv;
+             } 
+             /* Process -i option (inotify instances) */
+             else if (strcmp(*argv, "-i") == 0 && argc > 1) {
+                 argv++; 
+                 argc--;
+                 char* endptr;
+                 ret.inotify_instances = strtol(*argv, &endptr, 10);
+                 if (*endptr != '\0' || ret.inotify_instances <= 0 ||
+                     ret.inotify_instances > PIPELINE_MAX_SHARDS) {
+                     fprintf(stderr, "Invalid inotify instances: %s (1 to %d)\n",
+                             *argv, PIPELINE_MAX_SHARDS);
+                     exit(EXIT_FAILURE);
+                 }
+             } 
+             /* Process -H flag (huge pages) */
+             else if (strcmp(*argv, "-H") == 0) {
+                 ret.huge_pages = 1;
+             } 
              /* Handle unrecognized or incomplete options */
              else {
                  fprintf(stderr, "Unrecognized or incomplete argument: %s\n", *argv);
@@ -72,7 +106,7 @@
      
      /* Ensure required arguments are provided */
      if (!ret.logfile || !ret.config_file) {
-         fprintf(stderr, "Usage: ./fss_manager -l <logfile> -c <config_file> [-n <worker_limit>]\n");
+         fprintf(stderr, "Usage: ./fss_manager -l <logfile> -c <config_file> [-n <worker_limit>] [-e process|thread] [-H] [-i <instances>]\n");
          exit(EXIT_FAILURE);
      }
      
@@ -0,0 +1,147 @@
+/**
+ * @file deadline_queue.c
+ * @brief Implementation of the earliest-deadline-first queue
+ *
+ * The heap is an array of (deadline, sequence, item) entries that doubles
+ * when full. The sequence number breaks ties in push order, which keeps
+ * the tasks of one source in arrival order when their deadlines are equal.
+ */
+
+ #include "../include/deadline_queue.h"
+ #include <stdlib.h>
+
+ /**
+  * @struct dq_entry
+  * @brief One queued item
+  */
+ typedef struct dq_entry {
+     long long deadline;        /**< Absolute deadline */
+     unsigned long long seq;    /**< Push order, for ties */
+     void* item;                /**< Caller's item */
+ } dq_entry_t;
+
+ /**
+  * @struct deadline_queue
+  * @brief Queue handle
+  */
+ struct deadline_queue {
+     dq_entry_t* heap;          /**< Min-heap of entries */
+     size_t len;                /**< Entries in use */
+     size_t cap;                /**< Entries allocated */
+     unsigned long long seq;    /**< Next sequence number */
+ };
+
+ /**
+  * @brief Check whether entry a must come out before entry b
+  *
+  * @param a Entry
+  * @param b Entry
+  * @return 1 if so, 0 otherwise
+  */
+ static int before(const dq_entry_t* a, const dq_entry_t* b) {
+     return a->deadline < b->deadline || (a->deadline == b->deadline && a->seq < b->seq);
+ }
+
+ /**
+  * @brief Create an empty queue
+  *
+  * @return New queue
+  */
+ deadline_queue_t* deadline_queue_create(void) {
+     return calloc(1, sizeof(deadline_queue_t));
+ }
+
+ /**
+  * @brief Free a queue (items are not freed)
+  *
+  * @param q Queue to destroy (may be NULL)
+  */
+ void deadline_queue_destroy(deadline_queue_t* q) {
+     if (!q) return;
+     free(q->heap);
+     free(q);
+ }
+
+ /**
+  * @brief Add an item
+  *
+  * @param q Queue
+  * @param deadline Absolute deadline (any monotonic unit)
+  * @param item Caller's item (not NULL)
+  */
+ void deadline_queue_push(deadline_queue_t* q, long long deadline, void* item) {
+     if (q->len == q->cap) {
+         q->cap = q->cap ? q->cap * 2 : 64;
+         q->heap = realloc(q->heap, q->cap * sizeof(*q->heap));
+     }
+
+     /* Sift up */
+     dq_entry_t e = { deadline, q->seq++, item };
+     size_t i = q->len++;
+     while (i > 0) {
+         size_t parent = (i - 1) / 2;
+         if (!before(&e, &q->heap[parent])) break;
+         q->heap[i] = q->heap[parent];
+         i = parent;
+     }
+     q->heap[i] = e;
+ }
+
+ /**
+  * @brief Remove the item with the earliest deadline
+  *
+  * @param q Queue
+  * @return Item, or NULL if the queue is empty
+  */
+ void* deadline_queue_pop(deadline_queue_t* q) {
+     if (q->len == 0) return NULL;
+     void* item = q->heap[0].item;
+     dq_entry_t last = q->heap[--q->len];
+
+     /* Sift the last entry down from the root */
+     size_t i = 0;
+     for (;;) {
+         size_t c = 2 * i + 1;
+         if (c >= q->len) break;
+         if (c + 1 < q->len && before(&q->heap[c + 1], &q->heap[c])) c++;
+         if (!before(&q->heap[c], &last)) break;
+         q->heap[i] = q->heap[c];
+         i = c;
+     }
+     if (q->len > 0) q->heap[i] = last;
+     return item;
+ }
+
+ /**
+  * @brief Look at the earliest deadline without removing its item
+  *
+  * @param q Queue
+  * @param deadline Set to the earliest deadline
+  * @return 1 if the queue has an item, 0 if it is empty
+  */
+ int deadline_queue_peek(const deadline_queue_t* q, long long* deadline) {
+     if (q->len == 0) return 0;
+     *deadline = q->heap[0].deadline;
+     return 1;
+ }
+
+ /**
+  * @brief Number of items in the queue
+  *
+  * @param q Queue
+  * @return Items
+  */
+ size_t deadline_queue_size(const deadline_queue_t* q) {
+     return q->len;
+ }
+
+ /**
+  * @brief Item at a heap position, for walking all items in no particular order
+  *
+  * @param q Queue
+  * @param i Position, below deadline_queue_size()
+  * @return Item
+  */
+ void* deadline_queue_at(const deadline_queue_t* q, size_t i) {
+     return q->heap[i].item;
+ }
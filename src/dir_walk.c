@@ -0,0 +1,387 @@
+/**
+ * @file dir_walk.c
+ * @brief Implementation of the parallel recursive directory walker
+ *
+ * Each directory to visit is a job holding a reference on its parent. A job
+ * is opened with openat() relative to the parent's fd, listed with
+ * getdents64(), and its subdirectories are pushed as new jobs on the
+ * walking thread's own deque. The owner pops newest-first (depth-first, so
+ * few parent fds are open at once); idle threads steal oldest-first, which
+ * hands them the largest remaining subtrees.
+ */
+
+ #define _GNU_SOURCE  /* getdents64() */
+ #include "../include/dir_walk.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <string.h>
+ #include <errno.h>
+ #include <fcntl.h>
+ #include <unistd.h>
+ #include <dirent.h>
+ #include <pthread.h>
+ #include <stdatomic.h>
+ #include <sys/stat.h>
+ #include <linux/limits.h>
+
+ #define WALK_DEFAULT_BATCH 256        /**< Default entries per callback */
+ #define WALK_DENTS_BUFSIZE (64 * 1024) /**< getdents64() buffer size */
+
+ /**
+  * -----------------------------------------------------------------------------
+  * Type definitions
+  * -----------------------------------------------------------------------------
+  */
+
+ /**
+  * @struct walk_dir
+  * @brief A directory waiting to be (or being) listed
+  *
+  * refs counts the job itself while it is listed plus every child job that
+  * has not opened itself yet; the fd is closed when it drops to zero.
+  */
+ typedef struct walk_dir {
+     struct walk_dir* parent;  /**< Directory this one is opened relative to */
+     int fd;                   /**< Open directory fd (-1 until opened) */
+     atomic_int refs;          /**< References keeping fd open */
+     int depth;                /**< Depth below the root (root = 0) */
+     char* relpath;            /**< Path relative to the root */
+     char name[];              /**< Name in parent (the root path for the root) */
+ } walk_dir_t;
+
+ /**
+  * @struct walk_deque
+  * @brief Per-thread ring buffer of directory jobs
+  */
+ typedef struct walk_deque {
+     pthread_mutex_t lock;  /**< Guards the fields below */
+     walk_dir_t** buf;      /**< Ring buffer storage */
+     size_t cap;            /**< Capacity (power of two) */
+     size_t head;           /**< Index of the oldest job */
+     size_t count;          /**< Jobs queued */
+ } walk_deque_t;
+
+ /**
+  * @struct walk_state
+  * @brief State shared by every walker thread
+  */
+ typedef struct walk_state {
+     dir_walk_opts_t opts;        /**< Effective options */
+     dir_walk_fn fn;              /**< Consumer callback */
+     void* ctx;                   /**< Consumer context */
+     walk_deque_t* deques;        /**< One deque per thread */
+     atomic_long queued;          /**< Jobs sitting in deques */
+     atomic_long outstanding;     /**< Jobs queued or being listed */
+     atomic_int errors;           /**< Subdirectories that could not be read */
+     int root_errno;              /**< errno if the root could not be opened */
+     pthread_mutex_t idle_lock;   /**< Guards sleeping */
+     pthread_cond_t idle_cond;    /**< Signalled on new work or completion */
+ } walk_state_t;
+
+ /**
+  * @struct walk_thread_arg
+  * @brief Start argument for a walker thread
+  */
+ typedef struct walk_thread_arg {
+     walk_state_t* st;  /**< Shared state */
+     int self;          /**< Index of the thread's deque */
+ } walk_thread_arg_t;
+
+ /**
+  * -----------------------------------------------------------------------------
+  * Job helpers
+  * -----------------------------------------------------------------------------
+  */
+
+ /**
+  * @brief Create a job for a directory
+  *
+  * @param parent Parent job (NULL for the root); gains a reference
+  * @param name Name in parent, or the root path
+  * @param relpath Path relative to the root
+  * @param depth Depth below the root
+  * @return New job
+  */
+ static walk_dir_t* dir_new(walk_dir_t* parent, const char* name,
+                            const char* relpath, int depth) {
+     size_t len = strlen(name);
+     walk_dir_t* d = malloc(sizeof(*d) + len + 1);
+     memcpy(d->name, name, len + 1);
+     d->parent = parent;
+     d->fd = -1;
+     atomic_init(&d->refs, 1);
+     d->depth = depth;
+     d->relpath = strdup(relpath);
+     if (parent) atomic_fetch_add(&parent->refs, 1);
+     return d;
+ }
+
+ /**
+  * @brief Drop a reference, closing and freeing the job on the last one
+  *
+  * @param d Job to release
+  */
+ static void dir_release(walk_dir_t* d) {
+     if (atomic_fetch_sub(&d->refs, 1) != 1) return;
+     if (d->fd >= 0) close(d->fd);
+     free(d->relpath);
+     free(d);
+ }
+
+ /**
+  * @brief Append a job to the back of a deque
+  *
+  * @param q Deque to push to
+  * @param d Job to push
+  */
+ static void deque_push(walk_deque_t* q, walk_dir_t* d) {
+     pthread_mutex_lock(&q->lock);
+     if (q->count == q->cap) {
+         size_t ncap = q->cap ? q->cap * 2 : 64;
+         walk_dir_t** nbuf = malloc(ncap * sizeof(*nbuf));
+         for (size_t i = 0; i < q->count; i++)
+             nbuf[i] = q->buf[(q->head + i) & (q->cap - 1)];
+         free(q->buf);
+         q->buf = nbuf;
+         q->cap = ncap;
+         q->head = 0;
+     }
+     q->buf[(q->head + q->count) & (q->cap - 1)] = d;
+     q->count++;
+     pthread_mutex_unlock(&q->lock);
+ }
+
+ /**
+  * @brief Take the newest (owner) or oldest (thief) job from a deque
+  *
+  * @param q Deque to take from
+  * @param oldest Non-zero to take the oldest job
+  * @return Job, or NULL if the deque is empty
+  */
+ static walk_dir_t* deque_take(walk_deque_t* q, int oldest) {
+     walk_dir_t* d = NULL;
+     pthread_mutex_lock(&q->lock);
+     if (q->count > 0) {
+         if (oldest) {
+             d = q->buf[q->head];
+             q->head = (q->head + 1) & (q->cap - 1);
+         } else {
+             d = q->buf[(q->head + q->count - 1) & (q->cap - 1)];
+         }
+         q->count--;
+     }
+     pthread_mutex_unlock(&q->lock);
+     return d;
+ }
+
+ /**
+  * @brief Queue a job on a thread's deque and wake an idle thread
+  *
+  * @param st Shared state
+  * @param self Deque to push to
+  * @param d Job to queue
+  */
+ static void schedule_dir(walk_state_t* st, int self, walk_dir_t* d) {
+     atomic_fetch_add(&st->outstanding, 1);
+     deque_push(&st->deques[self], d);
+
+     pthread_mutex_lock(&st->idle_lock);
+     atomic_fetch_add(&st->queued, 1);
+     pthread_cond_signal(&st->idle_cond);
+     pthread_mutex_unlock(&st->idle_lock);
+ }
+
+ /**
+  * -----------------------------------------------------------------------------
+  * Walking
+  * -----------------------------------------------------------------------------
+  */
+
+ /**
+  * @brief Open, list and release one directory
+  *
+  * @param st Shared state
+  * @param self Index of the calling thread
+  * @param d Job to process
+  * @param batch Scratch array of opts.batch_size entries
+  * @param dents Scratch getdents64() buffer
+  */
+ static void walk_one(walk_state_t* st, int self, walk_dir_t* d,
+                      dir_walk_entry_t* batch, char* dents) {
+     int pfd = d->parent ? d->parent->fd : AT_FDCWD;
+     d->fd = openat(pfd, d->name, O_RDONLY | O_DIRECTORY | O_CLOEXEC |
+                    (d->parent ? O_NOFOLLOW : 0));
+     if (d->parent) {
+         dir_release(d->parent);
+         d->parent = NULL;
+     }
+     if (d->fd < 0) {
+         if (d->depth == 0) st->root_errno = errno;
+         else atomic_fetch_add(&st->errors, 1);
+         dir_release(d);
+         return;
+     }
+
+     int recurse = st->opts.max_depth == 0 || d->depth + 1 < st->opts.max_depth;
+     ssize_t len;
+     while ((len = getdents64(d->fd, dents, WALK_DENTS_BUFSIZE)) > 0) {
+         size_t n = 0;
+         for (ssize_t off = 0; off < len; ) {
+             struct dirent64* e = (struct dirent64*)(dents + off);
+             off += e->d_reclen;
+
+             /* Skip . and .. */
+             if (e->d_name[0] == '.' && (e->d_name[1] == '\0' ||
+                 (e->d_name[1] == '.' && e->d_name[2] == '\0')))
+                 continue;
+
+             /* Some filesystems don't fill d_type */
+             unsigned char type = e->d_type;
+             if (type == DT_UNKNOWN) {
+                 struct stat sb;
+                 if (fstatat(d->fd, e->d_name, &sb, AT_SYMLINK_NOFOLLOW) < 0) continue;
+                 type = S_ISDIR(sb.st_mode) ? DT_DIR : S_ISREG(sb.st_mode) ? DT_REG :
+                        S_ISLNK(sb.st_mode) ? DT_LNK : S_ISFIFO(sb.st_mode) ? DT_FIFO :
+                        S_ISSOCK(sb.st_mode) ? DT_SOCK : S_ISCHR(sb.st_mode) ? DT_CHR : DT_BLK;
+             }
+
+             batch[n].dirfd = d->fd;
+             batch[n].relpath = d->relpath;
+             batch[n].name = e->d_name;
+             batch[n].d_type = type;
+             batch[n].ino = e->d_ino;
+             batch[n].depth = d->depth;
+             n++;
+
+             /* Subdirectories become jobs other threads can steal */
+             if (type == DT_DIR && recurse) {
+                 char rel[PATH_MAX];
+                 if (d->relpath[0]) snprintf(rel, sizeof(rel), "%s/%s", d->relpath, e->d_name);
+                 else snprintf(rel, sizeof(rel), "%s", e->d_name);
+                 schedule_dir(st, self, dir_new(d, e->d_name, rel, d->depth + 1));
+             }
+
+             if (n == st->opts.batch_size) {
+                 st->fn(batch, n, st->ctx);
+                 n = 0;
+             }
+         }
+         /* Names point into dents: deliver before the next read */
+         if (n) st->fn(batch, n, st->ctx);
+     }
+     if (len < 0) atomic_fetch_add(&st->errors, 1);
+
+     dir_release(d);
+ }
+
+ /**
+  * @brief Walker thread body (also run by the calling thread)
+  */
+ static void* walk_thread_main(void* arg) {
+     walk_thread_arg_t* a = arg;
+     walk_state_t* st = a->st;
+     int self = a->self;
+     int nthreads = st->opts.threads;
+
+     dir_walk_entry_t* batch = malloc(st->opts.batch_size * sizeof(*batch));
+     char* dents = malloc(WALK_DENTS_BUFSIZE);
+
+     for (;;) {
+         /* Own deque newest-first, then steal oldest-first */
+         walk_dir_t* d = deque_take(&st->deques[self], 0);
+         for (int i = 1; !d && i < nthreads; i++)
+             d = deque_take(&st->deques[(self + i) % nthreads], 1);
+
+         if (d) {
+             atomic_fetch_sub(&st->queued, 1);
+             walk_one(st, self, d, batch, dents);
+             if (atomic_fetch_sub(&st->outstanding, 1) == 1) {
+                 /* Last job finished: wake everyone so they can exit */
+                 pthread_mutex_lock(&st->idle_lock);
+                 pthread_cond_broadcast(&st->idle_cond);
+                 pthread_mutex_unlock(&st->idle_lock);
+             }
+             continue;
+         }
+
+         /* Nothing to steal: sleep until new work or the walk is done */
+         pthread_mutex_lock(&st->idle_lock);
+         while (atomic_load(&st->queued) == 0 && atomic_load(&st->outstanding) > 0)
+             pthread_cond_wait(&st->idle_cond, &st->idle_lock);
+         int done = atomic_load(&st->outstanding) == 0;
+         pthread_mutex_unlock(&st->idle_lock);
+         if (done) break;
+     }
+
+     free(batch);
+     free(dents);
+     return NULL;
+ }
+
+ /**
+  * -----------------------------------------------------------------------------
+  * Public API Implementation
+  * -----------------------------------------------------------------------------
+  */
+
+ /**
+  * @brief Walk a directory tree
+  *
+  * @param root Directory to walk
+  * @param opts Options (NULL for single-threaded, unlimited depth)
+  * @param fn Consumer callback
+  * @param ctx Consumer context
+  * @return Number of subdirectories that could not be read, or -1 (errno set)
+  *         if the root itself could not be opened
+  */
+ int dir_walk(const char* root, const dir_walk_opts_t* opts, dir_walk_fn fn, void* ctx) {
+     walk_state_t st;
+     memset(&st, 0, sizeof(st));
+     if (opts) st.opts = *opts;
+     if (st.opts.threads < 1) st.opts.threads = 1;
+     if (st.opts.batch_size == 0) st.opts.batch_size = WALK_DEFAULT_BATCH;
+     st.fn = fn;
+     st.ctx = ctx;
+     pthread_mutex_init(&st.idle_lock, NULL);
+     pthread_cond_init(&st.idle_cond, NULL);
+
+     int nthreads = st.opts.threads;
+     st.deques = calloc(nthreads, sizeof(*st.deques));
+     for (int i = 0; i < nthreads; i++) pthread_mutex_init(&st.deques[i].lock, NULL);
+
+     /* Seed the walk with the root on the caller's deque */
+     schedule_dir(&st, 0, dir_new(NULL, root, "", 0));
+
+     pthread_t* threads = calloc(nthreads, sizeof(*threads));
+     walk_thread_arg_t* args = calloc(nthreads, sizeof(*args));
+     int started = 1;
+     for (int i = 1; i < nthreads; i++) {
+         args[i].st = &st;
+         args[i].self = i;
+         if (pthread_create(&threads[i], NULL, walk_thread_main, &args[i])) break;
+         started++;
+     }
+
+     /* The calling thread walks too */
+     args[0].st = &st;
+     args[0].self = 0;
+     walk_thread_main(&args[0]);
+
+     for (int i = 1; i < started; i++) pthread_join(threads[i], NULL);
+
+     for (int i = 0; i < nthreads; i++) {
+         pthread_mutex_destroy(&st.deques[i].lock);
+         free(st.deques[i].buf);
+     }
+     free(st.deques);
+     free(threads);
+     free(args);
+     pthread_mutex_destroy(&st.idle_lock);
+     pthread_cond_destroy(&st.idle_cond);
+
+     if (st.root_errno) {
+         errno = st.root_errno;
+         return -1;
+     }
+     return atomic_load(&st.errors);
+ }
@@ -0,0 +1,205 @@
+/**
+ * @file event_stream.c
+ * @brief Implementation of watch-mode event delivery
+ *
+ * Each subscriber owns a fixed buffer of pending lines. Flushing writes at
+ * most PIPE_BUF bytes per write() and always ends a chunk on a line
+ * boundary: such writes to a pipe are atomic, so a full FIFO rejects the
+ * whole chunk with EAGAIN instead of splitting a line.
+ */
+
+ #include "../include/event_stream.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <string.h>
+ #include <stdarg.h>
+ #include <errno.h>
+ #include <time.h>
+ #include <unistd.h>
+ #include <limits.h>
+ #include <linux/limits.h>
+
+ /**
+  * @struct subscriber
+  * @brief One watching console
+  */
+ typedef struct subscriber {
+     int fd;                          /**< Output fd (-1 if the slot is free) */
+     char source[PATH_MAX];           /**< Source filter ("" for all) */
+     char buf[EVENT_STREAM_BUFSIZE];  /**< Pending lines */
+     size_t len;                      /**< Bytes pending */
+     unsigned long dropped;           /**< Dropped since the last DROPPED notice */
+     unsigned long dropped_total;     /**< Dropped over the subscription */
+ } subscriber_t;
+
+ static subscriber_t* subs[EVENT_STREAM_MAX_SUBSCRIBERS];  /**< Subscription table */
+
+ /**
+  * @brief Find a subscriber by fd
+  *
+  * @param fd Output fd
+  * @return Slot index, or -1
+  */
+ static int find_sub(int fd) {
+     for (int i = 0; i < EVENT_STREAM_MAX_SUBSCRIBERS; i++)
+         if (subs[i] && subs[i]->fd == fd) return i;
+     return -1;
+ }
+
+ /**
+  * @brief Append a line if it fits
+  *
+  * @param s Subscriber
+  * @param line Line including its newline
+  * @param n Length of line
+  * @return 1 if appended, 0 if the buffer is full
+  */
+ static int append(subscriber_t* s, const char* line, size_t n) {
+     if (s->len + n > sizeof(s->buf)) return 0;
+     memcpy(s->buf + s->len, line, n);
+     s->len += n;
+     return 1;
+ }
+
+ /**
+  * @brief Current time as "[YYYY-mm-dd HH:MM:SS]"
+  *
+  * @param out Buffer of at least 32 bytes
+  */
+ static void timestamp(char* out) {
+     time_t now = time(NULL);
+     struct tm tm_info;
+     strftime(out, 32, "[%Y-%m-%d %H:%M:%S]", localtime_r(&now, &tm_info));
+ }
+
+ /**
+  * @brief Subscribe an output fd to events
+  *
+  * @param fd Non-blocking output fd
+  * @param source Only events for this source (NULL for all)
+  * @return 0 on success, -1 if the subscriber table is full
+  */
+ int event_stream_subscribe(int fd, const char* source) {
+     int i = find_sub(fd);
+     if (i < 0) {
+         for (i = 0; i < EVENT_STREAM_MAX_SUBSCRIBERS && subs[i]; i++);
+         if (i == EVENT_STREAM_MAX_SUBSCRIBERS) return -1;
+         subs[i] = calloc(1, sizeof(*subs[i]));
+         subs[i]->fd = fd;
+     }
+     snprintf(subs[i]->source, sizeof(subs[i]->source), "%s", source ? source : "");
+     return 0;
+ }
+
+ /**
+  * @brief Cancel a subscription, discarding anything still buffered
+  *
+  * @param fd Subscribed fd
+  * @return Events dropped over the subscription's lifetime, or -1
+  */
+ long event_stream_unsubscribe(int fd) {
+     int i = find_sub(fd);
+     if (i < 0) return -1;
+     long dropped = (long)subs[i]->dropped_total;
+     free(subs[i]);
+     subs[i] = NULL;
+     return dropped;
+ }
+
+ /**
+  * @brief Queue an event for every matching subscriber
+  *
+  * @param source Source the event concerns (NULL reaches every subscriber)
+  * @param fmt printf-style body
+  */
+ void event_stream_publish(const char* source, const char* fmt, ...) {
+     char line[PATH_MAX * 2 + 256], ts[32];
+     int n = -1;
+
+     for (int i = 0; i < EVENT_STREAM_MAX_SUBSCRIBERS; i++) {
+         subscriber_t* s = subs[i];
+         if (!s || (source && s->source[0] && strcmp(s->source, source) != 0)) continue;
+
+         /* Format lazily: most of the time nobody is watching */
+         if (n < 0) {
+             timestamp(ts);
+             int h = snprintf(line, sizeof(line), "EVENT %s ", ts);
+             va_list ap;
+             va_start(ap, fmt);
+             vsnprintf(line + h, sizeof(line) - h - 1, fmt, ap);
+             va_end(ap);
+             n = strlen(line);
+             line[n++] = '\n';
+         }
+
+         /* Tell the consumer what it missed before anything newer */
+         if (s->dropped) {
+             char notice[96];
+             int m = snprintf(notice, sizeof(notice), "EVENT %s [DROPPED] [%lu]\n", ts, s->dropped);
+             if (s->len + m + n <= sizeof(s->buf)) {
+                 append(s, notice, m);
+                 s->dropped = 0;
+             }
+         }
+
+         if (s->dropped || !append(s, line, n)) {
+             s->dropped++;
+             s->dropped_total++;
+         }
+     }
+ }
+
+ /**
+  * @brief Write buffered events without blocking
+  */
+ void event_stream_flush(void) {
+     for (int i = 0; i < EVENT_STREAM_MAX_SUBSCRIBERS; i++) {
+         subscriber_t* s = subs[i];
+         if (!s) continue;
+
+         size_t off = 0;
+         while (off < s->len) {
+             /* Largest run of whole lines within PIPE_BUF */
+             size_t chunk = s->len - off;
+             if (chunk > PIPE_BUF) {
+                 chunk = PIPE_BUF;
+                 while (chunk > 0 && s->buf[off + chunk - 1] != '\n') chunk--;
+                 if (chunk == 0) chunk = PIPE_BUF;  /* Line longer than PIPE_BUF */
+             }
+
+             ssize_t w = write(s->fd, s->buf + off, chunk);
+             if (w > 0) {
+                 off += w;
+                 continue;
+             }
+             if (w < 0 && errno == EINTR) continue;
+             if (w < 0 && errno == EAGAIN) break;  /* Reader is slow: keep the rest */
+
+             /* Reader gone (EPIPE) or fd invalid */
+             free(s);
+             subs[i] = NULL;
+             s = NULL;
+             break;
+         }
+         if (!s) continue;
+
+         memmove(s->buf, s->buf + off, s->len - off);
+         s->len -= off;
+     }
+ }
+
+ /**
+  * @brief Add fds with buffered events to a select() write set
+  *
+  * @param wfds Write set to extend
+  * @param maxfd Current highest fd + 1
+  * @return New highest fd + 1
+  */
+ int event_stream_fill_wfds(fd_set* wfds, int maxfd) {
+     for (int i = 0; i < EVENT_STREAM_MAX_SUBSCRIBERS; i++) {
+         if (!subs[i] || subs[i]->len == 0) continue;
+         FD_SET(subs[i]->fd, wfds);
+         if (subs[i]->fd >= maxfd) maxfd = subs[i]->fd + 1;
+     }
+     return maxfd;
+ }
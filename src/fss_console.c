@@ -3,24 +3,25 @@
  * @brief User interface for managing and querying the FSS system
  *
  * This file implements the console interface that users interact with to
- * control the File Synchronization System. It communicates with the fss_manager
- * process through named pipes (FIFOs) to send commands and receive responses.
+ * control the File Synchronization System. It talks to the fss_manager
+ * process through the client library (libfss.h), which keeps one connection
+ * over the named pipes (FIFOs) open for the whole session.
  */
 
+ #include "../include/status_shm.h"
+ #include "../include/libfss.h"
  #include <stdio.h>
  #include <stdlib.h>
  #include <string.h>
  #include <unistd.h>
- #include <fcntl.h>
- #include <sys/types.h>
- #include <sys/stat.h>
- #include <sys/select.h>
+ #include <signal.h>
+ #include <poll.h>
  #include <time.h>
  #include <errno.h>
  
- #define FSS_IN   "fss_in"    /**< Name of the FIFO for sending commands to the manager */
- #define FSS_OUT  "fss_out"   /**< Name of the FIFO for receiving responses from the manager */
- #define BUFSIZE  1024        /**< Buffer size for commands and responses */
+ #define BUFSIZE  1024        /**< Buffer size for commands */
+ #define CONNECT_TIMEOUT_MS 5000  /**< How long to wait for the manager's FIFOs */
+ #define REPLY_TIMEOUT_MS 5000    /**< How long a reply may take (shutdown and status --all excepted) */
  
  /**
   * @brief Log a command to the console log file
@@ -44,28 +45,90 @@
  }
  
  /**
-  * @brief Wait for a FIFO to be created by the manager
+  * @brief Print a pushed event line
   *
-  * Polls the filesystem until the named pipe appears or a timeout occurs.
-  * This ensures the console doesn't start until the manager is ready.
+  * @param line Line without newline
+  * @param ctx Unused
+  */
+ void print_event(const char *line, void *ctx) {
+     (void)ctx;
+     printf("%s\n", line);
+     fflush(stdout);
+ }
+ 
+ /**
+  * @brief Stream pushed events until the user presses Enter
+  *
+  * Events are printed by print_event() as they arrive after a successful
+  * 'watch'. When a line is typed on stdin the subscription is ended with
+  * 'unwatch', and the manager's confirmation is printed.
   *
-  * @param path Path to the FIFO to wait for
+  * @param c Connection to the manager
+  * @param log_file Console log file
+  * @return 0 when the watch ended, -1 if the manager went away
   */
- void wait_for_fifo(const char *path) {
-     struct stat st;
-     int tries = 50;  /* Try up to 50 times (5 seconds total) */
-     
-     while (tries-- > 0) {
-         /* Check if FIFO exists and is actually a FIFO */
-         if (stat(path, &st) == 0 && S_ISFIFO(st.st_mode)) {
-             return;  /* FIFO exists, we can proceed */
+ int watch_loop(fss_client_t *c, FILE *log_file) {
+     char buf[BUFSIZE];
+ 
+     printf("Watching, press Enter to stop.\n");
+     fflush(stdout);
+ 
+     while (1) {
+         struct pollfd pfd[2] = {
+             { .fd = STDIN_FILENO, .events = POLLIN },
+             { .fd = fss_fd(c), .events = POLLIN },
+         };
+         if (poll(pfd, 2, -1) < 0) {
+             if (errno == EINTR) continue;
+             perror("poll");
+             return -1;
+         }
+         if (pfd[1].revents && fss_poll(c, 0) < 0) return -1;
+ 
+         /* Any input line ends the watch */
+         if (pfd[0].revents) {
+             if (!fgets(buf, sizeof(buf), stdin)) buf[0] = 0;
+             log_command(log_file, "unwatch");
+             char *reply = fss_call(c, "unwatch", REPLY_TIMEOUT_MS);
+             if (!reply) return errno == EPIPE ? -1 : 0;
+             printf("%s", reply);
+             free(reply);
+             return 0;
+         }
+     }
+ }
+ 
+ /**
+  * @brief Handle the local 'stat' command
+  *
+  * Reads the manager's shared status table directly instead of asking
+  * the manager, so it answers even while the manager is busy.
+  *
+  * @param arg Source directory, or "--all"
+  */
+ void print_stat(const char *arg) {
+     status_shm_t *table = status_shm_open(STATUS_SHM_FILE);
+     if (!table) {
+         printf("No status table (%s); is fss_manager running here?\n", STATUS_SHM_FILE);
+         return;
+     }
+ 
+     status_record_t rec;
+     char line[PATH_MAX * 2 + 256];
+     int64_t now = status_shm_now_ms();
+     printf("%s", status_shm_fields());
+     if (strcmp(arg, "--all") == 0) {
+         for (unsigned i = 0; status_shm_read(table, i, &rec) == 0; i++) {
+             status_shm_format(&rec, now, line, sizeof(line));
+             printf("%s", line);
          }
-         usleep(100 * 1000);  /* Sleep 100ms between attempts */
+     } else if (status_shm_find(table, arg, &rec) == 0) {
+         status_shm_format(&rec, now, line, sizeof(line));
+         printf("%s", line);
+     } else {
+         printf("Directory not monitored: %s\n", arg);
      }
-     
-     /* Timeout occurred */
-     fprintf(stderr, "Timeout waiting for FIFO: %s\n", path);
-     exit(EXIT_FAILURE);
+     status_shm_close(table, 0);
  }
  
  /**
@@ -93,31 +156,20 @@
          return EXIT_FAILURE;
      }
  
-     /* Wait for manager to create the communication pipes */
-     wait_for_fifo(FSS_IN);
-     wait_for_fifo(FSS_OUT);
- 
-     /* Open pipe for sending commands to manager */
-     int fd_in = open(FSS_IN, O_WRONLY);
-     if (fd_in < 0) {
-         perror("Failed to open fss_in pipe");
+     /* Connect once; the connection is reused for every command */
+     signal(SIGPIPE, SIG_IGN);
+     fss_client_t *c = fss_connect(NULL, CONNECT_TIMEOUT_MS);
+     if (!c) {
+         if (errno == ETIMEDOUT) fprintf(stderr, "Timeout waiting for fss_in and fss_out\n");
+         else perror("Failed to open the manager's pipes");
          fprintf(stderr, "Make sure fss_manager is running\n");
          fclose(log_file);
          return EXIT_FAILURE;
      }
+     fss_on_event(c, print_event, NULL);
  
-     /* Open pipe for receiving responses from manager */
-     int fd_out = open(FSS_OUT, O_RDONLY | O_NONBLOCK);
-     if (fd_out < 0) {
-         perror("Failed to open fss_out pipe");
-         close(fd_in);
-         fclose(log_file);
-         return EXIT_FAILURE;
-     }
- 
-     /* Buffers for user commands and manager responses */
+     /* Buffer for user commands */
      char command[BUFSIZE];
-     char response[BUFSIZE * 4];  /* Response buffer is 4x command buffer */
  
      /* Display welcome message */
      printf("FSS Console. Type 'help' for available commands.\n");
@@ -132,6 +184,7 @@
  
          /* Remove trailing newline from command */
          command[strcspn(command, "\n")] = 0;
+         if (!command[0]) continue;
  
          /* Handle built-in 'exit' command */
          if (strcmp(command, "exit") == 0) {
@@ -143,50 +196,51 @@
              printf("Available commands:\n");
              printf("  add <source> <target>  - Add a directory for monitoring\n");
              printf("  status <source>        - Show status of a monitored directory\n");
+             printf("  status --all           - Machine-readable status of every directory\n");
+             printf("  stat <source>|--all    - Read status from the shared table (no manager round trip)\n");
              printf("  cancel <source>        - Stop monitoring a directory\n");
              printf("  sync <source>          - Synchronize a directory\n");
+             printf("  verify <source>        - Compare a digest=1 directory with its target\n");
+             printf("  reconcile <source>     - Sync the differences verify reports\n");
+             printf("  watch [source]         - Stream task events (Enter stops)\n");
              printf("  shutdown               - Shutdown the manager\n");
              printf("  exit                   - Exit the console\n");
              continue;
          }
  
-         /* Log the command to console log file */
-         log_command(log_file, command);
- 
-         /* Send command to manager */
-         ssize_t w = write(fd_in, command, strlen(command));
-         if (w < 0) {
-             perror("Failed to write to fss_in pipe");
+         /* Handle 'stat' locally from the shared status table */
+         if (strncmp(command, "stat ", 5) == 0) {
+             print_stat(command + 5);
              continue;
          }
-         write(fd_in, "\n", 1);  /* Send newline to terminate command */
- 
-         /* Wait for response with timeout */
-         fd_set read_fds;
-         struct timeval tv;
  
-         FD_ZERO(&read_fds);
-         FD_SET(fd_out, &read_fds);
-         tv.tv_sec  = 5;  /* 5 second timeout */
-         tv.tv_usec = 0;
+         /* Log the command to console log file */
+         log_command(log_file, command);
  
-         int sel = select(fd_out + 1, &read_fds, NULL, NULL, &tv);
-         if (sel < 0) {
-             perror("select");
-             continue;
-         } else if (sel == 0) {
-             printf("Timeout waiting for response from manager\n");
-             continue;
+         /* Send the command and wait for its whole reply */
+         int slow = strncmp(command, "shutdown", 8) == 0 || strcmp(command, "status --all") == 0;
+         char *response = fss_call(c, command, slow ? -1 : REPLY_TIMEOUT_MS);
+         if (!response) {
+             if (errno == ETIMEDOUT) {
+                 printf("Timeout waiting for response from manager\n");
+                 continue;
+             }
+             if (errno == EINVAL) {
+                 printf("Invalid command\n");
+                 continue;
+             }
+             printf("Connection to manager lost\n");
+             break;
          }
+         printf("%s", response);
  
-         /* Read and display the response */
-         ssize_t n = read(fd_out, response, sizeof(response) - 1);
-         if (n < 0) {
-             perror("Failed to read from fss_out pipe");
-             continue;
+         /* Stay attached to the event stream after a successful 'watch' */
+         int watching = strncmp(command, "watch", 5) == 0 && strstr(response, "Watching");
+         free(response);
+         if (watching && watch_loop(c, log_file) < 0) {
+             printf("Connection to manager lost\n");
+             break;
          }
-         response[n] = '\0';  /* Null-terminate the response */
-         printf("%s", response);
  
          /* Exit if 'shutdown' command was issued */
          if (strncmp(command, "shutdown", 8) == 0) {
@@ -195,8 +249,7 @@
      }
  
      /* Clean up resources */
-     close(fd_in);
-     close(fd_out);
+     fss_close(c);
      fclose(log_file);
      return EXIT_SUCCESS;
  }
\ No newline at end of file
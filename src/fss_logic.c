@@ -8,9 +8,26 @@
  * source and target directories.
  */
 
+ #define _GNU_SOURCE  /* pipe2() */
  #include "../include/fss_logic.h"
  #include "../include/hashmap.h"
  #include "../include/sync_info.h"
+ #include "../include/fss_pipeline.h"
+ #include "../include/sync_ops.h"
+ #include "../include/thread_pool.h"
+ #include "../include/source_options.h"
+ #include "../include/path_index.h"
+ #include "../include/write_tracker.h"
+ #include "../include/event_stream.h"
+ #include "../include/status_stream.h"
+ #include "../include/task_priority.h"
+ #include "../include/task_table.h"
+ #include "../include/deadline_queue.h"
+ #include "../include/sync_policy.h"
+ #include "../include/timer_wheel.h"
+ #include "../include/poll_monitor.h"
+ #include "../include/status_shm.h"
+ #include "../include/merkle.h"
  #include <stdio.h>
  #include <stdlib.h>
  #include <string.h>
@@ -20,9 +37,10 @@
  #include <errno.h>
  #include <sys/inotify.h>
  #include <linux/limits.h>
- #include <signal.h>
- #include <sys/wait.h>
  #include <sys/stat.h>
+ #include <poll.h>
+ #include <pthread.h>
+ #include <sys/syscall.h>
  
  
  /**
@@ -36,33 +54,57 @@
   * @brief Represents a pending synchronization task in the queue
   *
   * When the system reaches the worker limit, new synchronization tasks
-  * are queued until a worker becomes available.
+  * are queued, earliest deadline first, until a worker becomes available.
+  * A task that conflicts with a running one of its source is deferred in
+  * the task table.
   */
  typedef struct worker_task {
      char source_dir[PATH_MAX]; /**< Source directory path */
      char target_dir[PATH_MAX]; /**< Target directory path */
      char filename[PATH_MAX];   /**< File to synchronize (or "ALL" for full sync) */
-     char operation[20];        /**< Operation type: "FULL", "ADDED", "MODIFIED", "DELETED" */
-     struct worker_task* next;  /**< Pointer to next task in queue */
+     char from[NAME_MAX + 1];   /**< Old name of a RENAMED task ("" otherwise) */
+     char operation[20];        /**< Operation type: "FULL", "ADDED", "MODIFIED", "DELETED", "RENAMED" */
+     int reserved;              /**< Released from deferral, already running in the task table */
+     long long changed;         /**< When the oldest change it covers was seen (ms, CLOCK_MONOTONIC) */
  } worker_task_t;
  
  /**
   * @struct worker_info
   * @brief Represents an active worker process
   *
-  * Tracks information about a running worker process, including its
-  * communication pipe and the synchronization task it's performing.
+  * Tracks information about a running worker process and the synchronization
+  * task it's performing. Its output pipe is owned by the completion thread.
   */
  typedef struct worker_info {
      pid_t pid;                 /**< Process ID of the worker */
-     int pipe_fd;               /**< File descriptor for reading worker output */
      char source_dir[PATH_MAX]; /**< Source directory being synchronized */
      char target_dir[PATH_MAX]; /**< Target directory being synchronized */
      char filename[PATH_MAX];   /**< File being synchronized (or "ALL") */
+     char from[NAME_MAX + 1];   /**< Old name of a RENAMED task ("" otherwise) */
      char operation[20];        /**< Operation being performed */
+     sync_info_t* feeds;        /**< Monitored source the target lies in (or NULL) */
+     int feeds_exact;           /**< Target is exactly feeds' source directory */
+     pid_t task_tid;            /**< OS task running it: the worker PID or pool thread TID (0 until known) */
+     long long changed;         /**< When the oldest change it covers was seen (ms, CLOCK_MONOTONIC) */
      struct worker_info* next;  /**< Pointer to next active worker in list */
  } worker_info_t;
  
+ /**
+  * @struct exec_job
+  * @brief A task run in-process, by the threaded executor or inline
+  */
+ typedef struct exec_job {
+     pid_t id;                  /**< Task ID (stands in for the worker PID) */
+     char source_dir[PATH_MAX]; /**< Source directory path */
+     char target_dir[PATH_MAX]; /**< Target directory path */
+     char filename[PATH_MAX];   /**< File to synchronize (or "ALL") */
+     char from[NAME_MAX + 1];   /**< Old name of a RENAMED task */
+     char operation[20];        /**< Operation type */
+     sync_options_t opts;       /**< Per-source options */
+     task_priority_t priority;  /**< Per-source priority, applied to the task's own thread */
+     pid_t* tid_slot;           /**< Where to publish the pool thread's TID (worker_info_t.task_tid) */
+ } exec_job_t;
+ 
  /**
   * -----------------------------------------------------------------------------
   * Watch descriptor to source directory mapping
@@ -74,11 +116,15 @@
   * @brief Maps inotify watch descriptors to source directories
   *
   * Enables lookup of which source directory an inotify event came from
-  * based on the watch descriptor included in the event.
+  * based on the watch descriptor included in the event. Paths are stored
+  * in canonical form, as keys of the path indexes.
   */
  typedef struct {
+     int shard;                /**< inotify instance holding the watch (-1 if polled) */
      int wd;                   /**< inotify watch descriptor */
-     char source[PATH_MAX];    /**< Source directory path being watched */
+     sync_info_t* info;        /**< Source registered with this watch */
+     char source[PATH_MAX];    /**< Canonical source directory being watched */
+     char target[PATH_MAX];    /**< Canonical target directory */
  } watch_map_t;
  
  /**
@@ -86,7 +132,8 @@
   * Global variables (single definition)
   * -----------------------------------------------------------------------------
   */
- int inotify_fd;                  /**< File descriptor for inotify instance */
+ int inotify_fds[PIPELINE_MAX_SHARDS];  /**< inotify instances, sources assigned by hash */
+ int inotify_shards = 0;                 /**< Number of inotify instances */
  volatile int running = 1;        /**< Flag indicating if main loop should continue */
  
  int global_fd_out = -1;          /**< File descriptor for console output pipe */
@@ -94,15 +141,100 @@
  
  static int worker_limit_global = 5;  /**< Maximum concurrent worker processes */
  static int active_worker_count = 0;  /**< Current number of active workers */
+ static int inline_task_count = 0;    /**< Inline tasks running or waiting for the inline thread */
  
  /* Active worker list and task queue */
  static worker_info_t* active_workers = NULL;  /**< Linked list of active workers */
- static worker_task_t* task_queue = NULL;      /**< Queue of pending synchronization tasks */
+ static deadline_queue_t* task_queue = NULL;   /**< Pending tasks, earliest deadline first */
+ static task_table_t* task_table = NULL;       /**< Running and deferred tasks by (source, file) */
+ 
+ /* Executor selection */
+ static executor_mode_t executor_mode = EXECUTOR_PROCESS;  /**< How tasks are run */
+ static thread_pool_t* executor_pool = NULL;  /**< Pool for EXECUTOR_THREAD */
+ static thread_pool_t* inline_pool = NULL;    /**< Manager-side fast path for EXECUTOR_PROCESS */
+ static pid_t next_job_id = 0;                /**< Last in-process task ID */
+ 
+ /* Prioritized in-process tasks, each on a thread of its own */
+ static pthread_mutex_t own_thread_lock = PTHREAD_MUTEX_INITIALIZER;  /**< Guards own_threads */
+ static pthread_cond_t own_thread_done = PTHREAD_COND_INITIALIZER;    /**< Signalled as one exits */
+ static int own_threads = 0;                  /**< Such threads still running */
+ 
+ #define BEST_EFFORT_LAG 3600  /**< Deadline (seconds) for tasks of sources without max_lag */
+ 
+ #define INLINE_THREADS 1                 /**< Threads running inline tasks */
+ #define INLINE_ID_BASE (4 * 1024 * 1024) /**< Inline task IDs start above PID_MAX_LIMIT */
  
  /* Watch descriptor mapping */
  static watch_map_t* watch_map = NULL;    /**< Array of watch descriptor mappings */
  static int watch_map_len = 0;            /**< Number of entries in watch_map */
  
+ /* Watch descriptor -> watch_map index, per inotify instance; the last
+  * table holds pollers, whose synthetic descriptors count down from -1 */
+ #define POLLER_SLOTS PIPELINE_MAX_SHARDS
+ static int* wd_slots[PIPELINE_MAX_SHARDS + 1];    /**< Index into watch_map, -1 if none */
+ static int wd_slots_len[PIPELINE_MAX_SHARDS + 1]; /**< Length of each table */
+ 
+ /**
+  * @struct pending_move_t
+  * @brief First half of a rename, held until its IN_MOVED_TO arrives
+  */
+ typedef struct {
+     sync_info_t* info;          /**< Source it happened in (NULL when none is held) */
+     int shard;                  /**< inotify instance it came from */
+     uint32_t cookie;            /**< Cookie pairing it with its IN_MOVED_TO */
+     char dir[PATH_MAX];         /**< Canonical watched directory */
+     char name[NAME_MAX + 1];    /**< Old name */
+ } pending_move_t;
+ 
+ static pending_move_t pending_move;  /**< Held IN_MOVED_FROM (info NULL if none) */
+ 
+ /**
+  * @struct held_delete
+  * @brief A deletion held back by its source's sync policy
+  */
+ struct held_delete {
+     struct held_delete* next;   /**< Older held deletion */
+     char name[NAME_MAX + 1];    /**< Deleted name */
+ };
+ 
+ static timer_wheel_t* policy_wheel = NULL;  /**< Policy and poll timers, one tick per second */
+ 
+ /**
+  * @struct poll_state
+  * @brief Polling monitor of one monitor=poll source
+  *
+  * The manifest and result are only touched by the scan while busy is set,
+  * and by the scheduler otherwise. A source cancelled mid-scan leaves its
+  * poller behind with info NULL, freed when the scan reports back.
+  */
+ struct poll_state {
+     struct poll_state* next;    /**< Next poller */
+     sync_info_t* info;          /**< Source polled (NULL once cancelled) */
+     char dir[PATH_MAX];         /**< Directory scanned */
+     int wd;                     /**< Synthetic watch descriptor (negative) its events carry */
+     poll_manifest_t* manifest;  /**< Entries seen by the last scan */
+     tw_timer_t timer;           /**< Next scan */
+     int interval;               /**< Current polling interval in seconds */
+     int busy;                   /**< A scan is running on the poll pool */
+     int full_pending;           /**< The initial full sync waits for the baseline scan */
+     long result;                /**< Changes the last scan found (-1 if it failed) */
+     long long scan_ms;          /**< How long the last scan took */
+     size_t entries;             /**< Entries in the manifest after the last scan */
+     unsigned long scans;        /**< Scans finished */
+     unsigned long changes;      /**< Changes found by all scans */
+ };
+ 
+ static struct poll_state* pollers = NULL;   /**< Every poller, cancelled ones included */
+ static int next_poll_wd = 0;                /**< Last synthetic watch descriptor handed out */
+ static thread_pool_t* poll_pool = NULL;     /**< Runs the scans of polled sources */
+ 
+ #define POLL_THREADS 2                      /**< Threads running poll scans */
+ #define POLL_SCAN_DONE 0x00100000u          /**< Event mask ending a scan's events (unused by inotify) */
+ 
+ /* Path indexes (canonical path -> sync_info_t) */
+ static path_index_t* source_index = NULL;  /**< Monitored source directories */
+ static path_index_t* target_index = NULL;  /**< Their target directories */
+ 
  /**
   * -----------------------------------------------------------------------------
   * Helper functions
@@ -113,18 +245,100 @@
   * @brief Generate a timestamp string in the standard format
   *
   * Creates a timestamp in the format [YYYY-MM-DD HH:MM:SS] for logging.
-  * Uses a static buffer for efficiency.
+  * Uses a per-thread static buffer for efficiency.
   *
   * @return Pointer to static buffer containing formatted timestamp
   */
  static char* get_timestamp() {
-     static char buf[32];
+     static __thread char buf[32];
      time_t now = time(NULL);
-     struct tm* tm_info = localtime(&now);
-     strftime(buf, sizeof(buf), "[%Y-%m-%d %H:%M:%S]", tm_info);
+     struct tm tm_info;
+     strftime(buf, sizeof(buf), "[%Y-%m-%d %H:%M:%S]", localtime_r(&now, &tm_info));
      return buf;
  }
  
+ /**
+  * @brief Current time for change and deadline bookkeeping
+  *
+  * @return Milliseconds on CLOCK_MONOTONIC
+  */
+ static long long now_ms() {
+     struct timespec ts;
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+ }
+ 
+ static sync_info_t* status_dirty_list = NULL;  /**< Sources to publish, linked by status_next */
+ static int status_full_logged = 0;             /**< "Table full" was logged */
+ 
+ /**
+  * @brief Note that a source's record in the status table is out of date
+  *
+  * Publishing then only visits the sources on the dirty list. Sources left
+  * out of a full table never get published, so they are not listed.
+  *
+  * @param info Source (may be NULL)
+  */
+ static void mark_status(sync_info_t* info) {
+     if (!info || info->status_dirty) return;
+     if (info->status_slot < 0 && status_full_logged) return;
+     info->status_dirty = 1;
+     info->status_next = status_dirty_list;
+     status_dirty_list = info;
+ }
+ 
+ /**
+  * @brief Count a change a new task covers as unsynced
+  *
+  * @param info Source (may be NULL)
+  * @param changed When the change was seen
+  */
+ static void change_seen(sync_info_t* info, long long changed) {
+     if (!info) return;
+     if (!info->changes) {
+         info->changes = deadline_queue_create();
+         info->changes_done = deadline_queue_create();
+     }
+     deadline_queue_push(info->changes, changed, info);
+ }
+ 
+ /**
+  * @brief Count a change as synced (or no longer covered by its own task)
+  *
+  * Removing from the middle of a heap is not supported, so the change is
+  * recorded in a second heap and both drop matching minima; the oldest
+  * change left is then always live at the top of info->changes.
+  *
+  * @param info Source (may be NULL)
+  * @param changed When the change was seen
+  */
+ static void change_synced(sync_info_t* info, long long changed) {
+     long long a, b;
+     
+     if (!info || !info->changes) return;
+     deadline_queue_push(info->changes_done, changed, info);
+     while (deadline_queue_peek(info->changes, &a) && deadline_queue_peek(info->changes_done, &b) &&
+            a == b) {
+         deadline_queue_pop(info->changes);
+         deadline_queue_pop(info->changes_done);
+     }
+ }
+ 
+ /**
+  * @brief Fold a new change into a task that already waits
+  *
+  * The task keeps the older of the two times; the newer one is no longer
+  * covered by a task of its own.
+  *
+  * @param info Source (may be NULL)
+  * @param kept Waiting task's time of change, updated
+  * @param changed Time of the change folded in
+  */
+ static void merge_change(sync_info_t* info, long long* kept, long long changed) {
+     change_synced(info, changed < *kept ? *kept : changed);
+     if (changed < *kept) *kept = changed;
+ }
+ 
  /**
   * @brief Add a worker to the active workers list
   *
@@ -132,29 +346,42 @@
   * to the front of the active workers list.
   *
   * @param pid Process ID of the worker
-  * @param pipe_fd File descriptor for reading worker output
   * @param src Source directory path
   * @param dst Target directory path
   * @param op Operation type
   * @param fn Filename being processed
+  * @param from Old name of a RENAMED task ("" otherwise)
+  * @param changed When the oldest change it covers was seen
+  * @return The new entry
   */
- static void add_active_worker(pid_t pid, int pipe_fd,
-                               const char* src, const char* dst,
-                               const char* op, const char* fn)
+ static worker_info_t* add_active_worker(pid_t pid,
+                                         const char* src, const char* dst,
+                                         const char* op, const char* fn,
+                                         const char* from, long long changed)
  {
      /* Allocate and initialize new worker info */
      worker_info_t* w = malloc(sizeof(*w));
      w->pid = pid;
-     w->pipe_fd = pipe_fd;
      strcpy(w->source_dir, src);
      strcpy(w->target_dir, dst);
      strcpy(w->operation, op);
      strcpy(w->filename, fn);
+     snprintf(w->from, sizeof(w->from), "%s", from);
+     w->feeds = NULL;
+     w->feeds_exact = 0;
+     w->task_tid = 0;
+     w->changed = changed;
+     
+     sync_info_t* info = hashSearch(w->source_dir);
+     if (info) info->in_flight++;
+     mark_status(info);
      
-     /* Add to front of list and update count */
+     /* Add to front of list and update count; inline tasks take no worker slot */
      w->next = active_workers;
      active_workers = w;
-     active_worker_count++;
+     if (pid >= INLINE_ID_BASE) inline_task_count++;
+     else active_worker_count++;
+     return w;
  }
  
  /**
@@ -177,8 +404,14 @@
              if (prev) prev->next = cur->next;
              else active_workers = cur->next;
              
-             /* Update count and return */
-             active_worker_count--;
+             /* Update counts and return */
+             sync_info_t* info = hashSearch(cur->source_dir);
+             if (info) info->in_flight--;
+             change_synced(info, cur->changed);
+             mark_status(info);
+             task_table_finish(task_table, cur->source_dir, cur->filename);
+             if (pid >= INLINE_ID_BASE) inline_task_count--;
+             else active_worker_count--;
              return cur;
          }
          prev = cur; 
@@ -189,78 +422,868 @@
  }
  
  /**
-  * @brief Check if a worker is already active for a source directory
+  * @brief Check whether an event was caused by the manager's own writes
   *
-  * Searches the active workers list for any worker processing
-  * the specified source directory.
+  * An event is self-generated if a running task is writing that file into
+  * the source (its in-flight writes), or if the file is still exactly as a
+  * finished task left it: same (dev, inode, mtime), or deleted by us.
   *
-  * @param src Source directory path to check
-  * @return 1 if a worker is active for this source, 0 otherwise
+  * @param info Source the event was routed to
+  * @param dir Canonical watched directory
+  * @param name File name from the event
+  * @param deleted Non-zero for a delete event
+  * @return 1 if the event should be dropped, 0 otherwise
   */
- static int is_worker_active_for_source(const char* src) {
-     /* Iterate through active workers */
+ static int is_own_event(sync_info_t* info, const char* dir, const char* name, int deleted) {
+     /* In flight: a task targeting this source is writing the file right now */
      for (worker_info_t* w = active_workers; w; w = w->next)
-         if (!strcmp(w->source_dir, src))
-             return 1;  /* Found a matching worker */
-     
-     return 0;  /* No matching worker found */
+         if (w->feeds == info && (!strcmp(w->filename, "ALL") || !strcmp(w->filename, name) ||
+                                  !strcmp(w->from, name)))
+             return 1;
+ 
+     char path[PATH_MAX * 2];
+     snprintf(path, sizeof(path), "%s/%s", dir, name);
+ 
+     /* lstat: tasks recreate symlinks and report the link itself */
+     struct stat st;
+     if (deleted) return lstat(path, &st) < 0 && write_tracker_take_unlink(path);
+     return lstat(path, &st) == 0 && write_tracker_is_own(&st);
  }
  
  /**
-  * @brief Add a task to the queue
-  *
-  * Creates a new worker_task structure and adds it to the
-  * end of the task queue.
+  * @brief Allocate a task
   *
   * @param src Source directory path
   * @param dst Target directory path
   * @param fn Filename to process
+  * @param from Old name of a RENAMED task ("" otherwise)
   * @param op Operation type
+  * @param changed When the change was seen
+  * @return New task
   */
- static void queue_task(const char* src, const char* dst,
-                        const char* fn, const char* op)
+ static worker_task_t* new_task(const char* src, const char* dst,
+                                const char* fn, const char* from, const char* op,
+                                long long changed)
  {
-     /* Create and initialize task */
      worker_task_t* t = malloc(sizeof(*t));
      strcpy(t->source_dir, src);
      strcpy(t->target_dir, dst);
      strcpy(t->filename, fn);
+     snprintf(t->from, sizeof(t->from), "%s", from);
      strcpy(t->operation, op);
-     t->next = NULL;
+     t->reserved = 0;
+     t->changed = changed;
+     return t;
+ }
+ 
+ /**
+  * @brief Deadline by which a change of a source must be synced
+  *
+  * @param info Source (may be NULL)
+  * @param changed When the change was seen
+  * @return Deadline (ms, CLOCK_MONOTONIC)
+  */
+ static long long task_deadline(const sync_info_t* info, long long changed) {
+     return changed + 1000LL * (info && info->max_lag ? info->max_lag : BEST_EFFORT_LAG);
+ }
+ 
+ /**
+  * @brief Add a task to the queue
+  *
+  * Tasks are taken earliest deadline first. A source's deadlines never go
+  * down, even when its max_lag is lowered, so its own tasks stay in
+  * arrival order; deferred tasks are already reserved and need no such care.
+  *
+  * @param t Task to queue
+  */
+ static void push_task(worker_task_t* t) {
+     sync_info_t* info = hashSearch(t->source_dir);
+     long long deadline = task_deadline(info, t->changed);
      
-     /* Add to queue (either empty or at end) */
-     if (!task_queue) {
-         task_queue = t;  /* First task in queue */
-     } else {
-         /* Find end of queue */
-         worker_task_t* c = task_queue;
-         while (c->next) c = c->next;
-         c->next = t;     /* Add to end */
+     if (info) {
+         info->queued++;
+         mark_status(info);
+         if (!t->reserved) {
+             if (deadline < info->last_deadline) deadline = info->last_deadline;
+             info->last_deadline = deadline;
+         }
+     }
+     deadline_queue_push(task_queue, deadline, t);
+ }
+ 
+ /**
+  * @brief Add a new task to the queue
+  *
+  * @param src Source directory path
+  * @param dst Target directory path
+  * @param fn Filename to process
+  * @param from Old name of a RENAMED task ("" otherwise)
+  * @param op Operation type
+  * @param changed When the change was seen
+  */
+ static void queue_task(const char* src, const char* dst,
+                        const char* fn, const char* from, const char* op,
+                        long long changed)
+ {
+     push_task(new_task(src, dst, fn, from, op, changed));
+ }
+ 
+ /**
+  * @brief Defer a task behind a running one of the same source
+  *
+  * Repeated changes to a waiting file collapse into one task carrying the
+  * latest operation and the time of the oldest change; a waiting rename
+  * stays one unless the file is then deleted, since its fallback copies
+  * the file anyway. A file added or modified while a FULL sync of its
+  * source waits is covered by that sync and not deferred separately.
+  *
+  * @param src Source directory path
+  * @param dst Target directory path
+  * @param fn Filename to process (or "ALL")
+  * @param from Old name of a RENAMED task ("" otherwise)
+  * @param op Operation type
+  * @param changed When the change was seen
+  * @param log_file File pointer for logging
+  */
+ static void defer_task(const char* src, const char* dst, const char* fn,
+                        const char* from, const char* op, long long changed,
+                        FILE* log_file)
+ {
+     sync_info_t* info = hashSearch((char*)src);
+     worker_task_t* t = task_table_deferred(task_table, src, fn);
+     if (t) {
+         if (strcmp(t->operation, "RENAMED") || !strcmp(op, "DELETED")) {
+             snprintf(t->operation, sizeof(t->operation), "%s", op);
+             snprintf(t->from, sizeof(t->from), "%s", from);
+         }
+         merge_change(info, &t->changed, changed);
+         return;
+     }
+     worker_task_t* full = task_table_deferred(task_table, src, "ALL");
+     if (strcmp(fn, "ALL") && strcmp(op, "DELETED") && full) {
+         merge_change(info, &full->changed, changed);
+         return;
      }
+     
+     task_table_defer(task_table, src, fn, new_task(src, dst, fn, from, op, changed));
+     if (info) info->queued++;
+     mark_status(info);
+     fss_log(log_file, "%s Deferred task: %s -> %s (%s %s)\n",
+             get_timestamp(), src, dst, op, fn);
  }
  
  /**
-  * @brief Remove and return the first task from the queue
+  * @brief Queue the deferred tasks of a source that may run now
+  *
+  * @param src Source directory whose task just finished
+  */
+ static void release_deferred(const char* src) {
+     worker_task_t* t;
+     
+     while ((t = task_table_take_ready(task_table, src))) {
+         sync_info_t* info = hashSearch(t->source_dir);
+         if (info) info->queued--;
+         mark_status(info);
+         t->reserved = 1;
+         push_task(t);
+     }
+ }
+ 
+ /**
+  * @brief Remove and return the task with the earliest deadline
   *
   * @return Pointer to the task removed, or NULL if queue is empty
   */
  static worker_task_t* dequeue_task() {
-     if (!task_queue) return NULL;
+     worker_task_t* t = deadline_queue_pop(task_queue);
+     if (!t) return NULL;
      
-     /* Remove first task */
-     worker_task_t* t = task_queue;
-     task_queue = t->next;
+     sync_info_t* info = hashSearch(t->source_dir);
+     if (info) info->queued--;
+     mark_status(info);
      
      return t;
  }
  
+ /**
+  * @brief Oldest unsynced change of a source
+  *
+  * The changes its queued, deferred and running tasks cover are kept in a
+  * min-heap per source (see change_seen() and change_synced()).
+  *
+  * @param info Source (may be NULL)
+  * @param oldest Set to when that change was seen
+  * @return 1 if the source has unsynced changes, 0 otherwise
+  */
+ static int oldest_change(const sync_info_t* info, long long* oldest) {
+     return info && info->changes && deadline_queue_peek(info->changes, oldest);
+ }
+ 
  /**
   * -----------------------------------------------------------------------------
   * Forward declarations for internal functions
   * -----------------------------------------------------------------------------
   */
- static void process_worker_output(worker_info_t* w);
  static void start_queued_task();
+ static void submit_task(const char* src, const char* dst, const char* fn,
+                         const char* from, const char* op, FILE* log_file);
+ static void dispatch_task(const char* src, const char* dst, const char* fn,
+                           const char* from, const char* op, long long changed,
+                           int reserved, FILE* log_file);
+ 
+ /**
+  * -----------------------------------------------------------------------------
+  * Sync policies
+  * -----------------------------------------------------------------------------
+  */
+ 
+ /**
+  * @brief Hold a change back while the source's policy says so
+  *
+  * Deletions (and the old name of a rename) are kept to be replayed at
+  * the next flush; every other change is covered by the full sync that
+  * ends the flush, however many there were.
+  *
+  * @param info Source the change belongs to
+  * @param name File name (or "ALL")
+  * @param from Old name for a RENAMED change ("" otherwise)
+  * @param op Operation type
+  * @return 1 if the change was held, 0 if it should be synced now
+  */
+ static int hold_change(sync_info_t* info, const char* name, const char* from, const char* op) {
+     if (!info->holding) return 0;
+     
+     const char* gone = !strcmp(op, "DELETED") ? name : !strcmp(op, "RENAMED") ? from : NULL;
+     if (gone) {
+         struct held_delete* d = malloc(sizeof(*d));
+         snprintf(d->name, sizeof(d->name), "%s", gone);
+         d->next = info->held_deletes;
+         info->held_deletes = d;
+     }
+     if (strcmp(op, "DELETED")) info->held_full = 1;
+     info->held_changes++;
+     mark_status(info);
+     return 1;
+ }
+ 
+ /**
+  * @brief Forget a source's held changes
+  *
+  * @param info Source
+  */
+ static void drop_held(sync_info_t* info) {
+     while (info->held_deletes) {
+         struct held_delete* d = info->held_deletes;
+         info->held_deletes = d->next;
+         free(d);
+     }
+     info->held_full = 0;
+     info->held_changes = 0;
+     mark_status(info);
+ }
+ 
+ /**
+  * @brief Sync a source's held changes
+  *
+  * Held deletions are replayed oldest first, then one full sync copies
+  * whatever was added, modified or renamed in the meantime.
+  *
+  * @param info Source
+  * @param log_file File pointer for logging
+  */
+ static void flush_held(sync_info_t* info, FILE* log_file) {
+     if (!info->held_changes) return;
+     fss_log(log_file, "%s Policy flush: %s (%lu changes held)\n",
+             get_timestamp(), info->source_dir, info->held_changes);
+     
+     struct held_delete* oldest = NULL;
+     while (info->held_deletes) {
+         struct held_delete* d = info->held_deletes;
+         info->held_deletes = d->next;
+         d->next = oldest;
+         oldest = d;
+     }
+     while (oldest) {
+         struct held_delete* d = oldest;
+         oldest = d->next;
+         submit_task(info->source_dir, info->target_dir, d->name, "", "DELETED", log_file);
+         free(d);
+     }
+     if (info->held_full)
+         start_worker(info->source_dir, info->target_dir, "ALL", "FULL", log_file);
+     drop_held(info);
+ }
+ 
+ /**
+  * @brief Set whether a source holds changes and arm its next policy timer
+  *
+  * @param info Source (its policy already parsed)
+  */
+ static void arm_policy(sync_info_t* info) {
+     time_t now = time(NULL);
+     unsigned long long tick = now_ms() / 1000;
+     
+     info->policy_timer.data = info;
+     switch (info->policy.kind) {
+     case SYNC_POLICY_INTERVAL:
+         info->holding = 1;
+         timer_wheel_add(policy_wheel, &info->policy_timer, tick + info->policy.interval);
+         break;
+     case SYNC_POLICY_WINDOW:
+         info->holding = !sync_policy_in_window(&info->policy, now);
+         timer_wheel_add(policy_wheel, &info->policy_timer,
+                         tick + sync_policy_next_boundary(&info->policy, now));
+         break;
+     default:
+         info->holding = 0;
+         timer_wheel_cancel(policy_wheel, &info->policy_timer);
+     }
+ }
+ 
+ /**
+  * @brief Policy timer callback: an interval elapsed or a window boundary passed
+  *
+  * @param info Source whose policy timer expired
+  * @param log_file File pointer for logging
+  */
+ static void policy_timer_fired(sync_info_t* info, FILE* log_file) {
+     if (!info->active) return;
+     
+     int was_holding = info->holding;
+     arm_policy(info);
+     if (info->policy.kind == SYNC_POLICY_WINDOW && was_holding != info->holding)
+         fss_log(log_file, "%s Sync window %s for %s\n", get_timestamp(),
+                 info->holding ? "closed" : "opened", info->source_dir);
+     if (info->policy.kind == SYNC_POLICY_INTERVAL || !info->holding)
+         flush_held(info, log_file);
+ }
+ 
+ /**
+  * -----------------------------------------------------------------------------
+  * Polling monitor
+  * -----------------------------------------------------------------------------
+  */
+ 
+ /**
+  * @brief Scan callback: queue a change for the scheduler (poll pool thread)
+  *
+  * @param name Entry name
+  * @param mask inotify-style mask
+  * @param ctx Poller
+  */
+ static void post_poll_change(const char* name, uint32_t mask, void* ctx) {
+     struct poll_state* ps = ctx;
+     pipeline_post_event(ps->wd, mask, name);
+ }
+ 
+ /**
+  * @brief Rescan a polled source (poll pool thread)
+  *
+  * Changes are queued as events on the poller's watch descriptor, followed
+  * by a POLL_SCAN_DONE event that hands the poller back to the scheduler.
+  *
+  * @param arg Poller
+  */
+ static void run_poll_scan(void* arg) {
+     struct poll_state* ps = arg;
+     long long start = now_ms();
+     ps->result = poll_scan(ps->manifest, ps->dir, post_poll_change, ps);
+     ps->scan_ms = now_ms() - start;
+     pipeline_post_event(ps->wd, POLL_SCAN_DONE, "");
+     pipeline_wake_scheduler();
+ }
+ 
+ /**
+  * @brief Start a scan unless one is already running
+  *
+  * @param ps Poller
+  */
+ static void submit_poll_scan(struct poll_state* ps) {
+     if (ps->busy) return;
+     ps->busy = 1;
+     pool_submit(poll_pool, run_poll_scan, ps);
+ }
+ 
+ /**
+  * @brief Set up polling for a monitor=poll source
+  *
+  * Starts the baseline scan; the caller holds the initial full sync until
+  * it finishes, so nothing that changes after the baseline can be missed.
+  *
+  * @param info Source
+  * @return Synthetic watch descriptor for its events
+  */
+ static int start_poller(sync_info_t* info) {
+     if (!poll_pool) poll_pool = pool_create(POLL_THREADS);
+     
+     struct poll_state* ps = calloc(1, sizeof(*ps));
+     ps->info = info;
+     snprintf(ps->dir, sizeof(ps->dir), "%s", info->source_dir);
+     ps->wd = --next_poll_wd;
+     ps->manifest = poll_manifest_create();
+     ps->timer.data = info;
+     ps->interval = info->poll.min_interval;
+     ps->full_pending = 1;
+     ps->next = pollers;
+     pollers = ps;
+     info->poller = ps;
+     submit_poll_scan(ps);
+     return ps->wd;
+ }
+ 
+ /**
+  * @brief Free a poller and unlink it from the poller list
+  *
+  * @param ps Idle poller
+  */
+ static void free_poller(struct poll_state* ps) {
+     for (struct poll_state** pp = &pollers; *pp; pp = &(*pp)->next) {
+         if (*pp == ps) {
+             *pp = ps->next;
+             break;
+         }
+     }
+     poll_manifest_destroy(ps->manifest);
+     free(ps);
+ }
+ 
+ /**
+  * @brief Stop polling a cancelled source
+  *
+  * @param info Source
+  */
+ static void stop_poller(sync_info_t* info) {
+     struct poll_state* ps = info->poller;
+     if (!ps) return;
+     info->poller = NULL;
+     timer_wheel_cancel(policy_wheel, &ps->timer);
+     if (ps->busy) ps->info = NULL;  /* Freed when the scan reports back */
+     else free_poller(ps);
+ }
+ 
+ /**
+  * @brief A scan finished: adapt the interval and schedule the next one
+  *
+  * @param wd Watch descriptor of the poller
+  * @param log_file File pointer for logging
+  */
+ static void poll_scan_done(int wd, FILE* log_file) {
+     struct poll_state* ps = pollers;
+     while (ps && ps->wd != wd) ps = ps->next;
+     if (!ps) return;
+     
+     ps->busy = 0;
+     sync_info_t* info = ps->info;
+     if (!info) {
+         free_poller(ps);
+         return;
+     }
+     
+     ps->scans++;
+     ps->entries = poll_manifest_size(ps->manifest);
+     if (ps->result < 0) {
+         fss_log(log_file, "%s Poll scan failed: %s\n", get_timestamp(), info->source_dir);
+     } else {
+         ps->changes += ps->result;
+         ps->interval = poll_next_interval(&info->poll, ps->interval, ps->result, ps->scan_ms);
+     }
+     if (ps->full_pending) {
+         ps->full_pending = 0;
+         if (!hold_change(info, "ALL", "", "FULL"))
+             start_worker(info->source_dir, info->target_dir, "ALL", "FULL", log_file);
+     }
+     timer_wheel_add(policy_wheel, &ps->timer, now_ms() / 1000 + ps->interval);
+ }
+ 
+ /**
+  * @brief Timer callback: hand an expired timer to its policy or poller
+  *
+  * @param t Expired timer (data is its sync_info_t)
+  * @param ctx Log file
+  */
+ static void timer_fired(tw_timer_t* t, void* ctx) {
+     sync_info_t* info = t->data;
+     if (info->poller && t == &info->poller->timer) submit_poll_scan(info->poller);
+     else policy_timer_fired(info, ctx);
+ }
+ 
+ /**
+  * @brief Run the policy and poll timers that are due
+  *
+  * Called once per main loop iteration; the wheel only does work for the
+  * seconds that passed and the timers that expire in them.
+  *
+  * @param log_file File pointer for logging
+  */
+ void handle_timers(FILE* log_file) {
+     timer_wheel_advance(policy_wheel, now_ms() / 1000, timer_fired, log_file);
+ }
+ 
+ /**
+  * -----------------------------------------------------------------------------
+  * Replica digests
+  * -----------------------------------------------------------------------------
+  */
+ 
+ /**
+  * @struct digest_state
+  * @brief Hash trees of a digest=1 source and of its target
+  *
+  * The trees are built and refreshed on the digest pool and compared by
+  * the scheduler, each under the lock. The scheduler only ever tries the
+  * lock, and the pool holds it for as little as it can: whole trees are
+  * scanned into fresh trees and swapped in, and only single-entry
+  * refreshes update the trees in place. The state is freed by whoever
+  * drops the last reference: the source when it is cancelled, or the
+  * last job still queued for it.
+  */
+ struct digest_state {
+     pthread_mutex_t lock;       /**< Serializes access to the trees */
+     merkle_tree_t* src;         /**< Source tree */
+     merkle_tree_t* dst;         /**< Target tree */
+     char source_dir[PATH_MAX];  /**< Directory src mirrors */
+     char target_dir[PATH_MAX];  /**< Directory dst mirrors */
+     unsigned flags;             /**< merkle_create() flags of both trees */
+     int refs;                   /**< The source (until cancelled) and queued jobs (atomic) */
+     int cancelled;              /**< The source was cancelled: jobs do nothing (atomic) */
+     int ready;                  /**< The initial build is done */
+ };
+ 
+ /**
+  * @struct digest_job
+  * @brief Build or refresh of a source's trees
+  */
+ typedef struct digest_job {
+     struct digest_state* ds;    /**< Trees to update */
+     char path[PATH_MAX];        /**< Entry to rescan ("" for everything) */
+     char from[NAME_MAX + 1];    /**< Old name of a rename, rescanned too ("" if none) */
+ } digest_job_t;
+ 
+ static thread_pool_t* digest_pool = NULL;  /**< Builds and refreshes trees, in submission order */
+ static int digest_stopping = 0;            /**< Shutting down: queued jobs are skipped */
+ 
+ #define DIGEST_WALK_THREADS 2     /**< Walker threads of a tree build */
+ #define VERIFY_SHOW 10            /**< Differences listed by 'verify' */
+ #define RECONCILE_MAX_TASKS 256   /**< More differences than this make 'reconcile' sync in full */
+ 
+ /**
+  * @brief Drop a reference to a source's trees, freeing them with the last one
+  *
+  * @param ds Trees (not locked by the caller)
+  */
+ static void digest_release(struct digest_state* ds) {
+     if (__atomic_sub_fetch(&ds->refs, 1, __ATOMIC_ACQ_REL) > 0) return;
+     merkle_destroy(ds->src);
+     merkle_destroy(ds->dst);
+     pthread_mutex_destroy(&ds->lock);
+     free(ds);
+ }
+ 
+ /**
+  * @brief Build or refresh a source's trees (digest pool thread)
+  *
+  * @param arg Job
+  */
+ static void run_digest_job(void* arg) {
+     digest_job_t* job = arg;
+     struct digest_state* ds = job->ds;
+ 
+     if (__atomic_load_n(&ds->cancelled, __ATOMIC_RELAXED) ||
+         __atomic_load_n(&digest_stopping, __ATOMIC_RELAXED)) {
+         /* Nothing to do */
+     } else if (!job->path[0]) {
+         /* Whole trees: scan unlocked into new ones, then swap them in */
+         merkle_tree_t* src = merkle_create(ds->flags);
+         merkle_tree_t* dst = merkle_create(ds->flags);
+         merkle_scan(src, ds->source_dir, "", DIGEST_WALK_THREADS);
+         merkle_scan(dst, ds->target_dir, "", DIGEST_WALK_THREADS);
+ 
+         pthread_mutex_lock(&ds->lock);
+         merkle_tree_t* old_src = ds->src;
+         merkle_tree_t* old_dst = ds->dst;
+         ds->src = src;
+         ds->dst = dst;
+         ds->ready = 1;
+         pthread_mutex_unlock(&ds->lock);
+         merkle_destroy(old_src);
+         merkle_destroy(old_dst);
+     } else {
+         /* The entries a task touched, in place */
+         pthread_mutex_lock(&ds->lock);
+         merkle_scan(ds->src, ds->source_dir, job->path, 1);
+         merkle_scan(ds->dst, ds->target_dir, job->path, 1);
+         if (job->from[0]) {
+             merkle_scan(ds->src, ds->source_dir, job->from, 1);
+             merkle_scan(ds->dst, ds->target_dir, job->from, 1);
+         }
+         pthread_mutex_unlock(&ds->lock);
+     }
+     digest_release(ds);
+     free(job);
+ }
+ 
+ /**
+  * @brief Queue a build or refresh of a source's trees
+  *
+  * @param ds Trees
+  * @param path Entry to rescan ("ALL" or "" for everything)
+  * @param from Old name of a rename (NULL or "" if none)
+  */
+ static void submit_digest_job(struct digest_state* ds, const char* path, const char* from) {
+     digest_job_t* job = calloc(1, sizeof(*job));
+     job->ds = ds;
+     snprintf(job->path, sizeof(job->path), "%s", strcmp(path, "ALL") ? path : "");
+     snprintf(job->from, sizeof(job->from), "%s", from ? from : "");
+ 
+     __atomic_add_fetch(&ds->refs, 1, __ATOMIC_RELAXED);
+     pool_submit(digest_pool, run_digest_job, job);
+ }
+ 
+ /**
+  * @brief Start keeping digests of a digest=1 source and its target
+  *
+  * File digests leave out what the source's tasks do not carry over: sizes
+  * of compressed targets, and mtimes of copies without preserve_times.
+  *
+  * @param info Source
+  */
+ static void start_digests(sync_info_t* info) {
+     if (!digest_pool) digest_pool = pool_create(1);
+ 
+     sync_options_t opts;
+     sync_options_init(&opts);
+     sync_options_parse(info->sync_opts, &opts);
+     unsigned flags = (opts.compress ? MERKLE_NO_SIZE : 0) | (opts.preserve_times ? 0 : MERKLE_NO_MTIME);
+ 
+     struct digest_state* ds = calloc(1, sizeof(*ds));
+     pthread_mutex_init(&ds->lock, NULL);
+     ds->flags = flags;
+     ds->src = merkle_create(flags);
+     ds->dst = merkle_create(flags);
+     snprintf(ds->source_dir, sizeof(ds->source_dir), "%s", info->source_dir);
+     snprintf(ds->target_dir, sizeof(ds->target_dir), "%s", info->target_dir);
+     ds->refs = 1;
+     info->digests = ds;
+     submit_digest_job(ds, "", NULL);
+ }
+ 
+ /**
+  * @brief Stop keeping digests of a cancelled source
+  *
+  * @param info Source
+  */
+ static void stop_digests(sync_info_t* info) {
+     struct digest_state* ds = info->digests;
+     if (!ds) return;
+     info->digests = NULL;
+     __atomic_store_n(&ds->cancelled, 1, __ATOMIC_RELAXED);
+     digest_release(ds);
+ }
+ 
+ /**
+  * @brief Lock a source's trees for comparison
+  *
+  * A refresh in progress is not waited for, so a command never stalls
+  * the scheduler.
+  *
+  * @param info Source
+  * @param fd_out File descriptor for console output
+  * @return Locked trees, or NULL if they are not available (reply written)
+  */
+ static struct digest_state* lock_digests(sync_info_t* info, int fd_out) {
+     struct digest_state* ds = info->digests;
+     char* ts = get_timestamp();
+ 
+     if (!ds) {
+         dprintf(fd_out, "%s No digests kept for %s (add it with digest=1)\n", ts, info->source_dir);
+         return NULL;
+     }
+     if (pthread_mutex_trylock(&ds->lock) != 0) {
+         dprintf(fd_out, "%s Digests of %s are being updated, try again\n", ts, info->source_dir);
+         return NULL;
+     }
+     if (!ds->ready) {
+         pthread_mutex_unlock(&ds->lock);
+         dprintf(fd_out, "%s Digests of %s are still being built\n", ts, info->source_dir);
+         return NULL;
+     }
+     return ds;
+ }
+ 
+ /**
+  * @struct verify_ctx
+  * @brief Differences collected by 'verify'
+  */
+ typedef struct verify_ctx {
+     long count;                         /**< Differences found */
+     char shown[VERIFY_SHOW][PATH_MAX];  /**< The first ones, as reply lines */
+ } verify_ctx_t;
+ 
+ /**
+  * @brief merkle_diff() callback of 'verify'
+  *
+  * @param path Entry path
+  * @param kind How it differs
+  * @param is_dir The entry is a directory
+  * @param ctx verify_ctx_t
+  * @return 0 (keep going)
+  */
+ static int collect_difference(const char* path, merkle_diff_kind_t kind, int is_dir, void* ctx) {
+     verify_ctx_t* v = ctx;
+     if (v->count < VERIFY_SHOW)
+         snprintf(v->shown[v->count], PATH_MAX, "%s %s%s",
+                  kind == MERKLE_ONLY_A ? "missing" : kind == MERKLE_ONLY_B ? "extra" : "differs",
+                  path, is_dir ? "/" : "");
+     v->count++;
+     return 0;
+ }
+ 
+ /**
+  * @struct reconcile_ctx
+  * @brief Tasks planned by 'reconcile'
+  */
+ typedef struct reconcile_ctx {
+     char* paths[RECONCILE_MAX_TASKS];  /**< Files to sync one by one */
+     char deleted[RECONCILE_MAX_TASKS]; /**< The file is only in the target */
+     long tasks;                 /**< Entries in paths */
+     int full;                   /**< A full sync is needed instead */
+ } reconcile_ctx_t;
+ 
+ /**
+  * @brief merkle_diff() callback of 'reconcile': plan a task for a difference
+  *
+  * Files are copied or deleted one by one; a directory that is missing,
+  * extra or replaced, or too many differences, need a full sync. Tasks are
+  * only submitted once the trees are unlocked.
+  *
+  * @param path Entry path
+  * @param kind How it differs
+  * @param is_dir The entry is a directory
+  * @param ctx reconcile_ctx_t
+  * @return 1 once a full sync is needed (stops the comparison), 0 otherwise
+  */
+ static int queue_difference(const char* path, merkle_diff_kind_t kind, int is_dir, void* ctx) {
+     reconcile_ctx_t* r = ctx;
+     if (is_dir || r->tasks >= RECONCILE_MAX_TASKS) {
+         r->full = 1;
+         return 1;
+     }
+     r->paths[r->tasks] = strdup(path);
+     r->deleted[r->tasks] = kind == MERKLE_ONLY_B;
+     r->tasks++;
+     return 0;
+ }
+ 
+ /**
+  * @brief Refresh a source's trees after one of its tasks finished
+  *
+  * @param w Finished task
+  */
+ static void refresh_digests(const worker_info_t* w) {
+     sync_info_t* info = hashSearch((char*)w->source_dir);
+     if (!info || !info->digests) return;
+     submit_digest_job(info->digests, w->filename,
+                       !strcmp(w->operation, "RENAMED") ? w->from : NULL);
+ }
+ 
+ /**
+  * -----------------------------------------------------------------------------
+  * Shared status table
+  * -----------------------------------------------------------------------------
+  */
+ 
+ #define STATUS_PUBLISH_MS 100  /**< Least time between two publishing rounds */
+ 
+ static status_shm_t* status_table = NULL;  /**< Table readers map (NULL if unavailable) */
+ static long long status_published = 0;     /**< When publish_status() last ran */
+ 
+ /**
+  * @brief Create the shared status table
+  *
+  * Without it the manager runs as before; status is then only available
+  * through the status command.
+  *
+  * @param path Table file
+  * @param log_file File pointer for logging
+  */
+ void open_status_table(const char* path, FILE* log_file) {
+     status_table = status_shm_create(path, STATUS_SHM_SLOTS);
+     if (!status_table)
+         fss_log(log_file, "%s Cannot create status table %s: %s\n",
+                 get_timestamp(), path, strerror(errno));
+ }
+ 
+ /**
+  * @brief Copy a source's state into its status record
+  *
+  * @param info Source
+  * @param now Current time (now_ms())
+  * @param rec Record to fill
+  */
+ static void fill_status_record(const sync_info_t* info, long long now, status_record_t* rec) {
+     long long oldest;
+     
+     memset(rec, 0, sizeof(*rec));
+     snprintf(rec->source, sizeof(rec->source), "%s", info->source_dir);
+     snprintf(rec->target, sizeof(rec->target), "%s", info->target_dir);
+     rec->active = info->active;
+     rec->errors = info->error_count;
+     rec->queued = info->queued;
+     rec->in_flight = info->in_flight;
+     rec->max_lag = info->max_lag;
+     rec->last_sync = info->last_sync_time;
+     rec->oldest_change_ms = oldest_change(info, &oldest) ? oldest : -1;
+     rec->bytes_synced = info->bytes_synced;
+     rec->held_changes = info->held_changes;
+     rec->deadline_misses = info->deadline_misses;
+     rec->suppressed_events = info->suppressed_events;
+     rec->updated_ms = now;
+ }
+ 
+ /**
+  * @brief Publish the sources that changed into the shared status table
+  *
+  * Called once per main loop iteration, but does work at most every
+  * STATUS_PUBLISH_MS: a burst of events then costs one record write per
+  * source instead of one per counter change.
+  *
+  * @param log_file File pointer for logging
+  * @return 1 if changes are left for a later call, 0 otherwise
+  */
+ int publish_status(FILE* log_file) {
+     long long now = now_ms();
+     
+     if (!status_table) return 0;
+     if (now - status_published < STATUS_PUBLISH_MS) return status_dirty_list != NULL;
+     status_published = now;
+     status_shm_heartbeat(status_table, now);
+     
+     sync_info_t* info = status_dirty_list;
+     status_dirty_list = NULL;
+     for (sync_info_t* next; info; info = next) {
+         next = info->status_next;
+         info->status_dirty = 0;
+         if (info->status_slot < 0 && (info->status_slot = status_shm_claim(status_table)) < 0) {
+             if (!status_full_logged)
+                 fss_log(log_file, "%s Status table full, %s is not published\n",
+                         get_timestamp(), info->source_dir);
+             status_full_logged = 1;
+             continue;
+         }
+         status_record_t rec;
+         fill_status_record(info, now, &rec);
+         status_shm_publish(status_table, info->status_slot, &rec);
+     }
+     return 0;
+ }
+ 
+ /**
+  * @brief Remove the shared status table
+  */
+ void close_status_table() {
+     status_shm_close(status_table, 1);
+     status_table = NULL;
+ }
  
  /**
   * -----------------------------------------------------------------------------
@@ -281,6 +1304,294 @@
      global_log_file = log_file;
      global_fd_out = fd_out;
      worker_limit_global = worker_limit;
+     if (!task_table) task_table = task_table_create();
+     if (!task_queue) task_queue = deadline_queue_create();
+     if (!policy_wheel) policy_wheel = timer_wheel_create(now_ms() / 1000);
+ }
+ 
+ /**
+  * @brief Select how synchronization tasks are executed
+  *
+  * In thread mode a work-stealing pool with one thread per worker slot
+  * runs tasks in-process instead of forking ./worker. In process mode a
+  * small pool runs the cheap metadata-only tasks inline (see
+  * is_inline_task()), so only real data movement pays for a fork.
+  *
+  * @param mode Executor mode
+  */
+ void set_executor_mode(executor_mode_t mode) {
+     executor_mode = mode;
+     if (mode == EXECUTOR_THREAD && !executor_pool) {
+         executor_pool = pool_create(worker_limit_global);
+         if (!executor_pool) {
+             fprintf(stderr, "Cannot start executor threads, using worker processes\n");
+             executor_mode = EXECUTOR_PROCESS;
+         }
+     }
+     if (executor_mode == EXECUTOR_PROCESS && !inline_pool) {
+         inline_pool = pool_create(INLINE_THREADS);
+         if (!inline_pool)
+             fprintf(stderr, "Cannot start inline threads, every task forks a worker\n");
+     }
+ }
+ 
+ /**
+  * @brief Stop the executor
+  *
+  * Waits for in-process tasks still running on the pools or on threads
+  * of their own.
+  */
+ void shutdown_executor() {
+     pthread_mutex_lock(&own_thread_lock);
+     while (own_threads > 0) pthread_cond_wait(&own_thread_done, &own_thread_lock);
+     pthread_mutex_unlock(&own_thread_lock);
+     pool_destroy(executor_pool);
+     pool_destroy(inline_pool);
+     pool_destroy(poll_pool);
+     __atomic_store_n(&digest_stopping, 1, __ATOMIC_RELAXED);
+     pool_destroy(digest_pool);
+     executor_pool = NULL;
+     inline_pool = NULL;
+     poll_pool = NULL;
+     digest_pool = NULL;
+ }
+ 
+ /**
+  * @brief Check whether path is dir or lies inside it
+  *
+  * @param dir Canonical directory
+  * @param path Canonical path
+  * @return 1 if path is dir or below it, 0 otherwise
+  */
+ static int path_within(const char* dir, const char* path) {
+     size_t n = strlen(dir);
+     if (strncmp(dir, path, n) != 0) return 0;
+     return path[n] == '\0' || path[n] == '/' || (n > 0 && dir[n - 1] == '/');
+ }
+ 
+ /**
+  * @brief Pick the inotify instance a source is watched through
+  *
+  * @param csrc Canonical source directory
+  * @return Instance index (FNV-1a of the path modulo inotify_shards)
+  */
+ static int source_shard(const char* csrc) {
+     uint32_t h = 2166136261u;
+     for (; *csrc; csrc++) {
+         h ^= (unsigned char)*csrc;
+         h *= 16777619u;
+     }
+     return (int)(h % (uint32_t)inotify_shards);
+ }
+ 
+ /**
+  * @brief Slot of a watch descriptor in the per-instance tables
+  *
+  * @param shard inotify instance (-1 for a poller)
+  * @param wd Watch descriptor
+  * @param table Set to the table to use
+  * @return Index in that table, or -1 if the descriptor cannot be valid
+  */
+ static int wd_slot(int shard, int wd, int* table) {
+     *table = shard < 0 ? POLLER_SLOTS : shard;
+     int slot = shard < 0 ? -wd : wd;
+     return *table <= POLLER_SLOTS && slot >= 0 ? slot : -1;
+ }
+ 
+ /**
+  * @brief Record which watch_map entry a watch descriptor belongs to
+  *
+  * @param shard inotify instance (-1 for a poller)
+  * @param wd Watch descriptor
+  * @param index Index into watch_map, or -1 to forget the descriptor
+  */
+ static void set_watch_slot(int shard, int wd, int index) {
+     int t, slot = wd_slot(shard, wd, &t);
+     if (slot < 0) return;
+     if (slot >= wd_slots_len[t]) {
+         if (index < 0) return;
+         int len = wd_slots_len[t] ? wd_slots_len[t] : 64;
+         while (len <= slot) len *= 2;
+         wd_slots[t] = realloc(wd_slots[t], len * sizeof(*wd_slots[t]));
+         for (int i = wd_slots_len[t]; i < len; i++) wd_slots[t][i] = -1;
+         wd_slots_len[t] = len;
+     }
+     wd_slots[t][slot] = index;
+ }
+ 
+ /**
+  * @brief Find the watch an event came from
+  *
+  * @param shard inotify instance (-1 for a poller)
+  * @param wd Watch descriptor
+  * @return Its watch_map entry, or NULL if it is no longer watched
+  */
+ static watch_map_t* find_watch(int shard, int wd) {
+     int t, slot = wd_slot(shard, wd, &t);
+     if (slot < 0 || slot >= wd_slots_len[t] || wd_slots[t][slot] < 0) return NULL;
+     return &watch_map[wd_slots[t][slot]];
+ }
+ 
+ /**
+  * @brief Canonical form of a task's target directory
+  *
+  * A source's own target was resolved when it was added; the realpath()
+  * walk is only paid for anything else.
+  *
+  * @param info Source of the task (may be NULL)
+  * @param dst Target directory of the task
+  * @param buf Buffer for a target resolved now
+  * @param len Size of buf
+  * @return info->canonical_target or buf
+  */
+ static const char* canonical_target(const sync_info_t* info, const char* dst, char* buf, size_t len) {
+     if (info && !strcmp(dst, info->target_dir)) return info->canonical_target;
+     path_index_canonical(dst, buf, len);
+     return buf;
+ }
+ 
+ /**
+  * @brief Reject source/target pairs that would feed their own events back
+  *
+  * A pair is refused if its source and target overlap, if its target is
+  * already another pair's target, or if following targets into the sources
+  * that contain them leads back to the new source (a sync loop). Chained
+  * setups where a target is another pair's source are allowed.
+  *
+  * @param csrc Canonical source directory
+  * @param ctgt Canonical target directory
+  * @param err Buffer for the reason
+  * @param errlen Size of err
+  * @return 0 if the pair can be added, -1 otherwise
+  */
+ static int check_source_conflict(const char* csrc, const char* ctgt,
+                                  char* err, size_t errlen) {
+     sync_info_t* other;
+ 
+     if (path_within(csrc, ctgt) || path_within(ctgt, csrc)) {
+         snprintf(err, errlen, "source and target overlap");
+         return -1;
+     }
+     if ((other = path_index_find(source_index, csrc))) {
+         snprintf(err, errlen, "already monitored as %s", other->source_dir);
+         return -1;
+     }
+     if ((other = path_index_find(target_index, ctgt))) {
+         snprintf(err, errlen, "target already used by %s", other->source_dir);
+         return -1;
+     }
+ 
+     /* Follow target -> containing source -> its target ... */
+     char cur[PATH_MAX];
+     snprintf(cur, sizeof(cur), "%s", ctgt);
+     for (size_t hops = 0; hops <= path_index_size(source_index); hops++) {
+         other = path_index_longest_prefix(source_index, cur, NULL);
+         if (!other) break;
+         snprintf(cur, sizeof(cur), "%s", other->canonical_target);
+         if (path_within(csrc, cur)) {
+             snprintf(err, errlen, "target lies inside %s, whose target lies inside this source",
+                      other->source_dir);
+             return -1;
+         }
+     }
+     return 0;
+ }
+ 
+ /**
+  * @brief Start monitoring a source directory
+  *
+  * Shared by the config file and the 'add' command: validates the pair,
+  * registers it in the hashmap and path indexes, sets up the inotify watch
+  * and starts the initial full synchronization. A cancelled source is
+  * reactivated in place.
+  *
+  * @param src Source directory path
+  * @param dst Target directory path
+  * @param options Whitespace-separated key=value options (may be empty)
+  * @param fd_out File descriptor for console output
+  * @param log_file File pointer for logging
+  * @return 0 on success, -1 if the pair was not added
+  */
+ static int add_source(const char* src, const char* dst, const char* options,
+                       int fd_out, FILE* log_file) {
+     char csrc[PATH_MAX], ctgt[PATH_MAX], err[PATH_MAX + 128];
+     char* ts = get_timestamp();
+ 
+     /* Check if already monitored */
+     sync_info_t* info = hashSearch((char*)src);
+     if (info && info->active) {
+         dprintf(fd_out, "%s Already in queue: %s\n", ts, src);
+         fss_log(log_file, "%s Already in queue: %s\n", ts, src);
+         return -1;
+     }
+ 
+     path_index_canonical(src, csrc, sizeof(csrc));
+     path_index_canonical(dst, ctgt, sizeof(ctgt));
+     if (check_source_conflict(csrc, ctgt, err, sizeof(err)) < 0) {
+         dprintf(fd_out, "%s Rejected %s -> %s: %s\n", ts, src, dst, err);
+         fss_log(log_file, "%s Rejected %s -> %s: %s\n", ts, src, dst, err);
+         return -1;
+     }
+ 
+     /* Create sync_info structure (or reuse the cancelled one) */
+     int fresh = info == NULL;
+     if (fresh) {
+         info = calloc(1, sizeof(*info));
+         snprintf(info->source_dir, sizeof(info->source_dir), "%s", src);
+     }
+     if (source_options_parse(options, info, err, sizeof(err)) < 0) {
+         dprintf(fd_out, "%s Rejected %s -> %s: %s\n", ts, src, dst, err);
+         fss_log(log_file, "%s Rejected %s -> %s: %s\n", ts, src, dst, err);
+         if (fresh) free(info);
+         return -1;
+     }
+     snprintf(info->target_dir, sizeof(info->target_dir), "%s", dst);
+     snprintf(info->canonical_target, sizeof(info->canonical_target), "%s", ctgt);
+     info->active = 1;
+     info->last_sync_time = 0;   /* Never synchronized yet */
+     info->error_count = 0;
+     if (fresh) info->status_slot = -1;
+     mark_status(info);
+ 
+     /* Add to hashmap and path indexes */
+     if (fresh) hashInsert(info);
+     path_index_insert(source_index, csrc, info);
+     path_index_insert(target_index, ctgt, info);
+ 
+     /* Log to file and console */
+     fss_log(log_file, "%s Added directory: %s -> %s\n", ts, src, dst);
+     fss_log(log_file, "%s Monitoring started for %s\n", ts, src);
+     dprintf(fd_out, "%s Added directory: %s -> %s\n", ts, src, dst);
+     dprintf(fd_out, "%s Monitoring started for %s\n", ts, src);
+ 
+     /* Ensure target directory exists */
+     mkdir(dst, 0777);
+     if (info->digest) start_digests(info);
+ 
+     /* Set up an inotify watch on the source's instance, or poll where
+      * inotify cannot see remote changes */
+     int shard = info->poll.monitor == MONITOR_POLL ? -1 : source_shard(csrc);
+     int wd = shard < 0 ? start_poller(info)
+            : inotify_add_watch(inotify_fds[shard], src, IN_CREATE|IN_MODIFY|IN_DELETE|
+                                                         IN_MOVED_FROM|IN_MOVED_TO);
+ 
+     /* Add to watch map */
+     watch_map = realloc(watch_map, (watch_map_len+1)*sizeof(*watch_map));
+     watch_map[watch_map_len].shard = shard;
+     watch_map[watch_map_len].wd = wd;
+     watch_map[watch_map_len].info = info;
+     snprintf(watch_map[watch_map_len].source, PATH_MAX, "%s", csrc);
+     snprintf(watch_map[watch_map_len].target, PATH_MAX, "%s", ctgt);
+     set_watch_slot(shard, wd, watch_map_len);
+     watch_map_len++;
+ 
+     /* Start initial full synchronization, or hold it until the policy allows
+      * (a polled source starts it once its baseline scan is done) */
+     drop_held(info);
+     arm_policy(info);
+     if (!info->poller && !hold_change(info, "ALL", "", "FULL"))
+         start_worker(src, dst, "ALL", "FULL", log_file);
+     return 0;
  }
  
  /**
@@ -289,143 +1600,217 @@
   * Parses the config file for source-target directory pairs,
   * initializes monitoring, and starts synchronization.
   *
-  * @param config_file Path to the configuration file
-  * @param unused Unused parameter (kept for API compatibility)
+  * @param config_file Path to the configuration file
+  * @param unused Unused parameter (kept for API compatibility)
+  * @param log_file File pointer for logging
+  */
+ void readConfig(const char* config_file, int unused, FILE* log_file) {
+     (void)unused;  /* Suppress unused parameter warning */
+     
+     /* Open config file */
+     FILE* fp = fopen(config_file, "r");
+     if (!fp) { 
+         perror("fopen config"); 
+         exit(EXIT_FAILURE); 
+     }
+ 
+     /* Process each line in the config file */
+     char src[PATH_MAX], dst[PATH_MAX], line[PATH_MAX*2];
+     while (fgets(line, sizeof(line), fp)) {
+         /* Skip empty lines and comments */
+         if (line[0]=='\n' || line[0]=='#') continue;
+         
+         /* Parse source and target directories, then any key=value options */
+         int consumed = 0;
+         if (sscanf(line,"%s %s%n",src,dst,&consumed)==2) {
+             add_source(src, dst, line + consumed, global_fd_out, log_file);
+         }
+     }
+     
+     fclose(fp);
+ }
+ 
+ /**
+  * @brief Initialize inotify for directory monitoring
+  *
+  * Sets up the inotify instances with non-blocking mode and
+  * initializes the watch mapping data structure. Each source is watched
+  * through the instance its canonical path hashes to, so one busy source
+  * can only overflow the queue it shares with a fraction of the others.
+  *
+  * @param shards Number of inotify instances (1 to PIPELINE_MAX_SHARDS)
+  */
+ void setup_inotify(int shards) {
+     /* Create non-blocking inotify instances */
+     for (inotify_shards = 0; inotify_shards < shards; inotify_shards++) {
+         inotify_fds[inotify_shards] = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+         if (inotify_fds[inotify_shards] < 0) { 
+             perror("inotify_init"); 
+             exit(EXIT_FAILURE); 
+         }
+     }
+     
+     /* Initialize watch map and path indexes */
+     watch_map = NULL;
+     watch_map_len = 0;
+     source_index = path_index_create();
+     target_index = path_index_create();
+ }
+ 
+ /**
+  * @brief Log a file change and hand it to the scheduler
+  *
+  * Changes the source's sync policy holds back are only counted.
+  *
+  * @param info Source the change happened in
+  * @param name File name
+  * @param from Old name for a RENAMED change ("" otherwise)
+  * @param op Operation type
+  * @param log_file File pointer for logging
+  */
+ static void submit_change(sync_info_t* info, const char* name, const char* from,
+                           const char* op, FILE* log_file) {
+     if (hold_change(info, name, from, op)) return;
+     fss_log(log_file, "%s [%s] [%s] [0] [%s] [STARTED] [File: %s]\n",
+             get_timestamp(), info->source_dir, info->target_dir, op, name);
+     submit_task(info->source_dir, info->target_dir, name, from, op, log_file);
+ }
+ 
+ /**
+  * @brief Hand a file change to the scheduler unless we caused it ourselves
+  *
+  * @param info Source the change happened in
+  * @param dir Canonical watched directory
+  * @param name File name
+  * @param op Operation type
+  * @param log_file File pointer for logging
+  */
+ static void route_change(sync_info_t* info, const char* dir, const char* name,
+                          const char* op, FILE* log_file) {
+     /* Copies into a watched target come back as events: drop them */
+     if (is_own_event(info, dir, name, !strcmp(op, "DELETED"))) {
+         info->suppressed_events++;
+         mark_status(info);
+         return;
+     }
+     submit_change(info, name, "", op, log_file);
+ }
+ 
+ /**
+  * @brief Treat a held IN_MOVED_FROM whose IN_MOVED_TO never came as a delete
+  *
+  * The file left the monitored source (or its halves were drained apart,
+  * which costs a copy instead of a rename but stays correct).
+  *
   * @param log_file File pointer for logging
   */
- void readConfig(const char* config_file, int unused, FILE* log_file) {
-     (void)unused;  /* Suppress unused parameter warning */
-     
-     /* Open config file */
-     FILE* fp = fopen(config_file, "r");
-     if (!fp) { 
-         perror("fopen config"); 
-         exit(EXIT_FAILURE); 
-     }
- 
-     /* Process each line in the config file */
-     char src[PATH_MAX], dst[PATH_MAX], line[PATH_MAX*2];
-     while (fgets(line, sizeof(line), fp)) {
-         /* Skip empty lines and comments */
-         if (line[0]=='\n' || line[0]=='#') continue;
-         
-         /* Parse source and target directories */
-         if (sscanf(line,"%s %s",src,dst)==2) {
-             /* Create sync_info structure */
-             sync_info_t* info = malloc(sizeof(*info));
-             strcpy(info->source_dir, src);
-             strcpy(info->target_dir, dst);
-             info->active = 1;
-             info->last_sync_time = 0;   /* Never synchronized yet */
-             info->error_count = 0;
-             info->next = NULL;
-             
-             /* Add to hashmap */
-             hashInsert(info);
- 
-             /* Log to file and console */
-             char* ts = get_timestamp();
-             fprintf(log_file, "%s Added directory: %s -> %s\n", ts, src, dst);
-             fprintf(log_file, "%s Monitoring started for %s\n", ts, src);
-             fflush(log_file);
-             dprintf(global_fd_out, "%s Added directory: %s -> %s\n", ts, src, dst);
-             dprintf(global_fd_out, "%s Monitoring started for %s\n", ts, src);
- 
-             /* Ensure target directory exists */
-             mkdir(dst, 0777);
- 
-             /* Set up inotify watch */
-             int wd = inotify_add_watch(inotify_fd, src, 
-                                       IN_CREATE|IN_MODIFY|IN_DELETE);
-             
-             /* Add to watch map */
-             watch_map = realloc(watch_map, (watch_map_len+1)*sizeof(*watch_map));
-             watch_map[watch_map_len].wd = wd;
-             strncpy(watch_map[watch_map_len].source, src, PATH_MAX);
-             watch_map_len++;
- 
-             /* Start initial full synchronization */
-             start_worker(src, dst, "ALL", "FULL", log_file);
-         }
-     }
-     
-     fclose(fp);
+ static void flush_pending_move(FILE* log_file) {
+     if (!pending_move.info) return;
+     sync_info_t* info = pending_move.info;
+     pending_move.info = NULL;
+     if (info->active) route_change(info, pending_move.dir, pending_move.name, "DELETED", log_file);
  }
  
  /**
-  * @brief Initialize inotify for directory monitoring
+  * @brief Hand both halves of a rename within one source to the scheduler
+  *
+  * The rename is applied to the target by a RENAMED task for the new name,
+  * followed by a DELETED task for the old one, which keeps the old name
+  * ordered with its own earlier tasks. A half caused by our own writes is
+  * dropped and the other one handled like a plain add or delete.
   *
-  * Sets up the inotify instance with non-blocking mode and
-  * initializes the watch mapping data structure.
+  * @param info Source the rename happened in
+  * @param dir Canonical watched directory
+  * @param name New name
+  * @param log_file File pointer for logging
   */
- void setup_inotify() {
-     /* Create non-blocking inotify instance */
-     inotify_fd = inotify_init1(IN_NONBLOCK);
-     if (inotify_fd < 0) { 
-         perror("inotify_init"); 
-         exit(EXIT_FAILURE); 
+ static void route_rename(sync_info_t* info, const char* dir, const char* name, FILE* log_file) {
+     int from_own = is_own_event(info, pending_move.dir, pending_move.name, 1);
+     int to_own = is_own_event(info, dir, name, 0);
+     pending_move.info = NULL;
+ 
+     if (from_own || to_own) {
+         info->suppressed_events++;
+         mark_status(info);
      }
-     
-     /* Initialize watch map */
-     watch_map = NULL;
-     watch_map_len = 0;
+     if (!from_own && !to_own) submit_change(info, name, pending_move.name, "RENAMED", log_file);
+     else if (!to_own) submit_change(info, name, "", "ADDED", log_file);
+     if (!from_own) submit_change(info, pending_move.name, "", "DELETED", log_file);
  }
  
  /**
   * @brief Process inotify events
   *
-  * Reads and processes events from the inotify file descriptor,
-  * mapping watch descriptors to source directories and spawning
-  * workers to handle file changes.
+  * Drains the events queued by the ingestion threads, mapping watch
+  * descriptors to source directories and spawning workers to handle
+  * file changes. An IN_MOVED_FROM is held until the next event of its
+  * inotify instance, which normally is its IN_MOVED_TO, so renames within
+  * a source are applied as renames.
   *
   * @param log_file File pointer for logging
   */
  void handle_inotify_events(FILE* log_file) {
-     char buf[4096];
-     
-     /* Read events (non-blocking) */
-     ssize_t len = read(inotify_fd, buf, sizeof(buf));
-     if (len <= 0) return;  /* No events or error */
+     fss_event_t* ev;
+
+     while ((ev = pipeline_next_event())) {
+         /* A poll scan handed its poller back */
+         if (ev->mask & POLL_SCAN_DONE) {
+             poll_scan_done(ev->wd, log_file);
+             pipeline_release_event(ev);
+             continue;
+         }
  
-     /* Process each event in buffer */
-     for (char* p = buf; p < buf+len; ) {
-         struct inotify_event* ev = (void*)p;
-         
-         /* Find source directory for this watch descriptor */
-         const char* src = NULL;
-         for (int i = 0; i < watch_map_len; i++) {
-             if (watch_map[i].wd == ev->wd) {
-                 src = watch_map[i].source;
-                 break;
-             }
+         /* Only events of the same instance are ordered with a held rename */
+         int same_shard = pending_move.info && pending_move.shard == ev->shard;
+ 
+         /* The kernel dropped events: the targets may now be stale */
+         if (ev->mask & IN_Q_OVERFLOW) {
+             if (same_shard) flush_pending_move(log_file);
+             fss_log(log_file, "%s inotify queue overflow on instance %d, events were lost\n",
+                     get_timestamp(), ev->shard);
+             event_stream_publish(NULL, "[ERROR] [inotify queue overflow, events were lost]");
+             pipeline_release_event(ev);
+             continue;
          }
-         
-         if (!src) {
-             /* Unknown watch descriptor */
-             fprintf(stderr, "Unknown watch descriptor %d\n", ev->wd);
-         } else if (ev->len > 0) {
+
+         /* The watch descriptor leads straight to its source */
+         watch_map_t* wm = find_watch(ev->shard, ev->wd);
+         const char* dir = wm ? wm->source : NULL;
+         sync_info_t* info = wm ? wm->info : NULL;
+ 
+         /* Anything of its instance but the matching IN_MOVED_TO ends a held rename */
+         int renamed = same_shard && info && (ev->mask & IN_MOVED_TO) &&
+                       pending_move.info == info && pending_move.cookie == ev->cookie;
+         if (same_shard && !renamed) flush_pending_move(log_file);
+ 
+         if (!info) {
+             /* Unknown watch descriptor; IN_IGNORED follows a cancel, and
+              * a poller cancelled mid-scan still reports what it found */
+             if (!(ev->mask & IN_IGNORED) && ev->shard >= 0)
+                 fprintf(stderr, "Unknown watch descriptor %d\n", ev->wd);
+         } else if (renamed) {
+             route_rename(info, dir, ev->name, log_file);
+         } else if (ev->name[0] && (ev->mask & IN_MOVED_FROM)) {
+             /* Hold it: the IN_MOVED_TO of a rename follows right away */
+             flush_pending_move(log_file);
+             pending_move.info = info;
+             pending_move.shard = ev->shard;
+             pending_move.cookie = ev->cookie;
+             snprintf(pending_move.dir, sizeof(pending_move.dir), "%s", dir);
+             snprintf(pending_move.name, sizeof(pending_move.name), "%s", ev->name);
+         } else if (ev->name[0]) {
              /* Determine operation type */
-             const char* op = (ev->mask&IN_CREATE) ? "ADDED" :
+             const char* op = (ev->mask&(IN_CREATE|IN_MOVED_TO)) ? "ADDED" :
                              (ev->mask&IN_MODIFY) ? "MODIFIED" :
                              (ev->mask&IN_DELETE) ? "DELETED" : "UNKNOWN";
-             
-             /* Get sync_info for this source directory */
-             sync_info_t* info = hashSearch((char*)src);
-             
-             /* Log event start */
-             char* ts = get_timestamp();
-             fprintf(log_file,
-                    "%s [%s] [%s] [0] [%s] [STARTED] [File: %s]\n",
-                    ts, src, info->target_dir, op, ev->name);
-             fflush(log_file);
-             
-             /* Spawn worker to handle the file change */
-             start_worker(src, info->target_dir, ev->name, op, log_file);
+             route_change(info, dir, ev->name, op, log_file);
          }
          
-         /* Move to next event */
-         p += sizeof(*ev) + ev->len;
+         pipeline_release_event(ev);
      }
+     
+     /* Drained: a rename half left over moved out of the source */
+     flush_pending_move(log_file);
  }
  
  /**
@@ -434,58 +1819,76 @@
   * Parses command lines received from the console and
   * dispatches them to the appropriate handler functions.
   *
+  * A line may start with a request tag ("@<tag> <command>"). The reply is
+  * then followed by a line "@<tag> END", so a client that pipelines
+  * requests can tell where each reply ends (see libfss.h).
+  *
   * @param cmdline Command line to process
   * @param fd_out File descriptor for console output
   * @param log_file File pointer for logging
   */
  void handle_command(const char* cmdline, int fd_out, FILE* log_file) {
      char cmd[BUFSIZE], a1[PATH_MAX], a2[PATH_MAX];
+     char tag[32], end[64] = "";
+     
+     /* Strip the request tag, if any */
+     int skip = 0;
+     if (sscanf(cmdline, "@%31[0-9.] %n", tag, &skip) == 1 && skip) {
+         snprintf(end, sizeof(end), "@%s END\n", tag);
+         cmdline += skip;
+     }
      
-     /* Parse command and arguments */
-     int n = sscanf(cmdline, "%s %s %s", cmd, a1, a2);
+     /* Parse command and arguments (add may be followed by options) */
+     int consumed = 0;
+     int n = sscanf(cmdline, "%s %s %s%n", cmd, a1, a2, &consumed);
      
      /* Dispatch to appropriate handler */
-     if (!strcmp(cmd, "add") && n==3) 
-         handle_command_add(a1, a2, fd_out, log_file);
+     if (n < 1)
+         dprintf(fd_out, "Unrecognized: %s\n", cmdline);
+     else if (!strcmp(cmd, "add") && n==3) 
+         handle_command_add(a1, a2, cmdline + consumed, fd_out, log_file);
      else if (!strcmp(cmd, "cancel") && n==2) 
          handle_command_cancel(a1, fd_out, log_file);
+     else if (!strcmp(cmd, "status") && n==2 && !strcmp(a1, "--all")) {
+         /* The bulk response is written later; it carries the end line itself */
+         handle_command_status_all(end[0] ? end : NULL, fd_out, log_file);
+         return;
+     }
      else if (!strcmp(cmd, "status") && n==2) 
          handle_command_status(a1, fd_out, log_file);
      else if (!strcmp(cmd, "sync") && n==2) 
          handle_command_sync(a1, fd_out, log_file);
+     else if (!strcmp(cmd, "verify") && n==2) 
+         handle_command_verify(a1, fd_out, log_file);
+     else if (!strcmp(cmd, "reconcile") && n==2) 
+         handle_command_reconcile(a1, fd_out, log_file);
      else if (!strcmp(cmd, "shutdown")) 
          handle_command_shutdown(fd_out, log_file);
+     else if (!strcmp(cmd, "watch") && n <= 2) 
+         handle_command_watch(n == 2 ? a1 : NULL, fd_out, log_file);
+     else if (!strcmp(cmd, "unwatch") && n == 1) 
+         handle_command_unwatch(fd_out, log_file);
      else 
          dprintf(fd_out, "Unrecognized: %s\n", cmdline);
+     
+     if (end[0] && fd_out >= 0) dprintf(fd_out, "%s", end);
  }
  
  /**
   * @brief Handle 'add' command
   *
-  * Adds a new directory pair for monitoring and synchronization.
-  * Note: This is a placeholder implementation that only handles
-  * the case where the directory is already monitored.
+  * Adds a new directory pair for monitoring and synchronization, with the
+  * same validation as config file entries.
   *
   * @param src Source directory path
   * @param dst Target directory path
+  * @param options Whitespace-separated key=value options (may be empty)
   * @param fd_out File descriptor for console output
   * @param log_file File pointer for logging
   */
- void handle_command_add(const char* src, const char* dst, int fd_out, FILE* log_file) {
-     /* Check if already monitored */
-     sync_info_t* e = hashSearch((char*)src);
-     char* ts = get_timestamp();
-     
-     if (e && e->active && !strcmp(e->target_dir, dst)) {
-         /* Already monitored with same target */
-         dprintf(fd_out, "%s Already in queue: %s\n", ts, src);
-         fprintf(log_file, "%s Already in queue: %s\n", ts, src);
-         fflush(log_file);
-         return;
-     }
-     
-     /* Full implementation left as exercise */
-     /* Would need to create sync_info, add inotify watch, start sync */
+ void handle_command_add(const char* src, const char* dst, const char* options,
+                         int fd_out, FILE* log_file) {
+     add_source(src, dst, options, fd_out, log_file);
  }
  
  /**
@@ -503,16 +1906,20 @@
      char* ts = get_timestamp();
  
      if (info && info->active) {
-         /* Mark as inactive */
+         /* Mark as inactive; held changes are dropped with it */
          info->active = 0;
+         mark_status(info);
+         timer_wheel_cancel(policy_wheel, &info->policy_timer);
+         drop_held(info);
+         stop_poller(info);
+         stop_digests(info);
          
          /* Log to file */
-         fprintf(log_file, "%s Monitoring stopped for %s\n", ts, source);
+         fss_log(log_file, "%s Monitoring stopped for %s\n", ts, source);
      } else {
          /* Not monitored */
-         fprintf(log_file, "%s Directory not monitored: %s\n", ts, source);
+         fss_log(log_file, "%s Directory not monitored: %s\n", ts, source);
      }
-     fflush(log_file);
  
      /* Send response to console */
      if (info && info->active == 0) {
@@ -521,11 +1928,17 @@
          dprintf(fd_out, "%s Directory not monitored: %s\n", ts, source);
      }
  
-     /* Remove inotify watch if directory was active */
+     /* Remove inotify watch and index entries if directory was active */
      if (info) {
          for (int i = 0; i < watch_map_len; i++) {
-             if (strcmp(watch_map[i].source, source) == 0) {
-                 inotify_rm_watch(inotify_fd, watch_map[i].wd);
+             if (watch_map[i].info == info) {
+                 if (watch_map[i].shard >= 0)
+                     inotify_rm_watch(inotify_fds[watch_map[i].shard], watch_map[i].wd);
+                 path_index_remove(source_index, watch_map[i].source);
+                 path_index_remove(target_index, watch_map[i].target);
+                 set_watch_slot(watch_map[i].shard, watch_map[i].wd, -1);
+                 watch_map[i] = watch_map[--watch_map_len];
+                 if (i < watch_map_len) set_watch_slot(watch_map[i].shard, watch_map[i].wd, i);
                  break;
              }
          }
@@ -547,8 +1960,7 @@
      char* ts = get_timestamp();
  
      /* Always log the status request */
-     fprintf(log_file, "%s Status requested for %s\n", ts, source);
-     fflush(log_file);
+     fss_log(log_file, "%s Status requested for %s\n", ts, source);
  
      if (info && info->active) {
          /* Directory is being monitored - format last sync time */
@@ -556,6 +1968,47 @@
          strftime(lst, sizeof(lst), "%Y-%m-%d %H:%M:%S", 
                  localtime(&info->last_sync_time));
          
+         /* Configured priority, and what a running task of this source really has */
+         char prio[128], eff[160] = "no task running";
+         task_priority_describe(&info->priority, prio, sizeof(prio));
+         for (worker_info_t* w = active_workers; w; w = w->next) {
+             pid_t tid = __atomic_load_n(&w->task_tid, __ATOMIC_RELAXED);
+             if (strcmp(w->source_dir, source) || tid <= 0) continue;
+             char got[128];
+             if (task_priority_query(tid, got, sizeof(got)) == 0) {
+                 snprintf(eff, sizeof(eff), "%s (%s %d)", got,
+                          executor_mode == EXECUTOR_THREAD || w->pid >= INLINE_ID_BASE
+                              ? "thread" : "pid", tid);
+                 break;
+             }
+         }
+ 
+         /* Replication lag: age of the oldest change not yet synced */
+         char lag[32] = "0.0s", max_lag[16] = "none";
+         long long oldest;
+         if (oldest_change(info, &oldest))
+             snprintf(lag, sizeof(lag), "%.1fs", (now_ms() - oldest) / 1000.0);
+         if (info->max_lag) snprintf(max_lag, sizeof(max_lag), "%ds", info->max_lag);
+ 
+         /* Sync policy, and when it next flushes or changes state */
+         char policy[96];
+         size_t used;
+         sync_policy_describe(&info->policy, policy, sizeof(policy));
+         used = strlen(policy);
+         if (timer_wheel_pending(&info->policy_timer)) {
+             long long left = (long long)info->policy_timer.expires - now_ms() / 1000;
+             snprintf(policy + used, sizeof(policy) - used, ", %s in %llds",
+                      info->policy.kind == SYNC_POLICY_INTERVAL ? "next flush"
+                      : info->holding ? "opens" : "closes", left > 0 ? left : 0);
+         }
+ 
+         /* Change detection, and how often a polled source is rescanned */
+         char monitor[128] = "inotify";
+         struct poll_state* ps = info->poller;
+         if (ps)
+             snprintf(monitor, sizeof(monitor), "poll every %ds (%lu scans, %lu changes, %zu entries)",
+                      ps->interval, ps->scans, ps->changes, ps->entries);
+         
          /* Send status information to console */
          dprintf(fd_out,
                  "%s Status requested for %s\n"
@@ -563,18 +2016,62 @@
                  "Target: %s\n"
                  "Last Sync: %s\n"
                  "Errors: %d\n"
+                 "Suppressed Events: %lu\n"
+                 "Queued: %d\n"
+                 "In Flight: %d\n"
+                 "Bytes Synced: %llu\n"
+                 "Replication Lag: %s\n"
+                 "Max Lag: %s\n"
+                 "Deadline Misses: %lu\n"
+                 "Sync Policy: %s\n"
+                 "Held Changes: %lu\n"
+                 "Monitor: %s\n"
+                 "Priority: %s\n"
+                 "Priority In Effect: %s\n"
                  "Status: Active\n",
                  ts, source,
                  source,
                  info->target_dir,
                  lst,
-                 info->error_count);
+                 info->error_count,
+                 info->suppressed_events,
+                 info->queued,
+                 info->in_flight,
+                 info->bytes_synced,
+                 lag,
+                 max_lag,
+                 info->deadline_misses,
+                 policy,
+                 info->held_changes,
+                 monitor,
+                 prio,
+                 eff);
      } else {
          /* Directory not monitored */
          dprintf(fd_out, "%s Directory not monitored: %s\n", ts, source);
      }
  }
  
+ /**
+  * @brief Handle 'status --all' command
+  *
+  * Starts a bulk response covering every source, cancelled ones included.
+  * The records are written by status_stream_pump() from the main loop as
+  * the console reads them.
+  *
+  * @param end Line that ends the reply of a tagged request (NULL if untagged)
+  * @param fd_out File descriptor for console output
+  * @param log_file File pointer for logging
+  */
+ void handle_command_status_all(const char* end, int fd_out, FILE* log_file) {
+     char* ts = get_timestamp();
+ 
+     if (fd_out < 0) return;  /* No console to answer */
+     fss_log(log_file, "%s Status requested for all sources\n", ts);
+     if (status_stream_start(fd_out, end) < 0)
+         dprintf(fd_out, "%s Bulk status already in progress\n%s", ts, end ? end : "");
+ }
+ 
  /**
   * @brief Handle 'sync' command
   *
@@ -593,28 +2090,105 @@
  
      if (!info || !info->active) {
          /* Not being monitored */
-         fprintf(log_file, "%s Directory not monitored: %s\n", ts, source);
-         fflush(log_file);
+         fss_log(log_file, "%s Directory not monitored: %s\n", ts, source);
          dprintf(fd_out, "%s Directory not monitored: %s\n", ts, source);
          return;
      }
  
-     /* Check if sync already in progress */
-     if (is_worker_active_for_source(source)) {
-         fprintf(log_file, "%s Sync already in progress %s\n", ts, source);
-         fflush(log_file);
+     /* Check if a full sync is already running or waiting */
+     if (task_table_full_pending(task_table, source)) {
+         fss_log(log_file, "%s Sync already in progress %s\n", ts, source);
          dprintf(fd_out, "%s Sync already in progress %s\n", ts, source);
          return;
      }
  
      /* Start new synchronization */
-     fprintf(log_file, "%s Syncing directory: %s -> %s\n", ts, source, info->target_dir);
-     fflush(log_file);
+     fss_log(log_file, "%s Syncing directory: %s -> %s\n", ts, source, info->target_dir);
      dprintf(fd_out, "%s Syncing directory: %s -> %s\n", ts, source, info->target_dir);
  
      start_worker(source, info->target_dir, "ALL", "FULL", log_file);
  }
  
+ /**
+  * @brief Handle 'verify' command
+  *
+  * Compares the digests of a digest=1 source and its target, descending
+  * only into directories whose digests differ, and lists the first
+  * differences.
+  *
+  * @param source Source directory to verify
+  * @param fd_out File descriptor for console output
+  * @param log_file File pointer for logging
+  */
+ void handle_command_verify(const char* source, int fd_out, FILE* log_file) {
+     sync_info_t* info = hashSearch((char*)source);
+     char* ts = get_timestamp();
+ 
+     if (!info || !info->active) {
+         fss_log(log_file, "%s Directory not monitored: %s\n", ts, source);
+         dprintf(fd_out, "%s Directory not monitored: %s\n", ts, source);
+         return;
+     }
+     struct digest_state* ds = lock_digests(info, fd_out);
+     if (!ds) return;
+ 
+     verify_ctx_t* v = calloc(1, sizeof(*v));
+     long visited = merkle_diff(ds->src, ds->dst, collect_difference, v);
+     size_t entries = merkle_size(ds->src);
+     pthread_mutex_unlock(&ds->lock);
+ 
+     fss_log(log_file, "%s Verified %s: %ld differences (%ld of %zu entries visited)\n",
+             ts, source, v->count, visited, entries);
+     dprintf(fd_out, "%s Verified %s -> %s: %s, %ld differences (%ld of %zu entries visited)\n",
+             ts, source, info->target_dir, v->count ? "DIFFERENT" : "IN SYNC",
+             v->count, visited, entries);
+     for (long i = 0; i < v->count && i < VERIFY_SHOW; i++)
+         dprintf(fd_out, "  %s\n", v->shown[i]);
+     if (v->count > VERIFY_SHOW)
+         dprintf(fd_out, "  ... %ld more\n", v->count - VERIFY_SHOW);
+     free(v);
+ }
+ 
+ /**
+  * @brief Handle 'reconcile' command
+  *
+  * Compares the digests of a digest=1 source and its target and queues a
+  * task for each difference, or one full sync if they differ too much.
+  *
+  * @param source Source directory to reconcile
+  * @param fd_out File descriptor for console output
+  * @param log_file File pointer for logging
+  */
+ void handle_command_reconcile(const char* source, int fd_out, FILE* log_file) {
+     sync_info_t* info = hashSearch((char*)source);
+     char* ts = get_timestamp();
+ 
+     if (!info || !info->active) {
+         fss_log(log_file, "%s Directory not monitored: %s\n", ts, source);
+         dprintf(fd_out, "%s Directory not monitored: %s\n", ts, source);
+         return;
+     }
+     struct digest_state* ds = lock_digests(info, fd_out);
+     if (!ds) return;
+ 
+     reconcile_ctx_t* r = calloc(1, sizeof(*r));
+     merkle_diff(ds->src, ds->dst, queue_difference, r);
+     pthread_mutex_unlock(&ds->lock);
+ 
+     for (long i = 0; i < r->tasks; i++) {
+         submit_task(source, info->target_dir, r->paths[i], "",
+                     r->deleted[i] ? "DELETED" : "MODIFIED", log_file);
+         free(r->paths[i]);
+     }
+     if (r->full && !task_table_full_pending(task_table, source))
+         start_worker(source, info->target_dir, "ALL", "FULL", log_file);
+     fss_log(log_file, "%s Reconciling %s: %ld file tasks%s\n",
+             ts, source, r->tasks, r->full ? " and a full sync" : "");
+     dprintf(fd_out, "%s Reconciling %s -> %s: %ld file tasks%s\n",
+             ts, source, info->target_dir, r->tasks, r->full ? " and a full sync" : "");
+     free(r);
+ }
+ 
  /**
   * @brief Handle 'shutdown' command
   *
@@ -633,66 +2207,274 @@
      dprintf(fd_out, "%s Processing remaining queued tasks.\n", ts);
  
      /* Log shutdown process */
-     fprintf(log_file,
+     fss_log(log_file,
              "%s Shutting down manager...\n"
              "%s Waiting for all active workers to finish.\n"
              "%s Processing remaining queued tasks.\n",
              ts, ts, ts);
-     fflush(log_file);
  
-     /* Wait for all active workers to finish */
-     for (worker_info_t* w = active_workers; w; w = w->next) {
-         waitpid(w->pid, NULL, 0);
-         process_worker_output(w);
+     /* Wait for active workers; completions start the queued tasks */
+     while (active_worker_count > 0 || inline_task_count > 0 || deadline_queue_size(task_queue) > 0) {
+         struct pollfd pfd = { .fd = pipeline_wake_fd(), .events = POLLIN };
+         if (poll(&pfd, 1, 1000) > 0) pipeline_clear_wake();
+         handle_worker_completions(log_file);
      }
      
-     /* Drain the task queue */
-     while (dequeue_task()) {}
-     
      /* Set flag to exit main loop */
      running = 0;
  
      /* Send completion message */
      dprintf(fd_out, "%s Manager shutdown complete.\n", ts);
-     fprintf(log_file, "%s Manager shutdown complete.\n", ts);
-     fflush(log_file);
-     
-     /* Clean up hashmap */
-     hashDestroy();
+     fss_log(log_file, "%s Manager shutdown complete.\n", ts);
  }
  
  /**
-  * @brief SIGCHLD signal handler
+  * @brief Handle 'watch' command
   *
-  * Handles the termination of worker processes, processes their
-  * output, and starts queued tasks if worker limit allows.
+  * Subscribes the console to task start/finish/error events, for one
+  * source or for all of them. Events are pushed as "EVENT ..." lines until
+  * the console sends 'unwatch'.
   *
-  * @param signum Signal number (SIGCHLD)
+  * @param source Source to watch (NULL for all)
+  * @param fd_out File descriptor for console output
+  * @param log_file File pointer for logging
   */
- void sigchld_handler(int signum) {
-     pid_t pid;
-     int status;
+ void handle_command_watch(const char* source, int fd_out, FILE* log_file) {
+     char* ts = get_timestamp();
  
-     /* Reap all terminated child processes */
-     while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
-         DBG("sigchld: reaped %d\n", pid);
-         
+     if (fd_out < 0) return;  /* No console to push to */
+     if (source) {
+         sync_info_t* info = hashSearch((char*)source);
+         if (!info || !info->active) {
+             dprintf(fd_out, "%s Directory not monitored: %s\n", ts, source);
+             return;
+         }
+     }
+     if (event_stream_subscribe(fd_out, source) < 0) {
+         dprintf(fd_out, "%s Too many watchers\n", ts);
+         return;
+     }
+ 
+     fss_log(log_file, "%s Watching %s\n", ts, source ? source : "all sources");
+     dprintf(fd_out, "%s Watching %s\n", ts, source ? source : "all sources");
+ }
+ 
+ /**
+  * @brief Handle 'unwatch' command
+  *
+  * Ends the console's subscription and reports how many events it lost
+  * by not reading fast enough.
+  *
+  * @param fd_out File descriptor for console output
+  * @param log_file File pointer for logging
+  */
+ void handle_command_unwatch(int fd_out, FILE* log_file) {
+     char* ts = get_timestamp();
+     long dropped = event_stream_unsubscribe(fd_out);
+ 
+     if (dropped < 0) {
+         dprintf(fd_out, "%s Not watching\n", ts);
+         return;
+     }
+     fss_log(log_file, "%s Watch stopped (%ld events dropped)\n", ts, dropped);
+     dprintf(fd_out, "%s Watch stopped (%ld events dropped)\n", ts, dropped);
+ }
+ 
+ /**
+  * @brief Forward a finished task's changes to the source it wrote into
+  *
+  * Events for the task's writes were dropped as self-generated, so the
+  * downstream source gets exactly one task instead: the same per-file
+  * operation when the target is that source's directory, or a full sync
+  * otherwise. Deletions are recorded so late delete events are dropped too.
+  *
+  * @param w Finished task
+  * @param status Its result status
+  * @param log_file File pointer for logging
+  */
+ static void propagate_completion(const worker_info_t* w, const char* status, FILE* log_file) {
+     sync_info_t* down = w->feeds;
+     int per_file = w->feeds_exact && strcmp(w->filename, "ALL") != 0;
+ 
+     /* A rename removes its old name like a delete does */
+     int renamed = !strcmp(w->operation, "RENAMED");
+     if (per_file && (renamed || !strcmp(w->operation, "DELETED"))) {
+         char tbuf[PATH_MAX], path[PATH_MAX * 2];
+         const char* ctgt = canonical_target(hashSearch((char*)w->source_dir), w->target_dir,
+                                             tbuf, sizeof(tbuf));
+         snprintf(path, sizeof(path), "%s/%s", ctgt, renamed ? w->from : w->filename);
+         write_tracker_record_unlink(path);
+     }
+ 
+     if (!down->active || !strcmp(status, "ERROR")) return;
+     if (hold_change(down, per_file ? w->filename : "ALL", w->from,
+                     per_file ? w->operation : "FULL"))
+         return;
+ 
+     if (per_file)
+         submit_task(down->source_dir, down->target_dir, w->filename, w->from,
+                     w->operation, log_file);
+     else
+         start_worker(down->source_dir, down->target_dir, "ALL", "FULL", log_file);
+ }
+ 
+ /**
+  * @brief Handle finished workers
+  *
+  * Drains the completions reported by the completion thread, updates the
+  * sync_info of each source and starts queued tasks if worker limit allows.
+  *
+  * @param log_file File pointer for logging
+  */
+ void handle_worker_completions(FILE* log_file) {
+     worker_completion_t* c;
+ 
+     while ((c = pipeline_next_completion())) {
          /* Find and remove the worker from active list */
-         worker_info_t* w = remove_active_worker(pid);
+         worker_info_t* w = remove_active_worker(c->pid);
          
          if (w) {
-             /* Process its output and start queued task if possible */
-             process_worker_output(w);
+             /* Push the result to watching consoles */
+             event_stream_publish(w->source_dir, "[%s] [%s] [%s] [%d] [%s] [%s] [%s]",
+                                  strcmp(c->status, "ERROR") ? "FINISH" : "ERROR",
+                                  w->source_dir, w->target_dir, c->pid, w->operation,
+                                  c->status, c->details);
+ 
+             /* Update sync_info */
+             sync_info_t* i = hashSearch(w->source_dir);
+             mark_status(i);
+             if (i) {
+                 i->last_sync_time = time(NULL);
+                 i->bytes_synced += c->bytes;
+                 if (!strcmp(c->status, "ERROR")) 
+                     i->error_count++;
+                 if (strcmp(c->status, "SUCCESS")) {
+                     i->last_error_time = i->last_sync_time;
+                     snprintf(i->last_error, sizeof(i->last_error), "%s:%s", c->status, c->details);
+                 }
+                 
+                 /* Synced later than the source's recovery point objective */
+                 long long done = now_ms();
+                 if (i->max_lag && done > task_deadline(i, w->changed)) {
+                     i->deadline_misses++;
+                     fss_log(log_file, "%s Deadline missed: %s (%s %s) lag %.1fs, max_lag %ds\n",
+                             get_timestamp(), w->source_dir, w->operation, w->filename,
+                             (done - w->changed) / 1000.0, i->max_lag);
+                 }
+             }
+ 
+             /* Bring the replica digests up to date with what it did */
+             refresh_digests(w);
+ 
+             /* The task wrote into another monitored source */
+             if (w->feeds) propagate_completion(w, c->status, log_file);
+ 
+             /* Tasks that waited for this one go first, then the queue */
+             release_deferred(w->source_dir);
+             free(w);
              start_queued_task();
          }
+         free(c);
      }
  }
  
+ /**
+  * @brief on_write callback for in-process tasks writing into a watched source
+  *
+  * @param st Stat of the file just written
+  * @param ctx Unused
+  */
+ static void track_own_write(const struct stat* st, void* ctx) {
+     (void)ctx;
+     write_tracker_record(st->st_dev, st->st_ino, &st->st_mtim);
+ }
+ 
+ /**
+  * @brief Run an in-process task on an executor or inline thread
+  *
+  * Calls the shared synchronization logic directly and reports the result
+  * through the same completion path as worker processes. A task with a
+  * priority runs on a thread of its own (see run_own_thread()), so the
+  * priority is applied and never has to be undone; RLIMIT_CPU would limit
+  * the whole manager, so it is left out here.
+  *
+  * @param arg exec_job_t to run (freed here)
+  */
+ static void run_exec_job(void* arg) {
+     exec_job_t* j = arg;
+     sync_result_t r;
+     char err[256];
+ 
+     __atomic_store_n(j->tid_slot, (pid_t)syscall(SYS_gettid), __ATOMIC_RELAXED);
+     if (!task_priority_is_default(&j->priority) &&
+         task_priority_apply(&j->priority, 0, NULL, err, sizeof(err)) < 0)
+         fprintf(stderr, "Priority not fully applied for %s: %s\n", j->source_dir, err);
+ 
+     sync_result_init(&r, NULL);
+     if (j->opts.report_writes) r.on_write = track_own_write;
+     if (!strcmp(j->operation, "RENAMED"))
+         sync_run_rename(j->source_dir, j->target_dir, j->from, j->filename, &j->opts, &r);
+     else
+         sync_run_task(j->source_dir, j->target_dir, j->filename, j->operation, &j->opts, &r);
+     pipeline_post_completion(j->id, j->source_dir, j->target_dir,
+                              j->operation, r.status, r.details, r.bytes_written);
+     free(j);
+ }
+ 
+ /**
+  * @brief Body of a thread running one prioritized task
+  *
+  * Lowering a pool thread's nice value or moving it to SCHED_IDLE cannot
+  * be undone without CAP_SYS_NICE, and the thread would go on to run every
+  * other source's tasks degraded. The thread exits with the task instead.
+  *
+  * @param arg exec_job_t to run (freed by run_exec_job())
+  * @return NULL
+  */
+ static void* run_own_thread(void* arg) {
+     run_exec_job(arg);
+     pthread_mutex_lock(&own_thread_lock);
+     if (--own_threads == 0) pthread_cond_broadcast(&own_thread_done);
+     pthread_mutex_unlock(&own_thread_lock);
+     return NULL;
+ }
+ 
+ /**
+  * @brief Start a prioritized task on a detached thread of its own
+  *
+  * Called from the scheduler thread, whose priority the new thread
+  * inherits before applying the source's.
+  *
+  * @param j Task to run
+  * @return 0 if the thread was started, -1 otherwise (j is left to the caller)
+  */
+ static int start_own_thread(exec_job_t* j) {
+     pthread_attr_t attr;
+     pthread_t t;
+ 
+     pthread_mutex_lock(&own_thread_lock);
+     own_threads++;
+     pthread_mutex_unlock(&own_thread_lock);
+ 
+     pthread_attr_init(&attr);
+     pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+     int rc = pthread_create(&t, &attr, run_own_thread, j);
+     pthread_attr_destroy(&attr);
+     if (rc == 0) return 0;
+ 
+     pthread_mutex_lock(&own_thread_lock);
+     if (--own_threads == 0) pthread_cond_broadcast(&own_thread_done);
+     pthread_mutex_unlock(&own_thread_lock);
+     return -1;
+ }
+ 
  /**
   * @brief Start a worker process for synchronization
   *
-  * Creates a new worker process to perform a synchronization operation.
-  * If at worker limit, the task is queued for later execution.
+  * Creates a new worker process (or, in thread mode, an in-process task)
+  * to perform a synchronization operation. If at worker limit, the task
+  * is queued for later execution. Tasks for different files of one source
+  * run side by side; see dispatch_task() for the ordering rules.
   *
   * @param src Source directory path
   * @param dst Target directory path
@@ -704,24 +2486,162 @@
                    const char* fn, const char* op,
                    FILE* log_file)
  {
-     /* Check if a worker is already active for this source */
-     if (is_worker_active_for_source(src)) {
-         return;  /* Already being handled */
-     }
+     submit_task(src, dst, fn, "", op, log_file);
+ }
  
-     /* If at worker limit, queue the task */
-     if (active_worker_count >= worker_limit_global) {
-         queue_task(src, dst, fn, op);
-         fprintf(log_file, "%s Queued task: %s -> %s (%s %s)\n",
+ /**
+  * @brief Queue a task, or run it if a worker slot is free
+  *
+  * @param src Source directory path
+  * @param dst Target directory path
+  * @param fn Filename to synchronize (or "ALL" for full sync)
+  * @param from Old name of a RENAMED task ("" otherwise)
+  * @param op Operation type
+  * @param log_file File pointer for logging
+  */
+ static void submit_task(const char* src, const char* dst, const char* fn,
+                         const char* from, const char* op, FILE* log_file)
+ {
+     long long changed = now_ms();
+     change_seen(hashSearch((char*)src), changed);
+     
+     /* If at worker limit (or behind queued tasks), queue the task */
+     if (active_worker_count >= worker_limit_global || deadline_queue_size(task_queue) > 0) {
+         queue_task(src, dst, fn, from, op, changed);
+         fss_log(log_file, "%s Queued task: %s -> %s (%s %s)\n",
                  get_timestamp(), src, dst, op, fn);
-         fflush(log_file);
+         event_stream_publish(src, "[QUEUED] [%s] [%s] [%s] [File: %s]", src, dst, op, fn);
+         return;
+     }
+     
+     dispatch_task(src, dst, fn, from, op, changed, 0, log_file);
+ }
+ 
+ /**
+  * @brief Check whether a task is cheap enough to run inside the manager
+  *
+  * Deletes, renames, directories, links and special files only touch
+  * metadata, and regular files up to inline_copy_max bytes are a single
+  * copy_file_range(); forking and exec'ing ./worker would cost more than
+  * the operation itself.
+  *
+  * @param src Source directory path
+  * @param fn Filename (or "ALL")
+  * @param op Operation type
+  * @param o Parsed per-source options
+  * @return 1 to run inline, 0 to fork a worker
+  */
+ static int is_inline_task(const char* src, const char* fn, const char* op,
+                           const sync_options_t* o) {
+     if (!strcmp(fn, "ALL")) return 0;
+     if (!strcmp(op, "DELETED") || !strcmp(op, "RENAMED")) return 1;
+ 
+     char path[PATH_MAX * 2];
+     struct stat st;
+     snprintf(path, sizeof(path), "%s/%s", src, fn);
+     if (lstat(path, &st) < 0) return 1;  /* Gone again: fails fast either way */
+     if (o->follow_links && S_ISLNK(st.st_mode) && stat(path, &st) < 0) return 1;
+     return !S_ISREG(st.st_mode) || (o->inline_copy_max > 0 && st.st_size <= o->inline_copy_max);
+ }
+ 
+ /**
+  * @brief Run a task in a free worker slot, or defer it
+  *
+  * A task waits in the task table while a task for the same file or a
+  * FULL sync of its source runs, and a FULL sync waits for every running
+  * task of its source; everything else starts right away.
+  *
+  * @param src Source directory path
+  * @param dst Target directory path
+  * @param fn Filename to synchronize (or "ALL" for full sync)
+  * @param from Old name of a RENAMED task ("" otherwise)
+  * @param op Operation type
+  * @param changed When the oldest change it covers was seen
+  * @param reserved Task was released from deferral and is already running in the table
+  * @param log_file File pointer for logging
+  */
+ static void dispatch_task(const char* src, const char* dst, const char* fn,
+                           const char* from, const char* op, long long changed,
+                           int reserved, FILE* log_file)
+ {
+     /* Per-file ordering and FULL/per-file exclusion */
+     if (!reserved) {
+         if (task_table_busy(task_table, src, fn)) {
+             defer_task(src, dst, fn, from, op, changed, log_file);
+             return;
+         }
+         task_table_start(task_table, src, fn);
+     }
+     
+     /* Per-source worker options from the config file */
+     sync_info_t* info = hashSearch((char*)src);
+     const char* opts = info ? info->sync_opts : "";
+ 
+     /* Writing into another monitored source: have the task report its writes */
+     char tbuf[PATH_MAX], optbuf[sizeof(info->sync_opts) + 32];
+     size_t matched = 0;
+     const char* ctgt = canonical_target(info, dst, tbuf, sizeof(tbuf));
+     sync_info_t* feeds = path_index_longest_prefix(source_index, ctgt, &matched);
+     if (feeds) {
+         snprintf(optbuf, sizeof(optbuf), "%s%sreport_writes=1", opts, opts[0] ? "," : "");
+         opts = optbuf;
+     }
+ 
+     /* Threaded executor, or a metadata-only task: run it in-process, no fork or exec */
+     sync_options_t o;
+     sync_options_init(&o);
+     sync_options_parse(opts, &o);  /* validated when the config was read */
+     thread_pool_t* pool = executor_mode == EXECUTOR_THREAD ? executor_pool
+                         : inline_pool && is_inline_task(src, fn, op, &o) ? inline_pool : NULL;
+     if (!pool && !strcmp(op, "RENAMED")) op = "ADDED";  /* No inline threads: copy instead */
+     
+     if (pool) {
+         exec_job_t* j = malloc(sizeof(*j));
+         j->id = pool == inline_pool ? INLINE_ID_BASE + ++next_job_id : ++next_job_id;
+         snprintf(j->source_dir, sizeof(j->source_dir), "%s", src);
+         snprintf(j->target_dir, sizeof(j->target_dir), "%s", dst);
+         snprintf(j->filename, sizeof(j->filename), "%s", fn);
+         snprintf(j->from, sizeof(j->from), "%s", from);
+         snprintf(j->operation, sizeof(j->operation), "%s", op);
+         j->opts = o;
+         /* Inline tasks are too short to be worth a thread of their own to lower */
+         if (info && pool != inline_pool) j->priority = info->priority;
+         else task_priority_init(&j->priority);
+ 
+         worker_info_t* w = add_active_worker(j->id, src, dst, op, fn, from, changed);
+         w->feeds = feeds;
+         w->feeds_exact = feeds && ctgt[matched] == '\0';
+         j->tid_slot = &w->task_tid;
+         fss_log(log_file, "%s [%s] [%s] [%d] [%s] [STARTED] [File: %s]\n",
+                 get_timestamp(), src, dst, j->id, op, fn);
+         event_stream_publish(src, "[START] [%s] [%s] [%d] [%s] [File: %s]", src, dst, j->id, op, fn);
+         if (!task_priority_is_default(&j->priority)) {
+             if (start_own_thread(j) == 0) return;
+             fss_log(log_file, "%s Cannot start a thread for %s, task %d runs without its priority\n",
+                     get_timestamp(), src, j->id);
+             task_priority_init(&j->priority);
+         }
+         pool_submit(pool, run_exec_job, j);
          return;
      }
      
-     /* Create pipe for worker output */
+     /* The worker applies its priority itself: the manager is multithreaded,
+      * so the child may only make raw system calls before exec() */
+     char prio[96], argbuf[sizeof(optbuf) + sizeof(prio)];
+     if (info && !task_priority_is_default(&info->priority)) {
+         task_priority_options(&info->priority, prio, sizeof(prio));
+         snprintf(argbuf, sizeof(argbuf), "%s%s%s", opts, opts[0] ? "," : "", prio);
+         opts = argbuf;
+     }
+     
+     /* Create pipe for worker output (close-on-exec so siblings don't hold it) */
      int p[2];
-     if (pipe(p) < 0) { 
+     if (pipe2(p, O_CLOEXEC) < 0) { 
          perror("pipe"); 
+         change_synced(info, changed);
+         mark_status(info);
+         task_table_finish(task_table, src, fn);
+         release_deferred(src);
          return; 
      }
      
@@ -731,6 +2651,10 @@
          perror("fork"); 
          close(p[0]); 
          close(p[1]); 
+         change_synced(info, changed);
+         mark_status(info);
+         task_table_finish(task_table, src, fn);
+         release_deferred(src);
          return; 
      }
      
@@ -743,105 +2667,55 @@
          close(p[1]);
          
          /* Execute worker binary */
-         execl("./worker", "worker", src, dst, fn, op, NULL);
+         if (opts[0]) execl("./worker", "worker", src, dst, fn, op, opts, NULL);
+         else execl("./worker", "worker", src, dst, fn, op, NULL);
          
-         /* If exec fails */
-         perror("execl"); 
-         exit(1);
+         /* If exec fails (no stdio: another thread may have held its locks at fork) */
+         static const char msg[] = "execl: cannot start ./worker\n";
+         if (write(STDERR_FILENO, msg, sizeof(msg) - 1) < 0) _exit(1);
+         _exit(1);
      }
      
      /* Parent process (manager) */
      close(p[1]);  /* Close write end */
      
      /* Add to active workers list */
-     add_active_worker(pid, p[0], src, dst, op, fn);
+     worker_info_t* w = add_active_worker(pid, src, dst, op, fn, "", changed);
+     w->feeds = feeds;
+     w->feeds_exact = feeds && ctgt[matched] == '\0';
+     w->task_tid = pid;
      
      /* Log worker start */
-     fprintf(log_file, "%s [%s] [%s] [%d] [%s] [STARTED] [File: %s]\n",
+     fss_log(log_file, "%s [%s] [%s] [%d] [%s] [STARTED] [File: %s]\n",
              get_timestamp(), src, dst, pid, op, fn);
-     fflush(log_file);
- }
- 
- /**
-  * @brief Process worker output and log results
-  *
-  * Reads the worker's stdout, parses the EXEC_REPORT, updates
-  * sync_info, and logs the synchronization result.
-  *
-  * @param w Pointer to worker_info structure
-  */
- static void process_worker_output(worker_info_t* w) {
-     char buf[4096] = {0}, *line;
-     int inrep = 0;
-     char status[16] = "UNKNOWN", details[128] = "";
- 
-     /* Set pipe to non-blocking mode */
-     fcntl(w->pipe_fd, F_SETFL, O_NONBLOCK);
-     
-     /* Read all available data from pipe */
-     ssize_t n;
-     while ((n = read(w->pipe_fd, buf + strlen(buf), 
-                      sizeof(buf) - strlen(buf) - 1)) > 0) {}
-     
-     close(w->pipe_fd);
- 
-     /* Parse the worker's output line by line */
-     line = strtok(buf, "\n");
-     while (line) {
-         if (!strcmp(line, "EXEC_REPORT_START")) {
-             inrep = 1;  /* Start of report */
-         } else if (!strcmp(line, "EXEC_REPORT_END")) {
-             inrep = 0;  /* End of report */
-         } else if (inrep) {
-             /* Extract status and details from report */
-             if (!strncmp(line, "STATUS: ", 8)) 
-                 strcpy(status, line + 8);
-             if (!strncmp(line, "DETAILS:", 8)) 
-                 strcpy(details, line + 8);
-         }
-         line = strtok(NULL, "\n");
-     }
- 
-     /* Update sync_info */
-     sync_info_t* i = hashSearch(w->source_dir);
-     if (i) {
-         i->last_sync_time = time(NULL);
-         if (!strcmp(status, "ERROR")) 
-             i->error_count++;
-     }
+     event_stream_publish(src, "[START] [%s] [%s] [%d] [%s] [File: %s]", src, dst, pid, op, fn);
  
-     /* Log the completion and result */
-     fprintf(global_log_file,
-             "%s [%s] [%s] [%d] [%s] [%s] [%s]\n",
-             get_timestamp(), w->source_dir, w->target_dir,
-             w->pid, w->operation, status, details);
-     fflush(global_log_file);
- 
-     /* Free worker info structure */
-     free(w);
+     /* The completion thread collects its output and reaps it */
+     pipeline_watch_worker(pid, p[0], src, dst, op);
  }
  
  /**
-  * @brief Start a queued task if under worker limit
+  * @brief Start queued tasks while under worker limit
   *
-  * Checks if the system is under the worker limit, and if so,
-  * dequeues and starts a task from the queue.
+  * Dequeues and starts tasks, earliest deadline first, until the worker
+  * limit is reached or the queue is empty; deferred tasks do not take a
+  * worker slot.
   */
  static void start_queued_task() {
-     if (active_worker_count < worker_limit_global) {
-         /* Dequeue a task */
-         worker_task_t* t = dequeue_task();
+     worker_task_t* t;
+     
+     while (active_worker_count < worker_limit_global && (t = dequeue_task())) {
+         /* Start worker for this task */
+         dispatch_task(t->source_dir,
+                       t->target_dir,
+                       t->filename,
+                       t->from,
+                       t->operation,
+                       t->changed,
+                       t->reserved,
+                       global_log_file);
          
-         if (t) {
-             /* Start worker for this task */
-             start_worker(t->source_dir,
-                         t->target_dir,
-                         t->filename,
-                         t->operation,
-                         global_log_file);
-             
-             /* Free task structure */
-             free(t);
-         }
+         /* Free task structure */
+         free(t);
      }
  }
\ No newline at end of file
@@ -8,6 +8,9 @@
  * - Creating communication channels with the console (named pipes)
  * - Monitoring directories for changes using inotify
  * - Managing worker processes that perform actual synchronization
+ *
+ * The main thread acts as the scheduler; inotify ingestion and worker
+ * completion/logging run on their own threads (see fss_pipeline.h).
  * - Processing commands from the user console
  * - Coordinating synchronization activities between source and target directories
  */
@@ -15,6 +18,10 @@
  #include "../include/cli_parser.h"
  #include "../include/fss_logic.h"
  #include "../include/hashmap.h"
+ #include "../include/fss_pipeline.h"
+ #include "../include/event_stream.h"
+ #include "../include/status_stream.h"
+ #include "../include/status_shm.h"
  #include <sys/types.h>
  #include <sys/stat.h>
  #include <fcntl.h>
@@ -61,8 +68,8 @@
      }
      
      /* Initialize data structures */
-     hashInit(127);       /* Initialize the hashmap for storing sync info */
-     setup_inotify();     /* Set up inotify for directory monitoring */
+     hashInit(100000);    /* Initialize the hashmap for storing sync info */
+     setup_inotify(input.inotify_instances);  /* Set up inotify for directory monitoring */
      
      /* Open input pipe in non-blocking mode */
      int fd_in = open("fss_in", O_RDONLY | O_NONBLOCK);
@@ -76,20 +83,25 @@
      
      /* Initialize global variables needed by worker processes and handlers */
      init_globals(log_file, fd_out, input.worker_limit);
+     set_executor_mode(strcmp(input.executor, "thread") == 0 ? EXECUTOR_THREAD
+                                                             : EXECUTOR_PROCESS);
+     
+     /* Start the ingestion and completion/logging threads */
+     pipeline_use_huge_pages(input.huge_pages);
+     pipeline_start(inotify_fds, inotify_shards, log_file);
+     int wake_fd = pipeline_wake_fd();
+     
+     /* Publish source state for readers that bypass the FIFOs */
+     open_status_table(STATUS_SHM_FILE, log_file);
      
      /* Read configuration file and start initial synchronization */
      readConfig(input.config_file, input.worker_limit, log_file);
      
-     /* Install signal handler for SIGCHLD (child process termination) */
-     struct sigaction sa = { .sa_handler = sigchld_handler };
-     sigemptyset(&sa.sa_mask);
-     sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
-     if (sigaction(SIGCHLD, &sa, NULL)) { 
-         perror("sigaction"); 
-     }
-     
-     /* Main event loop - process inotify events and console commands */
-     fd_set rfds;
+     /* Main event loop - process queued events, completions and console commands */
+     fd_set rfds, wfds;
+     int status_pending = 0;
+     char cmd_buf[BUFSIZE];  /* Commands read so far, up to a partial last line */
+     size_t cmd_len = 0;
      while (running) {
          /* Try opening output pipe if not already connected */
          if (global_fd_out < 0) {
@@ -99,14 +111,20 @@
          /* Set up file descriptor set for select() */
          FD_ZERO(&rfds);
          FD_SET(fd_in, &rfds);
-         FD_SET(inotify_fd, &rfds);
-         int maxfd = (fd_in > inotify_fd ? fd_in : inotify_fd) + 1;
+         FD_SET(wake_fd, &rfds);
+         int maxfd = (fd_in > wake_fd ? fd_in : wake_fd) + 1;
+         
+         /* Also wait for slow watch/status consoles to drain their FIFO */
+         FD_ZERO(&wfds);
+         maxfd = event_stream_fill_wfds(&wfds, maxfd);
+         maxfd = status_stream_fill_wfds(&wfds, maxfd);
          
-         /* Set timeout for select() */
+         /* Set timeout for select(), shorter while the status table lags behind */
          struct timeval tv = { .tv_sec = 1, .tv_usec = 0 };
+         if (status_pending) tv = (struct timeval){ .tv_sec = 0, .tv_usec = 100000 };
          
          /* Wait for events with timeout */
-         int r = select(maxfd, &rfds, NULL, NULL, &tv);
+         int r = select(maxfd, &rfds, &wfds, NULL, &tv);
          if (r < 0) { 
              if (errno == EINTR) continue; /* Interrupted by signal, retry */
              perror("select"); 
@@ -115,30 +133,60 @@
          
          /* Process commands from console */
          if (FD_ISSET(fd_in, &rfds)) {
-             char buf[BUFSIZE];
-             ssize_t n = read(fd_in, buf, BUFSIZE-1);
+             ssize_t n = read(fd_in, cmd_buf + cmd_len, BUFSIZE - 1 - cmd_len);
              if (n > 0) {
-                 buf[n] = 0; /* Null-terminate the buffer */
+                 cmd_len += n;
+                 cmd_buf[cmd_len] = 0; /* Null-terminate the buffer */
                  
-                 /* Process each command (may be multiple commands separated by newlines) */
-                 char *cmd = strtok(buf, "\n");
-                 while (cmd) {
-                     handle_command(cmd, global_fd_out, log_file);
-                     cmd = strtok(NULL, "\n");
+                 /* The console may have connected since the top of the loop */
+                 if (global_fd_out < 0) {
+                     global_fd_out = open("fss_out", O_WRONLY | O_NONBLOCK);
+                 }
+                 
+                 /* Process each complete command; a pipelining client may
+                  * have a command split across two reads */
+                 char *line = cmd_buf, *nl;
+                 while ((nl = strchr(line, '\n'))) {
+                     *nl = 0;
+                     if (*line) handle_command(line, global_fd_out, log_file);
+                     line = nl + 1;
+                 }
+                 cmd_len -= line - cmd_buf;
+                 memmove(cmd_buf, line, cmd_len + 1);
+                 
+                 /* A line that fills the whole buffer is taken as it is */
+                 if (cmd_len == BUFSIZE - 1) {
+                     handle_command(cmd_buf, global_fd_out, log_file);
+                     cmd_len = 0;
                  }
              }
          }
          
-         /* Process inotify events (file system changes) */
-         if (FD_ISSET(inotify_fd, &rfds)) {
+         /* Process events and completions queued by the other threads */
+         if (FD_ISSET(wake_fd, &rfds)) {
+             pipeline_clear_wake();
+             handle_worker_completions(log_file);
              handle_inotify_events(log_file);
          }
+         
+         /* Interval flushes, sync window boundaries and poll rescans */
+         handle_timers(log_file);
+         status_pending = publish_status(log_file);
+         
+         /* Push this iteration's events to watch consoles in one batch */
+         event_stream_flush();
+         status_stream_pump();
      }
      
+     /* Stop the executor and helper threads (flushes pending log lines) */
+     shutdown_executor();
+     pipeline_stop();
+     close_status_table();
+     
      /* Clean up resources before exit */
      close(fd_in);
      if (global_fd_out >= 0) close(global_fd_out);
-     close(inotify_fd);
+     for (int i = 0; i < inotify_shards; i++) close(inotify_fds[i]);
      fclose(log_file);
      unlink("fss_in");
      unlink("fss_out");
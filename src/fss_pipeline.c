@@ -0,0 +1,675 @@
+/**
+ * @file fss_pipeline.c
+ * @brief Implementation of the manager's ingestion and completion threads
+ *
+ * The ingestion threads do nothing but read inotify and push events, so the
+ * kernel queues are drained even while the scheduler is busy forking or
+ * answering the console. Each inotify instance has its own thread and its
+ * own slice of the event arena, so the threads share nothing but the event
+ * queue they push to. The completion thread reads worker pipes while the
+ * workers run (so a chatty worker never blocks on a full pipe), reaps them,
+ * parses their EXEC_REPORT and is the only thread that writes the log file.
+ */
+
+ #include "../include/fss_pipeline.h"
+ #include "../include/fss_logic.h"
+ #include "../include/write_tracker.h"
+ #include "../include/placement.h"
+ #include <stdlib.h>
+ #include <string.h>
+ #include <stdarg.h>
+ #include <errno.h>
+ #include <poll.h>
+ #include <fcntl.h>
+ #include <unistd.h>
+ #include <pthread.h>
+ #include <time.h>
+ #include <sys/wait.h>
+ #include <sys/eventfd.h>
+ #include <sys/inotify.h>
+
+ #define EVENT_ARENA_SIZE (2 * 1024 * 1024)  /**< Bytes of preallocated events (one huge page) */
+
+ /**
+  * -----------------------------------------------------------------------------
+  * Type definitions
+  * -----------------------------------------------------------------------------
+  */
+
+ /**
+  * @struct log_line
+  * @brief A formatted log line waiting for the logging thread
+  */
+ typedef struct log_line {
+     mpsc_node_t node;  /**< Queue link */
+     char text[];       /**< NUL-terminated line */
+ } log_line_t;
+
+ /**
+  * @struct ingest_shard
+  * @brief One inotify instance and the thread draining it
+  */
+ typedef struct ingest_shard {
+     int fd;                 /**< Non-blocking inotify instance */
+     int index;              /**< Position in shards[] (fss_event_t.shard) */
+     pthread_t thread;       /**< Ingestion thread */
+     mpsc_queue_t free;      /**< Free arena events: scheduler -> this thread */
+ } ingest_shard_t;
+
+ /**
+  * @struct watched_worker
+  * @brief A running worker whose output the completion thread collects
+  */
+ typedef struct watched_worker {
+     mpsc_node_t node;           /**< Queue link (registration only) */
+     pid_t pid;                  /**< Process ID of the worker */
+     int pipe_fd;                /**< Read end of the worker's stdout */
+     char source_dir[PATH_MAX];  /**< Source directory */
+     char target_dir[PATH_MAX];  /**< Target directory */
+     char operation[20];         /**< Operation being performed */
+     char* out;                  /**< Output collected so far */
+     size_t out_len;             /**< Bytes in out */
+     size_t out_cap;             /**< Capacity of out */
+ } watched_worker_t;
+
+ /**
+  * -----------------------------------------------------------------------------
+  * Static state
+  * -----------------------------------------------------------------------------
+  */
+ static mpsc_queue_t event_queue;       /**< ingestion -> scheduler */
+ static mpsc_queue_t completion_queue;  /**< completion -> scheduler */
+ static mpsc_queue_t worker_queue;      /**< scheduler -> completion */
+ static mpsc_queue_t log_queue;         /**< any thread -> logging */
+
+ static int sched_wake_fd = -1;        /**< Wakes the scheduler */
+ static int completion_wake_fd = -1;   /**< Wakes the completion thread */
+ static atomic_int log_pending;        /**< Set while a log wake-up is outstanding */
+
+ static ingest_shard_t shards[PIPELINE_MAX_SHARDS];  /**< inotify instances being drained */
+ static int shard_count = 0;           /**< Entries used in shards[] */
+ static FILE* pipe_log_file = NULL;    /**< Log file owned by the logging thread */
+ static atomic_int pipeline_running;   /**< Threads keep looping while set */
+ static pthread_t completion_thread;
+
+ static placement_buf_t event_arena;   /**< Preallocated fss_event_t slab */
+ static size_t events_per_shard = 0;   /**< Arena events in each shard's slice */
+ static int arena_huge = 0;             /**< Back the arena with huge pages */
+
+ static atomic_ulong events_ingested;  /**< Events pushed by the ingestion thread */
+ static atomic_ulong overflows;        /**< IN_Q_OVERFLOW events seen */
+
+ /**
+  * -----------------------------------------------------------------------------
+  * Helper functions
+  * -----------------------------------------------------------------------------
+  */
+
+ /**
+  * @brief Check whether an event was carved from the arena
+  *
+  * @param e Event
+  * @return 1 if e lives in the arena, 0 if it was malloc()ed
+  */
+ static int in_arena(const fss_event_t* e) {
+     const char* p = (const char*)e;
+     return event_arena.data && p >= (char*)event_arena.data &&
+            p < (char*)event_arena.data + event_arena.size;
+ }
+
+ /**
+  * @brief Get an event to fill (the shard's ingestion thread only)
+  *
+  * Takes a free event from the shard's arena slice, or falls back to
+  * malloc() when a burst has used them all.
+  *
+  * @param shard Shard of the calling thread
+  * @return Event
+  */
+ static fss_event_t* alloc_event(ingest_shard_t* shard) {
+     mpsc_node_t* n = mpsc_pop(&shard->free);
+     if (n) return mpsc_entry(n, fss_event_t, node);
+     return malloc(sizeof(fss_event_t));
+ }
+
+ /**
+  * @brief Free an event whatever it came from
+  *
+  * An arena event goes back to the free list of the shard whose slice
+  * it lies in.
+  *
+  * @param e Event
+  */
+ static void free_event(fss_event_t* e) {
+     if (in_arena(e)) {
+         size_t i = (size_t)(e - (fss_event_t*)event_arena.data) / events_per_shard;
+         mpsc_push(&shards[i].free, &e->node);
+     } else {
+         free(e);
+     }
+ }
+
+ /**
+  * @brief Carve the event arena into one slice per shard and fill their free lists
+  */
+ static void arena_init(void) {
+     for (int i = 0; i < shard_count; i++) mpsc_init(&shards[i].free);
+     if (placement_buf_alloc(&event_arena, EVENT_ARENA_SIZE, arena_huge) < 0) {
+         event_arena.data = NULL;  /* Every event comes from malloc() */
+         return;
+     }
+     fss_event_t* slab = event_arena.data;
+     events_per_shard = EVENT_ARENA_SIZE / sizeof(fss_event_t) / shard_count;
+     for (int s = 0; s < shard_count; s++)
+         for (size_t i = 0; i < events_per_shard; i++)
+             mpsc_push(&shards[s].free, &slab[s * events_per_shard + i].node);
+ }
+
+ /**
+  * @brief Signal an eventfd
+  *
+  * @param fd eventfd to increment
+  */
+ static void wake(int fd) {
+     uint64_t one = 1;
+     if (write(fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+         perror("eventfd write");
+ }
+
+ /**
+  * @brief Reset an eventfd counter
+  *
+  * @param fd eventfd to drain
+  */
+ static void drain_wake(int fd) {
+     uint64_t v;
+     while (read(fd, &v, sizeof(v)) > 0) {}
+ }
+
+ /**
+  * @brief Write every queued log line and flush once
+  */
+ static void drain_log_queue() {
+     atomic_store(&log_pending, 0);
+
+     mpsc_node_t* n;
+     int wrote = 0;
+     while ((n = mpsc_pop(&log_queue))) {
+         log_line_t* l = mpsc_entry(n, log_line_t, node);
+         if (pipe_log_file) fputs(l->text, pipe_log_file);
+         free(l);
+         wrote = 1;
+     }
+     if (wrote && pipe_log_file) fflush(pipe_log_file);
+ }
+
+ /**
+  * @brief Parse a worker's EXEC_REPORT into a completion record
+  *
+  * WROTE lines before the report are fed to the write tracker, before the
+  * completion is posted, so the task's own events stay recognisable after
+  * the scheduler retires it.
+  *
+  * @param out NUL-terminated worker output (modified in place)
+  * @param c Completion to fill in
+  */
+ static void parse_report(char* out, worker_completion_t* c) {
+     int inrep = 0;
+     char* save = NULL;
+
+     strcpy(c->status, "UNKNOWN");
+     c->details[0] = '\0';
+     c->bytes = 0;
+
+     for (char* line = strtok_r(out, "\n", &save); line;
+          line = strtok_r(NULL, "\n", &save)) {
+         if (!strcmp(line, "EXEC_REPORT_START")) {
+             inrep = 1;  /* Start of report */
+         } else if (!strcmp(line, "EXEC_REPORT_END")) {
+             inrep = 0;  /* End of report */
+         } else if (!strncmp(line, "WROTE: ", 7)) {
+             /* A file the worker wrote into a watched directory */
+             unsigned long dev, ino;
+             struct timespec mtime;
+             if (sscanf(line + 7, "%lu %lu %ld %ld", &dev, &ino,
+                        &mtime.tv_sec, &mtime.tv_nsec) == 4)
+                 write_tracker_record((dev_t)dev, (ino_t)ino, &mtime);
+         } else if (inrep) {
+             /* Extract status and details from report */
+             if (!strncmp(line, "STATUS: ", 8))
+                 snprintf(c->status, sizeof(c->status), "%s", line + 8);
+             if (!strncmp(line, "DETAILS:", 8))
+                 snprintf(c->details, sizeof(c->details), "%s", line + 8);
+             if (!strncmp(line, "BYTES: ", 7))
+                 c->bytes = strtoull(line + 7, NULL, 10);
+         }
+     }
+ }
+
+ /**
+  * @brief Reap a worker whose pipe reached EOF and report its result
+  *
+  * @param w Worker to finish (freed by this function)
+  */
+ static void finish_worker(watched_worker_t* w) {
+     close(w->pipe_fd);
+     waitpid(w->pid, NULL, 0);
+     DBG("completion: reaped %d\n", w->pid);
+
+     worker_completion_t c;
+     if (w->out) {
+         w->out[w->out_len] = '\0';
+         parse_report(w->out, &c);
+     } else {
+         char empty[1] = "";
+         parse_report(empty, &c);
+     }
+
+     pipeline_post_completion(w->pid, w->source_dir, w->target_dir,
+                              w->operation, c.status, c.details, c.bytes);
+
+     free(w->out);
+     free(w);
+ }
+
+ /**
+  * @brief Read everything currently available from a worker pipe
+  *
+  * @param w Worker to read from
+  * @return 1 if the pipe reached EOF, 0 otherwise
+  */
+ static int read_worker_output(watched_worker_t* w) {
+     for (;;) {
+         if (w->out_cap - w->out_len < 1024) {
+             w->out_cap = w->out_cap ? w->out_cap * 2 : 4096;
+             w->out = realloc(w->out, w->out_cap);
+         }
+         ssize_t n = read(w->pipe_fd, w->out + w->out_len, w->out_cap - w->out_len - 1);
+         if (n > 0) {
+             w->out_len += n;
+             continue;
+         }
+         if (n == 0) return 1;
+         if (errno == EINTR) continue;
+         if (errno == EAGAIN) return 0;
+         return 1;  /* Treat other errors as EOF */
+     }
+ }
+
+ /**
+  * -----------------------------------------------------------------------------
+  * Thread bodies
+  * -----------------------------------------------------------------------------
+  */
+
+ /**
+  * @brief Ingestion thread: drain one inotify instance into the event queue
+  *
+  * Reads as many events as fit in one buffer per wake-up and signals the
+  * scheduler once per batch rather than once per event.
+  *
+  * @param arg Shard to drain
+  */
+ static void* ingest_main(void* arg) {
+     ingest_shard_t* shard = arg;
+     char buf[64 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+     struct pollfd pfd = { .fd = shard->fd, .events = POLLIN };
+
+     while (atomic_load(&pipeline_running)) {
+         int r = poll(&pfd, 1, 200);
+         if (r <= 0) continue;  /* Timeout or EINTR: re-check running */
+
+         ssize_t len = read(shard->fd, buf, sizeof(buf));
+         if (len <= 0) continue;
+
+         unsigned long batch = 0;
+         for (char* p = buf; p < buf + len; ) {
+             struct inotify_event* ev = (void*)p;
+             fss_event_t* e = alloc_event(shard);
+             e->shard = shard->index;
+             e->wd = ev->wd;
+             e->mask = ev->mask;
+             e->cookie = ev->cookie;
+             if (ev->len > 0) snprintf(e->name, sizeof(e->name), "%s", ev->name);
+             else e->name[0] = '\0';
+             if (ev->mask & IN_Q_OVERFLOW) atomic_fetch_add(&overflows, 1);
+
+             mpsc_push(&event_queue, &e->node);
+             batch++;
+             p += sizeof(*ev) + ev->len;
+         }
+
+         atomic_fetch_add(&events_ingested, batch);
+         wake(sched_wake_fd);
+     }
+     return NULL;
+ }
+
+ /**
+  * @brief Completion/logging thread
+  *
+  * Waits on its wake-up eventfd and on every running worker's pipe. Log lines
+  * are written in batches with a single flush.
+  */
+ static void* completion_main(void* arg) {
+     (void)arg;
+     watched_worker_t** workers = NULL;
+     struct pollfd* pfds = NULL;
+     int count = 0, cap = 0;
+
+     for (;;) {
+         int stopping = !atomic_load(&pipeline_running);
+
+         /* Write pending log lines before anything that logs directly */
+         drain_log_queue();
+
+         /* Pick up newly started workers */
+         mpsc_node_t* n;
+         while ((n = mpsc_pop(&worker_queue))) {
+             if (count == cap) {
+                 cap = cap ? cap * 2 : 16;
+                 workers = realloc(workers, cap * sizeof(*workers));
+                 pfds = realloc(pfds, (cap + 1) * sizeof(*pfds));
+             }
+             watched_worker_t* w = mpsc_entry(n, watched_worker_t, node);
+             fcntl(w->pipe_fd, F_SETFL, O_NONBLOCK);
+             workers[count++] = w;
+         }
+
+         if (stopping && count == 0) break;
+
+         /* Wait for output, worker exit or a wake-up */
+         if (!pfds) pfds = malloc(sizeof(*pfds));
+         pfds[0].fd = completion_wake_fd;
+         pfds[0].events = POLLIN;
+         for (int i = 0; i < count; i++) {
+             pfds[i + 1].fd = workers[i]->pipe_fd;
+             pfds[i + 1].events = POLLIN;
+             pfds[i + 1].revents = 0;
+         }
+         int r = poll(pfds, count + 1, 200);
+         if (r < 0 && errno != EINTR) {
+             perror("poll");
+             continue;
+         }
+         if (r <= 0) continue;
+
+         if (pfds[0].revents & POLLIN) drain_wake(completion_wake_fd);
+
+         /* Collect output; finish workers whose pipe closed */
+         for (int i = count - 1; i >= 0; i--) {
+             if (!pfds[i + 1].revents) continue;
+             if (read_worker_output(workers[i])) {
+                 finish_worker(workers[i]);
+                 workers[i] = workers[--count];
+             }
+         }
+     }
+
+     drain_log_queue();
+     free(workers);
+     free(pfds);
+     return NULL;
+ }
+
+ /**
+  * -----------------------------------------------------------------------------
+  * Public API Implementation
+  * -----------------------------------------------------------------------------
+  */
+
+ /**
+  * @brief Start the ingestion and completion/logging threads
+  *
+  * @param inotify_fds Non-blocking inotify instances to drain, one thread each
+  * @param n Number of instances (1 to PIPELINE_MAX_SHARDS)
+  * @param log_file Log file written by the logging thread (may be NULL)
+  */
+ void pipeline_start(const int* inotify_fds, int n, FILE* log_file) {
+     shard_count = n;
+     for (int i = 0; i < n; i++) {
+         shards[i].fd = inotify_fds[i];
+         shards[i].index = i;
+     }
+     mpsc_init(&event_queue);
+     mpsc_init(&completion_queue);
+     mpsc_init(&worker_queue);
+     mpsc_init(&log_queue);
+     arena_init();
+
+     sched_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+     completion_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+     if (sched_wake_fd < 0 || completion_wake_fd < 0) {
+         perror("eventfd");
+         exit(EXIT_FAILURE);
+     }
+
+     pipe_log_file = log_file;
+     atomic_store(&pipeline_running, 1);
+
+     for (int i = 0; i < n; i++) {
+         if (pthread_create(&shards[i].thread, NULL, ingest_main, &shards[i])) {
+             perror("pthread_create");
+             exit(EXIT_FAILURE);
+         }
+     }
+     if (pthread_create(&completion_thread, NULL, completion_main, NULL)) {
+         perror("pthread_create");
+         exit(EXIT_FAILURE);
+     }
+ }
+
+ /**
+  * @brief Stop both threads and flush any pending log lines
+  *
+  * The completion thread keeps running until every registered worker has
+  * been reaped, so no result is lost.
+  */
+ void pipeline_stop(void) {
+     if (!atomic_exchange(&pipeline_running, 0)) return;
+
+     wake(completion_wake_fd);
+     for (int i = 0; i < shard_count; i++) pthread_join(shards[i].thread, NULL);
+     pthread_join(completion_thread, NULL);
+     pipe_log_file = NULL;
+
+     /* Free anything the scheduler never consumed */
+     mpsc_node_t* n;
+     while ((n = mpsc_pop(&event_queue))) free_event(mpsc_entry(n, fss_event_t, node));
+     while ((n = mpsc_pop(&completion_queue))) free(mpsc_entry(n, worker_completion_t, node));
+
+     placement_buf_free(&event_arena);
+
+     close(sched_wake_fd);
+     close(completion_wake_fd);
+     sched_wake_fd = completion_wake_fd = -1;
+ }
+
+ /**
+  * @brief Get the descriptor the scheduler should wait on
+  *
+  * @return eventfd descriptor
+  */
+ int pipeline_wake_fd(void) {
+     return sched_wake_fd;
+ }
+
+ /**
+  * @brief Reset the scheduler's wake descriptor after it fired
+  */
+ void pipeline_clear_wake(void) {
+     drain_wake(sched_wake_fd);
+ }
+
+ /**
+  * @brief Pop the next inotify event
+  *
+  * @return Event, or NULL if none is queued
+  */
+ fss_event_t* pipeline_next_event(void) {
+     mpsc_node_t* n = mpsc_pop(&event_queue);
+     return n ? mpsc_entry(n, fss_event_t, node) : NULL;
+ }
+
+ /**
+  * @brief Give a processed event back to the event arena
+  *
+  * @param e Event from pipeline_next_event()
+  */
+ void pipeline_release_event(fss_event_t* e) {
+     free_event(e);
+ }
+
+ /**
+  * @brief Back the event arena with huge pages
+  *
+  * @param on Non-zero to request huge pages
+  */
+ void pipeline_use_huge_pages(int on) {
+     arena_huge = on;
+ }
+
+ /**
+  * @brief Pop the next worker completion
+  *
+  * @return Completion, or NULL if none is queued
+  */
+ worker_completion_t* pipeline_next_completion(void) {
+     mpsc_node_t* n = mpsc_pop(&completion_queue);
+     return n ? mpsc_entry(n, worker_completion_t, node) : NULL;
+ }
+
+ /**
+  * @brief Hand a freshly started worker to the completion thread
+  *
+  * @param pid Process ID of the worker
+  * @param pipe_fd Read end of the worker's stdout pipe
+  * @param src Source directory path
+  * @param dst Target directory path
+  * @param op Operation type
+  */
+ void pipeline_watch_worker(pid_t pid, int pipe_fd, const char* src,
+                            const char* dst, const char* op) {
+     watched_worker_t* w = calloc(1, sizeof(*w));
+     w->pid = pid;
+     w->pipe_fd = pipe_fd;
+     snprintf(w->source_dir, sizeof(w->source_dir), "%s", src);
+     snprintf(w->target_dir, sizeof(w->target_dir), "%s", dst);
+     snprintf(w->operation, sizeof(w->operation), "%s", op);
+
+     mpsc_push(&worker_queue, &w->node);
+     wake(completion_wake_fd);
+ }
+
+ /**
+  * @brief Report a finished task to the scheduler
+  *
+  * @param id Worker process ID (or in-process task ID)
+  * @param src Source directory path
+  * @param dst Target directory path
+  * @param op Operation type
+  * @param status Result status
+  * @param details Result details
+  * @param bytes Bytes written into the target
+  */
+ void pipeline_post_completion(pid_t id, const char* src, const char* dst,
+                               const char* op, const char* status, const char* details,
+                               unsigned long long bytes) {
+     /* Log the completion and result */
+     if (pipe_log_file) {
+         char ts[32];
+         time_t now = time(NULL);
+         struct tm tm_info;
+         strftime(ts, sizeof(ts), "[%Y-%m-%d %H:%M:%S]", localtime_r(&now, &tm_info));
+         fss_log(pipe_log_file, "%s [%s] [%s] [%d] [%s] [%s] [%s]\n",
+                 ts, src, dst, id, op, status, details);
+     }
+
+     worker_completion_t* c = malloc(sizeof(*c));
+     c->pid = id;
+     snprintf(c->status, sizeof(c->status), "%s", status);
+     snprintf(c->details, sizeof(c->details), "%s", details);
+     c->bytes = bytes;
+
+     mpsc_push(&completion_queue, &c->node);
+     wake(sched_wake_fd);
+ }
+
+ /**
+  * @brief Queue an event that did not come from inotify (any thread)
+  *
+  * Always allocated with malloc(): the arena's free list has a single
+  * consumer, the ingestion thread.
+  *
+  * @param wd Watch descriptor the scheduler maps the event to
+  * @param mask inotify-style event mask
+  * @param name Name of the affected entry ("" if none)
+  */
+ void pipeline_post_event(int wd, uint32_t mask, const char* name) {
+     fss_event_t* e = malloc(sizeof(*e));
+     e->shard = -1;
+     e->wd = wd;
+     e->mask = mask;
+     e->cookie = 0;
+     snprintf(e->name, sizeof(e->name), "%s", name);
+     mpsc_push(&event_queue, &e->node);
+ }
+
+ /**
+  * @brief Wake the scheduler to drain what was queued (any thread)
+  */
+ void pipeline_wake_scheduler(void) {
+     wake(sched_wake_fd);
+ }
+
+ /**
+  * @brief Write a line to the log file
+  *
+  * @param log_file Log file to write to
+  * @param fmt printf-style format string
+  */
+ void fss_log(FILE* log_file, const char* fmt, ...) {
+     va_list ap;
+
+     /* Synchronous path: no logging thread for this file */
+     if (!atomic_load(&pipeline_running) || log_file != pipe_log_file) {
+         va_start(ap, fmt);
+         vfprintf(log_file, fmt, ap);
+         va_end(ap);
+         fflush(log_file);
+         return;
+     }
+
+     va_start(ap, fmt);
+     int len = vsnprintf(NULL, 0, fmt, ap);
+     va_end(ap);
+     if (len < 0) return;
+
+     log_line_t* l = malloc(sizeof(*l) + len + 1);
+     va_start(ap, fmt);
+     vsnprintf(l->text, len + 1, fmt, ap);
+     va_end(ap);
+
+     mpsc_push(&log_queue, &l->node);
+
+     /* One wake-up covers every line queued until the thread drains */
+     if (!atomic_exchange(&log_pending, 1)) wake(completion_wake_fd);
+ }
+
+ /**
+  * @brief Total number of inotify events ingested so far
+  *
+  * @return Event count
+  */
+ unsigned long pipeline_events_ingested(void) {
+     return atomic_load(&events_ingested);
+ }
+
+ /**
+  * @brief Number of inotify queue overflows seen so far
+  *
+  * @return Overflow count
+  */
+ unsigned long pipeline_overflows(void) {
+     return atomic_load(&overflows);
+ }
@@ -0,0 +1,112 @@
+/**
+ * @file fss_purge.c
+ * @brief Command-line tool for deleting large backup targets
+ *
+ * Replaces the single-threaded "rm -rf" of fss_script.sh purge. The tree is
+ * deleted by the parallel purge engine; with -a it is first renamed aside,
+ * so it vanishes from its old path at once, and with -b the space is then
+ * reclaimed by a detached background process, optionally rate limited.
+ */
+
+ #include "../include/purge.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <string.h>
+ #include <unistd.h>
+ #include <fcntl.h>
+ #include <time.h>
+ #include <linux/limits.h>
+
+ /**
+  * @brief Print usage and exit
+  *
+  * @param prog Program name
+  */
+ static void usage(const char* prog) {
+     fprintf(stderr, "Usage: %s [-t threads] [-r unlinks_per_sec] [-a] [-b] <path>\n"
+                     "  -t  parallel walker threads (default 4)\n"
+                     "  -r  rate limit in unlinks per second (default unlimited)\n"
+                     "  -a  rename the path aside first so it disappears immediately\n"
+                     "  -b  delete in the background (implies -a)\n", prog);
+     exit(EXIT_FAILURE);
+ }
+
+ /**
+  * @brief Main entry point for fss_purge
+  *
+  * @param argc Argument count
+  * @param argv Argument vector
+  * @return EXIT_SUCCESS if everything was removed, EXIT_FAILURE otherwise
+  */
+ int main(int argc, char* argv[]) {
+     purge_opts_t opts = { .threads = 4, .rate = 0 };
+     int aside = 0, background = 0, opt;
+     char* end;
+
+     while ((opt = getopt(argc, argv, "t:r:ab")) != -1) {
+         switch (opt) {
+             case 't':
+                 opts.threads = strtol(optarg, &end, 10);
+                 if (*end || opts.threads < 1) usage(argv[0]);
+                 break;
+             case 'r':
+                 opts.rate = strtol(optarg, &end, 10);
+                 if (*end || opts.rate < 0) usage(argv[0]);
+                 break;
+             case 'a': aside = 1; break;
+             case 'b': background = aside = 1; break;
+             default: usage(argv[0]);
+         }
+     }
+     if (optind != argc - 1) usage(argv[0]);
+
+     const char* path = argv[optind];
+     char moved[PATH_MAX];
+
+     /* Make the path disappear for the user before any deletion starts */
+     if (aside) {
+         if (purge_rename_aside(path, moved, sizeof(moved)) < 0) {
+             perror(path);
+             return EXIT_FAILURE;
+         }
+         printf("Renamed %s to %s\n", path, moved);
+         path = moved;
+     }
+
+     /* Detach and reclaim the space in the background */
+     if (background) {
+         fflush(stdout);
+         pid_t pid = fork();
+         if (pid < 0) {
+             perror("fork");
+             return EXIT_FAILURE;
+         }
+         if (pid > 0) {
+             printf("Deleting in background (pid %d)\n", pid);
+             return EXIT_SUCCESS;
+         }
+         setsid();
+         int devnull = open("/dev/null", O_RDWR);
+         if (devnull >= 0) {
+             dup2(devnull, STDIN_FILENO);
+             dup2(devnull, STDOUT_FILENO);
+             dup2(devnull, STDERR_FILENO);
+             if (devnull > STDERR_FILENO) close(devnull);
+         }
+     }
+
+     struct timespec t0, t1;
+     clock_gettime(CLOCK_MONOTONIC, &t0);
+     purge_stats_t stats;
+     int rc = purge_tree(path, &opts, &stats);
+     clock_gettime(CLOCK_MONOTONIC, &t1);
+
+     if (rc < 0 && stats.files == 0 && stats.dirs == 0 && stats.errors == 0) {
+         perror(path);
+         return EXIT_FAILURE;
+     }
+     printf("Removed %lu files and %lu directories in %.2fs (%lu errors)\n",
+            stats.files, stats.dirs,
+            (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9, stats.errors);
+     return rc < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+ }
@@ -0,0 +1,77 @@
+/**
+ * @file fss_stat.c
+ * @brief Command-line tool for reading the manager's shared status table
+ *
+ * Prints the state of one source, or of every source, as tab-separated
+ * lines. It maps the table read-only and never talks to the manager, so
+ * monitoring scripts can poll it as often as they like.
+ */
+
+ #include "../include/status_shm.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <string.h>
+ #include <unistd.h>
+
+ #define STALE_MS 5000  /**< Heartbeat age after which the manager looks gone */
+
+ /**
+  * @brief Print usage and exit
+  *
+  * @param prog Program name
+  */
+ static void usage(const char* prog) {
+     fprintf(stderr, "Usage: %s [-H] [-f table] [source]\n"
+                     "  -H        omit the header line\n"
+                     "  -f table  status table file (default %s)\n", prog, STATUS_SHM_FILE);
+     exit(EXIT_FAILURE);
+ }
+
+ /**
+  * @brief Main entry point for fss_stat
+  *
+  * @param argc Argument count
+  * @param argv Argument vector
+  * @return EXIT_SUCCESS on success, EXIT_FAILURE if there is no table or no such source
+  */
+ int main(int argc, char* argv[]) {
+     const char* path = STATUS_SHM_FILE;
+     int header = 1, opt;
+
+     while ((opt = getopt(argc, argv, "Hf:")) != -1) {
+         if (opt == 'H') header = 0;
+         else if (opt == 'f') path = optarg;
+         else usage(argv[0]);
+     }
+     if (argc - optind > 1) usage(argv[0]);
+     const char* source = optind < argc ? argv[optind] : NULL;
+
+     status_shm_t* table = status_shm_open(path);
+     if (!table) {
+         fprintf(stderr, "fss_stat: %s: no status table\n", path);
+         return EXIT_FAILURE;
+     }
+     int64_t age = status_shm_age_ms(table);
+     if (age < 0 || age > STALE_MS)
+         fprintf(stderr, "fss_stat: warning: the manager has not updated %s recently\n", path);
+
+     status_record_t rec;
+     char line[PATH_MAX * 2 + 256];
+     int64_t now = status_shm_now_ms();
+     int rc = EXIT_SUCCESS;
+     if (header) fputs(status_shm_fields(), stdout);
+     if (!source) {
+         for (unsigned i = 0; status_shm_read(table, i, &rec) == 0; i++) {
+             status_shm_format(&rec, now, line, sizeof(line));
+             fputs(line, stdout);
+         }
+     } else if (status_shm_find(table, source, &rec) == 0) {
+         status_shm_format(&rec, now, line, sizeof(line));
+         fputs(line, stdout);
+     } else {
+         fprintf(stderr, "fss_stat: %s: not monitored\n", source);
+         rc = EXIT_FAILURE;
+     }
+     status_shm_close(table, 0);
+     return rc;
+ }
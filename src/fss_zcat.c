@@ -0,0 +1,102 @@
+/**
+ * @file fss_zcat.c
+ * @brief Command-line tool for reading files from compressed targets
+ *
+ * Writes the uncompressed contents of a file synced with compress=1 to
+ * stdout, or only a byte range of it; a range is served by decompressing
+ * just the chunks that cover it.
+ */
+
+ #include "../include/zfile.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <string.h>
+ #include <errno.h>
+ #include <unistd.h>
+ #include <fcntl.h>
+
+ #define ZCAT_BUFFER (64 * 1024)  /**< Bytes decompressed per write */
+
+ /**
+  * @brief Print usage and exit
+  *
+  * @param prog Program name
+  */
+ static void usage(const char* prog) {
+     fprintf(stderr, "Usage: %s [-i] <file> [offset [length]]\n"
+                     "  -i  print the file's size, chunk size and chunk count instead\n", prog);
+     exit(EXIT_FAILURE);
+ }
+
+ /**
+  * @brief Main entry point for fss_zcat
+  *
+  * @param argc Argument count
+  * @param argv Argument vector
+  * @return EXIT_SUCCESS on success, EXIT_FAILURE otherwise
+  */
+ int main(int argc, char* argv[]) {
+     int info = 0, opt;
+     char* end;
+
+     while ((opt = getopt(argc, argv, "i")) != -1) {
+         if (opt == 'i') info = 1;
+         else usage(argv[0]);
+     }
+     if (optind >= argc || argc - optind > 3) usage(argv[0]);
+
+     const char* path = argv[optind];
+     long long off = 0, len = -1;
+     if (argc - optind > 1) {
+         off = strtoll(argv[optind + 1], &end, 10);
+         if (*end || off < 0) usage(argv[0]);
+     }
+     if (argc - optind > 2) {
+         len = strtoll(argv[optind + 2], &end, 10);
+         if (*end || len < 0) usage(argv[0]);
+     }
+
+     int fd = open(path, O_RDONLY);
+     if (fd < 0) {
+         fprintf(stderr, "fss_zcat: %s: %s\n", path, strerror(errno));
+         return EXIT_FAILURE;
+     }
+     zfile_t z;
+     if (zfile_open(&z, fd) < 0) {
+         fprintf(stderr, "fss_zcat: %s: not a compressed target file\n", path);
+         close(fd);
+         return EXIT_FAILURE;
+     }
+
+     int rc = EXIT_SUCCESS;
+     if (info) {
+         struct zfile_footer* f = &z.footer;
+         printf("size=%llu chunk_size=%u chunks=%llu stored=%llu\n",
+                (unsigned long long)f->size, f->chunk_size, (unsigned long long)f->chunks,
+                (unsigned long long)(f->index_off + f->chunks * sizeof(zfile_chunk_t) +
+                                     sizeof(zfile_footer_t)));
+     } else {
+         char* buf = malloc(ZCAT_BUFFER);
+         while (buf && (len < 0 || len > 0)) {
+             size_t want = len < 0 || len > ZCAT_BUFFER ? ZCAT_BUFFER : (size_t)len;
+             ssize_t n = zfile_pread(&z, buf, want, off);
+             if (n < 0) {
+                 fprintf(stderr, "fss_zcat: %s: corrupt chunk near offset %lld\n", path, off);
+                 rc = EXIT_FAILURE;
+                 break;
+             }
+             if (n == 0) break;
+             if (fwrite(buf, 1, n, stdout) != (size_t)n) {
+                 rc = EXIT_FAILURE;
+                 break;
+             }
+             off += n;
+             if (len > 0) len -= n;
+         }
+         free(buf);
+     }
+
+     zfile_close(&z);
+     close(fd);
+     return rc;
+ }
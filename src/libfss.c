@@ -0,0 +1,563 @@
+/**
+ * @file libfss.c
+ * @brief Implementation of the control protocol client library
+ *
+ * Requests move through two lists: queued (submitted, not written yet) and
+ * sent (written, reply not complete yet). Both FIFOs are non-blocking. A
+ * command line is at most PIPE_BUF bytes, so each write() either sends it
+ * whole or fails with EAGAIN, and the manager never reads half a command.
+ * Incoming bytes are split into lines; the lines of the oldest sent request
+ * collect in a reply buffer until its end line arrives.
+ */
+
+ #include "../include/libfss.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <string.h>
+ #include <errno.h>
+ #include <fcntl.h>
+ #include <poll.h>
+ #include <time.h>
+ #include <unistd.h>
+ #include <limits.h>
+ #include <sys/stat.h>
+
+ #define CLIENT_INBUF 8192          /**< Bytes of a partial incoming line kept */
+ #define CONNECT_MAX_BACKOFF_MS 50  /**< Longest sleep between checks for the FIFOs */
+
+ /**
+  * @struct fss_request
+  * @brief One submitted command
+  */
+ typedef struct fss_request {
+     struct fss_request* next;      /**< Next request in its list */
+     char tag[32];                  /**< "<pid>.<seq>" */
+     char line[PIPE_BUF];           /**< "@<tag> <command>\n" */
+     size_t len;                    /**< Bytes in line */
+     int exclusive;                 /**< Must be the only request in flight */
+     int expired;                   /**< Callback already ran with FSS_REPLY_TIMEOUT */
+     long long deadline;            /**< When it times out (-1 = never) */
+     fss_reply_fn fn;               /**< Reply callback */
+     void* ctx;                     /**< Its context */
+ } fss_request_t;
+
+ /**
+  * @struct fss_client
+  * @brief Connection state
+  */
+ struct fss_client {
+     int fd_in;                     /**< Write end of fss_in */
+     int fd_out;                    /**< Read end of fss_out */
+     int broken;                    /**< The manager went away */
+     int want_write;                /**< fss_in was full at the last write */
+     unsigned long seq;             /**< Last request number */
+     fss_request_t* queued;         /**< Not written yet, oldest first */
+     fss_request_t** queued_tail;   /**< Where the next queued request goes */
+     fss_request_t* sent;           /**< Awaiting their end line, oldest first */
+     fss_request_t** sent_tail;     /**< Where the next sent request goes */
+     size_t nsent;                  /**< Requests in the sent list */
+     size_t exclusive_sent;         /**< Exclusive requests in the sent list */
+     size_t live;                   /**< Requests whose callback has not run */
+     char in[CLIENT_INBUF];         /**< Start of an incomplete line */
+     size_t in_len;                 /**< Bytes in in */
+     char* reply;                   /**< Lines of the oldest sent request */
+     size_t reply_len;              /**< Bytes in reply */
+     size_t reply_cap;              /**< Size of reply */
+     fss_event_fn on_event;         /**< Event handler */
+     void* event_ctx;               /**< Its context */
+ };
+
+ /**
+  * @brief Current monotonic time in milliseconds
+  *
+  * @return Milliseconds
+  */
+ static long long now_ms() {
+     struct timespec ts;
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+ }
+
+ /**
+  * @brief Turn a relative timeout into a deadline
+  *
+  * @param timeout_ms Timeout (negative = none)
+  * @return Deadline, or -1 for none
+  */
+ static long long deadline_after(int timeout_ms) {
+     return timeout_ms < 0 ? -1 : now_ms() + timeout_ms;
+ }
+
+ /**
+  * @brief Milliseconds left until a deadline, for poll()
+  *
+  * @param deadline Deadline (-1 = none)
+  * @return Milliseconds (0 if passed), or -1 for no deadline
+  */
+ static int ms_until(long long deadline) {
+     if (deadline < 0) return -1;
+     long long left = deadline - now_ms();
+     return left < 0 ? 0 : left > INT_MAX ? INT_MAX : (int)left;
+ }
+
+ /**
+  * @brief Connect to the manager
+  *
+  * @param dir Directory holding fss_in and fss_out (NULL for the current one)
+  * @param timeout_ms How long to wait for the FIFOs (negative = forever)
+  * @return Connection, or NULL on error (errno set)
+  */
+ fss_client_t* fss_connect(const char* dir, int timeout_ms) {
+     char in_path[PATH_MAX], out_path[PATH_MAX];
+     snprintf(in_path, sizeof(in_path), "%s/fss_in", dir ? dir : ".");
+     snprintf(out_path, sizeof(out_path), "%s/fss_out", dir ? dir : ".");
+
+     /* Wait for the manager, checking often at first: it is usually up already */
+     long long deadline = deadline_after(timeout_ms);
+     int backoff = 1, fd_in = -1, fd_out = -1;
+     while (1) {
+         struct stat st;
+         if (fd_out < 0 && stat(out_path, &st) == 0 && S_ISFIFO(st.st_mode))
+             fd_out = open(out_path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+         /* ENXIO: the manager has not opened fss_in for reading yet */
+         if (fd_out >= 0 && stat(in_path, &st) == 0 && S_ISFIFO(st.st_mode))
+             fd_in = open(in_path, O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+         if (fd_in >= 0) break;
+         if (errno != ENOENT && errno != ENXIO) {
+             int err = errno;
+             if (fd_out >= 0) close(fd_out);
+             errno = err;
+             return NULL;
+         }
+         if (deadline >= 0 && now_ms() >= deadline) {
+             if (fd_out >= 0) close(fd_out);
+             errno = ETIMEDOUT;
+             return NULL;
+         }
+         usleep(backoff * 1000);
+         if (backoff < CONNECT_MAX_BACKOFF_MS) backoff *= 2;
+     }
+
+     /* Discard output left over from an earlier client */
+     char junk[4096];
+     while (read(fd_out, junk, sizeof(junk)) > 0) {}
+
+     fss_client_t* c = calloc(1, sizeof(*c));
+     c->fd_in = fd_in;
+     c->fd_out = fd_out;
+     c->queued_tail = &c->queued;
+     c->sent_tail = &c->sent;
+     return c;
+ }
+
+ /**
+  * @brief Run a request's callback once
+  *
+  * @param c Connection
+  * @param r Request
+  * @param status Outcome
+  * @param reply Reply text ("" unless status is FSS_REPLY_OK)
+  */
+ static void finish(fss_client_t* c, fss_request_t* r, fss_reply_status_t status, const char* reply) {
+     fss_reply_fn fn = r->fn;
+     r->fn = NULL;
+     r->expired = 1;
+     c->live--;
+     if (fn) fn(status, reply, r->ctx);
+ }
+
+ /**
+  * @brief Fail every pending request after the connection is lost
+  *
+  * @param c Connection
+  * @return Callbacks run
+  */
+ static int fail_all(fss_client_t* c) {
+     int done = 0;
+     c->broken = 1;
+     while (c->sent) {
+         fss_request_t* r = c->sent;
+         c->sent = r->next;
+         if (!r->expired) {
+             finish(c, r, FSS_REPLY_CLOSED, "");
+             done++;
+         }
+         free(r);
+     }
+     while (c->queued) {
+         fss_request_t* r = c->queued;
+         c->queued = r->next;
+         finish(c, r, FSS_REPLY_CLOSED, "");
+         done++;
+         free(r);
+     }
+     c->sent_tail = &c->sent;
+     c->queued_tail = &c->queued;
+     c->nsent = c->exclusive_sent = 0;
+     return done;
+ }
+
+ /**
+  * @brief Close a connection
+  *
+  * @param c Connection (may be NULL)
+  */
+ void fss_close(fss_client_t* c) {
+     if (!c) return;
+     fail_all(c);
+     close(c->fd_in);
+     close(c->fd_out);
+     free(c->reply);
+     free(c);
+ }
+
+ /**
+  * @brief Set the handler for pushed events and unowned lines
+  *
+  * @param c Connection
+  * @param fn Handler (NULL to drop)
+  * @param ctx Context passed to fn
+  */
+ void fss_on_event(fss_client_t* c, fss_event_fn fn, void* ctx) {
+     c->on_event = fn;
+     c->event_ctx = ctx;
+ }
+
+ /**
+  * @brief Check whether a command must not share the pipe with others
+  *
+  * @param command Command line
+  * @return 1 for "status --all", 0 otherwise
+  */
+ static int is_exclusive(const char* command) {
+     char cmd[16], arg[16];
+     return sscanf(command, "%15s %15s", cmd, arg) == 2 &&
+            !strcmp(cmd, "status") && !strcmp(arg, "--all");
+ }
+
+ /**
+  * @brief Queue a command
+  *
+  * @param c Connection
+  * @param command Command line without newline
+  * @param timeout_ms Time from now the reply may take (negative = no limit)
+  * @param fn Reply callback (NULL to ignore the reply)
+  * @param ctx Context passed to fn
+  * @return 0 on success, -1 on error (errno set)
+  */
+ int fss_submit(fss_client_t* c, const char* command, int timeout_ms, fss_reply_fn fn, void* ctx) {
+     size_t len = strlen(command);
+     if (!len || len > FSS_MAX_COMMAND || strchr(command, '\n') || command[0] == '@') {
+         errno = EINVAL;
+         return -1;
+     }
+     if (c->broken) {
+         errno = EPIPE;
+         return -1;
+     }
+
+     fss_request_t* r = calloc(1, sizeof(*r));
+     snprintf(r->tag, sizeof(r->tag), "%ld.%lu", (long)getpid(), ++c->seq);
+     r->len = snprintf(r->line, sizeof(r->line), "@%s %s\n", r->tag, command);
+     r->exclusive = is_exclusive(command);
+     r->deadline = deadline_after(timeout_ms);
+     r->fn = fn;
+     r->ctx = ctx;
+     *c->queued_tail = r;
+     c->queued_tail = &r->next;
+     c->live++;
+     return 0;
+ }
+
+ /**
+  * @brief Write queued commands while the window and the FIFO allow
+  *
+  * @param c Connection
+  */
+ static void send_queued(fss_client_t* c) {
+     c->want_write = 0;
+     while (c->queued && !c->broken && c->nsent < FSS_CLIENT_WINDOW && !c->exclusive_sent) {
+         fss_request_t* r = c->queued;
+         if (r->exclusive && c->nsent) return;  /* Wait for the pipe to empty */
+
+         ssize_t w = write(c->fd_in, r->line, r->len);
+         if (w < 0) {
+             if (errno == EINTR) continue;
+             if (errno == EAGAIN) c->want_write = 1;
+             else c->broken = 1;
+             return;
+         }
+
+         c->queued = r->next;
+         if (!c->queued) c->queued_tail = &c->queued;
+         r->next = NULL;
+         *c->sent_tail = r;
+         c->sent_tail = &r->next;
+         c->nsent++;
+         c->exclusive_sent += r->exclusive;
+     }
+ }
+
+ /**
+  * @brief Append a line to the reply being collected
+  *
+  * @param c Connection
+  * @param line Line without newline
+  */
+ static void append_reply(fss_client_t* c, const char* line) {
+     size_t len = strlen(line);
+     if (c->reply_len + len + 2 > c->reply_cap) {
+         c->reply_cap = (c->reply_len + len + 2) * 2;
+         c->reply = realloc(c->reply, c->reply_cap);
+     }
+     memcpy(c->reply + c->reply_len, line, len);
+     c->reply_len += len;
+     c->reply[c->reply_len++] = '\n';
+     c->reply[c->reply_len] = '\0';
+ }
+
+ /**
+  * @brief Route one incoming line
+  *
+  * @param c Connection
+  * @param line Line without newline
+  * @return 1 if a callback ran, 0 otherwise
+  */
+ static int handle_line(fss_client_t* c, const char* line) {
+     if (!strncmp(line, "EVENT ", 6) || (!c->sent && line[0] != '@')) {
+         if (c->on_event) c->on_event(line, c->event_ctx);
+         return 0;
+     }
+     if (line[0] != '@') {
+         append_reply(c, line);
+         return 0;
+     }
+
+     /* An end line. Replies come in request order, so requests sent before
+      * the one it ends never got theirs (their output was lost). One that
+      * matches no request is left over from an earlier client */
+     size_t tlen = strcspn(line + 1, " ");
+     fss_request_t* r = c->sent;
+     while (r && !(strlen(r->tag) == tlen && !strncmp(line + 1, r->tag, tlen))) r = r->next;
+     int done = 0;
+     for (int last = 0; r && !last; ) {
+         fss_request_t* head = c->sent;
+         last = head == r;
+         c->sent = head->next;
+         if (!c->sent) c->sent_tail = &c->sent;
+         c->nsent--;
+         c->exclusive_sent -= head->exclusive;
+         if (!head->expired) {
+             if (last) finish(c, head, FSS_REPLY_OK, c->reply ? c->reply : "");
+             else finish(c, head, FSS_REPLY_TIMEOUT, "");
+             done++;
+         }
+         free(head);
+     }
+     c->reply_len = 0;
+     if (c->reply) c->reply[0] = '\0';
+     return done;
+ }
+
+ /**
+  * @brief Read whatever the manager wrote and route the complete lines
+  *
+  * @param c Connection
+  * @return Callbacks run
+  */
+ static int read_replies(fss_client_t* c) {
+     int done = 0;
+
+     while (1) {
+         ssize_t n = read(c->fd_out, c->in + c->in_len, sizeof(c->in) - 1 - c->in_len);
+         if (n < 0) {
+             if (errno == EINTR) continue;
+             if (errno != EAGAIN) c->broken = 1;
+             return done;
+         }
+         if (n == 0) {
+             c->broken = 1;  /* The manager closed its end */
+             return done;
+         }
+         c->in_len += n;
+         c->in[c->in_len] = '\0';
+
+         char *line = c->in, *nl;
+         while ((nl = strchr(line, '\n'))) {
+             *nl = '\0';
+             done += handle_line(c, line);
+             line = nl + 1;
+         }
+         c->in_len -= line - c->in;
+         memmove(c->in, line, c->in_len);
+
+         /* A line longer than the buffer is taken in pieces */
+         if (c->in_len == sizeof(c->in) - 1) {
+             c->in[c->in_len] = '\0';
+             done += handle_line(c, c->in);
+             c->in_len = 0;
+         }
+     }
+ }
+
+ /**
+  * @brief Time out the requests whose deadline passed
+  *
+  * A sent request stays in the sent list so its late reply is still
+  * recognized and dropped.
+  *
+  * @param c Connection
+  * @param next Set to the earliest deadline still ahead (-1 = none)
+  * @return Callbacks run
+  */
+ static int expire(fss_client_t* c, long long* next) {
+     long long now = now_ms();
+     int done = 0;
+     *next = -1;
+
+     for (fss_request_t* r = c->sent; r; r = r->next) {
+         if (r->expired || r->deadline < 0) continue;
+         if (r->deadline <= now) {
+             finish(c, r, FSS_REPLY_TIMEOUT, "");
+             done++;
+         } else if (*next < 0 || r->deadline < *next) {
+             *next = r->deadline;
+         }
+     }
+     for (fss_request_t** pp = &c->queued; *pp; ) {
+         fss_request_t* r = *pp;
+         if (r->deadline < 0 || r->deadline > now) {
+             if (r->deadline >= 0 && (*next < 0 || r->deadline < *next)) *next = r->deadline;
+             pp = &r->next;
+             continue;
+         }
+         *pp = r->next;
+         finish(c, r, FSS_REPLY_TIMEOUT, "");
+         done++;
+         free(r);
+     }
+     c->queued_tail = &c->queued;
+     while (*c->queued_tail) c->queued_tail = &(*c->queued_tail)->next;
+     return done;
+ }
+
+ /**
+  * @brief Send queued commands, read replies and run callbacks
+  *
+  * @param c Connection
+  * @param timeout_ms Longest time to wait for progress (0 = don't wait, negative = forever)
+  * @return Number of callbacks run, or -1 if the connection is lost
+  */
+ int fss_poll(fss_client_t* c, int timeout_ms) {
+     long long next;
+     int done = expire(c, &next);
+
+     if (!c->broken) send_queued(c);
+     if (!c->broken) {
+         /* Sleep until data arrives, fss_in has room, or a request times out;
+          * only check for replies if callbacks already ran */
+         int wait = done ? 0 : timeout_ms;
+         int until_next = ms_until(next);
+         if (until_next >= 0 && (wait < 0 || until_next < wait)) wait = until_next;
+
+         struct pollfd pfd[2] = {
+             { .fd = c->fd_out, .events = POLLIN },
+             { .fd = c->fd_in, .events = POLLOUT },
+         };
+         int r = poll(pfd, c->want_write ? 2 : 1, wait);
+         if (r < 0 && errno != EINTR) c->broken = 1;
+         if (r > 0 && (pfd[0].revents & (POLLIN | POLLHUP | POLLERR)))
+             done += read_replies(c);
+         if (r > 0 && (pfd[1].revents & POLLERR)) c->broken = 1;
+         if (!c->broken) send_queued(c);
+         done += expire(c, &next);
+     }
+
+     if (c->broken) {
+         done += fail_all(c);
+         return -1;
+     }
+     return done;
+ }
+
+ /**
+  * @brief Run fss_poll() until no request is pending
+  *
+  * @param c Connection
+  * @param timeout_ms Longest time to wait (negative = forever)
+  * @return 0 when idle, -1 on timeout or a lost connection (errno set)
+  */
+ int fss_wait(fss_client_t* c, int timeout_ms) {
+     long long deadline = deadline_after(timeout_ms);
+     while (c->live) {
+         if (deadline >= 0 && now_ms() >= deadline) {
+             errno = ETIMEDOUT;
+             return -1;
+         }
+         if (fss_poll(c, ms_until(deadline)) < 0) {
+             errno = EPIPE;
+             return -1;
+         }
+     }
+     return 0;
+ }
+
+ /**
+  * @struct call_result
+  * @brief Where fss_call() collects its reply
+  */
+ typedef struct call_result {
+     int done;                      /**< The callback ran */
+     fss_reply_status_t status;     /**< Outcome */
+     char* reply;                   /**< Copy of the reply */
+ } call_result_t;
+
+ /**
+  * @brief Reply callback of fss_call()
+  *
+  * @param status Outcome
+  * @param reply Reply text
+  * @param ctx call_result_t to fill
+  */
+ static void call_done(fss_reply_status_t status, const char* reply, void* ctx) {
+     call_result_t* res = ctx;
+     res->done = 1;
+     res->status = status;
+     if (status == FSS_REPLY_OK) res->reply = strdup(reply);
+ }
+
+ /**
+  * @brief Send one command and wait for its reply
+  *
+  * @param c Connection
+  * @param command Command line without newline
+  * @param timeout_ms Time the reply may take (negative = no limit)
+  * @return Reply (free() it), or NULL on error (errno set)
+  */
+ char* fss_call(fss_client_t* c, const char* command, int timeout_ms) {
+     call_result_t res = { 0 };
+     if (fss_submit(c, command, timeout_ms, call_done, &res) < 0) return NULL;
+     while (!res.done) fss_poll(c, -1);
+     if (res.status != FSS_REPLY_OK) errno = res.status == FSS_REPLY_TIMEOUT ? ETIMEDOUT : EPIPE;
+     return res.reply;
+ }
+
+ /**
+  * @brief Requests submitted and not completed yet
+  *
+  * @param c Connection
+  * @return Pending requests
+  */
+ size_t fss_pending(const fss_client_t* c) {
+     return c->live;
+ }
+
+ /**
+  * @brief File descriptor that becomes readable when replies or events arrive
+  *
+  * @param c Connection
+  * @return Read end of the manager's output FIFO
+  */
+ int fss_fd(const fss_client_t* c) {
+     return c->fd_out;
+ }
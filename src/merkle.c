@@ -0,0 +1,552 @@
+/**
+ * @file merkle.c
+ * @brief Implementation of directory hash trees
+ *
+ * Every node keeps its own digest; a directory also keeps the sum of its
+ * children's digests and a chained hash table of them by name. Setting a
+ * node's digest adds the change to its parent's sum, which changes the
+ * parent's digest, and so on up to the root.
+ *
+ * Scans stamp every node they see with a generation number, like the
+ * polling monitor's manifest; nodes left with an older stamp afterwards
+ * were not found and are removed.
+ */
+
+ #include "../include/merkle.h"
+ #include "../include/dir_walk.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <string.h>
+ #include <errno.h>
+ #include <fcntl.h>
+ #include <pthread.h>
+ #include <linux/limits.h>
+
+ #define MIN_BUCKETS 4   /**< Buckets of a directory's first table */
+
+ /**
+  * @struct merkle_node
+  * @brief One entry of the tree
+  */
+ typedef struct merkle_node {
+     struct merkle_node* parent;     /**< Containing directory (NULL for the root) */
+     struct merkle_node* next;       /**< Next node in the parent's bucket */
+     struct merkle_node** buckets;   /**< Children by name (directories only) */
+     size_t nbuckets;                /**< Number of buckets (a power of two, or 0) */
+     size_t nchildren;               /**< Children */
+     uint64_t name_hash;             /**< Hash of name */
+     uint64_t digest;                /**< Digest of the entry */
+     uint64_t sum;                   /**< Sum of the children's digests (directories only) */
+     unsigned type;                  /**< File type bits (S_IFMT) */
+     unsigned gen;                   /**< Scan that last saw it */
+     char name[];                    /**< Entry name ("" for the root) */
+ } merkle_node_t;
+
+ /**
+  * @struct merkle_tree
+  * @brief Tree handle
+  */
+ struct merkle_tree {
+     merkle_node_t* root;            /**< Root directory */
+     size_t count;                   /**< Nodes below the root */
+     unsigned flags;                 /**< MERKLE_NO_SIZE, MERKLE_NO_MTIME */
+     unsigned gen;                   /**< Current scan */
+ };
+
+ /**
+  * @brief Scramble a 64-bit value (the splitmix64 finalizer)
+  *
+  * @param x Value
+  * @return Mixed value
+  */
+ static uint64_t mix(uint64_t x) {
+     x ^= x >> 30;
+     x *= 0xbf58476d1ce4e5b9ULL;
+     x ^= x >> 27;
+     x *= 0x94d049bb133111ebULL;
+     return x ^ (x >> 31);
+ }
+
+ /**
+  * @brief Fold a value into a running digest
+  *
+  * @param h Digest so far
+  * @param v Value
+  * @return New digest
+  */
+ static uint64_t fold(uint64_t h, uint64_t v) {
+     return mix(h ^ mix(v + 0x9e3779b97f4a7c15ULL));
+ }
+
+ /**
+  * @brief FNV-1a hash of a name
+  *
+  * @param s Name
+  * @param len Length of s
+  * @return Hash
+  */
+ static uint64_t hash_name(const char* s, size_t len) {
+     uint64_t h = 14695981039346656037ULL;
+     for (size_t i = 0; i < len; i++) {
+         h ^= (unsigned char)s[i];
+         h *= 1099511628211ULL;
+     }
+     return h;
+ }
+
+ /**
+  * @brief Digest of a directory from its name and children
+  *
+  * @param n Directory node
+  * @return Digest
+  */
+ static uint64_t dir_digest(const merkle_node_t* n) {
+     return fold(fold(n->name_hash, S_IFDIR), n->sum);
+ }
+
+ /**
+  * @brief Digest of a non-directory entry
+  *
+  * @param t Tree (for its flags)
+  * @param n Node
+  * @param st Entry's lstat() data
+  * @return Digest
+  */
+ static uint64_t leaf_digest(const merkle_tree_t* t, const merkle_node_t* n, const struct stat* st) {
+     uint64_t h = fold(n->name_hash, st->st_mode & S_IFMT);
+     if (!(t->flags & MERKLE_NO_SIZE)) h = fold(h, (uint64_t)st->st_size);
+     if (!(t->flags & MERKLE_NO_MTIME))
+         h = fold(h, (uint64_t)st->st_mtim.tv_sec * 1000000000ULL + st->st_mtim.tv_nsec);
+     return h;
+ }
+
+ /**
+  * @brief Give a node a new digest and carry the change up to the root
+  *
+  * @param n Node
+  * @param digest New digest
+  */
+ static void set_digest(merkle_node_t* n, uint64_t digest) {
+     while (n && n->digest != digest) {
+         uint64_t old = n->digest;
+         n->digest = digest;
+         merkle_node_t* p = n->parent;
+         if (!p) return;
+         p->sum += digest - old;
+         digest = dir_digest(p);
+         n = p;
+     }
+ }
+
+ /**
+  * @brief Allocate a node
+  *
+  * @param name Entry name
+  * @param len Length of name
+  * @return New node (digest 0, no parent)
+  */
+ static merkle_node_t* new_node(const char* name, size_t len) {
+     merkle_node_t* n = calloc(1, sizeof(*n) + len + 1);
+     memcpy(n->name, name, len);
+     n->name_hash = hash_name(name, len);
+     return n;
+ }
+
+ /**
+  * @brief Free a node and everything below it
+  *
+  * @param t Tree (its count is updated)
+  * @param n Node
+  */
+ static void free_node(merkle_tree_t* t, merkle_node_t* n) {
+     for (size_t i = 0; i < n->nbuckets; i++) {
+         merkle_node_t* c = n->buckets[i];
+         while (c) {
+             merkle_node_t* next = c->next;
+             free_node(t, c);
+             c = next;
+         }
+     }
+     free(n->buckets);
+     if (n->parent) t->count--;
+     free(n);
+ }
+
+ /**
+  * @brief Find a child by name
+  *
+  * @param dir Directory node
+  * @param name Name
+  * @param len Length of name
+  * @param hash hash_name(name, len)
+  * @return Child, or NULL if dir has none by that name
+  */
+ static merkle_node_t* find_child(const merkle_node_t* dir, const char* name, size_t len, uint64_t hash) {
+     if (!dir->nbuckets) return NULL;
+     for (merkle_node_t* c = dir->buckets[hash & (dir->nbuckets - 1)]; c; c = c->next)
+         if (c->name_hash == hash && !strncmp(c->name, name, len) && !c->name[len]) return c;
+     return NULL;
+ }
+
+ /**
+  * @brief Link a new child into a directory, growing its table as needed
+  *
+  * @param t Tree
+  * @param dir Directory node
+  * @param c Child (digest 0)
+  */
+ static void add_child(merkle_tree_t* t, merkle_node_t* dir, merkle_node_t* c) {
+     if (dir->nchildren >= dir->nbuckets) {
+         size_t n = dir->nbuckets ? dir->nbuckets * 2 : MIN_BUCKETS;
+         merkle_node_t** b = calloc(n, sizeof(*b));
+         for (size_t i = 0; i < dir->nbuckets; i++) {
+             merkle_node_t* e = dir->buckets[i];
+             while (e) {
+                 merkle_node_t* next = e->next;
+                 e->next = b[e->name_hash & (n - 1)];
+                 b[e->name_hash & (n - 1)] = e;
+                 e = next;
+             }
+         }
+         free(dir->buckets);
+         dir->buckets = b;
+         dir->nbuckets = n;
+     }
+     c->parent = dir;
+     c->next = dir->buckets[c->name_hash & (dir->nbuckets - 1)];
+     dir->buckets[c->name_hash & (dir->nbuckets - 1)] = c;
+     dir->nchildren++;
+     t->count++;
+ }
+
+ /**
+  * @brief Unlink a node from its parent and free it
+  *
+  * @param t Tree
+  * @param n Node (not the root)
+  */
+ static void remove_node(merkle_tree_t* t, merkle_node_t* n) {
+     merkle_node_t* p = n->parent;
+     merkle_node_t** pp = &p->buckets[n->name_hash & (p->nbuckets - 1)];
+     while (*pp != n) pp = &(*pp)->next;
+     *pp = n->next;
+     p->nchildren--;
+     p->sum -= n->digest;
+     free_node(t, n);
+     set_digest(p, dir_digest(p));
+ }
+
+ /**
+  * @brief Drop a node's children and make it a leaf
+  *
+  * @param t Tree
+  * @param n Node
+  */
+ static void clear_children(merkle_tree_t* t, merkle_node_t* n) {
+     while (n->nchildren) {
+         for (size_t i = 0; i < n->nbuckets; i++)
+             if (n->buckets[i]) remove_node(t, n->buckets[i]);
+     }
+     free(n->buckets);
+     n->buckets = NULL;
+     n->nbuckets = 0;
+ }
+
+ /**
+  * @brief Find the node of a path, optionally creating missing directories
+  *
+  * @param t Tree
+  * @param path Relative path
+  * @param create Add missing components as directories
+  * @return Node, or NULL if it does not exist and create is 0
+  */
+ static merkle_node_t* lookup(merkle_tree_t* t, const char* path, int create) {
+     merkle_node_t* n = t->root;
+     const char* p = path;
+
+     while (*p) {
+         while (*p == '/') p++;
+         size_t len = strcspn(p, "/");
+         if (!len) break;
+         if (len == 1 && p[0] == '.') {
+             p += len;
+             continue;
+         }
+         uint64_t hash = hash_name(p, len);
+         merkle_node_t* c = find_child(n, p, len, hash);
+         if (!c) {
+             if (!create) return NULL;
+             c = new_node(p, len);
+             c->type = S_IFDIR;
+             add_child(t, n, c);
+             set_digest(c, dir_digest(c));
+         } else if (create && c->type != S_IFDIR && p[len]) {
+             /* A file where a directory is now: it is one */
+             c->type = S_IFDIR;
+             set_digest(c, dir_digest(c));
+         }
+         c->gen = t->gen;
+         n = c;
+         p += len;
+     }
+     return n;
+ }
+
+ /**
+  * @brief Create an empty tree
+  *
+  * @param flags MERKLE_NO_SIZE and/or MERKLE_NO_MTIME
+  * @return New tree
+  */
+ merkle_tree_t* merkle_create(unsigned flags) {
+     merkle_tree_t* t = calloc(1, sizeof(*t));
+     t->flags = flags;
+     t->root = new_node("", 0);
+     t->root->type = S_IFDIR;
+     t->root->digest = dir_digest(t->root);
+     return t;
+ }
+
+ /**
+  * @brief Free a tree
+  *
+  * @param t Tree to destroy (may be NULL)
+  */
+ void merkle_destroy(merkle_tree_t* t) {
+     if (!t) return;
+     free_node(t, t->root);
+     free(t);
+ }
+
+ /**
+  * @brief Set or remove one entry
+  *
+  * @param t Tree
+  * @param path Path relative to the root
+  * @param st Entry's lstat() data, or NULL to remove it
+  * @return 0 on success, -1 if path is empty
+  */
+ int merkle_update(merkle_tree_t* t, const char* path, const struct stat* st) {
+     if (!st) {
+         merkle_node_t* n = lookup(t, path, 0);
+         if (n == t->root) return -1;
+         if (n) remove_node(t, n);
+         return 0;
+     }
+
+     merkle_node_t* n = lookup(t, path, 1);
+     if (n == t->root) return -1;
+     unsigned type = st->st_mode & S_IFMT;
+     if (type == S_IFDIR) {
+         n->type = S_IFDIR;
+         set_digest(n, dir_digest(n));
+     } else {
+         if (n->nchildren || n->nbuckets) clear_children(t, n);
+         n->type = type;
+         set_digest(n, leaf_digest(t, n, st));
+     }
+     return 0;
+ }
+
+ /**
+  * @struct scan_ctx
+  * @brief State of one scan, shared with the walk callback
+  */
+ typedef struct scan_ctx {
+     merkle_tree_t* t;               /**< Tree being updated */
+     const char* base;               /**< Scanned path relative to the tree root */
+     pthread_mutex_t lock;           /**< Serializes tree updates of walker threads */
+     long entries;                   /**< Entries stat'ed */
+ } scan_ctx_t;
+
+ /**
+  * @brief Walk callback: stat a batch of entries, then update the tree under the lock
+  *
+  * @param batch Entries
+  * @param n Number of entries
+  * @param ctx Scan
+  */
+ static void scan_batch(const dir_walk_entry_t* batch, size_t n, void* ctx) {
+     scan_ctx_t* s = ctx;
+     struct stat* sts = malloc(n * sizeof(*sts));
+     char* ok = malloc(n);
+
+     for (size_t i = 0; i < n; i++)
+         ok[i] = fstatat(batch[i].dirfd, batch[i].name, &sts[i], AT_SYMLINK_NOFOLLOW) == 0;
+
+     pthread_mutex_lock(&s->lock);
+     for (size_t i = 0; i < n; i++) {
+         if (!ok[i]) continue;  /* Gone since it was listed: the sweep removes it */
+         char path[PATH_MAX];
+         snprintf(path, sizeof(path), "%s/%s/%s", s->base, batch[i].relpath, batch[i].name);
+         merkle_update(s->t, path, &sts[i]);
+         s->entries++;
+     }
+     pthread_mutex_unlock(&s->lock);
+     free(sts);
+     free(ok);
+ }
+
+ /**
+  * @brief Remove the nodes below a directory that the current scan did not see
+  *
+  * @param t Tree
+  * @param dir Directory node
+  */
+ static void sweep(merkle_tree_t* t, merkle_node_t* dir) {
+     for (size_t i = 0; i < dir->nbuckets; i++) {
+         merkle_node_t* c = dir->buckets[i];
+         while (c) {
+             merkle_node_t* next = c->next;
+             if (c->gen != t->gen) remove_node(t, c);
+             else if (c->type == S_IFDIR) sweep(t, c);
+             c = next;
+         }
+     }
+ }
+
+ /**
+  * @brief Bring the part of a tree under path in line with the filesystem
+  *
+  * @param t Tree
+  * @param root Directory the tree mirrors
+  * @param path Path relative to root ("" for the whole tree)
+  * @param threads Walker threads for directories
+  * @return Entries stat'ed, or -1 if root cannot be read
+  */
+ long merkle_scan(merkle_tree_t* t, const char* root, const char* path, int threads) {
+     char full[PATH_MAX];
+     struct stat st;
+     snprintf(full, sizeof(full), "%s/%s", root, path);
+     int whole = lookup(t, path, 0) == t->root;
+
+     if (lstat(full, &st) < 0 || (whole && !S_ISDIR(st.st_mode))) {
+         int gone = errno == ENOENT;
+         if (whole) {
+             clear_children(t, t->root);
+             return -1;
+         }
+         merkle_update(t, path, NULL);
+         return gone ? 0 : -1;
+     }
+     t->gen++;
+     if (!whole) merkle_update(t, path, &st);
+     if (!S_ISDIR(st.st_mode)) return 1;
+
+     scan_ctx_t s = { .t = t, .base = path, .entries = 1 };
+     pthread_mutex_init(&s.lock, NULL);
+     dir_walk_opts_t opts = { .threads = threads, .max_depth = 0, .batch_size = 0 };
+     int rc = dir_walk(full, &opts, scan_batch, &s);
+     pthread_mutex_destroy(&s.lock);
+     if (rc < 0) {
+         if (whole) clear_children(t, t->root);
+         return whole ? -1 : s.entries;
+     }
+     sweep(t, lookup(t, path, 0));
+     return s.entries;
+ }
+
+ /**
+  * @brief Digest of an entry
+  *
+  * @param t Tree
+  * @param path Path relative to the root ("" for the root)
+  * @return Digest, or 0 if the tree has no such entry
+  */
+ uint64_t merkle_digest(const merkle_tree_t* t, const char* path) {
+     merkle_node_t* n = lookup((merkle_tree_t*)t, path, 0);
+     return n ? n->digest : 0;
+ }
+
+ /**
+  * @brief Number of entries below the root
+  *
+  * @param t Tree
+  * @return Entries
+  */
+ size_t merkle_size(const merkle_tree_t* t) {
+     return t->count;
+ }
+
+ /**
+  * @struct diff_ctx
+  * @brief State of one comparison
+  */
+ typedef struct diff_ctx {
+     merkle_diff_fn fn;              /**< Difference callback */
+     void* ctx;                      /**< Its context */
+     char path[PATH_MAX];            /**< Path of the directory being compared */
+     long visited;                   /**< Entries visited */
+     int stop;                       /**< The callback asked to stop */
+ } diff_ctx_t;
+
+ /**
+  * @brief Report one difference at path + name
+  *
+  * @param d Comparison
+  * @param len Length of the directory path in d->path
+  * @param name Entry name
+  * @param kind How it differs
+  * @param is_dir The entry is a directory
+  */
+ static void report(diff_ctx_t* d, size_t len, const char* name, merkle_diff_kind_t kind, int is_dir) {
+     if (d->stop) return;
+     snprintf(d->path + len, sizeof(d->path) - len, "%s%s", len ? "/" : "", name);
+     if (d->fn(d->path, kind, is_dir, d->ctx)) d->stop = 1;
+     d->path[len] = '\0';
+ }
+
+ /**
+  * @brief Compare two directories whose digests differ
+  *
+  * @param d Comparison (d->path holds their path)
+  * @param a Directory in the first tree
+  * @param b Directory in the second tree
+  */
+ static void diff_dirs(diff_ctx_t* d, const merkle_node_t* a, const merkle_node_t* b) {
+     size_t len = strlen(d->path);
+
+     for (size_t i = 0; i < a->nbuckets && !d->stop; i++) {
+         for (const merkle_node_t* ca = a->buckets[i]; ca && !d->stop; ca = ca->next) {
+             d->visited++;
+             const merkle_node_t* cb = find_child(b, ca->name, strlen(ca->name), ca->name_hash);
+             if (!cb) {
+                 report(d, len, ca->name, MERKLE_ONLY_A, ca->type == S_IFDIR);
+             } else if (ca->digest == cb->digest) {
+                 continue;
+             } else if (ca->type == S_IFDIR && cb->type == S_IFDIR) {
+                 snprintf(d->path + len, sizeof(d->path) - len, "%s%s", len ? "/" : "", ca->name);
+                 diff_dirs(d, ca, cb);
+                 d->path[len] = '\0';
+             } else {
+                 report(d, len, ca->name, MERKLE_DIFFERS, ca->type == S_IFDIR);
+             }
+         }
+     }
+     for (size_t i = 0; i < b->nbuckets && !d->stop; i++) {
+         for (const merkle_node_t* cb = b->buckets[i]; cb && !d->stop; cb = cb->next) {
+             if (find_child(a, cb->name, strlen(cb->name), cb->name_hash)) continue;
+             d->visited++;
+             report(d, len, cb->name, MERKLE_ONLY_B, cb->type == S_IFDIR);
+         }
+     }
+ }
+
+ /**
+  * @brief Compare two trees
+  *
+  * @param a First tree
+  * @param b Second tree
+  * @param fn Callback for each difference
+  * @param ctx Context passed to fn
+  * @return Entries visited
+  */
+ long merkle_diff(const merkle_tree_t* a, const merkle_tree_t* b, merkle_diff_fn fn, void* ctx) {
+     diff_ctx_t* d = calloc(1, sizeof(*d));
+     d->fn = fn;
+     d->ctx = ctx;
+     if (a->root->digest != b->root->digest) diff_dirs(d, a->root, b->root);
+     long visited = d->visited;
+     free(d);
+     return visited;
+ }
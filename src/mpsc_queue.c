@@ -0,0 +1,77 @@
+/**
+ * @file mpsc_queue.c
+ * @brief Implementation of the lock-free multi-producer single-consumer queue
+ *
+ * Producers link themselves in with a single atomic exchange on head, so a
+ * push never blocks or retries. The consumer walks from tail and recycles the
+ * stub node when the queue drains. Based on Dmitry Vyukov's intrusive MPSC
+ * node-based queue.
+ */
+
+ #include "../include/mpsc_queue.h"
+
+ /**
+  * @brief Initialize an empty queue
+  *
+  * @param q Queue to initialize
+  */
+ void mpsc_init(mpsc_queue_t* q) {
+     atomic_store_explicit(&q->stub.next, NULL, memory_order_relaxed);
+     atomic_store_explicit(&q->head, &q->stub, memory_order_relaxed);
+     q->tail = &q->stub;
+ }
+
+ /**
+  * @brief Push a node onto the queue
+  *
+  * Swaps the node in as the new head, then links the previous head to it.
+  * Between those two steps the consumer sees a temporarily broken chain and
+  * simply reports the queue as empty.
+  *
+  * @param q Queue to push to
+  * @param n Node to push
+  */
+ void mpsc_push(mpsc_queue_t* q, mpsc_node_t* n) {
+     atomic_store_explicit(&n->next, NULL, memory_order_relaxed);
+     mpsc_node_t* prev = atomic_exchange_explicit(&q->head, n, memory_order_acq_rel);
+     atomic_store_explicit(&prev->next, n, memory_order_release);
+ }
+
+ /**
+  * @brief Pop the oldest node from the queue
+  *
+  * @param q Queue to pop from
+  * @return Oldest node, or NULL if empty (or a push is in progress)
+  */
+ mpsc_node_t* mpsc_pop(mpsc_queue_t* q) {
+     mpsc_node_t* tail = q->tail;
+     mpsc_node_t* next = atomic_load_explicit(&tail->next, memory_order_acquire);
+
+     /* Skip over the stub node */
+     if (tail == &q->stub) {
+         if (!next) return NULL;  /* Queue is empty */
+         q->tail = next;
+         tail = next;
+         next = atomic_load_explicit(&next->next, memory_order_acquire);
+     }
+
+     /* Common case: more than one node queued */
+     if (next) {
+         q->tail = next;
+         return tail;
+     }
+
+     /* tail is the last linked node; a producer may be mid-push */
+     mpsc_node_t* head = atomic_load_explicit(&q->head, memory_order_acquire);
+     if (tail != head) return NULL;
+
+     /* Re-insert the stub so tail can be handed out */
+     mpsc_push(q, &q->stub);
+     next = atomic_load_explicit(&tail->next, memory_order_acquire);
+     if (next) {
+         q->tail = next;
+         return tail;
+     }
+
+     return NULL;
+ }
@@ -0,0 +1,392 @@
+/**
+ * @file path_index.c
+ * @brief Implementation of the compressed radix tree path index
+ *
+ * Every node stores the key fragment on the edge leading to it. Siblings
+ * start with distinct characters, so choosing a child is a scan of the
+ * sibling list comparing one byte; nodes with a single child and no value
+ * are merged back into their child on removal to keep the tree compressed.
+ */
+
+ #include "../include/path_index.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <string.h>
+ #include <linux/limits.h>
+
+ /**
+  * @struct pi_node
+  * @brief Tree node; the root has an empty label
+  */
+ typedef struct pi_node {
+     struct pi_node* child;    /**< First child */
+     struct pi_node* sibling;  /**< Next child of the same parent */
+     void* value;              /**< Value if a key ends here, else NULL */
+     size_t len;               /**< Label length */
+     char* label;              /**< Key fragment on the incoming edge */
+ } pi_node_t;
+
+ /**
+  * @struct path_index
+  * @brief Index handle
+  */
+ struct path_index {
+     pi_node_t root;  /**< Root node (empty label) */
+     size_t count;    /**< Number of keys */
+ };
+
+ /**
+  * -----------------------------------------------------------------------------
+  * Node helpers
+  * -----------------------------------------------------------------------------
+  */
+
+ /**
+  * @brief Allocate a leaf node
+  *
+  * @param label Label bytes
+  * @param len Label length
+  * @return New node
+  */
+ static pi_node_t* node_new(const char* label, size_t len) {
+     pi_node_t* n = calloc(1, sizeof(*n));
+     n->label = malloc(len + 1);
+     memcpy(n->label, label, len);
+     n->label[len] = '\0';
+     n->len = len;
+     return n;
+ }
+
+ /**
+  * @brief Free a node and its whole subtree
+  *
+  * @param n Node to free
+  */
+ static void node_free(pi_node_t* n) {
+     while (n) {
+         pi_node_t* next = n->sibling;
+         node_free(n->child);
+         free(n->label);
+         free(n);
+         n = next;
+     }
+ }
+
+ /**
+  * @brief Find the link that points (or would point) to n's child starting with c
+  *
+  * @param n Parent node
+  * @param c First byte of the child's label
+  * @return Link to the child, or to the NULL end of the sibling list
+  */
+ static pi_node_t** child_link(pi_node_t* n, char c) {
+     pi_node_t** l = &n->child;
+     while (*l && (*l)->label[0] != c) l = &(*l)->sibling;
+     return l;
+ }
+
+ /**
+  * @brief Split a node's label after k bytes
+  *
+  * The node keeps the first k bytes; a new child takes the rest of the
+  * label along with the node's value and children.
+  *
+  * @param n Node to split
+  * @param k Bytes to keep (0 < k < n->len)
+  */
+ static void node_split(pi_node_t* n, size_t k) {
+     pi_node_t* m = node_new(n->label + k, n->len - k);
+     m->child = n->child;
+     m->value = n->value;
+     n->child = m;
+     n->value = NULL;
+     n->len = k;
+     n->label[k] = '\0';
+ }
+
+ /**
+  * @brief Merge a valueless node with its only child
+  *
+  * @param n Node to merge into
+  */
+ static void node_merge(pi_node_t* n) {
+     pi_node_t* c = n->child;
+     char* label = malloc(n->len + c->len + 1);
+     memcpy(label, n->label, n->len);
+     memcpy(label + n->len, c->label, c->len + 1);
+     free(n->label);
+     n->label = label;
+     n->len += c->len;
+     n->value = c->value;
+     n->child = c->child;
+     free(c->label);
+     free(c);
+ }
+
+ /**
+  * @brief Return any value in a subtree
+  *
+  * @param n Subtree root
+  * @param skip_self Ignore n's own value
+  * @return A value, or NULL if the subtree holds none
+  */
+ static void* any_value(const pi_node_t* n, int skip_self) {
+     if (n->value && !skip_self) return n->value;
+     for (const pi_node_t* c = n->child; c; c = c->sibling) {
+         void* v = any_value(c, 0);
+         if (v) return v;
+     }
+     return NULL;
+ }
+
+ /**
+  * -----------------------------------------------------------------------------
+  * Public API Implementation
+  * -----------------------------------------------------------------------------
+  */
+
+ /**
+  * @brief Create an empty index
+  *
+  * @return New index
+  */
+ path_index_t* path_index_create(void) {
+     path_index_t* idx = calloc(1, sizeof(*idx));
+     idx->root.label = calloc(1, 1);
+     return idx;
+ }
+
+ /**
+  * @brief Free an index (values are not freed)
+  *
+  * @param idx Index to destroy (may be NULL)
+  */
+ void path_index_destroy(path_index_t* idx) {
+     if (!idx) return;
+     node_free(idx->root.child);
+     free(idx->root.label);
+     free(idx);
+ }
+
+ /**
+  * @brief Insert or replace a path
+  *
+  * @param idx Index
+  * @param path Normalized path (see path_index_canonical())
+  * @param value Value to store (must not be NULL)
+  * @return Previous value for path, or NULL if it was not indexed
+  */
+ void* path_index_insert(path_index_t* idx, const char* path, void* value) {
+     pi_node_t* n = &idx->root;
+     const char* rest = path;
+
+     while (*rest) {
+         pi_node_t** link = child_link(n, *rest);
+         pi_node_t* c = *link;
+
+         /* No edge starts with this byte: hang the remainder off n */
+         if (!c) {
+             c = node_new(rest, strlen(rest));
+             c->value = value;
+             *link = c;
+             idx->count++;
+             return NULL;
+         }
+
+         /* Follow the common part of the edge, splitting it if needed */
+         size_t k = 0;
+         while (k < c->len && rest[k] == c->label[k]) k++;
+         if (k < c->len) node_split(c, k);
+         rest += k;
+         n = c;
+     }
+
+     void* old = n->value;
+     n->value = value;
+     if (!old) idx->count++;
+     return old;
+ }
+
+ /**
+  * @brief Remove a path
+  *
+  * @param idx Index
+  * @param path Path to remove
+  * @return Removed value, or NULL if path was not indexed
+  */
+ void* path_index_remove(path_index_t* idx, const char* path) {
+     pi_node_t* parent = NULL;
+     pi_node_t** link = NULL;
+     pi_node_t* n = &idx->root;
+     const char* rest = path;
+
+     while (*rest) {
+         pi_node_t** l = child_link(n, *rest);
+         pi_node_t* c = *l;
+         if (!c || strncmp(c->label, rest, c->len) != 0) return NULL;
+         parent = n;
+         link = l;
+         rest += c->len;
+         n = c;
+     }
+     if (!n->value) return NULL;
+
+     void* old = n->value;
+     n->value = NULL;
+     idx->count--;
+     if (n == &idx->root) return old;
+
+     /* Drop the leaf, or fold a pass-through node into its child */
+     if (!n->child) {
+         *link = n->sibling;
+         free(n->label);
+         free(n);
+         if (parent != &idx->root && !parent->value &&
+             parent->child && !parent->child->sibling)
+             node_merge(parent);
+     } else if (!n->child->sibling) {
+         node_merge(n);
+     }
+     return old;
+ }
+
+ /**
+  * @brief Exact lookup
+  *
+  * @param idx Index
+  * @param path Path to look up
+  * @return Value, or NULL if path is not indexed
+  */
+ void* path_index_find(const path_index_t* idx, const char* path) {
+     const pi_node_t* n = &idx->root;
+     const char* rest = path;
+
+     while (*rest) {
+         const pi_node_t* c = *child_link((pi_node_t*)n, *rest);
+         if (!c || strncmp(c->label, rest, c->len) != 0) return NULL;
+         rest += c->len;
+         n = c;
+     }
+     return n->value;
+ }
+
+ /**
+  * @brief Find the deepest indexed directory containing path (or equal to it)
+  *
+  * @param idx Index
+  * @param path Path to route
+  * @param matched If not NULL, receives the length of the matching key
+  * @return Value of the longest matching key, or NULL if none contains path
+  */
+ void* path_index_longest_prefix(const path_index_t* idx, const char* path, size_t* matched) {
+     const pi_node_t* n = &idx->root;
+     size_t off = 0, best_len = 0;
+     void* best = NULL;
+
+     for (;;) {
+         /* A key only contains path if it ends on a component boundary */
+         if (n->value && (path[off] == '\0' || path[off] == '/' ||
+                          (off > 0 && path[off - 1] == '/'))) {
+             best = n->value;
+             best_len = off;
+         }
+         if (!path[off]) break;
+
+         const pi_node_t* c = *child_link((pi_node_t*)n, path[off]);
+         if (!c || strncmp(c->label, path + off, c->len) != 0) break;
+         off += c->len;
+         n = c;
+     }
+
+     if (matched) *matched = best_len;
+     return best;
+ }
+
+ /**
+  * @brief Find any indexed path strictly below dir
+  *
+  * @param idx Index
+  * @param dir Directory to look under
+  * @return Value of some key inside dir, or NULL if there is none
+  */
+ void* path_index_find_under(const path_index_t* idx, const char* dir) {
+     /* Keys inside dir are exactly those starting with "dir/" */
+     char q[PATH_MAX + 1];
+     size_t dlen = strlen(dir);
+     int slash = dlen > 0 && dir[dlen - 1] == '/';
+     snprintf(q, sizeof(q), "%s%s", dir, slash ? "" : "/");
+     size_t qlen = strlen(q);
+
+     const pi_node_t* n = &idx->root;
+     size_t off = 0;
+     while (off < qlen) {
+         const pi_node_t* c = *child_link((pi_node_t*)n, q[off]);
+         if (!c) return NULL;
+         size_t m = c->len < qlen - off ? c->len : qlen - off;
+         if (strncmp(c->label, q + off, m) != 0) return NULL;
+         off += c->len;
+         n = c;
+     }
+
+     /* n's key starts with q; it is dir itself only when dir ended in '/' */
+     return any_value(n, slash && off == qlen);
+ }
+
+ /**
+  * @brief Number of indexed paths
+  *
+  * @param idx Index
+  * @return Number of keys
+  */
+ size_t path_index_size(const path_index_t* idx) {
+     return idx->count;
+ }
+
+ /**
+  * @brief Collapse repeated slashes and strip a trailing one
+  *
+  * @param path Input path
+  * @param out Output buffer
+  * @param outlen Size of out
+  */
+ static void normalize(const char* path, char* out, size_t outlen) {
+     size_t o = 0;
+     for (const char* p = path; *p && o + 1 < outlen; p++) {
+         if (*p == '/' && o > 0 && out[o - 1] == '/') continue;
+         out[o++] = *p;
+     }
+     if (o > 1 && out[o - 1] == '/') o--;
+     out[o] = '\0';
+ }
+
+ /**
+  * @brief Normalize a path for use as a key
+  *
+  * @param path Path as configured
+  * @param out Buffer for the key
+  * @param outlen Size of out
+  */
+ void path_index_canonical(const char* path, char* out, size_t outlen) {
+     char norm[PATH_MAX], resolved[PATH_MAX];
+     normalize(path, norm, sizeof(norm));
+
+     if (realpath(norm, resolved)) {
+         snprintf(out, outlen, "%s", resolved);
+         return;
+     }
+
+     /* Not created yet (typically a target): resolve the parent instead */
+     char* slash = strrchr(norm, '/');
+     const char* base = slash ? slash + 1 : norm;
+     if (slash == norm) {
+         snprintf(out, outlen, "%s", norm);
+         return;
+     }
+     if (slash) *slash = '\0';
+     if (*base && realpath(slash ? norm : ".", resolved)) {
+         snprintf(out, outlen, "%s%s%s", resolved, strcmp(resolved, "/") ? "/" : "", base);
+         return;
+     }
+     if (slash) *slash = '/';
+     snprintf(out, outlen, "%s", norm);
+ }
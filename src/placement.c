@@ -0,0 +1,323 @@
+/**
+ * @file placement.c
+ * @brief Implementation of CPU and NUMA placement
+ *
+ * Topology comes from /sys/devices/system/node/nodeN/cpulist, device
+ * locality from the numa_node attribute of the device (or one of its
+ * parents) under /sys/dev/block/MAJ:MIN. Both are read once and cached.
+ */
+
+ #define _GNU_SOURCE  /* cpu_set_t, sched_setaffinity() */
+ #include "../include/placement.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <string.h>
+ #include <errno.h>
+ #include <unistd.h>
+ #include <pthread.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <sys/sysmacros.h>
+ #include <stdint.h>
+ #include <linux/limits.h>
+
+ #define DEVICE_CACHE 32   /**< Devices whose node is remembered */
+
+ static pthread_once_t topo_once = PTHREAD_ONCE_INIT;  /**< Guards discovery */
+ static int node_count = 1;                            /**< Nodes found */
+ static cpu_set_t node_cpus[PLACEMENT_MAX_NODES];      /**< CPUs per node */
+
+ static pthread_mutex_t dev_lock = PTHREAD_MUTEX_INITIALIZER;  /**< Guards the device cache */
+ static struct { dev_t dev; int node; } dev_cache[DEVICE_CACHE];  /**< dev -> node */
+ static int dev_cached = 0;                                     /**< Entries used */
+
+ static __thread int bound_node = -1;  /**< Node the calling thread is bound to */
+
+ /**
+  * @brief Parse a sysfs CPU list ("0-3,8,10-11") into a set
+  *
+  * @param list CPU list text
+  * @param set Set to fill
+  * @return Number of CPUs added
+  */
+ static int parse_cpulist(const char* list, cpu_set_t* set) {
+     int added = 0;
+     const char* p = list;
+
+     CPU_ZERO(set);
+     while (*p && *p != '\n') {
+         char* end;
+         long lo = strtol(p, &end, 10), hi = lo;
+         if (end == p) break;
+         if (*end == '-') hi = strtol(end + 1, &end, 10);
+         for (long c = lo; c <= hi && c < CPU_SETSIZE; c++) {
+             CPU_SET(c, set);
+             added++;
+         }
+         p = *end == ',' ? end + 1 : end;
+     }
+     return added;
+ }
+
+ /**
+  * @brief Read a small sysfs file
+  *
+  * @param path File to read
+  * @param buf Output buffer
+  * @param len Size of buf
+  * @return 0 on success, -1 on error
+  */
+ static int read_sysfs(const char* path, char* buf, size_t len) {
+     FILE* f = fopen(path, "r");
+     if (!f) return -1;
+     int ok = fgets(buf, len, f) != NULL;
+     fclose(f);
+     return ok ? 0 : -1;
+ }
+
+ /**
+  * @brief Discover the node topology (run once)
+  */
+ static void discover(void) {
+     char path[128], buf[4096];
+     int n = 0;
+
+     for (int node = 0; node < PLACEMENT_MAX_NODES; node++) {
+         snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+         if (read_sysfs(path, buf, sizeof(buf)) < 0) break;
+         parse_cpulist(buf, &node_cpus[node]);
+         n++;
+     }
+
+     /* No sysfs topology: one node with every CPU we may run on */
+     if (n == 0) {
+         if (sched_getaffinity(0, sizeof(node_cpus[0]), &node_cpus[0]) < 0) {
+             CPU_ZERO(&node_cpus[0]);
+             for (long c = 0; c < sysconf(_SC_NPROCESSORS_CONF) && c < CPU_SETSIZE; c++)
+                 CPU_SET(c, &node_cpus[0]);
+         }
+         n = 1;
+     }
+     node_count = n;
+ }
+
+ /**
+  * @brief Number of NUMA nodes (at least 1)
+  *
+  * @return Node count
+  */
+ int placement_nodes(void) {
+     pthread_once(&topo_once, discover);
+     return node_count;
+ }
+
+ /**
+  * @brief CPUs of a node
+  *
+  * @param node Node number
+  * @param set Filled with the node's CPUs
+  * @return 0 on success, -1 if the node does not exist
+  */
+ int placement_node_cpus(int node, cpu_set_t* set) {
+     if (node < 0 || node >= placement_nodes()) return -1;
+     *set = node_cpus[node];
+     return 0;
+ }
+
+ /**
+  * @brief Look a device's node up in sysfs
+  *
+  * The numa_node attribute sits on the controller, so the search climbs
+  * from the block device (or the disk owning a partition) through its
+  * "device" links.
+  *
+  * @param dev Device number
+  * @return Node number, or -1 if unknown
+  */
+ static int sysfs_device_node(dev_t dev) {
+     char link[64], base[PATH_MAX], path[PATH_MAX + 64], buf[32];
+
+     snprintf(link, sizeof(link), "/sys/dev/block/%u:%u", major(dev), minor(dev));
+     if (!realpath(link, base)) return -1;
+
+     for (int pass = 0; pass < 2; pass++) {
+         /* Up to three controller levels (e.g. nvme0n1 -> nvme0 -> PCI function) */
+         char dir[PATH_MAX + 32];
+         snprintf(dir, sizeof(dir), "%s", base);
+         for (int level = 0; level < 3; level++) {
+             strncat(dir, "/device", sizeof(dir) - strlen(dir) - 1);
+             snprintf(path, sizeof(path), "%s/numa_node", dir);
+             if (read_sysfs(path, buf, sizeof(buf)) == 0) {
+                 int node = atoi(buf);
+                 if (node >= 0) return node;
+             }
+         }
+
+         /* A partition: retry from the disk that contains it */
+         char* slash = strrchr(base, '/');
+         if (!slash) break;
+         *slash = '\0';
+     }
+     return -1;
+ }
+
+ /**
+  * @brief NUMA node of the block device holding a path
+  *
+  * @param path Any path on the device
+  * @return Node number, or -1 if unknown
+  */
+ int placement_node_of_path(const char* path) {
+     struct stat st;
+     if (stat(path, &st) < 0) return -1;
+
+     pthread_mutex_lock(&dev_lock);
+     for (int i = 0; i < dev_cached; i++) {
+         if (dev_cache[i].dev == st.st_dev) {
+             int node = dev_cache[i].node;
+             pthread_mutex_unlock(&dev_lock);
+             return node;
+         }
+     }
+     pthread_mutex_unlock(&dev_lock);
+
+     int node = sysfs_device_node(st.st_dev);
+     if (node >= placement_nodes()) node = -1;
+
+     pthread_mutex_lock(&dev_lock);
+     if (dev_cached < DEVICE_CACHE) {
+         dev_cache[dev_cached].dev = st.st_dev;
+         dev_cache[dev_cached].node = node;
+         dev_cached++;
+     }
+     pthread_mutex_unlock(&dev_lock);
+     return node;
+ }
+
+ /**
+  * @brief Resolve a numa_node option for a source/target pair
+  *
+  * Auto prefers the target's node: the copy's writes, and the page cache
+  * pages they dirty, are what the device's DMA has to reach.
+  *
+  * @param numa_node Node number, PLACEMENT_AUTO or PLACEMENT_OFF
+  * @param source_dir Source directory
+  * @param target_dir Target directory
+  * @return Node to bind to, or -1 for no binding
+  */
+ int placement_resolve(int numa_node, const char* source_dir, const char* target_dir) {
+     if (numa_node == PLACEMENT_OFF) return -1;
+     if (numa_node >= 0) return numa_node < placement_nodes() ? numa_node : -1;
+
+     /* Binding is pointless with one node */
+     if (placement_nodes() < 2) return -1;
+     int node = placement_node_of_path(target_dir);
+     if (node < 0) node = placement_node_of_path(source_dir);
+     return node;
+ }
+
+ /**
+  * @brief Pin the calling thread to a node's CPUs
+  *
+  * @param node Node number
+  * @param saved Filled with the previous affinity (may be NULL)
+  * @return 0 on success, -1 on error
+  */
+ int placement_bind(int node, cpu_set_t* saved) {
+     cpu_set_t set;
+     if (placement_node_cpus(node, &set) < 0 || CPU_COUNT(&set) == 0) {
+         errno = EINVAL;
+         return -1;
+     }
+     if (saved && sched_getaffinity(0, sizeof(*saved), saved) < 0) return -1;
+     if (sched_setaffinity(0, sizeof(set), &set) < 0) return -1;
+     bound_node = node;
+     return 0;
+ }
+
+ /**
+  * @brief Undo placement_bind()
+  *
+  * @param saved Affinity returned by placement_bind()
+  */
+ void placement_unbind(const cpu_set_t* saved) {
+     sched_setaffinity(0, sizeof(*saved), saved);
+     bound_node = -1;
+ }
+
+ /**
+  * @brief Node the calling thread is bound to
+  *
+  * @return Node number, or -1 if the thread is not bound
+  */
+ int placement_current_node(void) {
+     return bound_node;
+ }
+
+ /**
+  * @brief Map huge-page-aligned memory and ask for transparent huge pages
+  *
+  * @param len Bytes to map (a multiple of PLACEMENT_HUGE_PAGE)
+  * @return Mapping, or MAP_FAILED
+  */
+ static void* map_thp(size_t len) {
+     /* Over-map by one huge page and trim, so the start is aligned */
+     size_t span = len + PLACEMENT_HUGE_PAGE;
+     char* raw = mmap(NULL, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+     if (raw == MAP_FAILED) return MAP_FAILED;
+
+     uintptr_t start = ((uintptr_t)raw + PLACEMENT_HUGE_PAGE - 1) & ~(PLACEMENT_HUGE_PAGE - 1);
+     char* p = (char*)start;
+     if (p > raw) munmap(raw, p - raw);
+     if (raw + span > p + len) munmap(p + len, raw + span - (p + len));
+     return p;
+ }
+
+ /**
+  * @brief Allocate a buffer whose pages live on the calling thread's node
+  *
+  * @param b Buffer to fill in
+  * @param size Bytes needed
+  * @param huge Back the buffer with huge pages if possible
+  * @return 0 on success, -1 on error
+  */
+ int placement_buf_alloc(placement_buf_t* b, size_t size, int huge) {
+     void* p = MAP_FAILED;
+
+     memset(b, 0, sizeof(*b));
+     b->size = size;
+     b->mapped = size;
+     b->pages = PLACEMENT_PAGES_SMALL;
+
+     if (huge) {
+         b->mapped = (size + PLACEMENT_HUGE_PAGE - 1) & ~(PLACEMENT_HUGE_PAGE - 1);
+         p = mmap(NULL, b->mapped, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+         if (p != MAP_FAILED) {
+             b->pages = PLACEMENT_PAGES_HUGETLB;
+         } else if ((p = map_thp(b->mapped)) != MAP_FAILED) {
+             /* No reserved huge pages: let khugepaged back it instead */
+             if (madvise(p, b->mapped, MADV_HUGEPAGE) == 0)
+                 b->pages = PLACEMENT_PAGES_THP;
+         }
+     }
+     if (p == MAP_FAILED) {
+         b->mapped = size;
+         p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+         if (p == MAP_FAILED) return -1;
+     }
+
+     memset(p, 0, b->mapped);  /* First touch: pages come from the local node */
+     b->data = p;
+     return 0;
+ }
+
+ /**
+  * @brief Free a buffer from placement_buf_alloc()
+  *
+  * @param b Buffer (freeing an unallocated one does nothing)
+  */
+ void placement_buf_free(placement_buf_t* b) {
+     if (b->data) munmap(b->data, b->mapped);
+     b->data = NULL;
+ }
@@ -0,0 +1,335 @@
+/**
+ * @file poll_monitor.c
+ * @brief Implementation of polling change detection
+ *
+ * The manifest is a chained hash table keyed by entry name. Every scan
+ * bumps a generation counter and stamps each entry it finds with it; the
+ * entries left with an older stamp afterwards are the deleted ones.
+ */
+
+ #define _GNU_SOURCE  /* statx() */
+ #include "../include/poll_monitor.h"
+ #include "../include/dir_walk.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <string.h>
+ #include <errno.h>
+ #include <fcntl.h>
+ #include <sys/stat.h>
+ #include <sys/inotify.h>
+
+ #define DEFAULT_MIN_INTERVAL 2             /**< Default poll_min (seconds) */
+ #define DEFAULT_MAX_INTERVAL 60            /**< Default poll_max (seconds) */
+ #define MAX_POLL_INTERVAL (24 * 3600)      /**< Largest interval accepted (a day) */
+ #define MANIFEST_BUCKETS 64                /**< Initial hash buckets */
+ #define SCAN_STATX_MASK (STATX_TYPE | STATX_INO | STATX_SIZE | STATX_MTIME)  /**< Fields compared */
+
+ /**
+  * @struct poll_entry
+  * @brief What the last scan saw of one directory entry
+  */
+ typedef struct poll_entry {
+     struct poll_entry* next;   /**< Next entry in the bucket */
+     uint64_t hash;             /**< Hash of name */
+     uint64_t ino;              /**< Inode number */
+     uint64_t size;             /**< Size in bytes */
+     long long mtime_ns;        /**< Modification time in nanoseconds */
+     unsigned type;             /**< File type bits (S_IFMT) */
+     unsigned gen;              /**< Scan that last saw it */
+     char name[];               /**< Entry name */
+ } poll_entry_t;
+
+ /**
+  * @struct poll_manifest
+  * @brief Manifest handle
+  */
+ struct poll_manifest {
+     poll_entry_t** buckets;    /**< Hash buckets */
+     size_t nbuckets;           /**< Number of buckets (a power of two) */
+     size_t count;              /**< Entries */
+     unsigned gen;              /**< Current scan */
+     int primed;                /**< A baseline has been recorded */
+ };
+
+ /**
+  * @struct scan_ctx
+  * @brief State of one scan, shared with the walk callback
+  */
+ typedef struct scan_ctx {
+     poll_manifest_t* m;        /**< Manifest being updated */
+     poll_change_fn fn;         /**< Change callback */
+     void* ctx;                 /**< Its context */
+     long changes;              /**< Changes reported so far */
+ } scan_ctx_t;
+
+ /**
+  * @brief Parse an interval in seconds
+  *
+  * @param value Text
+  * @param out Seconds
+  * @return 0 on success, -1 if invalid
+  */
+ static int parse_interval(const char* value, int* out) {
+     char* end;
+     long v = strtol(value, &end, 10);
+     if (!*value || *end || v < 1 || v > MAX_POLL_INTERVAL) return -1;
+     *out = (int)v;
+     return 0;
+ }
+
+ /**
+  * @brief Fill in the defaults (inotify)
+  *
+  * @param o Options to initialize
+  */
+ void poll_options_init(poll_options_t* o) {
+     o->monitor = MONITOR_INOTIFY;
+     o->min_interval = DEFAULT_MIN_INTERVAL;
+     o->max_interval = DEFAULT_MAX_INTERVAL;
+ }
+
+ /**
+  * @brief Set one monitor option
+  *
+  * @param o Options to update
+  * @param key Option name
+  * @param value Option value
+  * @return 0 if set, -1 if the value is invalid, 1 if key is not a monitor option
+  */
+ int poll_options_set(poll_options_t* o, const char* key, const char* value) {
+     if (!strcmp(key, "monitor")) {
+         if (!strcmp(value, "inotify")) o->monitor = MONITOR_INOTIFY;
+         else if (!strcmp(value, "poll")) o->monitor = MONITOR_POLL;
+         else return -1;
+         return 0;
+     }
+     if (!strcmp(key, "poll_min")) return parse_interval(value, &o->min_interval);
+     if (!strcmp(key, "poll_max")) return parse_interval(value, &o->max_interval);
+     return 1;
+ }
+
+ /**
+  * @brief Check the options once all of them are set
+  *
+  * @param o Options
+  * @return 0 if usable, -1 if poll_min exceeds poll_max
+  */
+ int poll_options_validate(const poll_options_t* o) {
+     return o->min_interval > o->max_interval ? -1 : 0;
+ }
+
+ /**
+  * @brief Pick the interval until the next scan
+  *
+  * @param o Options
+  * @param cur Current interval in seconds
+  * @param changes Changes the last scan found
+  * @param scan_ms How long the last scan took
+  * @return Next interval in seconds
+  */
+ int poll_next_interval(const poll_options_t* o, int cur, size_t changes, long long scan_ms) {
+     long long next = changes ? cur / 2 : (long long)cur * 2;
+     long long floor = (scan_ms * 4 + 999) / 1000;
+     if (next < floor) next = floor;
+     if (next < o->min_interval) next = o->min_interval;
+     if (next > o->max_interval) next = o->max_interval;
+     return (int)next;
+ }
+
+ /**
+  * @brief FNV-1a hash of a name
+  *
+  * @param s Name
+  * @return Hash
+  */
+ static uint64_t hash_name(const char* s) {
+     uint64_t h = 14695981039346656037ULL;
+     for (; *s; s++) {
+         h ^= (unsigned char)*s;
+         h *= 1099511628211ULL;
+     }
+     return h;
+ }
+
+ /**
+  * @brief Create an empty manifest
+  *
+  * @return New manifest
+  */
+ poll_manifest_t* poll_manifest_create(void) {
+     poll_manifest_t* m = calloc(1, sizeof(*m));
+     m->nbuckets = MANIFEST_BUCKETS;
+     m->buckets = calloc(m->nbuckets, sizeof(*m->buckets));
+     return m;
+ }
+
+ /**
+  * @brief Free a manifest
+  *
+  * @param m Manifest to destroy (may be NULL)
+  */
+ void poll_manifest_destroy(poll_manifest_t* m) {
+     if (!m) return;
+     for (size_t i = 0; i < m->nbuckets; i++) {
+         poll_entry_t* e = m->buckets[i];
+         while (e) {
+             poll_entry_t* next = e->next;
+             free(e);
+             e = next;
+         }
+     }
+     free(m->buckets);
+     free(m);
+ }
+
+ /**
+  * @brief Number of entries the last scan found
+  *
+  * @param m Manifest
+  * @return Entries
+  */
+ size_t poll_manifest_size(const poll_manifest_t* m) {
+     return m->count;
+ }
+
+ /**
+  * @brief Double the bucket array once the table is fuller than one entry per bucket
+  *
+  * @param m Manifest
+  */
+ static void maybe_grow(poll_manifest_t* m) {
+     if (m->count <= m->nbuckets) return;
+     size_t n = m->nbuckets * 2;
+     poll_entry_t** b = calloc(n, sizeof(*b));
+     for (size_t i = 0; i < m->nbuckets; i++) {
+         poll_entry_t* e = m->buckets[i];
+         while (e) {
+             poll_entry_t* next = e->next;
+             e->next = b[e->hash & (n - 1)];
+             b[e->hash & (n - 1)] = e;
+             e = next;
+         }
+     }
+     free(m->buckets);
+     m->buckets = b;
+     m->nbuckets = n;
+ }
+
+ /**
+  * @brief Find an entry by name
+  *
+  * @param m Manifest
+  * @param name Entry name
+  * @param hash hash_name(name)
+  * @return Entry, or NULL if the manifest has none by that name
+  */
+ static poll_entry_t* find_entry(poll_manifest_t* m, const char* name, uint64_t hash) {
+     for (poll_entry_t* e = m->buckets[hash & (m->nbuckets - 1)]; e; e = e->next)
+         if (e->hash == hash && !strcmp(e->name, name)) return e;
+     return NULL;
+ }
+
+ /**
+  * @brief Report a change, unless this scan only records the baseline
+  *
+  * @param s Scan
+  * @param name Entry name
+  * @param type File type bits of the entry
+  * @param mask IN_CREATE, IN_MODIFY or IN_DELETE
+  */
+ static void report(scan_ctx_t* s, const char* name, unsigned type, uint32_t mask) {
+     if (!s->m->primed) return;
+     s->fn(name, S_ISDIR(type) ? mask | IN_ISDIR : mask, s->ctx);
+     s->changes++;
+ }
+
+ /**
+  * @brief Walk callback: stat a batch of entries and diff them against the manifest
+  *
+  * All entries of a batch share one directory fd, so every statx() is a
+  * single lookup in an already open directory.
+  *
+  * @param batch Entries
+  * @param n Number of entries
+  * @param ctx Scan
+  */
+ static void scan_batch(const dir_walk_entry_t* batch, size_t n, void* ctx) {
+     scan_ctx_t* s = ctx;
+     poll_manifest_t* m = s->m;
+
+     for (size_t i = 0; i < n; i++) {
+         const char* name = batch[i].name;
+         uint64_t hash = hash_name(name);
+         poll_entry_t* e = find_entry(m, name, hash);
+         struct statx stx;
+
+         if (statx(batch[i].dirfd, name, AT_SYMLINK_NOFOLLOW, SCAN_STATX_MASK, &stx) < 0) {
+             /* Gone since it was listed: the sweep deletes it. Otherwise keep it as it was */
+             if (errno != ENOENT && e) e->gen = m->gen;
+             continue;
+         }
+         unsigned type = stx.stx_mode & S_IFMT;
+         long long mtime = stx.stx_mtime.tv_sec * 1000000000LL + stx.stx_mtime.tv_nsec;
+
+         if (!e) {
+             e = malloc(sizeof(*e) + strlen(name) + 1);
+             strcpy(e->name, name);
+             e->hash = hash;
+             e->next = m->buckets[hash & (m->nbuckets - 1)];
+             m->buckets[hash & (m->nbuckets - 1)] = e;
+             m->count++;
+             maybe_grow(m);
+             report(s, name, type, IN_CREATE);
+         } else if (e->type != type) {
+             report(s, name, e->type, IN_DELETE);
+             report(s, name, type, IN_CREATE);
+         } else if (!S_ISDIR(type) &&
+                    (e->ino != stx.stx_ino || e->size != stx.stx_size || e->mtime_ns != mtime)) {
+             report(s, name, type, IN_MODIFY);
+         }
+         e->ino = stx.stx_ino;
+         e->size = stx.stx_size;
+         e->mtime_ns = mtime;
+         e->type = type;
+         e->gen = m->gen;
+     }
+ }
+
+ /**
+  * @brief Rescan a directory and report what changed since the last scan
+  *
+  * @param m Manifest of the directory (not shared between threads)
+  * @param dir Directory to scan
+  * @param fn Callback for each change
+  * @param ctx Context passed to fn
+  * @return Number of changes reported, or -1 if dir could not be read
+  */
+ long poll_scan(poll_manifest_t* m, const char* dir, poll_change_fn fn, void* ctx) {
+     scan_ctx_t s = { .m = m, .fn = fn, .ctx = ctx, .changes = 0 };
+     dir_walk_opts_t opts = { .threads = 1, .max_depth = 1, .batch_size = 0 };
+
+     m->gen++;
+     if (dir_walk(dir, &opts, scan_batch, &s) < 0) {
+         /* Nothing was stamped: keep the old generation current */
+         m->gen--;
+         return -1;
+     }
+
+     /* Sweep: whatever this scan did not see was deleted */
+     for (size_t i = 0; i < m->nbuckets; i++) {
+         poll_entry_t** pp = &m->buckets[i];
+         while (*pp) {
+             poll_entry_t* e = *pp;
+             if (e->gen == m->gen) {
+                 pp = &e->next;
+                 continue;
+             }
+             report(&s, e->name, e->type, IN_DELETE);
+             *pp = e->next;
+             free(e);
+             m->count--;
+         }
+     }
+     m->primed = 1;
+     return s.changes;
+ }
@@ -0,0 +1,215 @@
+/**
+ * @file purge.c
+ * @brief Implementation of the parallel tree deletion engine
+ *
+ * Deletion runs in two phases. The directory walker visits the tree with
+ * several threads and unlinks every non-directory entry through the fd of
+ * its containing directory, collecting subdirectories as it goes. The
+ * (now empty) directories are then removed deepest first, relative to a
+ * single fd on the root.
+ */
+
+ #include "../include/purge.h"
+ #include "../include/dir_walk.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <string.h>
+ #include <errno.h>
+ #include <fcntl.h>
+ #include <unistd.h>
+ #include <time.h>
+ #include <dirent.h>
+ #include <pthread.h>
+ #include <stdatomic.h>
+ #include <sys/stat.h>
+ #include <linux/limits.h>
+
+ /**
+  * @struct purge_dir
+  * @brief A directory to remove once its contents are gone
+  */
+ typedef struct purge_dir {
+     int depth;      /**< Depth below the root (root's children = 1) */
+     char* relpath;  /**< Path relative to the root */
+ } purge_dir_t;
+
+ /**
+  * @struct purge_ctx
+  * @brief State shared by the walker callbacks
+  */
+ typedef struct purge_ctx {
+     long rate;                 /**< Unlinks per second (0 = unlimited) */
+     struct timespec start;     /**< When the purge started */
+     atomic_ulong ops;          /**< Unlinks issued so far (for the rate limit) */
+     atomic_ulong files;        /**< Files unlinked */
+     atomic_ulong errors;       /**< Failed removals */
+     pthread_mutex_t lock;      /**< Guards dirs */
+     purge_dir_t* dirs;         /**< Directories found */
+     size_t ndirs;              /**< Entries in dirs */
+     size_t cap;                /**< Capacity of dirs */
+ } purge_ctx_t;
+
+ /**
+  * @brief Seconds elapsed since a start time
+  *
+  * @param start Start time (CLOCK_MONOTONIC)
+  * @return Elapsed seconds
+  */
+ static double elapsed_since(const struct timespec* start) {
+     struct timespec now;
+     clock_gettime(CLOCK_MONOTONIC, &now);
+     return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+ }
+
+ /**
+  * @brief Wait until the next unlink is allowed by the rate limit
+  *
+  * Each operation takes a ticket; ticket n may run at start + n / rate.
+  *
+  * @param c Shared state
+  */
+ static void throttle(purge_ctx_t* c) {
+     if (c->rate <= 0) return;
+     unsigned long n = atomic_fetch_add(&c->ops, 1);
+     double wait = (double)n / c->rate - elapsed_since(&c->start);
+     if (wait > 0) {
+         struct timespec ts = { (time_t)wait, (long)((wait - (time_t)wait) * 1e9) };
+         nanosleep(&ts, NULL);
+     }
+ }
+
+ /**
+  * @brief Walker callback: unlink files, remember directories
+  *
+  * @param batch Entries from one directory
+  * @param n Number of entries
+  * @param arg purge_ctx_t
+  */
+ static void purge_batch(const dir_walk_entry_t* batch, size_t n, void* arg) {
+     purge_ctx_t* c = arg;
+
+     for (size_t i = 0; i < n; i++) {
+         const dir_walk_entry_t* e = &batch[i];
+
+         if (e->d_type == DT_DIR) {
+             char rel[PATH_MAX];
+             if (e->relpath[0]) snprintf(rel, sizeof(rel), "%s/%s", e->relpath, e->name);
+             else snprintf(rel, sizeof(rel), "%s", e->name);
+
+             pthread_mutex_lock(&c->lock);
+             if (c->ndirs == c->cap) {
+                 c->cap = c->cap ? c->cap * 2 : 256;
+                 c->dirs = realloc(c->dirs, c->cap * sizeof(*c->dirs));
+             }
+             c->dirs[c->ndirs].depth = e->depth + 1;
+             c->dirs[c->ndirs].relpath = strdup(rel);
+             c->ndirs++;
+             pthread_mutex_unlock(&c->lock);
+             continue;
+         }
+
+         throttle(c);
+         if (unlinkat(e->dirfd, e->name, 0) == 0) atomic_fetch_add(&c->files, 1);
+         else atomic_fetch_add(&c->errors, 1);
+     }
+ }
+
+ /**
+  * @brief qsort() comparator ordering directories deepest first
+  *
+  * @param a First purge_dir_t
+  * @param b Second purge_dir_t
+  * @return Negative if a is deeper than b
+  */
+ static int deepest_first(const void* a, const void* b) {
+     return ((const purge_dir_t*)b)->depth - ((const purge_dir_t*)a)->depth;
+ }
+
+ /**
+  * @brief Delete a file or a whole directory tree
+  *
+  * @param path File or directory to delete
+  * @param opts Options (NULL for single-threaded, unlimited rate)
+  * @param stats Receives counters (may be NULL)
+  * @return 0 if everything was removed, -1 otherwise
+  */
+ int purge_tree(const char* path, const purge_opts_t* opts, purge_stats_t* stats) {
+     purge_stats_t local = { 0, 0, 0 };
+     if (!stats) stats = &local;
+     memset(stats, 0, sizeof(*stats));
+
+     struct stat st;
+     if (lstat(path, &st) < 0) return -1;
+
+     /* Not a directory: a single unlink */
+     if (!S_ISDIR(st.st_mode)) {
+         if (unlink(path) < 0) {
+             stats->errors = 1;
+             return -1;
+         }
+         stats->files = 1;
+         return 0;
+     }
+
+     purge_ctx_t c;
+     memset(&c, 0, sizeof(c));
+     c.rate = opts ? opts->rate : 0;
+     clock_gettime(CLOCK_MONOTONIC, &c.start);
+     pthread_mutex_init(&c.lock, NULL);
+
+     /* Phase 1: unlink every file in parallel */
+     dir_walk_opts_t wopts = { .threads = opts ? opts->threads : 1 };
+     int unreadable = dir_walk(path, &wopts, purge_batch, &c);
+     int root_fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+     /* Phase 2: directories are empty now; remove them bottom-up */
+     qsort(c.dirs, c.ndirs, sizeof(*c.dirs), deepest_first);
+     for (size_t i = 0; i < c.ndirs; i++) {
+         throttle(&c);
+         if (root_fd >= 0 && unlinkat(root_fd, c.dirs[i].relpath, AT_REMOVEDIR) == 0) stats->dirs++;
+         else c.errors++;
+         free(c.dirs[i].relpath);
+     }
+     free(c.dirs);
+     if (root_fd >= 0) close(root_fd);
+
+     if (rmdir(path) == 0) stats->dirs++;
+     else c.errors++;
+
+     stats->files = atomic_load(&c.files);
+     stats->errors = atomic_load(&c.errors) + (unreadable > 0 ? unreadable : 0);
+     pthread_mutex_destroy(&c.lock);
+     return stats->errors ? -1 : 0;
+ }
+
+ /**
+  * @brief Rename a path aside so it disappears immediately
+  *
+  * @param path Path to move
+  * @param aside Buffer for the new path
+  * @param len Size of aside
+  * @return 0 on success, -1 on error (errno set)
+  */
+ int purge_rename_aside(const char* path, char* aside, size_t len) {
+     char copy[PATH_MAX];
+     snprintf(copy, sizeof(copy), "%s", path);
+
+     /* Strip trailing slashes so the last component is the name */
+     size_t n = strlen(copy);
+     while (n > 1 && copy[n - 1] == '/') copy[--n] = '\0';
+
+     char* slash = strrchr(copy, '/');
+     const char* name = slash ? slash + 1 : copy;
+     const char* parent = ".";
+     if (slash == copy) {
+         parent = "/";
+     } else if (slash) {
+         *slash = '\0';
+         parent = copy;
+     }
+
+     snprintf(aside, len, "%s%s.fss_purge.%s.%ld.%ld", parent,
+              strcmp(parent, "/") ? "/" : "", name, (long)getpid(), (long)time(NULL));
+     if (rename(path, aside) < 0) return -1;
+     return 0;
+ }
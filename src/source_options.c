@@ -0,0 +1,96 @@
+/**
+ * @file source_options.c
+ * @brief Implementation of per-source option parsing
+ */
+
+ #include "../include/source_options.h"
+ #include "../include/sync_ops.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <string.h>
+
+ #define MAX_LAG_LIMIT (366 * 24 * 3600)  /**< Largest max_lag accepted (a year) */
+
+ /**
+  * @brief Parse the option part of a config line into a sync_info_t
+  *
+  * @param text Whitespace-separated "key=value" options (may be empty)
+  * @param info Source to configure
+  * @param err Buffer for an error message
+  * @param errlen Size of err
+  * @return 0 on success, -1 on the first invalid option (err filled in)
+  */
+ int source_options_parse(const char* text, sync_info_t* info, char* err, size_t errlen) {
+     char buf[1024];
+     snprintf(buf, sizeof(buf), "%s", text ? text : "");
+     info->sync_opts[0] = '\0';
+     task_priority_init(&info->priority);
+     info->max_lag = 0;
+     info->digest = 0;
+     sync_policy_init(&info->policy);
+     poll_options_init(&info->poll);
+
+     /* Validate worker options here so mistakes surface at load time */
+     sync_options_t scratch;
+     sync_options_init(&scratch);
+
+     char* save = NULL;
+     for (char* tok = strtok_r(buf, " \t\r\n", &save); tok; tok = strtok_r(NULL, " \t\r\n", &save)) {
+         char* eq = strchr(tok, '=');
+         if (!eq || eq == tok) {
+             snprintf(err, errlen, "expected key=value, got '%s'", tok);
+             return -1;
+         }
+         *eq = '\0';
+         const char* key = tok;
+         const char* value = eq + 1;
+
+         if (sync_options_set(&scratch, key, value) == 0) {
+             size_t used = strlen(info->sync_opts);
+             int n = snprintf(info->sync_opts + used, sizeof(info->sync_opts) - used,
+                              "%s%s=%s", used ? "," : "", key, value);
+             if (n < 0 || (size_t)n >= sizeof(info->sync_opts) - used) {
+                 snprintf(err, errlen, "too many options");
+                 return -1;
+             }
+             continue;
+         }
+
+         /* Replication deadline, used by the manager's scheduler */
+         if (!strcmp(key, "max_lag")) {
+             char* end;
+             long v = strtol(value, &end, 10);
+             if (*value && !*end && v > 0 && v <= MAX_LAG_LIMIT) {
+                 info->max_lag = (int)v;
+                 continue;
+             }
+         }
+
+         /* Replica digests, kept by the manager */
+         if (!strcmp(key, "digest") && (!strcmp(value, "0") || !strcmp(value, "1"))) {
+             info->digest = value[0] == '1';
+             continue;
+         }
+
+         /* Priority is handed to each task when the manager launches it */
+         if (task_priority_set(&info->priority, key, value) == 0) continue;
+
+         /* So is the sync policy, through its timers */
+         if (sync_policy_set(&info->policy, key, value) == 0) continue;
+
+         /* And the monitor backend, when the source is added */
+         if (poll_options_set(&info->poll, key, value) == 0) continue;
+
+         snprintf(err, errlen, "invalid option %s=%s", key, value);
+         return -1;
+     }
+     if (sync_policy_validate(&info->policy) < 0) {
+         snprintf(err, errlen, "policy=window needs window=HH:MM-HH:MM");
+         return -1;
+     }
+     if (poll_options_validate(&info->poll) < 0) {
+         snprintf(err, errlen, "poll_min exceeds poll_max");
+         return -1;
+     }
+     return 0;
+ }
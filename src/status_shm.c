@@ -0,0 +1,321 @@
+/**
+ * @file status_shm.c
+ * @brief Implementation of the shared-memory status table
+ *
+ * The file starts with a header, followed by the slots. Everything is
+ * fixed-size, so a reader maps the whole file once and never needs to
+ * remap: the manager sizes it for STATUS_SHM_SLOTS up front (the file is
+ * sparse until slots are used).
+ */
+
+ #include "../include/status_shm.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <string.h>
+ #include <errno.h>
+ #include <fcntl.h>
+ #include <unistd.h>
+ #include <sched.h>
+ #include <stdatomic.h>
+ #include <time.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+
+ #define STATUS_SHM_MAGIC 0x53535346u  /**< "FSSS" */
+ #define STATUS_SHM_VERSION 1          /**< Layout version */
+
+ /**
+  * @struct status_shm_header
+  * @brief Start of the table file
+  */
+ typedef struct status_shm_header {
+     uint32_t magic;                   /**< STATUS_SHM_MAGIC */
+     uint32_t version;                 /**< STATUS_SHM_VERSION */
+     uint32_t slots;                   /**< Slots in the file */
+     uint32_t record_size;             /**< sizeof(status_record_t) of the writer */
+     _Atomic uint32_t used;            /**< Slots claimed */
+     int32_t pid;                      /**< Writer's process ID */
+     _Atomic int64_t heartbeat_ms;     /**< Writer's last heartbeat (-1 = none yet) */
+ } __attribute__((aligned(64))) status_shm_header_t;
+
+ /**
+  * @struct status_slot
+  * @brief One seqlock-guarded record
+  */
+ typedef struct status_slot {
+     _Atomic uint32_t seq;             /**< Odd while the writer updates rec */
+     status_record_t rec;              /**< Published record */
+ } __attribute__((aligned(64))) status_slot_t;
+
+ /**
+  * @struct status_shm
+  * @brief Mapping handle
+  */
+ struct status_shm {
+     status_shm_header_t* hdr;         /**< Mapped header */
+     status_slot_t* slots;             /**< Mapped slots */
+     size_t size;                      /**< Bytes mapped */
+     char path[PATH_MAX];              /**< Table file */
+ };
+
+ /**
+  * @brief Bytes a table with a number of slots takes
+  *
+  * @param slots Slots
+  * @return File size
+  */
+ static size_t table_size(unsigned slots) {
+     return sizeof(status_shm_header_t) + (size_t)slots * sizeof(status_slot_t);
+ }
+
+ /**
+  * @brief Map a table file
+  *
+  * @param fd Open table file
+  * @param size Bytes to map
+  * @param prot PROT_READ, or PROT_READ | PROT_WRITE
+  * @param path Table file name
+  * @return Handle, or NULL on error
+  */
+ static status_shm_t* map_table(int fd, size_t size, int prot, const char* path) {
+     void* p = mmap(NULL, size, prot, MAP_SHARED, fd, 0);
+     if (p == MAP_FAILED) return NULL;
+
+     status_shm_t* t = calloc(1, sizeof(*t));
+     t->hdr = p;
+     t->slots = (status_slot_t*)((char*)p + sizeof(status_shm_header_t));
+     t->size = size;
+     snprintf(t->path, sizeof(t->path), "%s", path);
+     return t;
+ }
+
+ /**
+  * @brief Create a status table and map it for writing (manager only)
+  *
+  * @param path Table file (replaced if it exists)
+  * @param slots Number of sources it can hold
+  * @return Table, or NULL on error (errno set)
+  */
+ status_shm_t* status_shm_create(const char* path, unsigned slots) {
+     /* Built under a temporary name and renamed into place: a reader still
+      * mapping an old table keeps it, instead of faulting on a truncated file */
+     char tmp[PATH_MAX + 8];
+     size_t size = table_size(slots);
+     snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+     int fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+     if (fd < 0) return NULL;
+     if (ftruncate(fd, size) < 0) {
+         close(fd);
+         unlink(tmp);
+         return NULL;
+     }
+     status_shm_t* t = map_table(fd, size, PROT_READ | PROT_WRITE, path);
+     close(fd);
+     if (!t) {
+         unlink(tmp);
+         return NULL;
+     }
+
+     t->hdr->slots = slots;
+     t->hdr->record_size = sizeof(status_record_t);
+     t->hdr->pid = getpid();
+     atomic_store(&t->hdr->used, 0);
+     atomic_store(&t->hdr->heartbeat_ms, -1);
+     t->hdr->version = STATUS_SHM_VERSION;
+     t->hdr->magic = STATUS_SHM_MAGIC;
+     if (rename(tmp, path) < 0) {
+         status_shm_close(t, 0);
+         unlink(tmp);
+         return NULL;
+     }
+     return t;
+ }
+
+ /**
+  * @brief Map an existing status table for reading
+  *
+  * @param path Table file
+  * @return Table, or NULL if it is missing or not a status table
+  */
+ status_shm_t* status_shm_open(const char* path) {
+     int fd = open(path, O_RDONLY | O_CLOEXEC);
+     if (fd < 0) return NULL;
+     struct stat st;
+     if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(status_shm_header_t)) {
+         close(fd);
+         return NULL;
+     }
+     status_shm_t* t = map_table(fd, st.st_size, PROT_READ, path);
+     close(fd);
+     if (!t) return NULL;
+
+     const status_shm_header_t* h = t->hdr;
+     if (h->magic != STATUS_SHM_MAGIC || h->version != STATUS_SHM_VERSION ||
+         h->record_size != sizeof(status_record_t) || table_size(h->slots) > t->size) {
+         status_shm_close(t, 0);
+         return NULL;
+     }
+     return t;
+ }
+
+ /**
+  * @brief Unmap a table
+  *
+  * @param t Table (may be NULL)
+  * @param remove Also delete the file (the manager does on shutdown)
+  */
+ void status_shm_close(status_shm_t* t, int remove) {
+     if (!t) return;
+     munmap(t->hdr, t->size);
+     if (remove) unlink(t->path);
+     free(t);
+ }
+
+ /**
+  * @brief Claim the next free slot (writer only)
+  *
+  * @param t Table
+  * @return Slot index, or -1 if the table is full
+  */
+ int status_shm_claim(status_shm_t* t) {
+     uint32_t used = atomic_load_explicit(&t->hdr->used, memory_order_relaxed);
+     if (used >= t->hdr->slots) return -1;
+     atomic_store_explicit(&t->hdr->used, used + 1, memory_order_release);
+     return (int)used;
+ }
+
+ /**
+  * @brief Publish a record into a slot (writer only)
+  *
+  * @param t Table
+  * @param slot Slot from status_shm_claim()
+  * @param rec Record
+  */
+ void status_shm_publish(status_shm_t* t, int slot, const status_record_t* rec) {
+     status_slot_t* s = &t->slots[slot];
+     uint32_t seq = atomic_load_explicit(&s->seq, memory_order_relaxed);
+
+     atomic_store_explicit(&s->seq, seq + 1, memory_order_relaxed);
+     atomic_thread_fence(memory_order_release);  /* Odd before any byte of rec changes */
+     memcpy(&s->rec, rec, sizeof(*rec));
+     atomic_store_explicit(&s->seq, seq + 2, memory_order_release);
+ }
+
+ /**
+  * @brief Record that the writer is alive (writer only)
+  *
+  * @param t Table
+  * @param now_ms Current CLOCK_MONOTONIC time in milliseconds
+  */
+ void status_shm_heartbeat(status_shm_t* t, int64_t now_ms) {
+     atomic_store_explicit(&t->hdr->heartbeat_ms, now_ms, memory_order_relaxed);
+ }
+
+ /**
+  * @brief Number of slots claimed so far
+  *
+  * @param t Table
+  * @return Slots
+  */
+ unsigned status_shm_count(const status_shm_t* t) {
+     return atomic_load_explicit(&t->hdr->used, memory_order_acquire);
+ }
+
+ /**
+  * @brief Milliseconds since the writer's last heartbeat
+  *
+  * @param t Table
+  * @return Age, or -1 if the writer never published
+  */
+ int64_t status_shm_age_ms(const status_shm_t* t) {
+     int64_t hb = atomic_load_explicit(&t->hdr->heartbeat_ms, memory_order_relaxed);
+     return hb < 0 ? -1 : status_shm_now_ms() - hb;
+ }
+
+ /**
+  * @brief Read a consistent copy of one slot
+  *
+  * @param t Table
+  * @param slot Slot index (below status_shm_count())
+  * @param out Record copy
+  * @return 0 on success, -1 if slot is out of range
+  */
+ int status_shm_read(const status_shm_t* t, unsigned slot, status_record_t* out) {
+     if (slot >= status_shm_count(t)) return -1;
+     status_slot_t* s = &t->slots[slot];
+
+     for (;;) {
+         uint32_t before = atomic_load_explicit(&s->seq, memory_order_acquire);
+         if (before & 1) {
+             sched_yield();  /* The writer is mid-update */
+             continue;
+         }
+         memcpy(out, &s->rec, sizeof(*out));
+         atomic_thread_fence(memory_order_acquire);  /* Copy done before the re-check */
+         if (atomic_load_explicit(&s->seq, memory_order_relaxed) == before) break;
+     }
+     out->source[sizeof(out->source) - 1] = '\0';
+     out->target[sizeof(out->target) - 1] = '\0';
+     return 0;
+ }
+
+ /**
+  * @brief Read the record of a source
+  *
+  * @param t Table
+  * @param source Source directory, as given to the manager
+  * @param out Record copy
+  * @return 0 on success, -1 if the table has no such source
+  */
+ int status_shm_find(const status_shm_t* t, const char* source, status_record_t* out) {
+     unsigned n = status_shm_count(t);
+     for (unsigned i = 0; i < n; i++)
+         if (status_shm_read(t, i, out) == 0 && !strcmp(out->source, source)) return 0;
+     return -1;
+ }
+
+ /**
+  * @brief Header line naming the fields of status_shm_format()
+  *
+  * @return Tab-separated field names, newline-terminated
+  */
+ const char* status_shm_fields(void) {
+     return "source\ttarget\tactive\tlast_sync\terrors\tqueued\tin_flight\tbytes_synced\t"
+            "lag_ms\tmax_lag\tdeadline_misses\theld_changes\tsuppressed\tage_ms\n";
+ }
+
+ /**
+  * @brief Format a record as one tab-separated line
+  *
+  * lag_ms is the age of the oldest unsynced change (0 if there is none),
+  * age_ms how long ago the manager published the record.
+  *
+  * @param rec Record
+  * @param now_ms Current CLOCK_MONOTONIC time in milliseconds
+  * @param out Output buffer
+  * @param len Size of out
+  * @return Length of the line
+  */
+ int status_shm_format(const status_record_t* rec, int64_t now_ms, char* out, size_t len) {
+     long long lag = rec->oldest_change_ms < 0 ? 0 : now_ms - rec->oldest_change_ms;
+     int n = snprintf(out, len, "%s\t%s\t%d\t%lld\t%d\t%d\t%d\t%llu\t%lld\t%d\t%llu\t%llu\t%llu\t%lld\n",
+                      rec->source, rec->target, rec->active, (long long)rec->last_sync,
+                      rec->errors, rec->queued, rec->in_flight,
+                      (unsigned long long)rec->bytes_synced, lag, rec->max_lag,
+                      (unsigned long long)rec->deadline_misses,
+                      (unsigned long long)rec->held_changes,
+                      (unsigned long long)rec->suppressed_events,
+                      (long long)(now_ms - rec->updated_ms));
+     return n < (int)len ? n : (int)len - 1;
+ }
+
+ /**
+  * @brief Current CLOCK_MONOTONIC time in milliseconds
+  *
+  * @return Milliseconds
+  */
+ int64_t status_shm_now_ms(void) {
+     struct timespec ts;
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+ }
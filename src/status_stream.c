@@ -0,0 +1,198 @@
+/**
+ * @file status_stream.c
+ * @brief Implementation of the streamed bulk status response
+ *
+ * Each response keeps a hashmap cursor and a buffer of formatted records.
+ * A pump refills the buffer with whole records, then writes it in chunks of
+ * at most PIPE_BUF bytes ending on a line boundary, so records never
+ * interleave with other output on the same FIFO. When the FIFO is full the
+ * rest waits for the next pump; the cursor only advances as space frees up.
+ */
+
+ #include "../include/status_stream.h"
+ #include "../include/hashmap.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <string.h>
+ #include <errno.h>
+ #include <unistd.h>
+ #include <limits.h>
+ #include <linux/limits.h>
+
+ /**
+  * @struct status_resp
+  * @brief One bulk status response in progress
+  */
+ typedef struct status_resp {
+     int fd;                            /**< Output fd */
+     HashIterator it;                   /**< Position in the hashmap */
+     int walked;                        /**< Every source has been formatted */
+     int trailer;                       /**< The END line has been queued */
+     unsigned long count;               /**< Records formatted so far */
+     char end[64];                      /**< Line queued after the trailer ("" for none) */
+     char buf[STATUS_STREAM_BUFSIZE];   /**< Formatted, unwritten bytes */
+     size_t len;                        /**< Bytes in buf */
+ } status_resp_t;
+
+ static status_resp_t* resps[STATUS_STREAM_MAX];  /**< Responses in progress */
+
+ /**
+  * @brief Start a bulk status response on an output fd
+  *
+  * @param fd Non-blocking output fd
+  * @param end Line written after the trailer (NULL for none)
+  * @return 0 on success, -1 if no slot is free or fd already has one
+  */
+ int status_stream_start(int fd, const char* end) {
+     int slot = -1;
+     for (int i = 0; i < STATUS_STREAM_MAX; i++) {
+         if (resps[i] && resps[i]->fd == fd) return -1;
+         if (!resps[i] && slot < 0) slot = i;
+     }
+     if (slot < 0) return -1;
+
+     status_resp_t* r = calloc(1, sizeof(*r));
+     r->fd = fd;
+     r->it = hashGetIterator();
+     snprintf(r->end, sizeof(r->end), "%s", end ? end : "");
+     r->len = snprintf(r->buf, sizeof(r->buf),
+                       "BEGIN STATUS_ALL fields=source,target,active,syncing,last_sync,"
+                       "errors,queued,in_flight,bytes_synced,suppressed,"
+                       "last_error_time,last_error,max_lag,deadline_misses,held_changes\n");
+     resps[slot] = r;
+     return 0;
+ }
+
+ /**
+  * @brief Format one source as a record line
+  *
+  * @param info Source to format
+  * @param out Output buffer
+  * @param size Size of out
+  * @return Length of the line
+  */
+ static int format_record(const sync_info_t* info, char* out, size_t size) {
+     char lerr_time[24] = "-";
+     if (info->last_error_time)
+         snprintf(lerr_time, sizeof(lerr_time), "%ld", (long)info->last_error_time);
+
+     int n = snprintf(out, size, "%s\t%s\t%d\t%d\t%ld\t%d\t%d\t%d\t%llu\t%lu\t%s\t%s\t%d\t%lu\t%lu\n",
+                      info->source_dir, info->target_dir, info->active, info->syncing,
+                      (long)info->last_sync_time, info->error_count,
+                      info->queued, info->in_flight, info->bytes_synced,
+                      info->suppressed_events, lerr_time,
+                      info->last_error[0] ? info->last_error : "-",
+                      info->max_lag, info->deadline_misses, info->held_changes);
+     if (n >= (int)size) {
+         /* Truncated: keep the record on one line */
+         n = size - 1;
+         out[n - 1] = '\n';
+     }
+     return n;
+ }
+
+ /**
+  * @brief Top up a response's buffer with whole records
+  *
+  * @param r Response to fill
+  */
+ static void fill(status_resp_t* r) {
+     char line[PATH_MAX * 2 + 256];
+
+     while (!r->walked) {
+         /* Stop while a worst-case record might not fit */
+         if (r->len + sizeof(line) > sizeof(r->buf)) return;
+
+         sync_info_t* info = hashNext(&r->it);
+         if (!info) {
+             r->walked = 1;
+             break;
+         }
+         int n = format_record(info, line, sizeof(line));
+         memcpy(r->buf + r->len, line, n);
+         r->len += n;
+         r->count++;
+     }
+
+     if (!r->trailer && r->len + 64 + sizeof(r->end) <= sizeof(r->buf)) {
+         r->len += snprintf(r->buf + r->len, sizeof(r->buf) - r->len,
+                            "END STATUS_ALL count=%lu\n%s", r->count, r->end);
+         r->trailer = 1;
+     }
+ }
+
+ /**
+  * @brief Write buffered bytes without blocking
+  *
+  * @param r Response to write
+  * @return 1 if the FIFO is full, 0 if the buffer was drained, -1 if the
+  *         reader went away
+  */
+ static int drain(status_resp_t* r) {
+     size_t off = 0;
+     int full = 0;
+
+     while (off < r->len) {
+         /* Largest run of whole lines within PIPE_BUF */
+         size_t chunk = r->len - off;
+         if (chunk > PIPE_BUF) {
+             chunk = PIPE_BUF;
+             while (chunk > 0 && r->buf[off + chunk - 1] != '\n') chunk--;
+             if (chunk == 0) chunk = PIPE_BUF;  /* Record longer than PIPE_BUF */
+         }
+
+         ssize_t w = write(r->fd, r->buf + off, chunk);
+         if (w > 0) {
+             off += w;
+             continue;
+         }
+         if (w < 0 && errno == EINTR) continue;
+         if (w < 0 && errno == EAGAIN) {
+             full = 1;
+             break;
+         }
+         return -1;
+     }
+
+     memmove(r->buf, r->buf + off, r->len - off);
+     r->len -= off;
+     return full;
+ }
+
+ /**
+  * @brief Format and write as much of each response as its fd accepts
+  */
+ void status_stream_pump(void) {
+     for (int i = 0; i < STATUS_STREAM_MAX; i++) {
+         status_resp_t* r = resps[i];
+         if (!r) continue;
+
+         int rc;
+         do {
+             fill(r);
+             rc = drain(r);
+         } while (rc == 0 && !(r->trailer && r->len == 0));
+
+         /* Done, or nobody is reading any more */
+         if (rc < 0 || (r->trailer && r->len == 0)) {
+             free(r);
+             resps[i] = NULL;
+         }
+     }
+ }
+
+ /**
+  * @brief Add fds of unfinished responses to a select() write set
+  *
+  * @param wfds Write set to extend
+  * @param maxfd Current highest fd + 1
+  * @return New highest fd + 1
+  */
+ int status_stream_fill_wfds(fd_set* wfds, int maxfd) {
+     for (int i = 0; i < STATUS_STREAM_MAX; i++) {
+         if (!resps[i]) continue;
+         FD_SET(resps[i]->fd, wfds);
+         if (resps[i]->fd >= maxfd) maxfd = resps[i]->fd + 1;
+     }
+     return maxfd;
+ }
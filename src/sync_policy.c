@@ -0,0 +1,154 @@
+/**
+ * @file sync_policy.c
+ * @brief Implementation of per-source sync policies
+ */
+
+ #include "../include/sync_policy.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <string.h>
+
+ #define DEFAULT_INTERVAL 3600           /**< Default flush period (seconds) */
+ #define MAX_INTERVAL (30 * 24 * 3600)   /**< Largest interval accepted (30 days) */
+ #define DAY_SECONDS (24 * 3600)         /**< Seconds per day */
+
+ /**
+  * @brief Parse "HH:MM" into minutes after midnight
+  *
+  * @param s Text (exactly HH:MM)
+  * @param len Length of s
+  * @param out Minutes
+  * @return 0 on success, -1 if invalid
+  */
+ static int parse_clock(const char* s, size_t len, int* out) {
+     int h, m, used = 0;
+     char buf[8];
+     if (len == 0 || len >= sizeof(buf)) return -1;
+     memcpy(buf, s, len);
+     buf[len] = '\0';
+     if (sscanf(buf, "%2d:%2d%n", &h, &m, &used) != 2 || used != (int)len) return -1;
+     if (h < 0 || h > 23 || m < 0 || m > 59) return -1;
+     *out = h * 60 + m;
+     return 0;
+ }
+
+ /**
+  * @brief Fill in the defaults (realtime)
+  *
+  * @param p Policy to initialize
+  */
+ void sync_policy_init(sync_policy_t* p) {
+     p->kind = SYNC_POLICY_REALTIME;
+     p->interval = DEFAULT_INTERVAL;
+     p->window_start = -1;
+     p->window_end = -1;
+ }
+
+ /**
+  * @brief Set one policy option
+  *
+  * @param p Policy to update
+  * @param key Option name
+  * @param value Option value
+  * @return 0 if set, -1 if the value is invalid, 1 if key is not a policy option
+  */
+ int sync_policy_set(sync_policy_t* p, const char* key, const char* value) {
+     if (!strcmp(key, "policy")) {
+         if (!strcmp(value, "realtime")) p->kind = SYNC_POLICY_REALTIME;
+         else if (!strcmp(value, "interval")) p->kind = SYNC_POLICY_INTERVAL;
+         else if (!strcmp(value, "window")) p->kind = SYNC_POLICY_WINDOW;
+         else return -1;
+         return 0;
+     }
+     if (!strcmp(key, "interval")) {
+         char* end;
+         long v = strtol(value, &end, 10);
+         if (!*value || *end || v < 1 || v > MAX_INTERVAL) return -1;
+         p->interval = v;
+         return 0;
+     }
+     if (!strcmp(key, "window")) {
+         const char* dash = strchr(value, '-');
+         int start, end;
+         if (!dash || parse_clock(value, dash - value, &start) < 0 ||
+             parse_clock(dash + 1, strlen(dash + 1), &end) < 0)
+             return -1;
+         p->window_start = start;
+         p->window_end = end;
+         return 0;
+     }
+     return 1;
+ }
+
+ /**
+  * @brief Check a policy once all its options are set
+  *
+  * @param p Policy
+  * @return 0 if usable, -1 if policy=window has no window
+  */
+ int sync_policy_validate(const sync_policy_t* p) {
+     return p->kind == SYNC_POLICY_WINDOW && p->window_start < 0 ? -1 : 0;
+ }
+
+ /**
+  * @brief Seconds since local midnight
+  *
+  * @param now Time
+  * @return Seconds
+  */
+ static long seconds_of_day(time_t now) {
+     struct tm tm;
+     localtime_r(&now, &tm);
+     return tm.tm_hour * 3600L + tm.tm_min * 60L + tm.tm_sec;
+ }
+
+ /**
+  * @brief Check whether a time falls inside the window
+  *
+  * @param p Policy with a window
+  * @param now Time to check
+  * @return 1 if inside (a window that closes when it opens is always open), 0 otherwise
+  */
+ int sync_policy_in_window(const sync_policy_t* p, time_t now) {
+     long s = seconds_of_day(now), open = p->window_start * 60L, close = p->window_end * 60L;
+     if (open == close) return 1;
+     if (open < close) return s >= open && s < close;
+     return s >= open || s < close;  /* Wraps past midnight */
+ }
+
+ /**
+  * @brief Seconds until the window next opens or closes
+  *
+  * @param p Policy with a window
+  * @param now Current time
+  * @return Seconds, at least 1
+  */
+ long sync_policy_next_boundary(const sync_policy_t* p, time_t now) {
+     long s = seconds_of_day(now);
+     long to_open = ((p->window_start * 60L - s) % DAY_SECONDS + DAY_SECONDS) % DAY_SECONDS;
+     long to_close = ((p->window_end * 60L - s) % DAY_SECONDS + DAY_SECONDS) % DAY_SECONDS;
+     if (to_open == 0) to_open = DAY_SECONDS;
+     if (to_close == 0) to_close = DAY_SECONDS;
+     return to_open < to_close ? to_open : to_close;
+ }
+
+ /**
+  * @brief Describe a policy as text ("realtime", "interval 3600s", "window 22:00-06:00")
+  *
+  * @param p Policy
+  * @param out Output buffer
+  * @param len Size of out
+  */
+ void sync_policy_describe(const sync_policy_t* p, char* out, size_t len) {
+     switch (p->kind) {
+     case SYNC_POLICY_INTERVAL:
+         snprintf(out, len, "interval %ds", p->interval);
+         break;
+     case SYNC_POLICY_WINDOW:
+         snprintf(out, len, "window %02d:%02d-%02d:%02d", p->window_start / 60,
+                  p->window_start % 60, p->window_end / 60, p->window_end % 60);
+         break;
+     default:
+         snprintf(out, len, "realtime");
+     }
+ }
@@ -0,0 +1,304 @@
+/**
+ * @file task_priority.c
+ * @brief Implementation of per-source task priority
+ *
+ * glibc has no ioprio_set() wrapper, so it is called through syscall().
+ * The ioprio and nice calls act on a single thread when given its TID,
+ * which is what lets the thread pool change them per task.
+ */
+
+ #define _GNU_SOURCE  /* SCHED_IDLE, gettid via syscall, prlimit() */
+ #include "../include/task_priority.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <string.h>
+ #include <errno.h>
+ #include <sched.h>
+ #include <unistd.h>
+ #include <sys/syscall.h>
+ #include <sys/resource.h>
+
+ #ifndef IOPRIO_WHO_PROCESS
+ #define IOPRIO_WHO_PROCESS 1
+ #endif
+ #define IOPRIO_CLASS_SHIFT 13                                  /**< Class bits above the level */
+ #define IOPRIO_PRIO_VALUE(c, l) (((c) << IOPRIO_CLASS_SHIFT) | (l))
+ #define IOPRIO_PRIO_CLASS(v) ((v) >> IOPRIO_CLASS_SHIFT)
+ #define IOPRIO_PRIO_DATA(v) ((v) & ((1 << IOPRIO_CLASS_SHIFT) - 1))
+
+ static const char* const io_class_names[] = { "none", "rt", "be", "idle" };  /**< By class number */
+
+ /**
+  * @brief Fill in "inherit everything"
+  *
+  * @param p Priority to initialize
+  */
+ void task_priority_init(task_priority_t* p) {
+     p->io_class = TASK_PRIORITY_UNSET;
+     p->io_level = 4;
+     p->sched_idle = 0;
+     p->nice = TASK_PRIORITY_UNSET;
+     p->cpu_limit = 0;
+ }
+
+ /**
+  * @brief Parse a whole decimal number within a range
+  *
+  * @param value Text to parse
+  * @param lo Lowest accepted value
+  * @param hi Highest accepted value
+  * @param out Parsed number
+  * @return 0 on success, -1 on error
+  */
+ static int parse_range(const char* value, long lo, long hi, long* out) {
+     char* end;
+     errno = 0;
+     long v = strtol(value, &end, 10);
+     if (errno || end == value || *end || v < lo || v > hi) return -1;
+     *out = v;
+     return 0;
+ }
+
+ /**
+  * @brief Set one priority option
+  *
+  * @param p Priority to update
+  * @param key Option name
+  * @param value Option value
+  * @return 0 on success, -1 if the value is invalid, 1 if the key is not a
+  *         priority option
+  */
+ int task_priority_set(task_priority_t* p, const char* key, const char* value) {
+     long v;
+
+     if (!strcmp(key, "io_class")) {
+         for (int c = 1; c <= 3; c++) {
+             if (!strcmp(value, io_class_names[c])) {
+                 p->io_class = c;
+                 return 0;
+             }
+         }
+         return -1;
+     }
+     if (!strcmp(key, "io_level")) {
+         if (parse_range(value, 0, 7, &v) < 0) return -1;
+         p->io_level = v;
+         return 0;
+     }
+     if (!strcmp(key, "cpu_sched")) {
+         if (!strcmp(value, "normal")) p->sched_idle = 0;
+         else if (!strcmp(value, "idle")) p->sched_idle = 1;
+         else return -1;
+         return 0;
+     }
+     if (!strcmp(key, "nice")) {
+         if (parse_range(value, -20, 19, &v) < 0) return -1;
+         p->nice = v;
+         return 0;
+     }
+     if (!strcmp(key, "cpu_limit")) {
+         if (parse_range(value, 1, 86400 * 365, &v) < 0) return -1;
+         p->cpu_limit = v;
+         return 0;
+     }
+     return 1;
+ }
+
+ /**
+  * @brief Check whether any field is configured
+  *
+  * @param p Priority
+  * @return 1 if nothing would be changed, 0 otherwise
+  */
+ int task_priority_is_default(const task_priority_t* p) {
+     return p->io_class == TASK_PRIORITY_UNSET && !p->sched_idle &&
+            p->nice == TASK_PRIORITY_UNSET && p->cpu_limit == 0;
+ }
+
+ /**
+  * @brief Format the configured fields as options ("io_class=idle,nice=19")
+  *
+  * @param p Priority
+  * @param out Output buffer ("" when nothing is configured)
+  * @param len Size of out
+  */
+ void task_priority_options(const task_priority_t* p, char* out, size_t len) {
+     size_t used = 0;
+
+     if (len == 0) return;
+     out[0] = '\0';
+     if (p->io_class != TASK_PRIORITY_UNSET)
+         used += snprintf(out + used, len - used, "io_class=%s,io_level=%d,",
+                          io_class_names[p->io_class], p->io_level);
+     if (used < len && p->sched_idle)
+         used += snprintf(out + used, len - used, "cpu_sched=idle,");
+     if (used < len && p->nice != TASK_PRIORITY_UNSET)
+         used += snprintf(out + used, len - used, "nice=%d,", p->nice);
+     if (used < len && p->cpu_limit > 0)
+         used += snprintf(out + used, len - used, "cpu_limit=%ld,", p->cpu_limit);
+     if (used > 0 && used < len) out[used - 1] = '\0';  /* Drop the trailing comma */
+ }
+
+ /**
+  * @brief Append a failure to the error buffer
+  *
+  * @param err Error buffer
+  * @param errlen Size of err
+  * @param what Setting that failed
+  */
+ static void add_error(char* err, size_t errlen, const char* what) {
+     if (!err || errlen == 0) return;
+     size_t used = strlen(err);
+     snprintf(err + used, errlen - used, "%s%s: %s", used ? "; " : "", what, strerror(errno));
+ }
+
+ /**
+  * @brief Apply a priority to the calling thread
+  *
+  * @param p Priority to apply
+  * @param process_wide Also set RLIMIT_CPU (only for a worker process)
+  * @param saved Filled with the previous values for task_priority_restore() (may be NULL)
+  * @param err Buffer for a description of what failed
+  * @param errlen Size of err
+  * @return 0 if everything was applied, -1 otherwise
+  */
+ int task_priority_apply(const task_priority_t* p, int process_wide,
+                         task_priority_saved_t* saved, char* err, size_t errlen) {
+     pid_t tid = syscall(SYS_gettid);
+     int rc = 0;
+
+     if (err && errlen) err[0] = '\0';
+     if (saved) {
+         saved->ioprio = syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, tid);
+         saved->policy = sched_getscheduler(0);
+         errno = 0;
+         saved->nice = getpriority(PRIO_PROCESS, tid);
+     }
+
+     if (p->io_class != TASK_PRIORITY_UNSET &&
+         syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid,
+                 IOPRIO_PRIO_VALUE(p->io_class, p->io_level)) < 0) {
+         add_error(err, errlen, "ioprio_set");
+         rc = -1;
+     }
+
+     if (p->sched_idle) {
+         struct sched_param sp = { .sched_priority = 0 };
+         if (sched_setscheduler(0, SCHED_IDLE, &sp) < 0) {
+             add_error(err, errlen, "sched_setscheduler");
+             rc = -1;
+         }
+     }
+
+     if (p->nice != TASK_PRIORITY_UNSET && setpriority(PRIO_PROCESS, tid, p->nice) < 0) {
+         add_error(err, errlen, "setpriority");
+         rc = -1;
+     }
+
+     if (process_wide && p->cpu_limit > 0) {
+         /* SIGXCPU at the soft limit, SIGKILL a few seconds later */
+         struct rlimit rl = { .rlim_cur = p->cpu_limit, .rlim_max = p->cpu_limit + 5 };
+         if (setrlimit(RLIMIT_CPU, &rl) < 0) {
+             add_error(err, errlen, "setrlimit");
+             rc = -1;
+         }
+     }
+     return rc;
+ }
+
+ /**
+  * @brief Restore the calling thread's priority
+  *
+  * @param saved Values from task_priority_apply()
+  * @param err Buffer for a description of what failed (may be NULL)
+  * @param errlen Size of err
+  * @return 0 if every previous value is back, -1 otherwise
+  */
+ int task_priority_restore(const task_priority_saved_t* saved, char* err, size_t errlen) {
+     pid_t tid = syscall(SYS_gettid);
+     struct sched_param sp = { .sched_priority = 0 };
+     int rc = 0;
+
+     if (err && errlen) err[0] = '\0';
+     if (saved->ioprio >= 0 &&
+         syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid, saved->ioprio) < 0) {
+         add_error(err, errlen, "ioprio_set");
+         rc = -1;
+     }
+     if (saved->policy >= 0 && sched_getscheduler(0) != saved->policy &&
+         sched_setscheduler(0, saved->policy, &sp) < 0) {
+         add_error(err, errlen, "sched_setscheduler");
+         rc = -1;
+     }
+     if (getpriority(PRIO_PROCESS, tid) != saved->nice &&
+         setpriority(PRIO_PROCESS, tid, saved->nice) < 0) {
+         add_error(err, errlen, "setpriority");
+         rc = -1;
+     }
+     return rc;
+ }
+
+ /**
+  * @brief Format priority fields
+  *
+  * @param io_class I/O class (0 = none, TASK_PRIORITY_UNSET = not configured)
+  * @param io_level I/O level
+  * @param sched_idle SCHED_IDLE flag
+  * @param nice Nice value, or TASK_PRIORITY_UNSET
+  * @param cpu_limit RLIMIT_CPU seconds (0 = none)
+  * @param out Output buffer
+  * @param len Size of out
+  */
+ static void describe(int io_class, int io_level, int sched_idle, int nice,
+                      long cpu_limit, char* out, size_t len) {
+     char io[16] = "inherit", ni[16] = "inherit", cpu[24] = "none";
+
+     /* The idle class has no levels */
+     if (io_class == 1 || io_class == 2)
+         snprintf(io, sizeof(io), "%s/%d", io_class_names[io_class], io_level);
+     else if (io_class == 0 || io_class == 3)
+         snprintf(io, sizeof(io), "%s", io_class_names[io_class]);
+     if (nice != TASK_PRIORITY_UNSET) snprintf(ni, sizeof(ni), "%d", nice);
+     if (cpu_limit > 0) snprintf(cpu, sizeof(cpu), "%lds", cpu_limit);
+
+     snprintf(out, len, "io=%s sched=%s nice=%s cpu_limit=%s",
+              io, sched_idle ? "idle" : "normal", ni, cpu);
+ }
+
+ /**
+  * @brief Format a configured priority
+  *
+  * @param p Priority
+  * @param out Output buffer
+  * @param len Size of out
+  */
+ void task_priority_describe(const task_priority_t* p, char* out, size_t len) {
+     describe(p->io_class, p->io_level, p->sched_idle, p->nice, p->cpu_limit, out, len);
+ }
+
+ /**
+  * @brief Read back the priority a running task actually has
+  *
+  * @param pid Process (or thread) ID
+  * @param out Output buffer, in the task_priority_describe() format
+  * @param len Size of out
+  * @return 0 on success, -1 if the task is gone
+  */
+ int task_priority_query(pid_t pid, char* out, size_t len) {
+     int io = syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, pid);
+     if (io < 0) return -1;
+     int policy = sched_getscheduler(pid);
+     if (policy < 0) return -1;
+     errno = 0;
+     int nice = getpriority(PRIO_PROCESS, pid);
+     if (nice == -1 && errno) return -1;
+
+     struct rlimit rl;
+     long cpu = 0;
+     if (prlimit(pid, RLIMIT_CPU, NULL, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY)
+         cpu = rl.rlim_cur;
+
+     describe(IOPRIO_PRIO_CLASS(io), IOPRIO_PRIO_DATA(io), policy == SCHED_IDLE,
+              nice, cpu, out, len);
+     return 0;
+ }
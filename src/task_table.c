@@ -0,0 +1,389 @@
+/**
+ * @file task_table.c
+ * @brief Implementation of the in-flight task table
+ *
+ * Two fixed-size chained hash tables: one record per source (running
+ * count and its FIFO of waiting tasks) and one per (source, filename)
+ * key (running count and the task waiting for it). A record is freed as
+ * soon as nothing runs or waits for it, so the table only ever holds the
+ * keys currently in play.
+ */
+
+ #include "../include/task_table.h"
+ #include <stdlib.h>
+ #include <stdint.h>
+ #include <string.h>
+
+ #define TT_BUCKETS 1024  /**< Hash table size (power of two) */
+
+ typedef struct tt_source tt_source_t;
+
+ /**
+  * @struct tt_file
+  * @brief Record of one (source, filename) key
+  */
+ typedef struct tt_file {
+     tt_source_t* src;        /**< Source record */
+     char* name;              /**< Filename (TASK_TABLE_ALL for FULL syncs) */
+     uint64_t hash;           /**< Hash of (source, name) */
+     int running;             /**< Running tasks for this key */
+     void* deferred;          /**< Task waiting for this key (or NULL) */
+     struct tt_file* next;    /**< Next record in the bucket */
+ } tt_file_t;
+
+ /**
+  * @struct tt_wait
+  * @brief Entry of a source's FIFO of waiting tasks
+  */
+ typedef struct tt_wait {
+     tt_file_t* file;         /**< Key whose deferred task waits here */
+     struct tt_wait* next;    /**< Next (younger) entry */
+ } tt_wait_t;
+
+ /**
+  * @struct tt_source
+  * @brief Record of one source
+  */
+ struct tt_source {
+     char* source;            /**< Source directory */
+     uint64_t hash;           /**< Hash of source */
+     int running;             /**< Running tasks of this source */
+     tt_wait_t* head;         /**< Oldest waiting task */
+     tt_wait_t* tail;         /**< Youngest waiting task */
+     struct tt_source* next;  /**< Next record in the bucket */
+ };
+
+ /**
+  * @struct task_table
+  * @brief Table handle
+  */
+ struct task_table {
+     tt_source_t* sources[TT_BUCKETS];  /**< Source records */
+     tt_file_t* files[TT_BUCKETS];      /**< (source, filename) records */
+ };
+
+ /**
+  * @brief FNV-1a hash of a string, continuing from h
+  *
+  * @param h Hash so far
+  * @param s String to add
+  * @return New hash
+  */
+ static uint64_t hash_str(uint64_t h, const char* s) {
+     for (; *s; s++) h = (h ^ (unsigned char)*s) * 1099511628211ULL;
+     return h;
+ }
+
+ /**
+  * @brief Check whether a filename denotes a FULL sync
+  *
+  * @param name Filename
+  * @return 1 if so, 0 otherwise
+  */
+ static int is_all(const char* name) {
+     return strcmp(name, TASK_TABLE_ALL) == 0;
+ }
+
+ /**
+  * @brief Look up (and optionally create) a source record
+  *
+  * @param t Table
+  * @param source Source directory
+  * @param create Create the record if missing
+  * @return Record, or NULL if missing and not created
+  */
+ static tt_source_t* source_get(task_table_t* t, const char* source, int create) {
+     uint64_t h = hash_str(1469598103934665603ULL, source);
+     tt_source_t** b = &t->sources[h & (TT_BUCKETS - 1)];
+
+     for (tt_source_t* s = *b; s; s = s->next)
+         if (s->hash == h && !strcmp(s->source, source)) return s;
+     if (!create) return NULL;
+
+     tt_source_t* s = calloc(1, sizeof(*s));
+     s->source = strdup(source);
+     s->hash = h;
+     s->next = *b;
+     *b = s;
+     return s;
+ }
+
+ /**
+  * @brief Look up (and optionally create) a (source, filename) record
+  *
+  * @param t Table
+  * @param s Source record
+  * @param name Filename
+  * @param create Create the record if missing
+  * @return Record, or NULL if missing and not created
+  */
+ static tt_file_t* file_get(task_table_t* t, tt_source_t* s, const char* name, int create) {
+     uint64_t h = hash_str((s->hash ^ 0xff) * 1099511628211ULL, name);
+     tt_file_t** b = &t->files[h & (TT_BUCKETS - 1)];
+
+     for (tt_file_t* f = *b; f; f = f->next)
+         if (f->hash == h && f->src == s && !strcmp(f->name, name)) return f;
+     if (!create) return NULL;
+
+     tt_file_t* f = calloc(1, sizeof(*f));
+     f->src = s;
+     f->name = strdup(name);
+     f->hash = h;
+     f->next = *b;
+     *b = f;
+     return f;
+ }
+
+ /**
+  * @brief Free a (source, filename) record nothing runs or waits for
+  *
+  * @param t Table
+  * @param f Record
+  */
+ static void file_release(task_table_t* t, tt_file_t* f) {
+     if (f->running > 0 || f->deferred) return;
+     for (tt_file_t** l = &t->files[f->hash & (TT_BUCKETS - 1)]; *l; l = &(*l)->next) {
+         if (*l == f) {
+             *l = f->next;
+             break;
+         }
+     }
+     free(f->name);
+     free(f);
+ }
+
+ /**
+  * @brief Free a source record nothing runs or waits for
+  *
+  * @param t Table
+  * @param s Record
+  */
+ static void source_release(task_table_t* t, tt_source_t* s) {
+     if (s->running > 0 || s->head) return;
+     for (tt_source_t** l = &t->sources[s->hash & (TT_BUCKETS - 1)]; *l; l = &(*l)->next) {
+         if (*l == s) {
+             *l = s->next;
+             break;
+         }
+     }
+     free(s->source);
+     free(s);
+ }
+
+ /**
+  * @brief Check whether a key has a running or waiting task
+  *
+  * @param f Record (may be NULL)
+  * @return 1 if so, 0 otherwise
+  */
+ static int file_pending(const tt_file_t* f) {
+     return f && (f->running > 0 || f->deferred);
+ }
+
+ /**
+  * @brief Create an empty table
+  *
+  * @return New table
+  */
+ task_table_t* task_table_create(void) {
+     return calloc(1, sizeof(task_table_t));
+ }
+
+ /**
+  * @brief Free a table (deferred tasks are not freed)
+  *
+  * @param t Table to destroy (may be NULL)
+  */
+ void task_table_destroy(task_table_t* t) {
+     if (!t) return;
+     for (size_t b = 0; b < TT_BUCKETS; b++) {
+         while (t->files[b]) {
+             tt_file_t* f = t->files[b];
+             t->files[b] = f->next;
+             free(f->name);
+             free(f);
+         }
+         while (t->sources[b]) {
+             tt_source_t* s = t->sources[b];
+             t->sources[b] = s->next;
+             while (s->head) {
+                 tt_wait_t* w = s->head;
+                 s->head = w->next;
+                 free(w);
+             }
+             free(s->source);
+             free(s);
+         }
+     }
+     free(t);
+ }
+
+ /**
+  * @brief Check whether a task has to wait
+  *
+  * @param t Table
+  * @param source Source directory
+  * @param filename File, or TASK_TABLE_ALL for a FULL sync
+  * @return 1 if the task must be deferred, 0 if it may start now
+  */
+ int task_table_busy(task_table_t* t, const char* source, const char* filename) {
+     tt_source_t* s = source_get(t, source, 0);
+     if (!s) return 0;
+
+     /* A FULL sync waits for everything already running or waiting */
+     if (is_all(filename)) return s->running > 0 || s->head != NULL;
+
+     /* A file waits for its own key and for any FULL sync of its source */
+     return file_pending(file_get(t, s, TASK_TABLE_ALL, 0)) ||
+            file_pending(file_get(t, s, filename, 0));
+ }
+
+ /**
+  * @brief Record a task as running
+  *
+  * @param t Table
+  * @param source Source directory
+  * @param filename File, or TASK_TABLE_ALL
+  */
+ void task_table_start(task_table_t* t, const char* source, const char* filename) {
+     tt_source_t* s = source_get(t, source, 1);
+     s->running++;
+     file_get(t, s, filename, 1)->running++;
+ }
+
+ /**
+  * @brief Record a running task as finished
+  *
+  * @param t Table
+  * @param source Source directory
+  * @param filename File, or TASK_TABLE_ALL
+  */
+ void task_table_finish(task_table_t* t, const char* source, const char* filename) {
+     tt_source_t* s = source_get(t, source, 0);
+     if (!s) return;
+     tt_file_t* f = file_get(t, s, filename, 0);
+     if (!f || f->running == 0) return;
+
+     f->running--;
+     s->running--;
+     file_release(t, f);
+     source_release(t, s);
+ }
+
+ /**
+  * @brief Queue a task behind the ones it conflicts with
+  *
+  * @param t Table
+  * @param source Source directory
+  * @param filename File, or TASK_TABLE_ALL
+  * @param task Caller's task (not NULL)
+  */
+ void task_table_defer(task_table_t* t, const char* source, const char* filename, void* task) {
+     tt_source_t* s = source_get(t, source, 1);
+     tt_file_t* f = file_get(t, s, filename, 1);
+     if (f->deferred) {
+         f->deferred = task;  /* Replaces the older one in its place */
+         return;
+     }
+
+     tt_wait_t* w = calloc(1, sizeof(*w));
+     w->file = f;
+     f->deferred = task;
+     if (s->tail) s->tail->next = w;
+     else s->head = w;
+     s->tail = w;
+ }
+
+ /**
+  * @brief The task waiting for a key, for coalescing a newer one into it
+  *
+  * @param t Table
+  * @param source Source directory
+  * @param filename File, or TASK_TABLE_ALL
+  * @return Waiting task, or NULL
+  */
+ void* task_table_deferred(task_table_t* t, const char* source, const char* filename) {
+     tt_source_t* s = source_get(t, source, 0);
+     tt_file_t* f = s ? file_get(t, s, filename, 0) : NULL;
+     return f ? f->deferred : NULL;
+ }
+
+ /**
+  * @brief Take the oldest waiting task of a source that may start now
+  *
+  * Walks the source's FIFO: a waiting FULL sync stops the walk unless it
+  * is first and nothing runs, and a file is skipped while its key runs.
+  * The task is recorded as running before it is returned.
+  *
+  * @param t Table
+  * @param source Source directory
+  * @return Task, or NULL if none can start
+  */
+ void* task_table_take_ready(task_table_t* t, const char* source) {
+     tt_source_t* s = source_get(t, source, 0);
+     if (!s) return NULL;
+
+     tt_file_t* full = file_get(t, s, TASK_TABLE_ALL, 0);
+     if (full && full->running > 0) return NULL;
+
+     for (tt_wait_t** l = &s->head, *prev = NULL; *l; prev = *l, l = &(*l)->next) {
+         tt_wait_t* w = *l;
+         tt_file_t* f = w->file;
+
+         if (is_all(f->name)) {
+             if (w != s->head || s->running > 0) return NULL;
+         } else if (f->running > 0) {
+             continue;
+         }
+
+         /* Unlink and hand it out, already running */
+         void* task = f->deferred;
+         *l = w->next;
+         if (s->tail == w) s->tail = prev;
+         free(w);
+         f->deferred = NULL;
+         f->running++;
+         s->running++;
+         return task;
+     }
+     return NULL;
+ }
+
+ /**
+  * @brief Call fn for every waiting task of a source, oldest first
+  *
+  * @param t Table
+  * @param source Source directory
+  * @param fn Callback (must not modify the table)
+  * @param ctx Context passed to fn
+  */
+ void task_table_walk_deferred(task_table_t* t, const char* source,
+                               void (*fn)(void* task, void* ctx), void* ctx) {
+     tt_source_t* s = source_get(t, source, 0);
+     if (!s) return;
+     for (tt_wait_t* w = s->head; w; w = w->next) fn(w->file->deferred, ctx);
+ }
+
+ /**
+  * @brief Number of running tasks of a source
+  *
+  * @param t Table
+  * @param source Source directory
+  * @return Running tasks
+  */
+ int task_table_running(task_table_t* t, const char* source) {
+     tt_source_t* s = source_get(t, source, 0);
+     return s ? s->running : 0;
+ }
+
+ /**
+  * @brief Check whether a FULL sync of a source is running or waiting
+  *
+  * @param t Table
+  * @param source Source directory
+  * @return 1 if so, 0 otherwise
+  */
+ int task_table_full_pending(task_table_t* t, const char* source) {
+     tt_source_t* s = source_get(t, source, 0);
+     return s && file_pending(file_get(t, s, TASK_TABLE_ALL, 0));
+ }
@@ -0,0 +1,278 @@
+/**
+ * @file thread_pool.c
+ * @brief Implementation of the work-stealing thread pool
+ *
+ * Deques are growable ring buffers guarded by a per-deque mutex; the owner
+ * takes from the front (oldest first) and thieves take from the back, so the
+ * two rarely contend on the same end. Idle threads sleep on a single
+ * condition variable keyed on the number of pending tasks.
+ */
+
+ #include "../include/thread_pool.h"
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <pthread.h>
+ #include <stdatomic.h>
+
+ /**
+  * -----------------------------------------------------------------------------
+  * Type definitions
+  * -----------------------------------------------------------------------------
+  */
+
+ /**
+  * @struct pool_task
+  * @brief A queued function call
+  */
+ typedef struct pool_task {
+     pool_fn_t fn;  /**< Function to run */
+     void* arg;     /**< Argument for fn */
+ } pool_task_t;
+
+ /**
+  * @struct pool_deque
+  * @brief Per-thread ring buffer of tasks
+  */
+ typedef struct pool_deque {
+     pthread_mutex_t lock;  /**< Guards the fields below */
+     pool_task_t* buf;      /**< Ring buffer storage */
+     size_t cap;            /**< Capacity of buf (power of two) */
+     size_t head;           /**< Index of the front task */
+     size_t count;          /**< Number of queued tasks */
+ } pool_deque_t;
+
+ /**
+  * @struct thread_pool
+  * @brief Pool state
+  */
+ struct thread_pool {
+     int nthreads;                /**< Number of threads */
+     pthread_t* threads;          /**< Thread handles */
+     pool_deque_t* deques;        /**< One deque per thread */
+     atomic_uint next_submit;     /**< Round-robin cursor for external submits */
+     atomic_long pending;         /**< Tasks queued but not yet taken */
+     pthread_mutex_t idle_lock;   /**< Guards sleeping and stopping */
+     pthread_cond_t idle_cond;    /**< Signalled when work arrives or on stop */
+     int stopping;                /**< Set by pool_destroy */
+ };
+
+ /**
+  * @struct pool_thread_arg
+  * @brief Start argument for a pool thread
+  */
+ typedef struct pool_thread_arg {
+     thread_pool_t* pool;  /**< Owning pool */
+     int index;            /**< Index of the thread's deque */
+ } pool_thread_arg_t;
+
+ static __thread int pool_self = -1;               /**< Calling thread's index */
+ static __thread thread_pool_t* pool_current = NULL; /**< Calling thread's pool */
+
+ /**
+  * -----------------------------------------------------------------------------
+  * Deque helpers
+  * -----------------------------------------------------------------------------
+  */
+
+ /**
+  * @brief Append a task to the back of a deque
+  *
+  * @param d Deque to push to
+  * @param t Task to push
+  */
+ static void deque_push_back(pool_deque_t* d, pool_task_t t) {
+     pthread_mutex_lock(&d->lock);
+     if (d->count == d->cap) {
+         /* Grow and unwrap the ring */
+         size_t ncap = d->cap ? d->cap * 2 : 64;
+         pool_task_t* nbuf = malloc(ncap * sizeof(*nbuf));
+         for (size_t i = 0; i < d->count; i++)
+             nbuf[i] = d->buf[(d->head + i) & (d->cap - 1)];
+         free(d->buf);
+         d->buf = nbuf;
+         d->cap = ncap;
+         d->head = 0;
+     }
+     d->buf[(d->head + d->count) & (d->cap - 1)] = t;
+     d->count++;
+     pthread_mutex_unlock(&d->lock);
+ }
+
+ /**
+  * @brief Take a task from the front (owner) or back (thief) of a deque
+  *
+  * @param d Deque to take from
+  * @param back Non-zero to take from the back
+  * @param out Receives the task
+  * @return 1 if a task was taken, 0 if the deque was empty
+  */
+ static int deque_take(pool_deque_t* d, int back, pool_task_t* out) {
+     pthread_mutex_lock(&d->lock);
+     if (d->count == 0) {
+         pthread_mutex_unlock(&d->lock);
+         return 0;
+     }
+     if (back) {
+         *out = d->buf[(d->head + d->count - 1) & (d->cap - 1)];
+     } else {
+         *out = d->buf[d->head];
+         d->head = (d->head + 1) & (d->cap - 1);
+     }
+     d->count--;
+     pthread_mutex_unlock(&d->lock);
+     return 1;
+ }
+
+ /**
+  * @brief Find work: own deque first, then steal from the others
+  *
+  * @param pool Pool to search
+  * @param self Index of the calling thread
+  * @param out Receives the task
+  * @return 1 if a task was found, 0 otherwise
+  */
+ static int find_task(thread_pool_t* pool, int self, pool_task_t* out) {
+     if (deque_take(&pool->deques[self], 0, out)) return 1;
+     for (int i = 1; i < pool->nthreads; i++) {
+         int victim = (self + i) % pool->nthreads;
+         if (deque_take(&pool->deques[victim], 1, out)) return 1;
+     }
+     return 0;
+ }
+
+ /**
+  * @brief Pool thread body
+  */
+ static void* pool_thread_main(void* arg) {
+     pool_thread_arg_t* a = arg;
+     thread_pool_t* pool = a->pool;
+     pool_self = a->index;
+     pool_current = pool;
+     free(a);
+
+     for (;;) {
+         pool_task_t t;
+         if (find_task(pool, pool_self, &t)) {
+             atomic_fetch_sub(&pool->pending, 1);
+             t.fn(t.arg);
+             continue;
+         }
+
+         /* Nothing to do: sleep until work arrives or the pool stops */
+         pthread_mutex_lock(&pool->idle_lock);
+         while (atomic_load(&pool->pending) == 0 && !pool->stopping)
+             pthread_cond_wait(&pool->idle_cond, &pool->idle_lock);
+         int done = pool->stopping && atomic_load(&pool->pending) == 0;
+         pthread_mutex_unlock(&pool->idle_lock);
+         if (done) break;
+     }
+     return NULL;
+ }
+
+ /**
+  * -----------------------------------------------------------------------------
+  * Public API Implementation
+  * -----------------------------------------------------------------------------
+  */
+
+ /**
+  * @brief Create a pool and start its threads
+  *
+  * @param nthreads Number of threads (at least 1)
+  * @return New pool, or NULL on failure
+  */
+ thread_pool_t* pool_create(int nthreads) {
+     if (nthreads < 1) nthreads = 1;
+
+     thread_pool_t* pool = calloc(1, sizeof(*pool));
+     pool->nthreads = nthreads;
+     pool->threads = calloc(nthreads, sizeof(*pool->threads));
+     pool->deques = calloc(nthreads, sizeof(*pool->deques));
+     pthread_mutex_init(&pool->idle_lock, NULL);
+     pthread_cond_init(&pool->idle_cond, NULL);
+
+     for (int i = 0; i < nthreads; i++)
+         pthread_mutex_init(&pool->deques[i].lock, NULL);
+
+     for (int i = 0; i < nthreads; i++) {
+         pool_thread_arg_t* a = malloc(sizeof(*a));
+         a->pool = pool;
+         a->index = i;
+         if (pthread_create(&pool->threads[i], NULL, pool_thread_main, a)) {
+             perror("pthread_create");
+             free(a);
+             pool->nthreads = i;  /* Only join what was started */
+             pool_destroy(pool);
+             return NULL;
+         }
+     }
+     return pool;
+ }
+
+ /**
+  * @brief Queue a task for execution
+  *
+  * @param pool Pool to submit to
+  * @param fn Function to run
+  * @param arg Argument passed to fn
+  */
+ void pool_submit(thread_pool_t* pool, pool_fn_t fn, void* arg) {
+     pool_task_t t = { .fn = fn, .arg = arg };
+
+     /* Pool threads keep their own work local; others spread round-robin */
+     int idx = (pool_current == pool && pool_self >= 0)
+               ? pool_self
+               : (int)(atomic_fetch_add(&pool->next_submit, 1) % pool->nthreads);
+     deque_push_back(&pool->deques[idx], t);
+
+     pthread_mutex_lock(&pool->idle_lock);
+     atomic_fetch_add(&pool->pending, 1);
+     pthread_cond_signal(&pool->idle_cond);
+     pthread_mutex_unlock(&pool->idle_lock);
+ }
+
+ /**
+  * @brief Get the number of threads in a pool
+  *
+  * @param pool Pool to query
+  * @return Thread count
+  */
+ int pool_size(thread_pool_t* pool) {
+     return pool->nthreads;
+ }
+
+ /**
+  * @brief Index of the calling pool thread
+  *
+  * @return Index in [0, pool_size) or -1 when not called from a pool thread
+  */
+ int pool_thread_index(void) {
+     return pool_self;
+ }
+
+ /**
+  * @brief Run every queued task, stop the threads and free the pool
+  *
+  * @param pool Pool to destroy
+  */
+ void pool_destroy(thread_pool_t* pool) {
+     if (!pool) return;
+
+     pthread_mutex_lock(&pool->idle_lock);
+     pool->stopping = 1;
+     pthread_cond_broadcast(&pool->idle_cond);
+     pthread_mutex_unlock(&pool->idle_lock);
+
+     for (int i = 0; i < pool->nthreads; i++)
+         pthread_join(pool->threads[i], NULL);
+
+     for (int i = 0; i < pool->nthreads; i++) {
+         pthread_mutex_destroy(&pool->deques[i].lock);
+         free(pool->deques[i].buf);
+     }
+     pthread_mutex_destroy(&pool->idle_lock);
+     pthread_cond_destroy(&pool->idle_cond);
+     free(pool->deques);
+     free(pool->threads);
+     free(pool);
+ }
@@ -0,0 +1,196 @@
+/**
+ * @file timer_wheel.c
+ * @brief Implementation of the hierarchical timer wheel
+ *
+ * Level 0 holds the timers due within 64 ticks, one slot per tick. Level n
+ * holds those due within 64^(n+1) ticks, one slot per 64^n ticks. Each time
+ * the clock crosses a multiple of 64^n, the level-n slot for the new range
+ * is emptied and its timers are filed again, which puts them one level
+ * lower. clk is the next tick to process, so every tick before it is done.
+ */
+
+ #include "../include/timer_wheel.h"
+ #include <stdlib.h>
+
+ #define TW_BITS 6                          /**< Bits per level */
+ #define TW_SLOTS (1 << TW_BITS)            /**< Slots per level */
+ #define TW_MASK (TW_SLOTS - 1)             /**< Slot index mask */
+ #define TW_LEVELS 4                        /**< Levels */
+ #define TW_SPAN (1ULL << (TW_BITS * TW_LEVELS))  /**< Ticks the wheel covers */
+
+ /**
+  * @struct timer_wheel
+  * @brief Wheel handle
+  */
+ struct timer_wheel {
+     tw_timer_t* slots[TW_LEVELS][TW_SLOTS];  /**< Slot lists */
+     unsigned long long clk;                  /**< Next tick to process */
+     size_t count;                            /**< Armed timers */
+ };
+
+ /**
+  * @brief File an unlinked timer in the slot its expiry falls into
+  *
+  * @param w Wheel
+  * @param t Timer (expires set)
+  */
+ static void file_timer(timer_wheel_t* w, tw_timer_t* t) {
+     tw_timer_t** slot;
+
+     if (t->expires < w->clk) {
+         /* Overdue: the slot processed next */
+         slot = &w->slots[0][w->clk & TW_MASK];
+     } else {
+         unsigned long long delta = t->expires - w->clk;
+         if (delta >= TW_SPAN) {
+             /* Beyond the horizon: fire there, the caller re-arms */
+             t->expires = w->clk + TW_SPAN - 1;
+             delta = TW_SPAN - 1;
+         }
+         int level = 0;
+         while (delta >= (1ULL << (TW_BITS * (level + 1)))) level++;
+         slot = &w->slots[level][(t->expires >> (TW_BITS * level)) & TW_MASK];
+     }
+
+     t->next = *slot;
+     if (t->next) t->next->pprev = &t->next;
+     t->pprev = slot;
+     *slot = t;
+ }
+
+ /**
+  * @brief Unlink a timer from its slot
+  *
+  * @param t Armed timer
+  */
+ static void unlink_timer(tw_timer_t* t) {
+     *t->pprev = t->next;
+     if (t->next) t->next->pprev = t->pprev;
+     t->next = NULL;
+     t->pprev = NULL;
+ }
+
+ /**
+  * @brief Re-file the timers of one slot of a coarser level
+  *
+  * @param w Wheel
+  * @param level Level (1 or more)
+  * @param index Slot
+  * @return index, so callers know whether the next level wraps too
+  */
+ static int cascade(timer_wheel_t* w, int level, int index) {
+     tw_timer_t* t = w->slots[level][index];
+     w->slots[level][index] = NULL;
+     while (t) {
+         tw_timer_t* next = t->next;
+         file_timer(w, t);
+         t = next;
+     }
+     return index;
+ }
+
+ /**
+  * @brief Create an empty wheel
+  *
+  * @param now Current tick
+  * @return New wheel
+  */
+ timer_wheel_t* timer_wheel_create(unsigned long long now) {
+     timer_wheel_t* w = calloc(1, sizeof(*w));
+     w->clk = now;
+     return w;
+ }
+
+ /**
+  * @brief Free a wheel (armed timers are left dangling, not freed)
+  *
+  * @param w Wheel to destroy (may be NULL)
+  */
+ void timer_wheel_destroy(timer_wheel_t* w) {
+     free(w);
+ }
+
+ /**
+  * @brief Arm a timer, re-arming it if it already is
+  *
+  * @param w Wheel
+  * @param t Timer
+  * @param expires Tick to fire at
+  */
+ void timer_wheel_add(timer_wheel_t* w, tw_timer_t* t, unsigned long long expires) {
+     if (t->pprev) unlink_timer(t);
+     else w->count++;
+     t->expires = expires;
+     file_timer(w, t);
+ }
+
+ /**
+  * @brief Disarm a timer (no-op if it is not armed)
+  *
+  * @param w Wheel
+  * @param t Timer
+  */
+ void timer_wheel_cancel(timer_wheel_t* w, tw_timer_t* t) {
+     if (!t->pprev) return;
+     unlink_timer(t);
+     w->count--;
+ }
+
+ /**
+  * @brief Check whether a timer is armed
+  *
+  * @param t Timer
+  * @return 1 if armed, 0 otherwise
+  */
+ int timer_wheel_pending(const tw_timer_t* t) {
+     return t->pprev != NULL;
+ }
+
+ /**
+  * @brief Number of armed timers
+  *
+  * @param w Wheel
+  * @return Timers
+  */
+ size_t timer_wheel_count(const timer_wheel_t* w) {
+     return w->count;
+ }
+
+ /**
+  * @brief Fire every timer due up to and including a tick
+  *
+  * @param w Wheel
+  * @param now Current tick
+  * @param fire Callback for each expired timer
+  * @param ctx Context passed to fire
+  * @return Number of timers fired
+  */
+ size_t timer_wheel_advance(timer_wheel_t* w, unsigned long long now,
+                            void (*fire)(tw_timer_t* t, void* ctx), void* ctx) {
+     size_t fired = 0;
+
+     while (w->clk <= now) {
+         int index = w->clk & TW_MASK;
+
+         /* Crossing into a new range of a coarser level: bring its timers down */
+         for (int level = 1; level < TW_LEVELS && index == 0; level++)
+             index = cascade(w, level, (w->clk >> (TW_BITS * level)) & TW_MASK);
+         index = w->clk & TW_MASK;
+
+         /* Detach the slot first: callbacks may re-arm into it */
+         tw_timer_t* list = w->slots[0][index];
+         w->slots[0][index] = NULL;
+         w->clk++;
+         while (list) {
+             tw_timer_t* t = list;
+             list = t->next;
+             if (list) list->pprev = &list;  /* Keep the detached list consistent */
+             t->next = NULL;
+             t->pprev = NULL;
+             w->count--;
+             fired++;
+             fire(t, ctx);
+         }
+     }
+     return fired;
+ }
@@ -0,0 +1,177 @@
+/**
+ * @file write_tracker.c
+ * @brief Implementation of the own-write record
+ *
+ * A fixed-size chained hash table behind one mutex. Write records are keyed
+ * by (dev, inode) and keep only the latest mtime; delete records are keyed
+ * by a hash of the path. Expired records are dropped lazily whenever their
+ * bucket is visited.
+ */
+
+ #include "../include/write_tracker.h"
+ #include <stdlib.h>
+ #include <stdint.h>
+ #include <string.h>
+ #include <pthread.h>
+
+ #define WT_BUCKETS 4096  /**< Hash table size (power of two) */
+
+ /**
+  * @struct wt_entry
+  * @brief One write or delete record
+  */
+ typedef struct wt_entry {
+     int unlink;              /**< 1 for a delete record, 0 for a write */
+     dev_t dev;               /**< Device (write records) */
+     ino_t ino;               /**< Inode (write records) */
+     struct timespec mtime;   /**< mtime after the write (write records) */
+     uint64_t path_hash;      /**< Path hash (delete records) */
+     time_t recorded;         /**< When the record was made */
+     struct wt_entry* next;   /**< Next entry in the bucket */
+ } wt_entry_t;
+
+ static wt_entry_t* buckets[WT_BUCKETS];                  /**< Hash table */
+ static pthread_mutex_t wt_lock = PTHREAD_MUTEX_INITIALIZER;  /**< Guards buckets */
+
+ /**
+  * @brief FNV-1a hash of a path
+  *
+  * @param path Path to hash
+  * @return 64-bit hash
+  */
+ static uint64_t hash_path(const char* path) {
+     uint64_t h = 1469598103934665603ULL;
+     for (; *path; path++) h = (h ^ (unsigned char)*path) * 1099511628211ULL;
+     return h;
+ }
+
+ /**
+  * @brief Bucket of a (dev, inode) key
+  *
+  * @param dev Device
+  * @param ino Inode
+  * @return Bucket index
+  */
+ static size_t bucket_of_inode(dev_t dev, ino_t ino) {
+     uint64_t h = ((uint64_t)dev * 0x9E3779B97F4A7C15ULL) ^ (uint64_t)ino;
+     return (h ^ (h >> 29)) & (WT_BUCKETS - 1);
+ }
+
+ /**
+  * @brief Find a record in a bucket, dropping expired ones on the way
+  *
+  * Must be called with wt_lock held.
+  *
+  * @param b Bucket index
+  * @param unlink Record kind
+  * @param dev Device (write records)
+  * @param ino Inode (write records)
+  * @param path_hash Path hash (delete records)
+  * @param prev_out Receives the link pointing to the match
+  * @return Matching record, or NULL
+  */
+ static wt_entry_t* bucket_find(size_t b, int unlink, dev_t dev, ino_t ino,
+                                uint64_t path_hash, wt_entry_t*** prev_out) {
+     time_t now = time(NULL);
+     wt_entry_t** l = &buckets[b];
+
+     while (*l) {
+         wt_entry_t* e = *l;
+         if (now - e->recorded > WRITE_TRACKER_TTL) {
+             *l = e->next;
+             free(e);
+             continue;
+         }
+         if (e->unlink == unlink &&
+             (unlink ? e->path_hash == path_hash : (e->dev == dev && e->ino == ino))) {
+             if (prev_out) *prev_out = l;
+             return e;
+         }
+         l = &e->next;
+     }
+     return NULL;
+ }
+
+ /**
+  * @brief Record a file the manager (or one of its workers) just wrote
+  *
+  * @param dev Device of the written file
+  * @param ino Inode of the written file
+  * @param mtime Modification time after the write
+  */
+ void write_tracker_record(dev_t dev, ino_t ino, const struct timespec* mtime) {
+     size_t b = bucket_of_inode(dev, ino);
+
+     pthread_mutex_lock(&wt_lock);
+     wt_entry_t* e = bucket_find(b, 0, dev, ino, 0, NULL);
+     if (!e) {
+         e = calloc(1, sizeof(*e));
+         e->dev = dev;
+         e->ino = ino;
+         e->next = buckets[b];
+         buckets[b] = e;
+     }
+     e->mtime = *mtime;
+     e->recorded = time(NULL);
+     pthread_mutex_unlock(&wt_lock);
+ }
+
+ /**
+  * @brief Check whether a file is exactly as the manager last wrote it
+  *
+  * @param st Current stat of the file
+  * @return 1 if the file matches a record, 0 otherwise
+  */
+ int write_tracker_is_own(const struct stat* st) {
+     size_t b = bucket_of_inode(st->st_dev, st->st_ino);
+
+     pthread_mutex_lock(&wt_lock);
+     wt_entry_t* e = bucket_find(b, 0, st->st_dev, st->st_ino, 0, NULL);
+     int own = e && e->mtime.tv_sec == st->st_mtim.tv_sec &&
+               e->mtime.tv_nsec == st->st_mtim.tv_nsec;
+     pthread_mutex_unlock(&wt_lock);
+     return own;
+ }
+
+ /**
+  * @brief Record a file the manager just deleted
+  *
+  * @param path Canonical path of the deleted file
+  */
+ void write_tracker_record_unlink(const char* path) {
+     uint64_t h = hash_path(path);
+     size_t b = h & (WT_BUCKETS - 1);
+
+     pthread_mutex_lock(&wt_lock);
+     wt_entry_t* e = bucket_find(b, 1, 0, 0, h, NULL);
+     if (!e) {
+         e = calloc(1, sizeof(*e));
+         e->unlink = 1;
+         e->path_hash = h;
+         e->next = buckets[b];
+         buckets[b] = e;
+     }
+     e->recorded = time(NULL);
+     pthread_mutex_unlock(&wt_lock);
+ }
+
+ /**
+  * @brief Consume a deletion record
+  *
+  * @param path Canonical path from a delete event
+  * @return 1 if the manager deleted path recently, 0 otherwise
+  */
+ int write_tracker_take_unlink(const char* path) {
+     uint64_t h = hash_path(path);
+     size_t b = h & (WT_BUCKETS - 1);
+     wt_entry_t** link = NULL;
+
+     pthread_mutex_lock(&wt_lock);
+     wt_entry_t* e = bucket_find(b, 1, 0, 0, h, &link);
+     if (e) {
+         *link = e->next;
+         free(e);
+     }
+     pthread_mutex_unlock(&wt_lock);
+     return e != NULL;
+ }
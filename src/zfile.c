@@ -0,0 +1,513 @@
+/**
+ * @file zfile.c
+ * @brief Implementation of the chunked compressed file format
+ *
+ * The codec is a byte-oriented LZ77 in the style of LZ4: a sequence is a
+ * token (literal count in the high nibble, match length - 4 in the low
+ * one, 15 meaning "more bytes follow, 255 at a time"), the literals, and a
+ * 16-bit little-endian match offset. The last sequence of a block has
+ * literals only. Matches are found through a 4096-entry hash table of
+ * 4-byte prefixes, which favours speed over ratio, as an archive copy
+ * running next to live syncs should.
+ */
+
+ #include "../include/zfile.h"
+ #include <stdlib.h>
+ #include <string.h>
+ #include <errno.h>
+ #include <unistd.h>
+ #include <sys/stat.h>
+
+ #define MIN_MATCH 4                 /**< Shortest match encoded */
+ #define HASH_BITS 12                /**< log2 of the match table size */
+ #define MAX_OFFSET 65535            /**< Farthest match reachable with 16 bits */
+
+ /**
+  * @brief Load 4 bytes without alignment requirements
+  *
+  * @param p Source
+  * @return The bytes as a host-order integer
+  */
+ static uint32_t load32(const unsigned char* p) {
+     uint32_t v;
+     memcpy(&v, p, sizeof(v));
+     return v;
+ }
+
+ /**
+  * @brief Hash a 4-byte prefix into the match table
+  *
+  * @param v Prefix
+  * @return Table slot
+  */
+ static unsigned hash4(uint32_t v) {
+     return (v * 2654435761u) >> (32 - HASH_BITS);
+ }
+
+ /**
+  * @brief Hash a chunk's raw bytes for change detection
+  *
+  * A 64-bit multiply/rotate hash over 8-byte words; not cryptographic,
+  * it only has to tell an edited chunk from the one in the index.
+  *
+  * @param p Bytes
+  * @param n Number of bytes
+  * @return Hash
+  */
+ static uint64_t chunk_hash(const unsigned char* p, size_t n) {
+     uint64_t h = 0x9e3779b97f4a7c15ull ^ n;
+     size_t i = 0;
+     for (; i + 8 <= n; i += 8) {
+         uint64_t w;
+         memcpy(&w, p + i, 8);
+         h ^= w * 0xff51afd7ed558ccdull;
+         h = (h << 31 | h >> 33) * 0xc4ceb9fe1a85ec53ull;
+     }
+     for (; i < n; i++) h = (h ^ p[i]) * 0x100000001b3ull;
+     h ^= h >> 29;
+     return h;
+ }
+
+ /**
+  * @brief Worst-case compressed size of a block
+  *
+  * @param n Raw size
+  * @return Size an output buffer needs
+  */
+ size_t zfile_bound(size_t n) {
+     return n + n / 255 + 16;
+ }
+
+ /**
+  * @brief Write a length remainder as 255-runs
+  *
+  * @param op Output cursor
+  * @param oend End of output
+  * @param v Remainder (length - 15)
+  * @return 0 on success, -1 if out of space
+  */
+ static int put_length(unsigned char** op, unsigned char* oend, size_t v) {
+     while (v >= 255) {
+         if (*op >= oend) return -1;
+         *(*op)++ = 255;
+         v -= 255;
+     }
+     if (*op >= oend) return -1;
+     *(*op)++ = (unsigned char)v;
+     return 0;
+ }
+
+ /**
+  * @brief Emit one sequence
+  *
+  * @param op Output cursor
+  * @param oend End of output
+  * @param lit Literals
+  * @param nlit Number of literals
+  * @param offset Match offset (ignored for the last sequence)
+  * @param mlen Match length, 0 for the last sequence
+  * @return 0 on success, -1 if out of space
+  */
+ static int put_sequence(unsigned char** op, unsigned char* oend, const unsigned char* lit,
+                         size_t nlit, size_t offset, size_t mlen) {
+     size_t ml = mlen ? mlen - MIN_MATCH : 0;
+     if (*op >= oend) return -1;
+     *(*op)++ = (unsigned char)((nlit < 15 ? nlit : 15) << 4 | (ml < 15 ? ml : 15));
+     if (nlit >= 15 && put_length(op, oend, nlit - 15) < 0) return -1;
+     if ((size_t)(oend - *op) < nlit) return -1;
+     memcpy(*op, lit, nlit);
+     *op += nlit;
+     if (!mlen) return 0;
+
+     if (oend - *op < 2) return -1;
+     *(*op)++ = offset & 0xff;
+     *(*op)++ = offset >> 8;
+     if (ml >= 15 && put_length(op, oend, ml - 15) < 0) return -1;
+     return 0;
+ }
+
+ /**
+  * @brief Compress a block
+  *
+  * @param src Raw bytes
+  * @param n Number of raw bytes
+  * @param dst Output buffer
+  * @param cap Size of dst
+  * @return Compressed size, or 0 if it would not fit in cap
+  */
+ size_t zfile_compress_block(const void* src, size_t n, void* dst, size_t cap) {
+     const unsigned char* in = src;
+     unsigned char* op = dst;
+     unsigned char* oend = op + cap;
+     uint32_t table[1 << HASH_BITS];  /* Position + 1 of the last prefix seen (0 = none) */
+     size_t ip = 0, anchor = 0;
+
+     memset(table, 0, sizeof(table));
+     while (ip + MIN_MATCH <= n) {
+         uint32_t seq = load32(in + ip);
+         unsigned h = hash4(seq);
+         size_t cand = table[h];
+         table[h] = ip + 1;
+
+         if (!cand || ip - (cand - 1) > MAX_OFFSET || load32(in + cand - 1) != seq) {
+             ip++;
+             continue;
+         }
+         size_t m = cand - 1, len = MIN_MATCH;
+         while (ip + len < n && in[m + len] == in[ip + len]) len++;
+
+         if (put_sequence(&op, oend, in + anchor, ip - anchor, ip - m, len) < 0) return 0;
+         ip += len;
+         anchor = ip;
+     }
+
+     if (put_sequence(&op, oend, in + anchor, n - anchor, 0, 0) < 0) return 0;
+     return op - (unsigned char*)dst;
+ }
+
+ /**
+  * @brief Read a length continuation
+  *
+  * @param ip Input cursor
+  * @param iend End of input
+  * @param v Length to extend
+  * @return 0 on success, -1 if the input ends first
+  */
+ static int get_length(const unsigned char** ip, const unsigned char* iend, size_t* v) {
+     unsigned char b;
+     do {
+         if (*ip >= iend) return -1;
+         b = *(*ip)++;
+         *v += b;
+     } while (b == 255);
+     return 0;
+ }
+
+ /**
+  * @brief Decompress a block
+  *
+  * @param src Compressed bytes
+  * @param n Number of compressed bytes
+  * @param dst Output buffer
+  * @param cap Size of dst
+  * @return Raw size, or -1 if the input is malformed or too large for cap
+  */
+ ssize_t zfile_decompress_block(const void* src, size_t n, void* dst, size_t cap) {
+     const unsigned char* ip = src;
+     const unsigned char* iend = ip + n;
+     unsigned char* out = dst;
+     unsigned char* op = out;
+     unsigned char* oend = out + cap;
+
+     while (ip < iend) {
+         unsigned token = *ip++;
+         size_t nlit = token >> 4;
+         if (nlit == 15 && get_length(&ip, iend, &nlit) < 0) return -1;
+         if (nlit > (size_t)(iend - ip) || nlit > (size_t)(oend - op)) return -1;
+         memcpy(op, ip, nlit);
+         op += nlit;
+         ip += nlit;
+         if (ip == iend) break;  /* Last sequence */
+
+         if (iend - ip < 2) return -1;
+         size_t offset = ip[0] | (size_t)ip[1] << 8;
+         ip += 2;
+         if (offset == 0 || offset > (size_t)(op - out)) return -1;
+
+         size_t mlen = token & 15;
+         if (mlen == 15 && get_length(&ip, iend, &mlen) < 0) return -1;
+         mlen += MIN_MATCH;
+         if (mlen > (size_t)(oend - op)) return -1;
+
+         /* Byte by byte: the match may overlap the bytes it produces */
+         const unsigned char* m = op - offset;
+         for (size_t i = 0; i < mlen; i++) op[i] = m[i];
+         op += mlen;
+     }
+     return op - out;
+ }
+
+ /**
+  * @brief pread() until len bytes or end of file
+  *
+  * @param fd File
+  * @param buf Output buffer
+  * @param len Bytes wanted
+  * @param off Offset
+  * @return Bytes read, or -1 on error
+  */
+ static ssize_t read_full(int fd, void* buf, size_t len, off_t off) {
+     size_t got = 0;
+     while (got < len) {
+         ssize_t n = pread(fd, (char*)buf + got, len - got, off + got);
+         if (n < 0 && errno == EINTR) continue;
+         if (n < 0) return -1;
+         if (n == 0) break;
+         got += n;
+     }
+     return got;
+ }
+
+ /**
+  * @brief pwrite() all of a buffer
+  *
+  * @param fd File
+  * @param buf Bytes
+  * @param len Number of bytes
+  * @param off Offset
+  * @return 0 on success, -1 on error
+  */
+ static int write_full(int fd, const void* buf, size_t len, off_t off) {
+     size_t done = 0;
+     while (done < len) {
+         ssize_t n = pwrite(fd, (const char*)buf + done, len - done, off + done);
+         if (n < 0 && errno == EINTR) continue;
+         if (n <= 0) return -1;
+         done += n;
+     }
+     return 0;
+ }
+
+ /**
+  * @brief Read the footer of a compressed file
+  *
+  * @param fd File
+  * @param footer Filled in
+  * @return 0 on success, -1 if the file is not in this format
+  */
+ int zfile_read_footer(int fd, zfile_footer_t* footer) {
+     struct stat st;
+     if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(*footer)) return -1;
+     off_t at = st.st_size - sizeof(*footer);
+     if (read_full(fd, footer, sizeof(*footer), at) != sizeof(*footer)) return -1;
+
+     /* The index must sit exactly between the chunk data and the footer */
+     if (footer->magic != ZFILE_MAGIC || footer->chunk_size == 0 ||
+         footer->chunk_size > ZFILE_CHUNK_MAX || footer->index_off > (uint64_t)at ||
+         footer->chunks != ((uint64_t)at - footer->index_off) / sizeof(zfile_chunk_t) ||
+         ((uint64_t)at - footer->index_off) % sizeof(zfile_chunk_t))
+         return -1;
+     return 0;
+ }
+
+ /**
+  * @brief Load the footer and index of a compressed file
+  *
+  * @param fd File
+  * @param footer Filled in
+  * @return Index (free() it), an empty allocation for zero chunks, or NULL
+  *         if the file is not in this format
+  */
+ static zfile_chunk_t* read_index(int fd, zfile_footer_t* footer) {
+     if (zfile_read_footer(fd, footer) < 0) return NULL;
+     size_t bytes = footer->chunks * sizeof(zfile_chunk_t);
+     zfile_chunk_t* index = malloc(bytes ? bytes : 1);
+     if (index && bytes && read_full(fd, index, bytes, footer->index_off) != (ssize_t)bytes) {
+         free(index);
+         return NULL;
+     }
+     return index;
+ }
+
+ /**
+  * @brief Bring a compressed target up to date with a source file
+  *
+  * @param src_fd Source file, read from offset 0
+  * @param dst_fd Target file, opened read-write
+  * @param chunk_size Raw chunk size (0 = ZFILE_CHUNK_DEFAULT)
+  * @param stats Filled in (may be NULL)
+  * @return 0 on success, -1 on error (errno set)
+  */
+ int zfile_sync(int src_fd, int dst_fd, size_t chunk_size, zfile_stats_t* stats) {
+     zfile_stats_t local;
+     if (!stats) stats = &local;
+     memset(stats, 0, sizeof(*stats));
+     if (chunk_size == 0) chunk_size = ZFILE_CHUNK_DEFAULT;
+     if (chunk_size > ZFILE_CHUNK_MAX) {
+         errno = EINVAL;
+         return -1;
+     }
+
+     /* The old index, if the target is usable as a base */
+     zfile_footer_t old;
+     zfile_chunk_t* old_index = read_index(dst_fd, &old);
+     if (old_index && old.chunk_size != chunk_size) {
+         free(old_index);
+         old_index = NULL;
+     }
+     size_t old_chunks = old_index ? old.chunks : 0;
+
+     unsigned char* raw = malloc(chunk_size);
+     size_t cap = zfile_bound(chunk_size);
+     unsigned char* comp = malloc(cap);
+     size_t n_chunks = 0, index_cap = old_chunks + 16;
+     zfile_chunk_t* index = malloc(index_cap * sizeof(*index));
+     int rc = -1;
+     if (!raw || !comp || !index) {
+         errno = ENOMEM;
+         goto out;
+     }
+
+     uint64_t size = 0, write_off = 0;
+     int diverged = 0;
+     for (;;) {
+         ssize_t got = read_full(src_fd, raw, chunk_size, size);
+         if (got < 0) goto out;
+         if (got == 0) break;
+         stats->bytes_read += got;
+         uint64_t h = chunk_hash(raw, got);
+
+         if (n_chunks == index_cap) {
+             zfile_chunk_t* grown = realloc(index, (index_cap *= 2) * sizeof(*index));
+             if (!grown) {
+                 errno = ENOMEM;
+                 goto out;
+             }
+             index = grown;
+         }
+
+         /* Still on the unchanged prefix: reuse the chunk as it is */
+         if (!diverged && n_chunks < old_chunks && old_index[n_chunks].rlen == (uint32_t)got &&
+             old_index[n_chunks].hash == h) {
+             index[n_chunks] = old_index[n_chunks];
+             write_off = old_index[n_chunks].offset + (old_index[n_chunks].clen & ~ZFILE_STORED);
+             stats->chunks_kept++;
+         } else {
+             if (!diverged) {
+                 diverged = 1;
+                 write_off = n_chunks < old_chunks ? old_index[n_chunks].offset : write_off;
+             }
+             size_t clen = zfile_compress_block(raw, got, comp, cap);
+             const void* data = comp;
+             uint32_t flag = 0;
+             if (clen == 0 || clen >= (size_t)got) {
+                 /* Incompressible: store the raw bytes */
+                 data = raw;
+                 clen = got;
+                 flag = ZFILE_STORED;
+             }
+             if (write_full(dst_fd, data, clen, write_off) < 0) goto out;
+             index[n_chunks].offset = write_off;
+             index[n_chunks].clen = (uint32_t)clen | flag;
+             index[n_chunks].rlen = (uint32_t)got;
+             index[n_chunks].hash = h;
+             write_off += clen;
+             stats->bytes_written += clen;
+             stats->chunks_written++;
+         }
+         n_chunks++;
+         size += got;
+         if ((size_t)got < chunk_size) break;
+     }
+
+     /* New index and footer right after the last chunk, then cut the rest */
+     zfile_footer_t footer = { .magic = ZFILE_MAGIC, .chunk_size = (uint32_t)chunk_size,
+                               .size = size, .index_off = write_off, .chunks = n_chunks };
+     size_t index_bytes = n_chunks * sizeof(*index);
+     if (write_full(dst_fd, index, index_bytes, write_off) < 0 ||
+         write_full(dst_fd, &footer, sizeof(footer), write_off + index_bytes) < 0 ||
+         ftruncate(dst_fd, write_off + index_bytes + sizeof(footer)) < 0)
+         goto out;
+     stats->bytes_written += index_bytes + sizeof(footer);
+     rc = 0;
+
+ out:
+     free(old_index);
+     free(raw);
+     free(comp);
+     free(index);
+     return rc;
+ }
+
+ /**
+  * @brief Open a compressed file for reading
+  *
+  * @param z Handle to fill in
+  * @param fd File (stays owned by the caller)
+  * @return 0 on success, -1 on error (errno set; EINVAL if not in this format)
+  */
+ int zfile_open(zfile_t* z, int fd) {
+     memset(z, 0, sizeof(*z));
+     z->fd = fd;
+     z->cached = -1;
+     z->index = read_index(fd, &z->footer);
+     if (!z->index) {
+         errno = EINVAL;
+         return -1;
+     }
+     z->raw = malloc(z->footer.chunk_size);
+     z->comp = malloc(zfile_bound(z->footer.chunk_size));
+     if (!z->raw || !z->comp) {
+         zfile_close(z);
+         errno = ENOMEM;
+         return -1;
+     }
+     return 0;
+ }
+
+ /**
+  * @brief Decompress one chunk into the handle's cache
+  *
+  * @param z Open file
+  * @param k Chunk number
+  * @return 0 on success, -1 on error
+  */
+ static int load_chunk(zfile_t* z, uint64_t k) {
+     if ((long)k == z->cached) return 0;
+     const zfile_chunk_t* c = &z->index[k];
+     size_t clen = c->clen & ~ZFILE_STORED;
+     if (c->rlen > z->footer.chunk_size || clen > zfile_bound(z->footer.chunk_size)) return -1;
+
+     if (c->clen & ZFILE_STORED) {
+         if (clen != c->rlen || read_full(z->fd, z->raw, clen, c->offset) != (ssize_t)clen) return -1;
+     } else {
+         if (read_full(z->fd, z->comp, clen, c->offset) != (ssize_t)clen) return -1;
+         if (zfile_decompress_block(z->comp, clen, z->raw, c->rlen) != (ssize_t)c->rlen) return -1;
+     }
+     z->cached = k;
+     return 0;
+ }
+
+ /**
+  * @brief Read uncompressed bytes at an offset
+  *
+  * @param z Open file
+  * @param buf Output buffer
+  * @param len Bytes wanted
+  * @param off Uncompressed offset
+  * @return Bytes read (short at end of file), or -1 on error
+  */
+ ssize_t zfile_pread(zfile_t* z, void* buf, size_t len, off_t off) {
+     size_t done = 0;
+     uint64_t cs = z->footer.chunk_size;
+
+     while (done < len && (uint64_t)off + done < z->footer.size) {
+         uint64_t pos = off + done;
+         uint64_t k = pos / cs;
+         if (k >= z->footer.chunks || load_chunk(z, k) < 0) {
+             errno = EIO;
+             return -1;
+         }
+         size_t in_chunk = pos - k * cs;
+         if (in_chunk >= z->index[k].rlen) break;
+         size_t n = z->index[k].rlen - in_chunk;
+         if (n > len - done) n = len - done;
+         memcpy((char*)buf + done, z->raw + in_chunk, n);
+         done += n;
+     }
+     return done;
+ }
+
+ /**
+  * @brief Release a handle from zfile_open()
+  *
+  * @param z Handle
+  */
+ void zfile_close(zfile_t* z) {
+     free(z->index);
+     free(z->raw);
+     free(z->comp);
+     z->index = NULL;
+     z->raw = NULL;
+     z->comp = NULL;
+ }
@@ -0,0 +1,69 @@
+#include "../include/deadline_queue.h"
+#include "acutest.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+void test_earliest_first(void) {
+    deadline_queue_t* q = deadline_queue_create();
+    int items[5];
+    long long deadlines[5] = { 50, 10, 40, 20, 30 };
+    for (int i = 0; i < 5; i++) deadline_queue_push(q, deadlines[i], &items[i]);
+    TEST_CHECK(deadline_queue_size(q) == 5);
+
+    long long first = 0;
+    TEST_CHECK(deadline_queue_peek(q, &first) == 1 && first == 10);
+    TEST_CHECK(deadline_queue_pop(q) == &items[1]);
+    TEST_CHECK(deadline_queue_peek(q, &first) == 1 && first == 20);
+    TEST_CHECK(deadline_queue_pop(q) == &items[3]);
+    TEST_CHECK(deadline_queue_pop(q) == &items[4]);
+    TEST_CHECK(deadline_queue_pop(q) == &items[2]);
+    TEST_CHECK(deadline_queue_pop(q) == &items[0]);
+    TEST_CHECK(deadline_queue_pop(q) == NULL);
+    TEST_CHECK(deadline_queue_peek(q, &first) == 0);
+    TEST_CHECK(deadline_queue_size(q) == 0);
+    deadline_queue_destroy(q);
+}
+
+void test_ties_in_push_order(void) {
+    deadline_queue_t* q = deadline_queue_create();
+    int items[200];
+
+    // Equal deadlines behave like a FIFO, even across growth
+    for (int i = 0; i < 200; i++) deadline_queue_push(q, i < 100 ? 7 : 3, &items[i]);
+    for (int i = 100; i < 200; i++) TEST_CHECK(deadline_queue_pop(q) == &items[i]);
+    for (int i = 0; i < 100; i++) TEST_CHECK(deadline_queue_pop(q) == &items[i]);
+    deadline_queue_destroy(q);
+}
+
+void test_random_against_sort(void) {
+    deadline_queue_t* q = deadline_queue_create();
+    long long d[1000];
+    unsigned seed = 1;
+    for (int i = 0; i < 1000; i++) {
+        seed = seed * 1103515245 + 12345;
+        d[i] = (seed >> 16) % 100;
+        deadline_queue_push(q, d[i], &d[i]);
+    }
+
+    // Every item can be walked
+    int seen = 0;
+    for (size_t i = 0; i < deadline_queue_size(q); i++)
+        if (deadline_queue_at(q, i)) seen++;
+    TEST_CHECK(seen == 1000);
+
+    // Popped in non-decreasing deadline order, ties by position
+    long long* prev = deadline_queue_pop(q);
+    for (int i = 1; i < 1000; i++) {
+        long long* cur = deadline_queue_pop(q);
+        TEST_CHECK(*prev < *cur || (*prev == *cur && prev < cur));
+        prev = cur;
+    }
+    deadline_queue_destroy(q);
+}
+
+TEST_LIST = {
+    { "Pop the earliest deadline first", test_earliest_first },
+    { "Pop equal deadlines in push order", test_ties_in_push_order },
+    { "Match a sort on random deadlines", test_random_against_sort },
+    { NULL, NULL }
+};
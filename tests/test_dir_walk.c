@@ -0,0 +1,104 @@
+#include "../include/dir_walk.h"
+#include "acutest.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#define ROOT "/tmp/test_dir_walk"
+#define DIRS 20
+#define FILES 30
+
+typedef struct {
+    pthread_mutex_t lock;
+    int files;
+    int dirs;
+    int max_depth;
+    int nested_ok;  // Saw d7/f3 with the right relpath
+} counts_t;
+
+static void count_batch(const dir_walk_entry_t* b, size_t n, void* arg) {
+    counts_t* c = arg;
+    pthread_mutex_lock(&c->lock);
+    for (size_t i = 0; i < n; i++) {
+        if (b[i].d_type == DT_REG) c->files++;
+        if (b[i].d_type == DT_DIR) c->dirs++;
+        if (b[i].depth > c->max_depth) c->max_depth = b[i].depth;
+        if (strcmp(b[i].relpath, "d7") == 0 && strcmp(b[i].name, "f3") == 0) c->nested_ok = 1;
+
+        // The containing directory fd must be usable for *at() calls
+        struct stat st;
+        TEST_CHECK(fstatat(b[i].dirfd, b[i].name, &st, AT_SYMLINK_NOFOLLOW) == 0);
+    }
+    pthread_mutex_unlock(&c->lock);
+}
+
+// ROOT/{f0..f29, d0..d19/{f0..f29, sub/x}}
+static void build_tree(void) {
+    char path[512];
+    system("rm -rf " ROOT);
+    mkdir(ROOT, 0755);
+    for (int f = 0; f < FILES; f++) {
+        snprintf(path, sizeof(path), ROOT "/f%d", f);
+        fclose(fopen(path, "w"));
+    }
+    for (int d = 0; d < DIRS; d++) {
+        snprintf(path, sizeof(path), ROOT "/d%d", d);
+        mkdir(path, 0755);
+        for (int f = 0; f < FILES; f++) {
+            snprintf(path, sizeof(path), ROOT "/d%d/f%d", d, f);
+            fclose(fopen(path, "w"));
+        }
+        snprintf(path, sizeof(path), ROOT "/d%d/sub", d);
+        mkdir(path, 0755);
+        snprintf(path, sizeof(path), ROOT "/d%d/sub/x", d);
+        fclose(fopen(path, "w"));
+    }
+}
+
+static void walk(int threads, int max_depth, counts_t* c) {
+    memset(c, 0, sizeof(*c));
+    pthread_mutex_init(&c->lock, NULL);
+    dir_walk_opts_t o = { .threads = threads, .max_depth = max_depth, .batch_size = 7 };
+    TEST_CHECK(dir_walk(ROOT, &o, count_batch, c) == 0);
+    pthread_mutex_destroy(&c->lock);
+}
+
+void test_walk_full_tree(void) {
+    build_tree();
+    for (int threads = 1; threads <= 4; threads *= 2) {
+        counts_t c;
+        walk(threads, 0, &c);
+        TEST_CHECK(c.files == FILES + DIRS * (FILES + 1));
+        TEST_MSG("threads=%d files=%d", threads, c.files);
+        TEST_CHECK(c.dirs == DIRS * 2);
+        TEST_CHECK(c.max_depth == 2);
+        TEST_CHECK(c.nested_ok);
+    }
+}
+
+void test_walk_depth_limit(void) {
+    build_tree();
+    counts_t c;
+    walk(4, 1, &c);
+    TEST_CHECK(c.files == FILES);
+    TEST_CHECK(c.dirs == DIRS);
+    TEST_CHECK(c.max_depth == 0);
+}
+
+void test_walk_missing_root(void) {
+    counts_t c;
+    memset(&c, 0, sizeof(c));
+    TEST_CHECK(dir_walk(ROOT "/does_not_exist", NULL, count_batch, &c) == -1);
+    TEST_CHECK(c.files == 0);
+    system("rm -rf " ROOT);
+}
+
+TEST_LIST = {
+    { "Walk the full tree with 1, 2 and 4 threads", test_walk_full_tree },
+    { "Respect max_depth", test_walk_depth_limit },
+    { "Report an unreadable root", test_walk_missing_root },
+    { NULL, NULL }
+};
@@ -58,6 +58,10 @@
  void test_inotify_monitoring();
  void test_console_commands();
  void test_worker_limit();
+ void test_thread_executor();
+ void test_chained_targets();
+ void test_watch_events();
+ void test_status_all();
  
  /**
   * @brief Create a test file with specific content
@@ -689,6 +693,249 @@
      printf("Worker limit test complete.\n");
  }
  
+ /**
+  * @brief Test the in-process threaded executor
+  *
+  * Starts the manager with "-e thread" and verifies that both the initial
+  * full sync and an inotify-triggered copy happen without worker processes.
+  */
+ void test_thread_executor() {
+     printf("Testing threaded executor...\n");
+     
+     // Setup test environment
+     setup_test_env();
+     create_test_file(TEST_SOURCE_DIR "/initial.txt", "Initial");
+     
+     // Start manager in thread mode
+     pid_t manager_pid = fork();
+     if (manager_pid == 0) {
+         execl("./fss_manager", "fss_manager", "-l", TEST_MANAGER_LOG, "-c", TEST_CONFIG_FILE,
+               "-n", "3", "-e", "thread", NULL);
+         exit(1);
+     }
+     
+     // Give manager time to start and complete initial sync
+     sleep(2);
+     TEST_CHECK(file_exists(TEST_TARGET_DIR "/initial.txt"));
+     
+     // Create a new file and wait for it to be copied
+     create_test_file(TEST_SOURCE_DIR "/threaded.txt", "Copied in-process");
+     sleep(2);
+     
+     char* content = read_file_content(TEST_TARGET_DIR "/threaded.txt");
+     TEST_CHECK(content != NULL);
+     if (content) {
+         TEST_CHECK(strcmp(content, "Copied in-process") == 0);
+         free(content);
+     }
+     
+     // Results are logged in the usual format
+     char* log_content = read_file_content(TEST_MANAGER_LOG);
+     TEST_CHECK(log_content != NULL);
+     if (log_content) {
+         TEST_CHECK(strstr(log_content, "[FULL] [SUCCESS]") != NULL);
+         TEST_CHECK(strstr(log_content, "[ADDED] [SUCCESS]") != NULL);
+         free(log_content);
+     }
+     
+     // Clean up
+     kill(manager_pid, SIGTERM);
+     waitpid(manager_pid, NULL, 0);
+     cleanup_test_env();
+     
+     printf("Threaded executor test complete.\n");
+ }
+ 
+ /**
+  * @brief Test feedback suppression when a target is itself monitored
+  *
+  * Chains source -> target -> target2. The copies made into the middle
+  * directory must not come back as extra tasks: the second pair runs at
+  * most once per task of the first pair, and the file still reaches the end.
+  */
+ void test_chained_targets() {
+     printf("Testing chained targets...\n");
+     
+     // Setup test environment with a second pair reading the first one's target
+     setup_test_env();
+     FILE* config = fopen(TEST_CONFIG_FILE, "a");
+     if (config) {
+         fprintf(config, "%s %s\n", TEST_TARGET_DIR, TEST_TARGET_DIR2);
+         fclose(config);
+     }
+     
+     pid_t manager_pid = fork();
+     if (manager_pid == 0) {
+         execl("./fss_manager", "fss_manager", "-l", TEST_MANAGER_LOG, "-c", TEST_CONFIG_FILE, "-n", "5", NULL);
+         exit(1);
+     }
+     sleep(3);
+     
+     // A file big enough to be written in many chunks
+     char* big = malloc(256 * 1024 + 1);
+     memset(big, 'x', 256 * 1024);
+     big[256 * 1024] = '\0';
+     create_test_file(TEST_SOURCE_DIR "/chained.txt", big);
+     sleep(5);
+     
+     char* content = read_file_content(TEST_TARGET_DIR2 "/chained.txt");
+     TEST_CHECK(content != NULL);
+     if (content) {
+         TEST_CHECK(strcmp(content, big) == 0);
+         free(content);
+     }
+     free(big);
+     
+     char* log_content = read_file_content(TEST_MANAGER_LOG);
+     TEST_CHECK(log_content != NULL);
+     if (log_content) {
+         TEST_CHECK(strstr(log_content, "Rejected") == NULL);  // Chains are allowed
+         
+         char first[PATH_MAX], second[PATH_MAX];
+         snprintf(first, sizeof(first), "[%s] [%s]", TEST_SOURCE_DIR, TEST_TARGET_DIR);
+         snprintf(second, sizeof(second), "[%s] [%s]", TEST_TARGET_DIR, TEST_TARGET_DIR2);
+         
+         // Count finished per-file tasks of each pair
+         int first_tasks = 0, second_tasks = 0;
+         for (char* line = strtok(log_content, "\n"); line; line = strtok(NULL, "\n")) {
+             if (!strstr(line, "chained.txt was copied")) continue;
+             if (strstr(line, first)) first_tasks++;
+             if (strstr(line, second)) second_tasks++;
+         }
+         TEST_CHECK(first_tasks >= 1);
+         TEST_CHECK(second_tasks >= 1 && second_tasks <= first_tasks);
+         TEST_MSG("first=%d second=%d", first_tasks, second_tasks);
+         free(log_content);
+     }
+     
+     kill(manager_pid, SIGTERM);
+     waitpid(manager_pid, NULL, 0);
+     cleanup_test_env();
+     
+     printf("Chained targets test complete.\n");
+ }
+ 
+ /**
+  * @brief Test the watch event stream
+  *
+  * Subscribes through the console pipes, creates a file, and verifies that
+  * START and FINISH events for it are pushed before unwatch ends the stream.
+  */
+ void test_watch_events() {
+     printf("Testing watch events...\n");
+     
+     setup_test_env();
+     
+     pid_t manager_pid = fork();
+     if (manager_pid == 0) {
+         execl("./fss_manager", "fss_manager", "-l", TEST_MANAGER_LOG, "-c", TEST_CONFIG_FILE, "-n", "5", NULL);
+         exit(1);
+     }
+     sleep(2);
+     
+     int fd_in = open("fss_in", O_WRONLY);
+     int fd_out = open("fss_out", O_RDONLY | O_NONBLOCK);
+     TEST_CHECK(fd_in >= 0);
+     TEST_CHECK(fd_out >= 0);
+     
+     char cmd[PATH_MAX * 2];
+     snprintf(cmd, sizeof(cmd), "watch %s\n", TEST_SOURCE_DIR);
+     write(fd_in, cmd, strlen(cmd));
+     sleep(1);
+     
+     create_test_file(TEST_SOURCE_DIR "/watched.txt", "watched");
+     sleep(2);
+     
+     write(fd_in, "unwatch\n", 8);
+     sleep(1);
+     
+     // Collect everything pushed to the console
+     char out[16384];
+     size_t len = 0;
+     ssize_t n;
+     while (len < sizeof(out) - 1 && (n = read(fd_out, out + len, sizeof(out) - 1 - len)) > 0)
+         len += n;
+     out[len] = '\0';
+     
+     TEST_CHECK(strstr(out, "Watching") != NULL);
+     TEST_CHECK(strstr(out, "[START]") != NULL);
+     TEST_CHECK(strstr(out, "[FINISH]") != NULL);
+     TEST_CHECK(strstr(out, "File: watched.txt") != NULL);
+     TEST_CHECK(strstr(out, "Watch stopped (0 events dropped)") != NULL);
+     TEST_MSG("console output: %s", out);
+     
+     kill(manager_pid, SIGTERM);
+     waitpid(manager_pid, NULL, 0);
+     close(fd_in);
+     close(fd_out);
+     cleanup_test_env();
+     
+     printf("Watch events test complete.\n");
+ }
+ 
+ /**
+  * @brief Test the bulk status response
+  *
+  * Syncs a file in process mode, then reads a complete "status --all"
+  * response and checks its framing and the byte count of the record.
+  */
+ void test_status_all() {
+     printf("Testing bulk status...\n");
+     
+     setup_test_env();
+     create_test_file(TEST_SOURCE_DIR "/bulk.txt", "0123456789");
+     
+     pid_t manager_pid = fork();
+     if (manager_pid == 0) {
+         execl("./fss_manager", "fss_manager", "-l", TEST_MANAGER_LOG, "-c", TEST_CONFIG_FILE, "-n", "5", NULL);
+         exit(1);
+     }
+     sleep(2);
+     
+     int fd_in = open("fss_in", O_WRONLY);
+     int fd_out = open("fss_out", O_RDONLY | O_NONBLOCK);
+     TEST_CHECK(fd_in >= 0);
+     TEST_CHECK(fd_out >= 0);
+     
+     write(fd_in, "status --all\n", 13);
+     sleep(1);
+     
+     char out[16384];
+     size_t len = 0;
+     ssize_t n;
+     while (len < sizeof(out) - 1 && (n = read(fd_out, out + len, sizeof(out) - 1 - len)) > 0)
+         len += n;
+     out[len] = '\0';
+     
+     TEST_CHECK(strncmp(out, "BEGIN STATUS_ALL fields=source,target,", 38) == 0);
+     TEST_CHECK(strstr(out, "END STATUS_ALL count=1\n") != NULL);
+     
+     // source, target, active, syncing, last_sync, errors, queued, in_flight, bytes_synced
+     char* rec = strstr(out, TEST_SOURCE_DIR "\t");
+     TEST_CHECK(rec != NULL);
+     if (rec) {
+         char src[PATH_MAX], dst[PATH_MAX];
+         int active, syncing, errors, queued, in_flight;
+         long last_sync;
+         unsigned long long bytes;
+         int f = sscanf(rec, "%s\t%s\t%d\t%d\t%ld\t%d\t%d\t%d\t%llu", src, dst, &active,
+                        &syncing, &last_sync, &errors, &queued, &in_flight, &bytes);
+         TEST_CHECK(f == 9);
+         TEST_CHECK(active == 1);
+         TEST_CHECK(last_sync > 0);
+         TEST_CHECK(bytes == 10);
+         TEST_MSG("record: %.200s", rec);
+     }
+     
+     kill(manager_pid, SIGTERM);
+     waitpid(manager_pid, NULL, 0);
+     close(fd_in);
+     close(fd_out);
+     cleanup_test_env();
+     
+     printf("Bulk status test complete.\n");
+ }
+ 
  /**
   * Test list for the acutest framework
   * Registers all test functions to be run by the test harness
@@ -701,5 +948,9 @@
      { "test_inotify_monitoring", test_inotify_monitoring },
      { "test_console_commands", test_console_commands },
      { "test_worker_limit", test_worker_limit },
+     { "test_thread_executor", test_thread_executor },
+     { "test_chained_targets", test_chained_targets },
+     { "test_watch_events", test_watch_events },
+     { "test_status_all", test_status_all },
      { NULL, NULL }
  };
\ No newline at end of file
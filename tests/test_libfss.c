@@ -0,0 +1,238 @@
+#include "../include/libfss.h"
+#include "acutest.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+static char dir[64];
+static pthread_t fake;
+static int overlapped;   // A command arrived while "status --all" was being answered
+
+// Writes a whole reply, waiting while the FIFO is full
+static void put(int fd, const char* text) {
+    size_t len = strlen(text), off = 0;
+    while (off < len) {
+        ssize_t w = write(fd, text + off, len - off);
+        if (w > 0) off += w;
+        else usleep(1000);
+    }
+}
+
+// Stands in for fss_manager: answers tagged commands the way it does
+//   echo <text>  -> <text>
+//   multi <n>    -> n lines
+//   event        -> an EVENT line, then "ok"
+//   silent       -> nothing at all
+//   status --all -> a framed reply, checking nothing was pipelined behind it
+//   quit         -> "bye", then closes its end
+static void* fake_main(void* arg) {
+    (void)arg;
+    char path[96], buf[8192];
+    size_t len = 0;
+    snprintf(path, sizeof(path), "%s/fss_in", dir);
+    int fd_in = open(path, O_RDONLY | O_NONBLOCK);
+    snprintf(path, sizeof(path), "%s/fss_out", dir);
+    int fd_out = -1;
+
+    while (1) {
+        ssize_t n = read(fd_in, buf + len, sizeof(buf) - 1 - len);
+        if (n <= 0) {
+            usleep(1000);
+            continue;
+        }
+        if (fd_out < 0) fd_out = open(path, O_WRONLY | O_NONBLOCK);
+        len += n;
+        buf[len] = '\0';
+
+        char *line = buf, *nl;
+        while ((nl = strchr(line, '\n'))) {
+            *nl = '\0';
+            char tag[32], out[256];
+            int skip = 0;
+            sscanf(line, "@%31s %n", tag, &skip);
+            const char* cmd = line + skip;
+
+            if (!strncmp(cmd, "echo ", 5)) {
+                snprintf(out, sizeof(out), "%s\n@%s END\n", cmd + 5, tag);
+                put(fd_out, out);
+            } else if (!strncmp(cmd, "multi ", 6)) {
+                for (int i = 0; i < atoi(cmd + 6); i++) {
+                    snprintf(out, sizeof(out), "line %d\n", i);
+                    put(fd_out, out);
+                }
+                snprintf(out, sizeof(out), "@%s END\n", tag);
+                put(fd_out, out);
+            } else if (!strcmp(cmd, "event")) {
+                snprintf(out, sizeof(out), "EVENT [now] [PING]\nok\n@%s END\n", tag);
+                put(fd_out, out);
+            } else if (!strcmp(cmd, "status --all")) {
+                usleep(50000);
+                if (nl[1] || read(fd_in, out, 1) > 0) overlapped = 1;
+                snprintf(out, sizeof(out), "BEGIN STATUS_ALL\nEND STATUS_ALL count=0\n@%s END\n", tag);
+                put(fd_out, out);
+            } else if (!strcmp(cmd, "quit")) {
+                snprintf(out, sizeof(out), "bye\n@%s END\n", tag);
+                put(fd_out, out);
+                close(fd_out);
+                close(fd_in);
+                return NULL;
+            }
+            line = nl + 1;
+        }
+        len -= line - buf;
+        memmove(buf, line, len);
+    }
+}
+
+static void start_fake(void) {
+    char path[96];
+    signal(SIGPIPE, SIG_IGN);
+    snprintf(dir, sizeof(dir), "/tmp/test_libfss_XXXXXX");
+    TEST_ASSERT(mkdtemp(dir) != NULL);
+    snprintf(path, sizeof(path), "%s/fss_in", dir);
+    mkfifo(path, 0666);
+    snprintf(path, sizeof(path), "%s/fss_out", dir);
+    mkfifo(path, 0666);
+    overlapped = 0;
+    pthread_create(&fake, NULL, fake_main, NULL);
+}
+
+// Ends the fake manager through the client and removes its FIFOs
+static void stop_fake(fss_client_t* c) {
+    char* r = fss_call(c, "quit", 2000);
+    TEST_CHECK(r && !strcmp(r, "bye\n"));
+    free(r);
+    pthread_join(fake, NULL);
+    fss_close(c);
+
+    char cmd[96];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    TEST_CHECK(system(cmd) == 0);
+}
+
+typedef struct {
+    int next;        // Number expected in the next reply
+    int ok, bad;
+} order_t;
+
+static void check_order(fss_reply_status_t status, const char* reply, void* ctx) {
+    order_t* o = ctx;
+    char want[32];
+    snprintf(want, sizeof(want), "%d\n", o->next++);
+    if (status == FSS_REPLY_OK && !strcmp(reply, want)) o->ok++;
+    else o->bad++;
+}
+
+static void count_event(const char* line, void* ctx) {
+    if (!strcmp(line, "EVENT [now] [PING]")) (*(int*)ctx)++;
+}
+
+static void record_status(fss_reply_status_t status, const char* reply, void* ctx) {
+    (void)reply;
+    *(fss_reply_status_t*)ctx = status;
+}
+
+void test_call(void) {
+    start_fake();
+    fss_client_t* c = fss_connect(dir, 2000);
+    TEST_ASSERT(c != NULL);
+
+    char* r = fss_call(c, "echo hello", 2000);
+    TEST_CHECK(r && !strcmp(r, "hello\n"));
+    free(r);
+
+    // Replies bigger than a pipe arrive whole
+    r = fss_call(c, "multi 5000", 5000);
+    TEST_CHECK(r && strstr(r, "line 0\n") == r && strstr(r, "line 4999\n"));
+    free(r);
+
+    TEST_CHECK(fss_call(c, "bad\ncommand", 2000) == NULL && errno == EINVAL);
+    TEST_CHECK(fss_pending(c) == 0);
+    stop_fake(c);
+}
+
+void test_connect_timeout(void) {
+    TEST_CHECK(fss_connect("/tmp/test_libfss_missing", 50) == NULL && errno == ETIMEDOUT);
+}
+
+void test_pipelined(void) {
+    start_fake();
+    fss_client_t* c = fss_connect(dir, 2000);
+    TEST_ASSERT(c != NULL);
+
+    order_t o = { 0, 0, 0 };
+    char cmd[32];
+    for (int i = 0; i < 2000; i++) {
+        snprintf(cmd, sizeof(cmd), "echo %d", i);
+        TEST_ASSERT(fss_submit(c, cmd, 5000, check_order, &o) == 0);
+    }
+    TEST_CHECK(fss_pending(c) == 2000);
+    TEST_CHECK(fss_wait(c, 10000) == 0);
+    TEST_CHECK(o.ok == 2000 && o.bad == 0);
+    TEST_MSG("ok %d, bad %d", o.ok, o.bad);
+    stop_fake(c);
+}
+
+void test_events_and_exclusive(void) {
+    start_fake();
+    fss_client_t* c = fss_connect(dir, 2000);
+    TEST_ASSERT(c != NULL);
+    int events = 0;
+    fss_on_event(c, count_event, &events);
+
+    char* r = fss_call(c, "event", 2000);
+    TEST_CHECK(r && !strcmp(r, "ok\n"));
+    TEST_CHECK(events == 1);
+    free(r);
+
+    // Nothing is written behind a bulk status until it is answered
+    order_t o = { 0, 0, 0 };
+    fss_reply_status_t st = -1;
+    fss_submit(c, "echo 0", 2000, check_order, &o);
+    fss_submit(c, "status --all", 2000, record_status, &st);
+    fss_submit(c, "echo 1", 2000, check_order, &o);
+    TEST_CHECK(fss_wait(c, 5000) == 0);
+    TEST_CHECK(st == FSS_REPLY_OK && o.ok == 2 && !overlapped);
+    stop_fake(c);
+}
+
+void test_timeout_and_close(void) {
+    start_fake();
+    fss_client_t* c = fss_connect(dir, 2000);
+    TEST_ASSERT(c != NULL);
+
+    // A request never answered times out; later replies still match up
+    TEST_CHECK(fss_call(c, "silent", 100) == NULL && errno == ETIMEDOUT);
+    char* r = fss_call(c, "echo after", 2000);
+    TEST_CHECK(r && !strcmp(r, "after\n"));
+    free(r);
+
+    // Requests behind the manager's exit fail as closed
+    fss_reply_status_t st = -1;
+    fss_submit(c, "quit", 2000, NULL, NULL);
+    fss_submit(c, "echo lost", 2000, record_status, &st);
+    TEST_CHECK(fss_wait(c, 5000) == -1);
+    TEST_CHECK(st == FSS_REPLY_CLOSED);
+    TEST_CHECK(fss_submit(c, "echo x", 100, NULL, NULL) == -1 && errno == EPIPE);
+    pthread_join(fake, NULL);
+    fss_close(c);
+
+    char cmd[96];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    TEST_CHECK(system(cmd) == 0);
+}
+
+TEST_LIST = {
+    { "Send a command and wait for its reply", test_call },
+    { "Time out connecting to a missing manager", test_connect_timeout },
+    { "Match pipelined replies to their requests", test_pipelined },
+    { "Deliver events and run exclusive commands", test_events_and_exclusive },
+    { "Time out a request and close with requests pending", test_timeout_and_close },
+    { NULL, NULL }
+};
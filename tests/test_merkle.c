@@ -0,0 +1,175 @@
+#include "../include/merkle.h"
+#include "acutest.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define SRC "/tmp/test_merkle_src"
+#define DST "/tmp/test_merkle_dst"
+
+typedef struct {
+    int count;
+    int only_a, only_b, differs;
+    char last[256];
+} diffs_t;
+
+static int record(const char* path, merkle_diff_kind_t kind, int is_dir, void* ctx) {
+    (void)is_dir;
+    diffs_t* d = ctx;
+    d->count++;
+    if (kind == MERKLE_ONLY_A) d->only_a++;
+    if (kind == MERKLE_ONLY_B) d->only_b++;
+    if (kind == MERKLE_DIFFERS) d->differs++;
+    snprintf(d->last, sizeof(d->last), "%s", path);
+    return 0;
+}
+
+static diffs_t diff(merkle_tree_t* a, merkle_tree_t* b) {
+    diffs_t d;
+    memset(&d, 0, sizeof(d));
+    merkle_diff(a, b, record, &d);
+    return d;
+}
+
+static void write_file(const char* path, const char* text) {
+    FILE* f = fopen(path, "w");
+    fputs(text, f);
+    fclose(f);
+}
+
+// <root>/{top, d0..d9/{f0..f9, sub/x}}, every file dated the same
+static void build_tree(const char* root) {
+    char path[256];
+    snprintf(path, sizeof(path), "rm -rf %s && mkdir -p %s", root, root);
+    system(path);
+    snprintf(path, sizeof(path), "%s/top", root);
+    write_file(path, "top");
+    for (int d = 0; d < 10; d++) {
+        snprintf(path, sizeof(path), "%s/d%d/sub", root, d);
+        char cmd[300];
+        snprintf(cmd, sizeof(cmd), "mkdir -p %s", path);
+        system(cmd);
+        strcat(path, "/x");
+        write_file(path, "x");
+        for (int f = 0; f < 10; f++) {
+            snprintf(path, sizeof(path), "%s/d%d/f%d", root, d, f);
+            write_file(path, "data");
+        }
+    }
+    snprintf(path, sizeof(path), "find %s -exec touch -h -d @1000000000 {} +", root);
+    system(path);
+}
+
+void test_update_and_digest(void) {
+    merkle_tree_t* t = merkle_create(0);
+    uint64_t empty = merkle_digest(t, "");
+    struct stat st;
+    memset(&st, 0, sizeof(st));
+    st.st_mode = S_IFREG | 0644;
+    st.st_size = 10;
+
+    TEST_CHECK(merkle_update(t, "a/b/c", &st) == 0);
+    TEST_CHECK(merkle_size(t) == 3);
+    uint64_t one = merkle_digest(t, "");
+    uint64_t dir_b = merkle_digest(t, "a/b");
+    TEST_CHECK(one != empty && dir_b != 0);
+
+    // A change shows in every directory above it, and undoing it restores them
+    st.st_size = 11;
+    merkle_update(t, "a/b/c", &st);
+    TEST_CHECK(merkle_digest(t, "a/b") != dir_b && merkle_digest(t, "") != one);
+    st.st_size = 10;
+    merkle_update(t, "a/b/c", &st);
+    TEST_CHECK(merkle_digest(t, "a/b") == dir_b && merkle_digest(t, "") == one);
+
+    // Insertion order does not matter
+    merkle_tree_t* u = merkle_create(0);
+    merkle_update(u, "a/z", &st);
+    merkle_update(u, "a/b/c", &st);
+    merkle_update(t, "a/z", &st);
+    TEST_CHECK(merkle_digest(t, "") == merkle_digest(u, ""));
+
+    TEST_CHECK(merkle_update(t, "a", NULL) == 0);
+    TEST_CHECK(merkle_size(t) == 0 && merkle_digest(t, "") == empty);
+    TEST_CHECK(merkle_digest(t, "a/b") == 0);
+    TEST_CHECK(merkle_update(t, "", NULL) == -1);
+    merkle_destroy(t);
+    merkle_destroy(u);
+}
+
+void test_scan_and_diff(void) {
+    build_tree(SRC);
+    build_tree(DST);
+    merkle_tree_t* a = merkle_create(0);
+    merkle_tree_t* b = merkle_create(0);
+    TEST_CHECK(merkle_scan(a, SRC, "", 4) == 132);
+    TEST_CHECK(merkle_scan(b, DST, "", 1) == 132);
+    TEST_CHECK(merkle_size(a) == 131);
+    TEST_CHECK(merkle_digest(a, "") == merkle_digest(b, ""));
+    diffs_t d = diff(a, b);
+    TEST_CHECK(d.count == 0);
+
+    // One changed file: only the path down to it is visited
+    write_file(SRC "/d3/sub/x", "changed");
+    TEST_CHECK(merkle_scan(a, SRC, "d3/sub/x", 1) == 1);
+    d = diff(a, b);
+    TEST_CHECK(d.count == 1 && d.differs == 1 && !strcmp(d.last, "d3/sub/x"));
+    TEST_MSG("count %d last %s", d.count, d.last);
+    long visited = merkle_diff(a, b, record, &d);
+    TEST_CHECK(visited < 30);
+    TEST_MSG("visited %ld", visited);
+
+    // Missing and extra entries; a missing directory is reported once
+    system("rm -rf " SRC "/d5 && rm " DST "/top");
+    write_file(DST "/d1/extra", "e");
+    TEST_CHECK(merkle_scan(a, SRC, "d5", 1) == 0);
+    TEST_CHECK(merkle_scan(b, DST, "", 2) > 0);
+    d = diff(a, b);
+    TEST_CHECK(d.only_a == 1 && d.only_b == 2 && d.differs == 1);
+    TEST_MSG("only_a %d only_b %d differs %d", d.only_a, d.only_b, d.differs);
+
+    // Rescanning both sides from scratch agrees with the incremental trees
+    merkle_tree_t* a2 = merkle_create(0);
+    merkle_scan(a2, SRC, "", 2);
+    TEST_CHECK(merkle_digest(a2, "") == merkle_digest(a, ""));
+    merkle_destroy(a2);
+
+    TEST_CHECK(merkle_scan(a, "/tmp/test_merkle_missing", "", 1) == -1);
+    TEST_CHECK(merkle_size(a) == 0);
+    merkle_destroy(a);
+    merkle_destroy(b);
+}
+
+void test_flags(void) {
+    build_tree(SRC);
+    build_tree(DST);
+    write_file(DST "/top", "a longer body");
+    system("touch -d @1000000000 " DST "/top");
+    system("touch -d @2000000000 " DST "/d0/f0");
+
+    merkle_tree_t* a = merkle_create(0);
+    merkle_tree_t* b = merkle_create(0);
+    merkle_scan(a, SRC, "", 1);
+    merkle_scan(b, DST, "", 1);
+    TEST_CHECK(diff(a, b).differs == 2);
+    merkle_destroy(a);
+    merkle_destroy(b);
+
+    a = merkle_create(MERKLE_NO_SIZE | MERKLE_NO_MTIME);
+    b = merkle_create(MERKLE_NO_SIZE | MERKLE_NO_MTIME);
+    merkle_scan(a, SRC, "", 1);
+    merkle_scan(b, DST, "", 1);
+    TEST_CHECK(diff(a, b).count == 0);
+    merkle_destroy(a);
+    merkle_destroy(b);
+    system("rm -rf " SRC " " DST);
+}
+
+TEST_LIST = {
+    { "Update entries and carry digests to the root", test_update_and_digest },
+    { "Scan directories and report differences", test_scan_and_diff },
+    { "Leave sizes and mtimes out of digests", test_flags },
+    { NULL, NULL }
+};
@@ -0,0 +1,77 @@
+#include "../include/mpsc_queue.h"
+#include "acutest.h"
+#include <pthread.h>
+
+#define PRODUCERS 4
+#define PER_PRODUCER 100000
+
+typedef struct {
+    mpsc_node_t node;
+    int producer;
+    int seq;
+} item_t;
+
+static mpsc_queue_t queue;
+
+static void* producer(void* arg) {
+    int id = (int)(long)arg;
+    for (int i = 0; i < PER_PRODUCER; i++) {
+        item_t* it = malloc(sizeof(*it));
+        it->producer = id;
+        it->seq = i;
+        mpsc_push(&queue, &it->node);
+    }
+    return NULL;
+}
+
+void test_mpsc_fifo(void) {
+    mpsc_init(&queue);
+    TEST_ASSERT(mpsc_pop(&queue) == NULL); // Empty queue
+
+    item_t items[3];
+    for (int i = 0; i < 3; i++) {
+        items[i].seq = i;
+        mpsc_push(&queue, &items[i].node);
+    }
+
+    // Single producer: items come out in push order
+    for (int i = 0; i < 3; i++) {
+        mpsc_node_t* n = mpsc_pop(&queue);
+        TEST_ASSERT(n != NULL);
+        TEST_CHECK(mpsc_entry(n, item_t, node)->seq == i);
+    }
+    TEST_CHECK(mpsc_pop(&queue) == NULL);
+}
+
+void test_mpsc_concurrent(void) {
+    mpsc_init(&queue);
+
+    pthread_t threads[PRODUCERS];
+    for (long i = 0; i < PRODUCERS; i++)
+        pthread_create(&threads[i], NULL, producer, (void*)i);
+
+    // Consume while producers run; per-producer order must be preserved
+    int next_seq[PRODUCERS] = {0};
+    int received = 0, in_order = 1;
+    while (received < PRODUCERS * PER_PRODUCER) {
+        mpsc_node_t* n = mpsc_pop(&queue);
+        if (!n) continue;
+        item_t* it = mpsc_entry(n, item_t, node);
+        if (it->seq != next_seq[it->producer]) in_order = 0;
+        next_seq[it->producer] = it->seq + 1;
+        free(it);
+        received++;
+    }
+
+    for (int i = 0; i < PRODUCERS; i++) pthread_join(threads[i], NULL);
+
+    TEST_CHECK(in_order);
+    TEST_CHECK(received == PRODUCERS * PER_PRODUCER);
+    TEST_CHECK(mpsc_pop(&queue) == NULL);
+}
+
+TEST_LIST = {
+    { "FIFO order with a single producer", test_mpsc_fifo },
+    { "Concurrent producers", test_mpsc_concurrent },
+    { NULL, NULL }
+};
@@ -0,0 +1,87 @@
+#include "../include/path_index.h"
+#include "acutest.h"
+#include <stdio.h>
+#include <string.h>
+#include <linux/limits.h>
+
+static int A, B, C, D;
+
+void test_exact_and_prefix(void) {
+    path_index_t* idx = path_index_create();
+    TEST_CHECK(path_index_insert(idx, "/data/a", &A) == NULL);
+    TEST_CHECK(path_index_insert(idx, "/data/ab", &B) == NULL);
+    TEST_CHECK(path_index_insert(idx, "/data/a/nested", &C) == NULL);
+    TEST_CHECK(path_index_size(idx) == 3);
+
+    TEST_CHECK(path_index_find(idx, "/data/a") == &A);
+    TEST_CHECK(path_index_find(idx, "/data/ab") == &B);
+    TEST_CHECK(path_index_find(idx, "/data") == NULL); // Split point, not a key
+
+    size_t len = 0;
+    TEST_CHECK(path_index_longest_prefix(idx, "/data/a/file", &len) == &A);
+    TEST_CHECK(len == strlen("/data/a"));
+    TEST_CHECK(path_index_longest_prefix(idx, "/data/a/nested/x/y", NULL) == &C);
+    TEST_CHECK(path_index_longest_prefix(idx, "/data/abc", NULL) == NULL); // Not a component boundary
+    TEST_CHECK(path_index_longest_prefix(idx, "/data/ab", NULL) == &B);
+    TEST_CHECK(path_index_longest_prefix(idx, "/other", NULL) == NULL);
+
+    // Replacing returns the previous value
+    TEST_CHECK(path_index_insert(idx, "/data/a", &D) == &A);
+    TEST_CHECK(path_index_size(idx) == 3);
+    path_index_destroy(idx);
+}
+
+void test_find_under(void) {
+    path_index_t* idx = path_index_create();
+    path_index_insert(idx, "/srv/src", &A);
+    path_index_insert(idx, "/srv/src2/x", &B);
+
+    TEST_CHECK(path_index_find_under(idx, "/srv") == &A || path_index_find_under(idx, "/srv") == &B);
+    TEST_CHECK(path_index_find_under(idx, "/srv/src2") == &B);
+    TEST_CHECK(path_index_find_under(idx, "/srv/src") == NULL); // Itself is not below itself
+    TEST_CHECK(path_index_find_under(idx, "/srv/sr") == NULL);
+    TEST_CHECK(path_index_find_under(idx, "/") != NULL);
+    path_index_destroy(idx);
+}
+
+void test_remove_keeps_tree_consistent(void) {
+    char keys[200][32];
+    path_index_t* idx = path_index_create();
+    for (int i = 0; i < 200; i++) {
+        snprintf(keys[i], sizeof(keys[i]), "/s/%d/d%d", i % 7, i);
+        path_index_insert(idx, keys[i], keys[i]);
+    }
+    TEST_CHECK(path_index_size(idx) == 200);
+
+    for (int i = 0; i < 200; i += 2)
+        TEST_CHECK(path_index_remove(idx, keys[i]) == keys[i]);
+    TEST_CHECK(path_index_remove(idx, "/s/0") == NULL);
+    TEST_CHECK(path_index_size(idx) == 100);
+
+    for (int i = 0; i < 200; i++) {
+        void* want = (i % 2) ? keys[i] : NULL;
+        TEST_CHECK(path_index_find(idx, keys[i]) == want);
+        TEST_MSG("key %s", keys[i]);
+    }
+    path_index_destroy(idx);
+}
+
+void test_canonical(void) {
+    char out[PATH_MAX];
+    path_index_canonical("/tmp//", out, sizeof(out));
+    TEST_CHECK(strcmp(out, "/tmp") == 0);
+    path_index_canonical("/tmp/does_not_exist_pi/", out, sizeof(out));
+    TEST_CHECK(strcmp(out, "/tmp/does_not_exist_pi") == 0);
+    path_index_canonical("/no/such//dir/", out, sizeof(out));
+    TEST_CHECK(strcmp(out, "/no/such/dir") == 0);
+    path_index_canonical("/", out, sizeof(out));
+    TEST_CHECK(strcmp(out, "/") == 0);
+}
+
+TEST_LIST = {
+    { "Exact and longest-prefix lookups", test_exact_and_prefix },
+    { "Find keys below a directory", test_find_under },
+    { "Remove keeps the tree consistent", test_remove_keeps_tree_consistent },
+    { "Canonical path keys", test_canonical },
+    { NULL, NULL }
+};
@@ -0,0 +1,102 @@
+#define _GNU_SOURCE
+#include "../include/placement.h"
+#include "../include/sync_ops.h"
+#include "acutest.h"
+#include <stdio.h>
+#include <string.h>
+
+void test_topology(void) {
+    TEST_CHECK(placement_nodes() >= 1);
+
+    cpu_set_t set;
+    TEST_CHECK(placement_node_cpus(0, &set) == 0);
+    TEST_CHECK(CPU_COUNT(&set) > 0);
+    TEST_CHECK(placement_node_cpus(placement_nodes(), &set) == -1);
+    TEST_CHECK(placement_node_cpus(-1, &set) == -1);
+}
+
+void test_bind_and_unbind(void) {
+    cpu_set_t before, saved, during, node0, after;
+    sched_getaffinity(0, sizeof(before), &before);
+    placement_node_cpus(0, &node0);
+
+    TEST_CHECK(placement_current_node() == -1);
+    TEST_CHECK(placement_bind(0, &saved) == 0);
+    TEST_CHECK(placement_current_node() == 0);
+    sched_getaffinity(0, sizeof(during), &during);
+    TEST_CHECK(CPU_EQUAL(&during, &node0));
+
+    placement_unbind(&saved);
+    TEST_CHECK(placement_current_node() == -1);
+    sched_getaffinity(0, sizeof(after), &after);
+    TEST_CHECK(CPU_EQUAL(&after, &before));
+
+    TEST_CHECK(placement_bind(PLACEMENT_MAX_NODES, NULL) == -1);
+}
+
+void test_resolve(void) {
+    TEST_CHECK(placement_resolve(PLACEMENT_OFF, "/tmp", "/tmp") == -1);
+    TEST_CHECK(placement_resolve(0, "/tmp", "/tmp") == 0);
+    TEST_CHECK(placement_resolve(placement_nodes(), "/tmp", "/tmp") == -1);
+
+    // Auto either finds a valid node or declines to bind
+    int node = placement_resolve(PLACEMENT_AUTO, "/tmp", "/tmp");
+    TEST_CHECK(node >= -1 && node < placement_nodes());
+    TEST_CHECK(placement_node_of_path("/nonexistent/path") == -1);
+}
+
+void test_alloc(void) {
+    placement_buf_t b;
+    TEST_CHECK(placement_buf_alloc(&b, 1 << 16, 0) == 0);
+    TEST_CHECK(b.pages == PLACEMENT_PAGES_SMALL);
+    TEST_CHECK(b.mapped == 1 << 16);
+    char* p = b.data;
+    TEST_CHECK(p[0] == 0 && p[(1 << 16) - 1] == 0);
+    memset(p, 'x', 1 << 16);
+    placement_buf_free(&b);
+    TEST_CHECK(b.data == NULL);
+    placement_buf_free(&b); // Freeing twice is harmless
+}
+
+void test_alloc_huge(void) {
+    placement_buf_t b;
+    TEST_CHECK(placement_buf_alloc(&b, 3 * 1024 * 1024, 1) == 0);
+    TEST_CHECK(b.size == 3 * 1024 * 1024);
+    TEST_MSG("pages=%d mapped=%zu", b.pages, b.mapped);
+
+    // Huge-page kinds are rounded up and aligned; the fallback is not
+    if (b.pages != PLACEMENT_PAGES_SMALL) {
+        TEST_CHECK(b.mapped == 2 * PLACEMENT_HUGE_PAGE);
+        TEST_CHECK(((unsigned long)b.data & (PLACEMENT_HUGE_PAGE - 1)) == 0);
+    }
+    memset(b.data, 'x', b.size);
+    placement_buf_free(&b);
+}
+
+void test_numa_option(void) {
+    sync_options_t o;
+    sync_options_init(&o);
+    TEST_CHECK(o.numa_node == PLACEMENT_OFF);
+    TEST_CHECK(sync_options_set(&o, "numa_node", "auto") == 0 && o.numa_node == PLACEMENT_AUTO);
+    TEST_CHECK(sync_options_set(&o, "numa_node", "1") == 0 && o.numa_node == 1);
+    TEST_CHECK(sync_options_set(&o, "numa_node", "off") == 0 && o.numa_node == PLACEMENT_OFF);
+    TEST_CHECK(sync_options_set(&o, "numa_node", "") == -1);
+    TEST_CHECK(sync_options_set(&o, "numa_node", "-3") == -1);
+    TEST_CHECK(sync_options_set(&o, "numa_node", "x") == -1);
+
+    TEST_CHECK(o.copy_buffer_kb == 4 && o.huge_pages == 0);
+    TEST_CHECK(sync_options_set(&o, "copy_buffer", "4096") == 0 && o.copy_buffer_kb == 4096);
+    TEST_CHECK(sync_options_set(&o, "copy_buffer", "2") == -1);
+    TEST_CHECK(sync_options_set(&o, "huge_pages", "1") == 0 && o.huge_pages == 1);
+    TEST_CHECK(sync_options_set(&o, "huge_pages", "yes") == -1);
+}
+
+TEST_LIST = {
+    { "Report nodes and their CPUs", test_topology },
+    { "Bind to a node and restore the affinity", test_bind_and_unbind },
+    { "Resolve numa_node settings to a node", test_resolve },
+    { "Allocate and free a placed buffer", test_alloc },
+    { "Allocate a buffer on huge pages or fall back", test_alloc_huge },
+    { "Parse the numa_node option", test_numa_option },
+    { NULL, NULL }
+};
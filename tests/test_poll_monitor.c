@@ -0,0 +1,161 @@
+#include "../include/poll_monitor.h"
+#include "acutest.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/inotify.h>
+
+static char dir[64];
+static char seen[4096];
+
+// Appends "MASK:name " for each change, in the order reported
+static void record(const char* name, uint32_t mask, void* ctx) {
+    (void)ctx;
+    const char* what = (mask & IN_CREATE) ? "C" : (mask & IN_MODIFY) ? "M" : "D";
+    size_t used = strlen(seen);
+    snprintf(seen + used, sizeof(seen) - used, "%s%s:%s ",
+             what, (mask & IN_ISDIR) ? "d" : "", name);
+}
+
+static void write_file(const char* name, const char* text) {
+    char path[128];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE* f = fopen(path, "w");
+    fputs(text, f);
+    fclose(f);
+}
+
+// Pushes a file's mtime back so a rewrite of the same size is still seen
+static void age_file(const char* name) {
+    char path[128];
+    struct timeval tv[2] = { { 1000000, 0 }, { 1000000, 0 } };
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    utimes(path, tv);
+}
+
+static void make_dir(void) {
+    snprintf(dir, sizeof(dir), "/tmp/test_poll_XXXXXX");
+    TEST_ASSERT(mkdtemp(dir) != NULL);
+}
+
+static void remove_dir(void) {
+    char cmd[96];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    TEST_CHECK(system(cmd) == 0);
+}
+
+void test_options(void) {
+    poll_options_t o;
+    poll_options_init(&o);
+    TEST_CHECK(o.monitor == MONITOR_INOTIFY && o.min_interval == 2 && o.max_interval == 60);
+    TEST_CHECK(poll_options_set(&o, "monitor", "poll") == 0 && o.monitor == MONITOR_POLL);
+    TEST_CHECK(poll_options_set(&o, "monitor", "fanotify") == -1);
+    TEST_CHECK(poll_options_set(&o, "poll_min", "5") == 0 && o.min_interval == 5);
+    TEST_CHECK(poll_options_set(&o, "poll_max", "0") == -1);
+    TEST_CHECK(poll_options_set(&o, "poll_max", "9x") == -1);
+    TEST_CHECK(poll_options_set(&o, "policy", "window") == 1);
+    TEST_CHECK(poll_options_validate(&o) == 0);
+    TEST_CHECK(poll_options_set(&o, "poll_max", "4") == 0);
+    TEST_CHECK(poll_options_validate(&o) == -1);
+}
+
+void test_interval(void) {
+    poll_options_t o;
+    poll_options_init(&o);
+
+    // Quiet scans back off to poll_max, busy ones speed up to poll_min
+    TEST_CHECK(poll_next_interval(&o, 2, 0, 0) == 4);
+    TEST_CHECK(poll_next_interval(&o, 48, 0, 0) == 60);
+    TEST_CHECK(poll_next_interval(&o, 60, 3, 0) == 30);
+    TEST_CHECK(poll_next_interval(&o, 3, 1, 0) == 2);
+
+    // A slow scan keeps the interval at four times its duration
+    TEST_CHECK(poll_next_interval(&o, 4, 10, 2500) == 10);
+    TEST_CHECK(poll_next_interval(&o, 4, 10, 60000) == 60);
+}
+
+void test_scan(void) {
+    make_dir();
+    write_file("a", "one");
+    write_file("b", "two");
+    poll_manifest_t* m = poll_manifest_create();
+
+    // The first scan records the baseline only
+    seen[0] = '\0';
+    TEST_CHECK(poll_scan(m, dir, record, NULL) == 0);
+    TEST_CHECK(poll_manifest_size(m) == 2);
+    TEST_CHECK(poll_scan(m, dir, record, NULL) == 0);
+
+    char path[128];
+    age_file("a");
+    write_file("a", "ONE");   // Same size, new mtime
+    write_file("c", "three");
+    snprintf(path, sizeof(path), "%s/b", dir);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/sub", dir);
+    mkdir(path, 0755);
+    seen[0] = '\0';
+    TEST_CHECK(poll_scan(m, dir, record, NULL) == 4);
+    TEST_CHECK(strstr(seen, "M:a ") && strstr(seen, "C:c ") && strstr(seen, "D:b ") &&
+               strstr(seen, "Cd:sub "));
+    TEST_MSG("seen: %s", seen);
+    TEST_CHECK(poll_manifest_size(m) == 3);
+
+    // Changes inside a subdirectory are not the top level's business
+    write_file("sub/x", "inner");
+    seen[0] = '\0';
+    TEST_CHECK(poll_scan(m, dir, record, NULL) == 0);
+    TEST_MSG("seen: %s", seen);
+
+    // A file replaced by a directory is deleted and created again
+    snprintf(path, sizeof(path), "%s/c", dir);
+    unlink(path);
+    mkdir(path, 0755);
+    seen[0] = '\0';
+    TEST_CHECK(poll_scan(m, dir, record, NULL) == 2);
+    TEST_CHECK(strcmp(seen, "D:c Cd:c ") == 0);
+    TEST_MSG("seen: %s", seen);
+
+    // An unreadable directory is not a mass deletion
+    remove_dir();
+    seen[0] = '\0';
+    TEST_CHECK(poll_scan(m, dir, record, NULL) == -1);
+    TEST_CHECK(seen[0] == '\0' && poll_manifest_size(m) == 3);
+    poll_manifest_destroy(m);
+}
+
+void test_many_entries(void) {
+    make_dir();
+    for (int i = 0; i < 2000; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "f%d", i);
+        write_file(name, "x");
+    }
+    poll_manifest_t* m = poll_manifest_create();
+    TEST_CHECK(poll_scan(m, dir, record, NULL) == 0);
+    TEST_CHECK(poll_manifest_size(m) == 2000);
+
+    // Delete every other file
+    for (int i = 0; i < 2000; i += 2) {
+        char path[128];
+        snprintf(path, sizeof(path), "%s/f%d", dir, i);
+        unlink(path);
+    }
+    seen[0] = '\0';
+    TEST_CHECK(poll_scan(m, dir, record, NULL) == 1000);
+    TEST_CHECK(poll_manifest_size(m) == 1000);
+    poll_manifest_destroy(m);
+    remove_dir();
+}
+
+TEST_LIST = {
+    { "Parse and validate monitor options", test_options },
+    { "Adapt the poll interval to activity", test_interval },
+    { "Report changes between scans", test_scan },
+    { "Scan a directory with many entries", test_many_entries },
+    { NULL, NULL }
+};
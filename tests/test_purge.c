@@ -0,0 +1,88 @@
+#include "../include/purge.h"
+#include "acutest.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <linux/limits.h>
+
+#define ROOT "/tmp/test_purge"
+
+// ROOT/{f0..f19, d0..d9/{f0..f19, sub/{x, link}}}
+static void build_tree(void) {
+    char path[512];
+    system("rm -rf " ROOT "*");
+    mkdir(ROOT, 0755);
+    for (int f = 0; f < 20; f++) {
+        snprintf(path, sizeof(path), ROOT "/f%d", f);
+        fclose(fopen(path, "w"));
+    }
+    for (int d = 0; d < 10; d++) {
+        snprintf(path, sizeof(path), ROOT "/d%d", d);
+        mkdir(path, 0755);
+        for (int f = 0; f < 20; f++) {
+            snprintf(path, sizeof(path), ROOT "/d%d/f%d", d, f);
+            fclose(fopen(path, "w"));
+        }
+        snprintf(path, sizeof(path), ROOT "/d%d/sub", d);
+        mkdir(path, 0755);
+        snprintf(path, sizeof(path), ROOT "/d%d/sub/x", d);
+        fclose(fopen(path, "w"));
+        snprintf(path, sizeof(path), ROOT "/d%d/sub/link", d);
+        symlink("/etc", path); // Must be unlinked, never followed
+    }
+}
+
+void test_purge_parallel(void) {
+    struct stat st;
+    build_tree();
+    purge_opts_t o = { .threads = 4, .rate = 0 };
+    purge_stats_t s;
+    TEST_CHECK(purge_tree(ROOT, &o, &s) == 0);
+    TEST_CHECK(s.files == 20 + 10 * 22);
+    TEST_CHECK(s.dirs == 1 + 10 * 2);
+    TEST_CHECK(s.errors == 0);
+    TEST_CHECK(stat(ROOT, &st) < 0);
+    TEST_CHECK(stat("/etc", &st) == 0);
+}
+
+void test_purge_rate_limit(void) {
+    build_tree();
+    purge_opts_t o = { .threads = 2, .rate = 1000 };
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    TEST_CHECK(purge_tree(ROOT, &o, NULL) == 0);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    TEST_CHECK(secs >= 0.2); // 260 unlinks at 1000/s
+    TEST_MSG("took %.3fs", secs);
+}
+
+void test_purge_rename_aside(void) {
+    char aside[PATH_MAX];
+    struct stat st;
+    build_tree();
+    TEST_CHECK(purge_rename_aside(ROOT "/", aside, sizeof(aside)) == 0);
+    TEST_CHECK(stat(ROOT, &st) < 0);
+    TEST_CHECK(strncmp(aside, "/tmp/.fss_purge.test_purge.", 27) == 0);
+    TEST_MSG("aside=%s", aside);
+    TEST_CHECK(purge_tree(aside, NULL, NULL) == 0);
+    TEST_CHECK(stat(aside, &st) < 0);
+}
+
+void test_purge_single_file(void) {
+    purge_stats_t s;
+    fclose(fopen(ROOT, "w"));
+    TEST_CHECK(purge_tree(ROOT, NULL, &s) == 0);
+    TEST_CHECK(s.files == 1);
+    TEST_CHECK(purge_tree(ROOT, NULL, &s) == -1);
+}
+
+TEST_LIST = {
+    { "Parallel purge removes the whole tree", test_purge_parallel },
+    { "Rate limit slows the purge down", test_purge_rate_limit },
+    { "Rename aside then purge", test_purge_rename_aside },
+    { "Purge a single file", test_purge_single_file },
+    { NULL, NULL }
+};
@@ -0,0 +1,140 @@
+#include "../include/status_shm.h"
+#include "acutest.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define TABLE "/tmp/test_status_shm"
+
+// Fills every field from one value, so a torn read shows as a mismatch
+static void fill(status_record_t* r, int v) {
+    memset(r, 0, sizeof(*r));
+    snprintf(r->source, sizeof(r->source), "/src/%d", v);
+    snprintf(r->target, sizeof(r->target), "/dst/%d", v);
+    r->active = 1;
+    r->errors = r->queued = r->in_flight = r->max_lag = v;
+    r->last_sync = r->oldest_change_ms = r->updated_ms = v;
+    r->bytes_synced = r->held_changes = r->deadline_misses = r->suppressed_events = v;
+}
+
+static int consistent(const status_record_t* r) {
+    int v = r->errors;
+    char src[32], dst[32];
+    snprintf(src, sizeof(src), "/src/%d", v);
+    snprintf(dst, sizeof(dst), "/dst/%d", v);
+    return !strcmp(r->source, src) && !strcmp(r->target, dst) && r->queued == v &&
+           r->in_flight == v && r->max_lag == v && r->last_sync == v &&
+           r->oldest_change_ms == v && r->updated_ms == v && r->bytes_synced == (uint64_t)v &&
+           r->held_changes == (uint64_t)v && r->deadline_misses == (uint64_t)v &&
+           r->suppressed_events == (uint64_t)v;
+}
+
+void test_publish_and_read(void) {
+    status_shm_t* w = status_shm_create(TABLE, 4);
+    TEST_ASSERT(w != NULL);
+    status_shm_t* r = status_shm_open(TABLE);
+    TEST_ASSERT(r != NULL);
+    TEST_CHECK(status_shm_count(r) == 0);
+    TEST_CHECK(status_shm_age_ms(r) == -1);
+
+    status_record_t rec, got;
+    for (int i = 0; i < 4; i++) {
+        int slot = status_shm_claim(w);
+        TEST_CHECK(slot == i);
+        fill(&rec, 10 + i);
+        status_shm_publish(w, slot, &rec);
+    }
+    TEST_CHECK(status_shm_claim(w) == -1);  // Full
+    status_shm_heartbeat(w, status_shm_now_ms());
+
+    TEST_CHECK(status_shm_count(r) == 4);
+    TEST_CHECK(status_shm_read(r, 2, &got) == 0 && got.errors == 12 && consistent(&got));
+    TEST_CHECK(status_shm_read(r, 4, &got) == -1);
+    TEST_CHECK(status_shm_find(r, "/src/13", &got) == 0 && got.queued == 13);
+    TEST_CHECK(status_shm_find(r, "/src/99", &got) == -1);
+    TEST_CHECK(status_shm_age_ms(r) >= 0 && status_shm_age_ms(r) < 1000);
+
+    char line[PATH_MAX * 2 + 256];
+    fill(&rec, 5);
+    rec.oldest_change_ms = 1000;
+    rec.updated_ms = 1500;
+    status_shm_format(&rec, 3000, line, sizeof(line));
+    TEST_CHECK(strcmp(line, "/src/5\t/dst/5\t1\t5\t5\t5\t5\t5\t2000\t5\t5\t5\t5\t1500\n") == 0);
+    TEST_MSG("line: %s", line);
+
+    // A new table replaces the file; a reader of the old one is unaffected
+    status_shm_t* w2 = status_shm_create(TABLE, 2);
+    TEST_ASSERT(w2 != NULL);
+    TEST_CHECK(status_shm_count(r) == 4 && status_shm_read(r, 3, &got) == 0 && got.errors == 13);
+    status_shm_t* r2 = status_shm_open(TABLE);
+    TEST_CHECK(r2 && status_shm_count(r2) == 0);
+
+    status_shm_close(r2, 0);
+    status_shm_close(r, 0);
+    status_shm_close(w, 0);
+    status_shm_close(w2, 1);
+    TEST_CHECK(access(TABLE, F_OK) != 0);
+}
+
+void test_rejects_other_files(void) {
+    FILE* f = fopen(TABLE, "w");
+    for (int i = 0; i < 1000; i++) fputs("not a table\n", f);
+    fclose(f);
+    TEST_CHECK(status_shm_open(TABLE) == NULL);
+    unlink(TABLE);
+    TEST_CHECK(status_shm_open(TABLE) == NULL);
+}
+
+static status_shm_t* torture_writer;
+static atomic_int torture_done;
+
+// Republishes both slots as fast as it can
+static void* writer_main(void* arg) {
+    (void)arg;
+    status_record_t rec;
+    for (int v = 0; v < 200000; v++) {
+        fill(&rec, v);
+        status_shm_publish(torture_writer, v & 1, &rec);
+    }
+    atomic_store(&torture_done, 1);
+    return NULL;
+}
+
+void test_concurrent_readers_never_see_torn_records(void) {
+    torture_writer = status_shm_create(TABLE, 2);
+    TEST_ASSERT(torture_writer != NULL);
+    status_record_t rec;
+    fill(&rec, 0);
+    status_shm_publish(torture_writer, status_shm_claim(torture_writer), &rec);
+    status_shm_publish(torture_writer, status_shm_claim(torture_writer), &rec);
+
+    status_shm_t* r = status_shm_open(TABLE);
+    TEST_ASSERT(r != NULL);
+    atomic_store(&torture_done, 0);
+    pthread_t th;
+    pthread_create(&th, NULL, writer_main, NULL);
+
+    long reads = 0, torn = 0;
+    while (!atomic_load(&torture_done)) {
+        status_record_t got;
+        status_shm_read(r, reads & 1, &got);
+        if (!consistent(&got)) torn++;
+        reads++;
+    }
+    pthread_join(th, NULL);
+    TEST_CHECK(torn == 0);
+    TEST_MSG("%ld of %ld reads torn", torn, reads);
+
+    status_shm_close(r, 0);
+    status_shm_close(torture_writer, 1);
+}
+
+TEST_LIST = {
+    { "Publish records and read them back", test_publish_and_read },
+    { "Refuse files that are not status tables", test_rejects_other_files },
+    { "Never show concurrent readers a torn record", test_concurrent_readers_never_see_torn_records },
+    { NULL, NULL }
+};
@@ -0,0 +1,598 @@
+#define _GNU_SOURCE
+#include "../include/sync_ops.h"
+#include "acutest.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/xattr.h>
+#include <linux/limits.h>
+
+#define SRC_DIR "/tmp/fss_test_sync_ops_src"
+#define DST_DIR "/tmp/fss_test_sync_ops_dst"
+
+static void reset_dirs(void) {
+    if (system("rm -rf " SRC_DIR " " DST_DIR) != 0) return;
+    mkdir(SRC_DIR, 0755);
+}
+
+static void write_file(const char* path, const char* data) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return;
+    if (write(fd, data, strlen(data)) < 0) perror("write");
+    close(fd);
+}
+
+static void set_mtime(const char* path, time_t sec, long nsec) {
+    struct timespec times[2] = { { sec, nsec }, { sec, nsec } };
+    utimensat(AT_FDCWD, path, times, 0);
+}
+
+static void record_write(const struct stat* st, void* ctx) {
+    *(struct timespec*)ctx = st->st_mtim;
+}
+
+void test_copy_preserves_mode_and_times(void) {
+    reset_dirs();
+    write_file(SRC_DIR "/a", "hello");
+    chmod(SRC_DIR "/a", 0750);
+    set_mtime(SRC_DIR "/a", 1000000000, 123456789);
+
+    sync_result_t r;
+    struct timespec reported = { 0, 0 };
+    sync_result_init(&r, NULL);
+    r.on_write = record_write;
+    r.on_write_ctx = &reported;
+    mkdir(DST_DIR, 0755);
+    TEST_CHECK(copy_file(SRC_DIR "/a", DST_DIR "/a", NULL, &r) == 0);
+
+    struct stat st;
+    TEST_ASSERT(stat(DST_DIR "/a", &st) == 0);
+    TEST_CHECK((st.st_mode & 07777) == 0750);
+    TEST_CHECK(st.st_mtim.tv_sec == 1000000000 && st.st_mtim.tv_nsec == 123456789);
+
+    // on_write reports the mtime after futimens()
+    TEST_CHECK(reported.tv_sec == 1000000000 && reported.tv_nsec == 123456789);
+}
+
+void test_copy_without_preserve(void) {
+    reset_dirs();
+    write_file(SRC_DIR "/a", "hello");
+    chmod(SRC_DIR "/a", 0600);
+    set_mtime(SRC_DIR "/a", 1000000000, 0);
+
+    sync_options_t o;
+    sync_options_init(&o);
+    TEST_CHECK(sync_options_parse("preserve_mode=0,preserve_times=0", &o) == 0);
+
+    sync_result_t r;
+    sync_result_init(&r, NULL);
+    mkdir(DST_DIR, 0755);
+    mode_t old = umask(022);
+    TEST_CHECK(copy_file(SRC_DIR "/a", DST_DIR "/a", &o, &r) == 0);
+    umask(old);
+
+    struct stat st;
+    TEST_ASSERT(stat(DST_DIR "/a", &st) == 0);
+    TEST_CHECK((st.st_mode & 0777) == 0644);
+    TEST_CHECK(st.st_mtim.tv_sec != 1000000000);
+}
+
+void test_copy_read_only_twice(void) {
+    reset_dirs();
+    write_file(SRC_DIR "/ro", "v1");
+    chmod(SRC_DIR "/ro", 0444);
+    mkdir(DST_DIR, 0755);
+
+    sync_result_t r;
+    sync_result_init(&r, NULL);
+    TEST_CHECK(copy_file(SRC_DIR "/ro", DST_DIR "/ro", NULL, &r) == 0);
+
+    // The target is now read-only too; a second copy must still work
+    chmod(SRC_DIR "/ro", 0644);
+    write_file(SRC_DIR "/ro", "v2");
+    chmod(SRC_DIR "/ro", 0444);
+    TEST_CHECK(copy_file(SRC_DIR "/ro", DST_DIR "/ro", NULL, &r) == 0);
+
+    char buf[8] = { 0 };
+    int fd = open(DST_DIR "/ro", O_RDONLY);
+    TEST_CHECK(fd >= 0 && read(fd, buf, sizeof(buf) - 1) == 2);
+    close(fd);
+    TEST_CHECK(strcmp(buf, "v2") == 0);
+}
+
+void test_copy_xattrs(void) {
+    reset_dirs();
+    write_file(SRC_DIR "/x", "data");
+    if (setxattr(SRC_DIR "/x", "user.fss_test", "v", 1, 0) < 0) {
+        TEST_SKIP("no user xattrs on /tmp");
+        return;
+    }
+    mkdir(DST_DIR, 0755);
+
+    sync_options_t o;
+    sync_options_init(&o);
+    TEST_CHECK(sync_options_parse("preserve_xattrs=1", &o) == 0);
+    sync_result_t r;
+    sync_result_init(&r, NULL);
+    TEST_CHECK(copy_file(SRC_DIR "/x", DST_DIR "/x", &o, &r) == 0);
+
+    char v[8] = { 0 };
+    TEST_CHECK(getxattr(DST_DIR "/x", "user.fss_test", v, sizeof(v)) == 1);
+    TEST_CHECK(v[0] == 'v');
+}
+
+void test_full_sync_skips_unchanged(void) {
+    reset_dirs();
+    write_file(SRC_DIR "/a", "aaa");
+    write_file(SRC_DIR "/b", "bbb");
+
+    sync_result_t r;
+    sync_result_init(&r, NULL);
+    full_sync(SRC_DIR, DST_DIR, NULL, &r);
+    TEST_CHECK(r.files_processed == 2);
+    TEST_CHECK(r.files_unchanged == 0);
+
+    // Second run: nothing changed, nothing is copied
+    sync_result_init(&r, NULL);
+    full_sync(SRC_DIR, DST_DIR, NULL, &r);
+    TEST_CHECK(r.files_processed == 0);
+    TEST_CHECK(r.files_unchanged == 2);
+    TEST_CHECK(r.bytes_written == 0);
+    TEST_CHECK(strcmp(r.details, "0 files processed, 2 unchanged") == 0);
+    TEST_MSG("details: %s", r.details);
+
+    // Same size, new mtime: copied again
+    write_file(SRC_DIR "/b", "BBB");
+    set_mtime(SRC_DIR "/b", 2000000000, 1);
+    sync_result_init(&r, NULL);
+    full_sync(SRC_DIR, DST_DIR, NULL, &r);
+    TEST_CHECK(r.files_processed == 1);
+    TEST_CHECK(r.files_unchanged == 1);
+
+    // skip_unchanged=0 copies everything
+    sync_options_t o;
+    sync_options_init(&o);
+    TEST_CHECK(sync_options_parse("skip_unchanged=0", &o) == 0);
+    sync_result_init(&r, NULL);
+    full_sync(SRC_DIR, DST_DIR, &o, &r);
+    TEST_CHECK(r.files_processed == 2);
+
+    if (system("rm -rf " SRC_DIR " " DST_DIR) != 0) return;
+}
+
+void test_full_sync_unreadable_subdir(void) {
+    reset_dirs();
+    mkdir(DST_DIR, 0755);
+    chmod(DST_DIR, 0777);  // Writable by nobody
+    mkdir(SRC_DIR "/open", 0755);
+    mkdir(SRC_DIR "/locked", 0755);
+    write_file(SRC_DIR "/open/a", "a");
+    write_file(SRC_DIR "/locked/b", "b");
+    chmod(SRC_DIR "/locked", 0);
+
+    // Root reads any directory: run the sync as nobody
+    pid_t pid = fork();
+    TEST_ASSERT(pid >= 0);
+    if (pid == 0) {
+        if (geteuid() == 0 && setresuid(65534, 65534, 65534) < 0) _exit(2);
+        sync_options_t o;
+        sync_options_init(&o);
+        sync_options_parse("recursive=1", &o);
+        sync_result_t r;
+        sync_result_init(&r, NULL);
+        full_sync(SRC_DIR, DST_DIR, &o, &r);
+        _exit(strcmp(r.status, "PARTIAL") == 0 && r.files_processed == 1 ? 0 : 3);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    TEST_CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    TEST_MSG("child exit %d", WEXITSTATUS(status));
+
+    chmod(SRC_DIR "/locked", 0755);
+    if (system("rm -rf " SRC_DIR " " DST_DIR) != 0) return;
+}
+
+void test_full_sync_recreates_links(void) {
+    reset_dirs();
+    write_file(SRC_DIR "/real", "0123456789");
+    if (symlink("real", SRC_DIR "/to_file") < 0) return;
+    if (symlink("/", SRC_DIR "/to_dir") < 0) return;
+    if (symlink("missing", SRC_DIR "/dangling") < 0) return;
+
+    sync_result_t r;
+    sync_result_init(&r, NULL);
+    full_sync(SRC_DIR, DST_DIR, NULL, &r);
+    TEST_CHECK(r.errors == 0);
+    TEST_CHECK(r.files_processed == 4);
+    TEST_CHECK(r.bytes_written == 10);  // Only the regular file's data
+
+    char buf[PATH_MAX];
+    struct stat st;
+    ssize_t n = readlink(DST_DIR "/to_file", buf, sizeof(buf) - 1);
+    TEST_CHECK(n == 4 && strncmp(buf, "real", 4) == 0);
+    n = readlink(DST_DIR "/to_dir", buf, sizeof(buf) - 1);
+    TEST_CHECK(n == 1 && buf[0] == '/');
+    TEST_CHECK(lstat(DST_DIR "/dangling", &st) == 0 && S_ISLNK(st.st_mode));
+
+    // Unchanged links are left alone; a retargeted one is replaced
+    unlink(SRC_DIR "/to_dir");
+    if (symlink("/tmp", SRC_DIR "/to_dir") < 0) return;
+    sync_result_init(&r, NULL);
+    full_sync(SRC_DIR, DST_DIR, NULL, &r);
+    TEST_CHECK(r.files_processed == 1);
+    TEST_CHECK(r.files_unchanged == 3);
+    n = readlink(DST_DIR "/to_dir", buf, sizeof(buf) - 1);
+    TEST_CHECK(n == 4 && strncmp(buf, "/tmp", 4) == 0);
+}
+
+void test_follow_links(void) {
+    reset_dirs();
+    write_file(SRC_DIR "/real", "abc");
+    if (symlink("real", SRC_DIR "/to_file") < 0) return;
+    if (symlink("/", SRC_DIR "/to_dir") < 0) return;
+
+    sync_options_t o;
+    sync_options_init(&o);
+    TEST_CHECK(sync_options_parse("follow_links=1", &o) == 0);
+    sync_result_t r;
+    sync_result_init(&r, NULL);
+    full_sync(SRC_DIR, DST_DIR, &o, &r);
+
+    struct stat st;
+    TEST_CHECK(lstat(DST_DIR "/to_file", &st) == 0 && S_ISREG(st.st_mode));
+    TEST_CHECK(lstat(DST_DIR "/to_dir", &st) < 0);
+    TEST_CHECK(r.files_skipped == 1);
+}
+
+void test_link_never_written_through(void) {
+    reset_dirs();
+    mkdir(DST_DIR, 0755);
+    write_file(DST_DIR "/victim", "keep");
+    if (symlink("victim", DST_DIR "/f") < 0) return;
+    write_file(SRC_DIR "/f", "new");
+
+    sync_result_t r;
+    sync_result_init(&r, NULL);
+    TEST_CHECK(copy_file(SRC_DIR "/f", DST_DIR "/f", NULL, &r) == 0);
+
+    struct stat st;
+    TEST_CHECK(lstat(DST_DIR "/f", &st) == 0 && S_ISREG(st.st_mode));
+    char buf[8] = { 0 };
+    int fd = open(DST_DIR "/victim", O_RDONLY);
+    TEST_CHECK(fd >= 0 && read(fd, buf, sizeof(buf) - 1) == 4);
+    close(fd);
+    TEST_CHECK(strcmp(buf, "keep") == 0);
+}
+
+void test_special_files(void) {
+    reset_dirs();
+    TEST_ASSERT(mkfifo(SRC_DIR "/fifo", 0640) == 0);
+
+    // Skipped by default
+    sync_result_t r;
+    sync_result_init(&r, NULL);
+    full_sync(SRC_DIR, DST_DIR, NULL, &r);
+    struct stat st;
+    TEST_CHECK(lstat(DST_DIR "/fifo", &st) < 0);
+    TEST_CHECK(r.files_skipped == 1);
+
+    sync_options_t o;
+    sync_options_init(&o);
+    TEST_CHECK(sync_options_parse("special_files=1", &o) == 0);
+    sync_result_init(&r, NULL);
+    full_sync(SRC_DIR, DST_DIR, &o, &r);
+    TEST_CHECK(lstat(DST_DIR "/fifo", &st) == 0 && S_ISFIFO(st.st_mode));
+    TEST_CHECK((st.st_mode & 0777) == 0640);
+
+    // A single-file task recreates it too, instead of blocking on open()
+    unlink(DST_DIR "/fifo");
+    sync_result_init(&r, NULL);
+    TEST_CHECK(sync_run_task(SRC_DIR, DST_DIR, "fifo", "ADDED", &o, &r) == 0);
+    TEST_CHECK(strcmp(r.status, "SUCCESS") == 0);
+    TEST_CHECK(lstat(DST_DIR "/fifo", &st) == 0 && S_ISFIFO(st.st_mode));
+
+    if (system("rm -rf " SRC_DIR " " DST_DIR) != 0) return;
+}
+
+void test_mirror(void) {
+    reset_dirs();
+    mkdir(SRC_DIR "/keep", 0755);
+    write_file(SRC_DIR "/a", "a");
+    write_file(SRC_DIR "/keep/b", "b");
+    sync_options_t o;
+    sync_options_init(&o);
+    TEST_CHECK(sync_options_parse("recursive=1,mirror=1", &o) == 0);
+
+    sync_result_t r;
+    sync_result_init(&r, NULL);
+    full_sync(SRC_DIR, DST_DIR, &o, &r);
+    TEST_CHECK(r.files_deleted == 0);
+
+    // Extraneous files at every level and a whole extraneous tree
+    write_file(DST_DIR "/stale1", "x");
+    write_file(DST_DIR "/keep/stale2", "x");
+    mkdir(DST_DIR "/gone", 0755);
+    mkdir(DST_DIR "/gone/deeper", 0755);
+    write_file(DST_DIR "/gone/deeper/f", "x");
+    if (symlink("a", DST_DIR "/stale_link") < 0) return;
+
+    sync_result_init(&r, NULL);
+    full_sync(SRC_DIR, DST_DIR, &o, &r);
+    TEST_CHECK(strcmp(r.status, "SUCCESS") == 0);
+    TEST_CHECK(r.files_deleted == 4);
+    TEST_MSG("deleted %d, details: %s", r.files_deleted, r.details);
+
+    struct stat st;
+    TEST_CHECK(lstat(DST_DIR "/stale1", &st) < 0);
+    TEST_CHECK(lstat(DST_DIR "/keep/stale2", &st) < 0);
+    TEST_CHECK(lstat(DST_DIR "/gone", &st) < 0);
+    TEST_CHECK(lstat(DST_DIR "/stale_link", &st) < 0);
+    TEST_CHECK(stat(DST_DIR "/a", &st) == 0);
+    TEST_CHECK(stat(DST_DIR "/keep/b", &st) == 0);
+}
+
+void test_mirror_non_recursive_keeps_dirs(void) {
+    reset_dirs();
+    write_file(SRC_DIR "/a", "a");
+    mkdir(DST_DIR, 0755);
+    mkdir(DST_DIR "/unmanaged", 0755);
+    write_file(DST_DIR "/stale", "x");
+
+    sync_options_t o;
+    sync_options_init(&o);
+    TEST_CHECK(sync_options_parse("mirror=1", &o) == 0);
+    sync_result_t r;
+    sync_result_init(&r, NULL);
+    full_sync(SRC_DIR, DST_DIR, &o, &r);
+
+    struct stat st;
+    TEST_CHECK(r.files_deleted == 1);
+    TEST_CHECK(lstat(DST_DIR "/stale", &st) < 0);
+    TEST_CHECK(stat(DST_DIR "/unmanaged", &st) == 0);
+}
+
+void test_mirror_threshold(void) {
+    reset_dirs();
+    mkdir(DST_DIR, 0755);
+    char path[256];
+    for (int i = 0; i < 5; i++) {
+        snprintf(path, sizeof(path), DST_DIR "/old%d", i);
+        write_file(path, "x");
+    }
+
+    // An empty source would delete everything: refused over the limit
+    sync_options_t o;
+    sync_options_init(&o);
+    TEST_CHECK(sync_options_parse("mirror=1,mirror_max_delete=3", &o) == 0);
+    sync_result_t r;
+    sync_result_init(&r, NULL);
+    full_sync(SRC_DIR, DST_DIR, &o, &r);
+    TEST_CHECK(strcmp(r.status, "PARTIAL") == 0);
+    TEST_CHECK(r.files_deleted == 0);
+    TEST_CHECK(strstr(r.details, "5 deletions refused") != NULL);
+    TEST_MSG("details: %s", r.details);
+    struct stat st;
+    TEST_CHECK(stat(DST_DIR "/old0", &st) == 0);
+
+    // Within the limit everything goes, in one batch for the directory
+    TEST_CHECK(sync_options_parse("mirror_max_delete=5", &o) == 0);
+    sync_result_init(&r, NULL);
+    full_sync(SRC_DIR, DST_DIR, &o, &r);
+    TEST_CHECK(r.files_deleted == 5);
+    TEST_CHECK(strcmp(r.details, "0 files processed, 5 deleted") == 0);
+    TEST_MSG("details: %s", r.details);
+
+    if (system("rm -rf " SRC_DIR " " DST_DIR) != 0) return;
+}
+
+void test_compressed_target(void) {
+    reset_dirs();
+    char big[20000];
+    for (size_t i = 0; i < sizeof(big); i++) big[i] = "abcabcabd"[i % 9];
+    big[sizeof(big) - 1] = '\0';
+    write_file(SRC_DIR "/big", big);
+
+    sync_options_t o;
+    sync_options_init(&o);
+    TEST_CHECK(sync_options_parse("compress=1,compress_chunk=4", &o) == 0);
+    sync_result_t r;
+    sync_result_init(&r, NULL);
+    full_sync(SRC_DIR, DST_DIR, &o, &r);
+    TEST_CHECK(r.files_processed == 1);
+
+    struct stat st;
+    TEST_ASSERT(stat(DST_DIR "/big", &st) == 0);
+    TEST_CHECK(st.st_size < (off_t)sizeof(big) / 4);
+    TEST_CHECK(r.bytes_written == (unsigned long long)st.st_size);
+
+    // The logical size in the footer lets unchanged files be skipped
+    sync_result_init(&r, NULL);
+    full_sync(SRC_DIR, DST_DIR, &o, &r);
+    TEST_CHECK(r.files_unchanged == 1 && r.files_processed == 0);
+
+    if (system("rm -rf " SRC_DIR " " DST_DIR) != 0) return;
+}
+
+void test_delete_missing_and_dirs(void) {
+    reset_dirs();
+    mkdir(DST_DIR, 0755);
+    mkdir(DST_DIR "/d", 0755);
+    write_file(DST_DIR "/d/x", "x");
+    mkdir(DST_DIR "/e", 0755);
+
+    // A missing target is already deleted
+    sync_result_t r;
+    sync_result_init(&r, NULL);
+    TEST_CHECK(delete_file(DST_DIR "/nothing", &r) == 0);
+    TEST_CHECK(r.files_skipped == 1 && r.errors == 0);
+
+    // Directories go with their contents
+    TEST_CHECK(delete_file(DST_DIR "/e", &r) == 0);
+    TEST_CHECK(delete_file(DST_DIR "/d", &r) == 0);
+    struct stat st;
+    TEST_CHECK(lstat(DST_DIR "/d", &st) == -1 && lstat(DST_DIR "/e", &st) == -1);
+    TEST_CHECK(r.errors == 0);
+
+    if (system("rm -rf " SRC_DIR " " DST_DIR) != 0) return;
+}
+
+void test_rename(void) {
+    reset_dirs();
+    write_file(SRC_DIR "/a", "hello");
+    sync_result_t r;
+    sync_result_init(&r, NULL);
+    full_sync(SRC_DIR, DST_DIR, NULL, &r);
+    struct stat before, st;
+    TEST_ASSERT(stat(DST_DIR "/a", &before) == 0);
+
+    // The up-to-date copy is renamed, not copied again
+    TEST_ASSERT(rename(SRC_DIR "/a", SRC_DIR "/b") == 0);
+    sync_result_init(&r, NULL);
+    sync_run_rename(SRC_DIR, DST_DIR, "a", "b", NULL, &r);
+    TEST_CHECK(strcmp(r.status, "SUCCESS") == 0);
+    TEST_CHECK(r.bytes_written == 0);
+    TEST_ASSERT(stat(DST_DIR "/b", &st) == 0);
+    TEST_CHECK(st.st_ino == before.st_ino);
+    TEST_CHECK(lstat(DST_DIR "/a", &st) == -1);
+
+    // A stale copy is not reused: the new name is copied
+    write_file(DST_DIR "/c", "old");
+    write_file(SRC_DIR "/d", "new data");
+    sync_result_init(&r, NULL);
+    sync_run_rename(SRC_DIR, DST_DIR, "c", "d", NULL, &r);
+    TEST_CHECK(strcmp(r.status, "SUCCESS") == 0);
+    TEST_CHECK(r.bytes_written == 8);
+    TEST_CHECK(stat(DST_DIR "/c", &st) == 0);
+
+    // Directories are renamed as a whole
+    mkdir(SRC_DIR "/dir", 0755);
+    mkdir(DST_DIR "/dir", 0755);
+    write_file(DST_DIR "/dir/x", "x");
+    TEST_ASSERT(rename(SRC_DIR "/dir", SRC_DIR "/dir2") == 0);
+    sync_result_init(&r, NULL);
+    sync_run_rename(SRC_DIR, DST_DIR, "dir", "dir2", NULL, &r);
+    TEST_CHECK(stat(DST_DIR "/dir2/x", &st) == 0);
+
+    if (system("rm -rf " SRC_DIR " " DST_DIR) != 0) return;
+}
+
+void test_inline_copy_and_mkdir(void) {
+    reset_dirs();
+    mkdir(DST_DIR, 0755);
+    write_file(SRC_DIR "/small", "copied with copy_file_range");
+    mkdir(SRC_DIR "/sub", 0711);
+
+    sync_options_t o;
+    sync_options_init(&o);
+    TEST_CHECK(sync_options_parse("inline_copy_max=4096", &o) == 0);
+    sync_result_t r;
+    sync_result_init(&r, NULL);
+    TEST_CHECK(sync_run_task(SRC_DIR, DST_DIR, "small", "ADDED", &o, &r) == 0);
+    TEST_CHECK(strcmp(r.status, "SUCCESS") == 0);
+    TEST_CHECK(r.bytes_written == 27);
+    char buf[64] = { 0 };
+    int fd = open(DST_DIR "/small", O_RDONLY);
+    TEST_CHECK(read(fd, buf, sizeof(buf)) == 27);
+    close(fd);
+    TEST_CHECK(strcmp(buf, "copied with copy_file_range") == 0);
+
+    // A new source directory is created in the target
+    sync_result_init(&r, NULL);
+    TEST_CHECK(sync_run_task(SRC_DIR, DST_DIR, "sub", "ADDED", &o, &r) == 0);
+    struct stat st;
+    TEST_ASSERT(stat(DST_DIR "/sub", &st) == 0);
+    TEST_CHECK(S_ISDIR(st.st_mode) && (st.st_mode & 07777) == 0711);
+
+    TEST_CHECK(sync_options_parse("inline_copy_max=99999999", &o) == -1);
+
+    if (system("rm -rf " SRC_DIR " " DST_DIR) != 0) return;
+}
+
+void test_in_place_update(void) {
+    reset_dirs();
+    mkdir(DST_DIR, 0755);
+    static char data[40000];
+    for (size_t i = 0; i < sizeof(data) - 1; i++) data[i] = 'a' + i % 23;
+    write_file(SRC_DIR "/f", data);
+
+    sync_options_t o;
+    sync_options_init(&o);
+    TEST_CHECK(sync_options_parse("in_place=1,copy_buffer=16", &o) == 0);
+    sync_result_t r;
+    sync_result_init(&r, NULL);
+    TEST_CHECK(sync_run_task(SRC_DIR, DST_DIR, "f", "MODIFIED", &o, &r) == 0);
+    TEST_CHECK(r.bytes_written == sizeof(data) - 1 && r.bytes_compared == 0);
+
+    // One changed byte rewrites one 4 KiB block; the rest is only compared
+    data[10000] = '#';
+    write_file(SRC_DIR "/f", data);
+    struct stat before, st;
+    TEST_ASSERT(stat(DST_DIR "/f", &before) == 0);
+    sync_result_init(&r, NULL);
+    TEST_CHECK(sync_run_task(SRC_DIR, DST_DIR, "f", "MODIFIED", &o, &r) == 0);
+    TEST_CHECK(r.bytes_written == 4096 && r.bytes_compared == sizeof(data) - 1);
+    TEST_MSG("written %llu compared %llu", r.bytes_written, r.bytes_compared);
+    TEST_CHECK(strstr(r.details, "bytes compared") != NULL);
+    TEST_ASSERT(stat(DST_DIR "/f", &st) == 0);
+    TEST_CHECK(st.st_ino == before.st_ino);
+
+    // A shorter source truncates the target; a longer one appends
+    char buf[sizeof(data)];
+    data[20000] = '\0';
+    write_file(SRC_DIR "/f", data);
+    sync_result_init(&r, NULL);
+    TEST_CHECK(copy_file(SRC_DIR "/f", DST_DIR "/f", &o, &r) == 0);
+    TEST_CHECK(r.bytes_written == 0);
+    int fd = open(DST_DIR "/f", O_RDONLY);
+    TEST_CHECK(read(fd, buf, sizeof(buf)) == 20000 && memcmp(buf, data, 20000) == 0);
+    close(fd);
+
+    data[20000] = 'z';
+    write_file(SRC_DIR "/f", data);
+    sync_result_init(&r, NULL);
+    TEST_CHECK(copy_file(SRC_DIR "/f", DST_DIR "/f", &o, &r) == 0);
+    fd = open(DST_DIR "/f", O_RDONLY);
+    TEST_CHECK(read(fd, buf, sizeof(buf)) == sizeof(data) - 1 && memcmp(buf, data, sizeof(data) - 1) == 0);
+    close(fd);
+    TEST_CHECK(r.bytes_written < sizeof(data) - 20000 + 4096);
+
+    if (system("rm -rf " SRC_DIR " " DST_DIR) != 0) return;
+}
+
+void test_options(void) {
+    sync_options_t o;
+    sync_options_init(&o);
+    TEST_CHECK(o.preserve_mode == 1 && o.preserve_times == 1);
+    TEST_CHECK(o.preserve_owner == 0 && o.preserve_xattrs == 0);
+    TEST_CHECK(o.skip_unchanged == 1);
+    TEST_CHECK(sync_options_set(&o, "preserve_owner", "1") == 0);
+    TEST_CHECK(o.preserve_owner == 1);
+    TEST_CHECK(sync_options_set(&o, "preserve_owner", "yes") == -1);
+}
+
+TEST_LIST = {
+    { "Parse and validate sync options", test_options },
+    { "Copy a file keeping its mode and times", test_copy_preserves_mode_and_times },
+    { "Copy a file without keeping mode and times", test_copy_without_preserve },
+    { "Copy over a read-only target", test_copy_read_only_twice },
+    { "Copy extended attributes", test_copy_xattrs },
+    { "Skip unchanged files on a full sync", test_full_sync_skips_unchanged },
+    { "Report unreadable subdirectories as a partial sync", test_full_sync_unreadable_subdir },
+    { "Recreate symlinks on a full sync", test_full_sync_recreates_links },
+    { "Follow symlinks when follow_links is set", test_follow_links },
+    { "Never write through a symlink in the target", test_link_never_written_through },
+    { "Skip or recreate special files", test_special_files },
+    { "Delete target entries missing from the source in mirror mode", test_mirror },
+    { "Keep target directories in non-recursive mirror mode", test_mirror_non_recursive_keeps_dirs },
+    { "Refuse mirror deletions past mirror_max_delete", test_mirror_threshold },
+    { "Sync into a compressed target", test_compressed_target },
+    { "Delete files and directories from the target", test_delete_missing_and_dirs },
+    { "Rename a file in the target", test_rename },
+    { "Copy small files and create directories inline", test_inline_copy_and_mkdir },
+    { "Rewrite only the changed blocks of a target in place", test_in_place_update },
+    { NULL, NULL }
+};
@@ -0,0 +1,78 @@
+#include "../include/sync_policy.h"
+#include "acutest.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 2026-01-05 00:00:00 UTC
+#define MIDNIGHT ((time_t)1767571200)
+
+static void use_utc(void) {
+    setenv("TZ", "UTC", 1);
+    tzset();
+}
+
+void test_parse(void) {
+    sync_policy_t p;
+    sync_policy_init(&p);
+    TEST_CHECK(p.kind == SYNC_POLICY_REALTIME && p.interval == 3600);
+    TEST_CHECK(sync_policy_validate(&p) == 0);
+
+    TEST_CHECK(sync_policy_set(&p, "policy", "interval") == 0);
+    TEST_CHECK(sync_policy_set(&p, "interval", "900") == 0);
+    TEST_CHECK(p.kind == SYNC_POLICY_INTERVAL && p.interval == 900);
+    TEST_CHECK(sync_policy_set(&p, "interval", "0") == -1);
+    TEST_CHECK(sync_policy_set(&p, "interval", "10s") == -1);
+    TEST_CHECK(sync_policy_set(&p, "policy", "hourly") == -1);
+    TEST_CHECK(sync_policy_set(&p, "nice", "5") == 1);
+
+    // A window policy needs a window
+    TEST_CHECK(sync_policy_set(&p, "policy", "window") == 0);
+    TEST_CHECK(sync_policy_validate(&p) == -1);
+    TEST_CHECK(sync_policy_set(&p, "window", "22:00-06:30") == 0);
+    TEST_CHECK(p.window_start == 22 * 60 && p.window_end == 6 * 60 + 30);
+    TEST_CHECK(sync_policy_validate(&p) == 0);
+    TEST_CHECK(sync_policy_set(&p, "window", "24:00-06:00") == -1);
+    TEST_CHECK(sync_policy_set(&p, "window", "22:00") == -1);
+    TEST_CHECK(sync_policy_set(&p, "window", "22:00-06:00x") == -1);
+
+    char buf[64];
+    sync_policy_describe(&p, buf, sizeof(buf));
+    TEST_CHECK(strcmp(buf, "window 22:00-06:30") == 0);
+}
+
+void test_window(void) {
+    use_utc();
+    sync_policy_t p;
+    sync_policy_init(&p);
+    sync_policy_set(&p, "policy", "window");
+
+    // Same-day window
+    sync_policy_set(&p, "window", "01:00-05:00");
+    TEST_CHECK(!sync_policy_in_window(&p, MIDNIGHT));
+    TEST_CHECK(sync_policy_next_boundary(&p, MIDNIGHT) == 3600);
+    TEST_CHECK(sync_policy_in_window(&p, MIDNIGHT + 3600));
+    TEST_CHECK(sync_policy_next_boundary(&p, MIDNIGHT + 3600) == 4 * 3600);
+    TEST_CHECK(!sync_policy_in_window(&p, MIDNIGHT + 5 * 3600));
+    TEST_CHECK(sync_policy_next_boundary(&p, MIDNIGHT + 5 * 3600) == 20 * 3600);
+
+    // Wrapping past midnight
+    sync_policy_set(&p, "window", "22:00-06:00");
+    TEST_CHECK(sync_policy_in_window(&p, MIDNIGHT + 23 * 3600));
+    TEST_CHECK(sync_policy_in_window(&p, MIDNIGHT + 3 * 3600));
+    TEST_CHECK(!sync_policy_in_window(&p, MIDNIGHT + 12 * 3600));
+    TEST_CHECK(sync_policy_next_boundary(&p, MIDNIGHT + 23 * 3600 + 30) == 7 * 3600 - 30);
+    TEST_CHECK(sync_policy_next_boundary(&p, MIDNIGHT + 12 * 3600) == 10 * 3600);
+
+    // Open all day
+    sync_policy_set(&p, "window", "08:00-08:00");
+    TEST_CHECK(sync_policy_in_window(&p, MIDNIGHT + 8 * 3600));
+    TEST_CHECK(sync_policy_in_window(&p, MIDNIGHT + 20 * 3600));
+    TEST_CHECK(sync_policy_next_boundary(&p, MIDNIGHT + 8 * 3600) == 24 * 3600);
+}
+
+TEST_LIST = {
+    { "Parse and describe sync policies", test_parse },
+    { "Open and close sync windows", test_window },
+    { NULL, NULL }
+};
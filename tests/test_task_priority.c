@@ -0,0 +1,161 @@
+#define _GNU_SOURCE
+#include "../include/task_priority.h"
+#include "acutest.h"
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+
+void test_set(void) {
+    task_priority_t p;
+    task_priority_init(&p);
+    TEST_CHECK(task_priority_is_default(&p));
+
+    TEST_CHECK(task_priority_set(&p, "io_class", "idle") == 0);
+    TEST_CHECK(p.io_class == 3);
+    TEST_CHECK(task_priority_set(&p, "io_level", "7") == 0);
+    TEST_CHECK(task_priority_set(&p, "cpu_sched", "idle") == 0);
+    TEST_CHECK(task_priority_set(&p, "nice", "19") == 0);
+    TEST_CHECK(task_priority_set(&p, "cpu_limit", "60") == 0);
+    TEST_CHECK(!task_priority_is_default(&p));
+
+    TEST_CHECK(task_priority_set(&p, "io_class", "fast") == -1);
+    TEST_CHECK(task_priority_set(&p, "io_level", "8") == -1);
+    TEST_CHECK(task_priority_set(&p, "nice", "-21") == -1);
+    TEST_CHECK(task_priority_set(&p, "nice", "5x") == -1);
+    TEST_CHECK(task_priority_set(&p, "cpu_limit", "0") == -1);
+    TEST_CHECK(task_priority_set(&p, "recursive", "1") == 1);
+    TEST_CHECK(p.nice == 19 && p.io_level == 7);
+}
+
+void test_describe(void) {
+    task_priority_t p;
+    char out[128];
+
+    task_priority_init(&p);
+    task_priority_describe(&p, out, sizeof(out));
+    TEST_CHECK(strcmp(out, "io=inherit sched=normal nice=inherit cpu_limit=none") == 0);
+    task_priority_options(&p, out, sizeof(out));
+    TEST_CHECK(out[0] == '\0');
+
+    task_priority_set(&p, "io_class", "be");
+    task_priority_set(&p, "io_level", "6");
+    task_priority_set(&p, "nice", "5");
+    task_priority_describe(&p, out, sizeof(out));
+    TEST_CHECK(strcmp(out, "io=be/6 sched=normal nice=5 cpu_limit=none") == 0);
+    TEST_MSG("got: %s", out);
+
+    // Options for a worker's command line parse back to the same priority
+    task_priority_set(&p, "cpu_sched", "idle");
+    task_priority_set(&p, "cpu_limit", "30");
+    task_priority_options(&p, out, sizeof(out));
+    TEST_CHECK(strcmp(out, "io_class=be,io_level=6,cpu_sched=idle,nice=5,cpu_limit=30") == 0);
+    TEST_MSG("got: %s", out);
+    task_priority_t q;
+    task_priority_init(&q);
+    char* save = NULL;
+    for (char* kv = strtok_r(out, ",", &save); kv; kv = strtok_r(NULL, ",", &save)) {
+        char* eq = strchr(kv, '=');
+        *eq = '\0';
+        TEST_CHECK(task_priority_set(&q, kv, eq + 1) == 0);
+    }
+    TEST_CHECK(memcmp(&p, &q, sizeof(p)) == 0);
+}
+
+void test_apply_process(void) {
+    task_priority_t p;
+    task_priority_init(&p);
+    task_priority_set(&p, "io_class", "idle");
+    task_priority_set(&p, "cpu_sched", "idle");
+    task_priority_set(&p, "nice", "15");
+    task_priority_set(&p, "cpu_limit", "30");
+
+    int ready[2];
+    TEST_ASSERT(pipe(ready) == 0);
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Lowering priority never needs privileges
+        char err[256];
+        int rc = task_priority_apply(&p, 1, NULL, err, sizeof(err));
+        if (write(ready[1], &rc, sizeof(rc)) < 0) _exit(1);
+        pause();
+        _exit(0);
+    }
+    close(ready[1]);
+    int rc = -1;
+    TEST_CHECK(read(ready[0], &rc, sizeof(rc)) == sizeof(rc));
+    TEST_CHECK(rc == 0);
+
+    char out[128];
+    TEST_CHECK(task_priority_query(pid, out, sizeof(out)) == 0);
+    TEST_CHECK(strcmp(out, "io=idle sched=idle nice=15 cpu_limit=30s") == 0);
+    TEST_MSG("got: %s", out);
+
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    close(ready[0]);
+    TEST_CHECK(task_priority_query(pid, out, sizeof(out)) == -1);
+}
+
+void test_apply_thread_restore(void) {
+    task_priority_t p;
+    task_priority_saved_t saved;
+    char err[256], before[128], during[128], after[128];
+    pid_t tid = syscall(SYS_gettid);
+
+    task_priority_init(&p);
+    task_priority_set(&p, "io_class", "idle");
+    task_priority_set(&p, "nice", "10");
+
+    task_priority_query(tid, before, sizeof(before));
+    TEST_CHECK(task_priority_apply(&p, 0, &saved, err, sizeof(err)) == 0);
+    TEST_MSG("err: %s", err);
+    task_priority_query(tid, during, sizeof(during));
+    TEST_CHECK(strncmp(during, "io=idle ", 8) == 0);
+    TEST_CHECK(strstr(during, "nice=10") != NULL);
+
+    // Raising nice back needs CAP_SYS_NICE
+    int restored = task_priority_restore(&saved, err, sizeof(err));
+    task_priority_query(tid, after, sizeof(after));
+    TEST_CHECK((restored == 0) == (strcmp(after, before) == 0));
+    TEST_MSG("restored %d (%s) before: %s after: %s", restored, err, before, after);
+    if (geteuid() == 0) TEST_CHECK(restored == 0);
+}
+
+void test_restore_refused(void) {
+    pid_t pid = fork();
+    TEST_ASSERT(pid >= 0);
+    if (pid == 0) {
+        // Without CAP_SYS_NICE and with RLIMIT_NICE 0, nice can only go up
+        struct rlimit rl = { 0, 0 };
+        setrlimit(RLIMIT_NICE, &rl);
+        if (geteuid() == 0 && setresuid(65534, 65534, 65534) < 0) _exit(2);
+        if (getpriority(PRIO_PROCESS, 0) >= 19) _exit(0);
+
+        task_priority_t p;
+        task_priority_saved_t saved;
+        char err[256];
+        task_priority_init(&p);
+        task_priority_set(&p, "nice", "19");
+        task_priority_set(&p, "cpu_sched", "idle");
+        if (task_priority_apply(&p, 0, &saved, err, sizeof(err)) < 0) _exit(3);
+        if (task_priority_restore(&saved, err, sizeof(err)) == 0) _exit(4);
+        _exit(strstr(err, "setpriority") ? 0 : 5);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    TEST_CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    TEST_MSG("child exit %d", WEXITSTATUS(status));
+}
+
+TEST_LIST = {
+    { "Set and validate priority options", test_set },
+    { "Describe a priority setting", test_describe },
+    { "Apply a priority to a child process", test_apply_process },
+    { "Apply a priority to a thread and restore it", test_apply_thread_restore },
+    { "Report a restore refused without CAP_SYS_NICE", test_restore_refused },
+    { NULL, NULL }
+};
@@ -0,0 +1,148 @@
+#include "../include/task_table.h"
+#include "acutest.h"
+#include <stdio.h>
+#include <string.h>
+
+static int T1, T2, T3, T4;
+static void* walked[8];
+
+static void collect(void* task, void* ctx) {
+    int* n = ctx;
+    if (*n < 8) walked[*n] = task;
+    (*n)++;
+}
+
+void test_files_run_side_by_side(void) {
+    task_table_t* t = task_table_create();
+    TEST_CHECK(task_table_busy(t, "/src", "a") == 0);
+    task_table_start(t, "/src", "a");
+    TEST_CHECK(task_table_busy(t, "/src", "b") == 0);
+    task_table_start(t, "/src", "b");
+    TEST_CHECK(task_table_running(t, "/src") == 2);
+
+    // Same file waits, other sources are unaffected
+    TEST_CHECK(task_table_busy(t, "/src", "a") == 1);
+    TEST_CHECK(task_table_busy(t, "/other", "a") == 0);
+
+    task_table_finish(t, "/src", "a");
+    TEST_CHECK(task_table_busy(t, "/src", "a") == 0);
+    task_table_finish(t, "/src", "b");
+    TEST_CHECK(task_table_running(t, "/src") == 0);
+
+    // Finishing something unknown is harmless
+    task_table_finish(t, "/src", "b");
+    task_table_finish(t, "/nowhere", "x");
+    TEST_CHECK(task_table_running(t, "/src") == 0);
+    task_table_destroy(t);
+}
+
+void test_full_excludes_files(void) {
+    task_table_t* t = task_table_create();
+
+    // A FULL sync waits for running files
+    task_table_start(t, "/src", "a");
+    TEST_CHECK(task_table_busy(t, "/src", TASK_TABLE_ALL) == 1);
+    task_table_finish(t, "/src", "a");
+    TEST_CHECK(task_table_busy(t, "/src", TASK_TABLE_ALL) == 0);
+
+    // Files wait for a running FULL sync
+    task_table_start(t, "/src", TASK_TABLE_ALL);
+    TEST_CHECK(task_table_full_pending(t, "/src") == 1);
+    TEST_CHECK(task_table_busy(t, "/src", "a") == 1);
+    TEST_CHECK(task_table_busy(t, "/src", TASK_TABLE_ALL) == 1);
+    task_table_finish(t, "/src", TASK_TABLE_ALL);
+    TEST_CHECK(task_table_full_pending(t, "/src") == 0);
+    TEST_CHECK(task_table_busy(t, "/src", "a") == 0);
+    task_table_destroy(t);
+}
+
+void test_deferred_order(void) {
+    task_table_t* t = task_table_create();
+    task_table_start(t, "/src", "a");
+    task_table_start(t, "/src", "b");
+
+    // a waits for its own key; a waiting FULL then holds back later files
+    task_table_defer(t, "/src", "a", &T1);
+    TEST_CHECK(task_table_deferred(t, "/src", "a") == &T1);
+    task_table_defer(t, "/src", TASK_TABLE_ALL, &T2);
+    TEST_CHECK(task_table_full_pending(t, "/src") == 1);
+    TEST_CHECK(task_table_busy(t, "/src", "c") == 1);
+    task_table_defer(t, "/src", "c", &T3);
+
+    // Coalescing keeps the place in line
+    task_table_defer(t, "/src", "a", &T4);
+    TEST_CHECK(task_table_deferred(t, "/src", "a") == &T4);
+
+    // b finishing frees nothing: a still runs, the FULL is behind it
+    task_table_finish(t, "/src", "b");
+    TEST_CHECK(task_table_take_ready(t, "/src") == NULL);
+
+    // a finishing releases the deferred a, which holds the FULL back
+    task_table_finish(t, "/src", "a");
+    TEST_CHECK(task_table_take_ready(t, "/src") == &T4);
+    TEST_CHECK(task_table_running(t, "/src") == 1);
+    TEST_CHECK(task_table_take_ready(t, "/src") == NULL);
+    TEST_CHECK(task_table_busy(t, "/src", "a") == 1);
+    task_table_finish(t, "/src", "a");
+
+    // Now the FULL, and c only once the FULL is done
+    TEST_CHECK(task_table_take_ready(t, "/src") == &T2);
+    TEST_CHECK(task_table_take_ready(t, "/src") == NULL);
+    task_table_finish(t, "/src", TASK_TABLE_ALL);
+    TEST_CHECK(task_table_take_ready(t, "/src") == &T3);
+    TEST_CHECK(task_table_take_ready(t, "/src") == NULL);
+    task_table_finish(t, "/src", "c");
+    TEST_CHECK(task_table_busy(t, "/src", "c") == 0);
+    TEST_CHECK(task_table_full_pending(t, "/src") == 0);
+    task_table_destroy(t);
+}
+
+void test_skips_blocked_files(void) {
+    task_table_t* t = task_table_create();
+    task_table_start(t, "/src", "a");
+    task_table_start(t, "/src", "b");
+    task_table_defer(t, "/src", "a", &T1);
+    task_table_defer(t, "/src", "b", &T2);
+
+    // Walking sees both, oldest first
+    int n = 0;
+    task_table_walk_deferred(t, "/src", collect, &n);
+    TEST_CHECK(n == 2 && walked[0] == &T1 && walked[1] == &T2);
+
+    // b's deferred task is not stuck behind a's
+    task_table_finish(t, "/src", "b");
+    TEST_CHECK(task_table_take_ready(t, "/src") == &T2);
+    TEST_CHECK(task_table_take_ready(t, "/src") == NULL);
+    TEST_CHECK(task_table_deferred(t, "/src", "a") == &T1);
+    TEST_CHECK(task_table_running(t, "/src") == 2);
+
+    // Destroying with tasks still deferred
+    task_table_destroy(t);
+}
+
+void test_many_files(void) {
+    task_table_t* t = task_table_create();
+    char name[32];
+    for (int i = 0; i < 5000; i++) {
+        snprintf(name, sizeof(name), "f%d", i);
+        task_table_start(t, "/src", name);
+    }
+    TEST_CHECK(task_table_running(t, "/src") == 5000);
+    TEST_CHECK(task_table_busy(t, "/src", "f4999") == 1);
+    TEST_CHECK(task_table_busy(t, "/src", "f5000") == 0);
+    for (int i = 0; i < 5000; i++) {
+        snprintf(name, sizeof(name), "f%d", i);
+        task_table_finish(t, "/src", name);
+    }
+    TEST_CHECK(task_table_running(t, "/src") == 0);
+    task_table_destroy(t);
+}
+
+TEST_LIST = {
+    { "Run tasks for different files side by side", test_files_run_side_by_side },
+    { "Keep a FULL sync and file tasks apart", test_full_excludes_files },
+    { "Release deferred tasks in order", test_deferred_order },
+    { "Release tasks past a blocked file", test_skips_blocked_files },
+    { "Track many running files", test_many_files },
+    { NULL, NULL }
+};
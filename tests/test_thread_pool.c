@@ -0,0 +1,50 @@
+#include "../include/thread_pool.h"
+#include "acutest.h"
+#include <stdatomic.h>
+
+#define TASKS 10000
+
+static atomic_int counter;
+static thread_pool_t* pool;
+
+static void count_task(void* arg) {
+    (void)arg;
+    atomic_fetch_add(&counter, 1);
+}
+
+// Spawns children from a pool thread so they land on its own deque
+static void spawn_task(void* arg) {
+    TEST_CHECK(pool_thread_index() >= 0);
+    for (int i = 0; i < 100; i++) pool_submit(pool, count_task, NULL);
+    (void)arg;
+}
+
+void test_pool_runs_all_tasks(void) {
+    atomic_store(&counter, 0);
+    pool = pool_create(4);
+    TEST_ASSERT(pool != NULL);
+    TEST_CHECK(pool_size(pool) == 4);
+    TEST_CHECK(pool_thread_index() == -1); // Not a pool thread
+
+    for (int i = 0; i < TASKS; i++) pool_submit(pool, count_task, NULL);
+
+    pool_destroy(pool); // Runs everything queued before joining
+    TEST_CHECK(atomic_load(&counter) == TASKS);
+}
+
+void test_pool_nested_submit(void) {
+    atomic_store(&counter, 0);
+    pool = pool_create(4);
+    TEST_ASSERT(pool != NULL);
+
+    for (int i = 0; i < 10; i++) pool_submit(pool, spawn_task, NULL);
+
+    pool_destroy(pool);
+    TEST_CHECK(atomic_load(&counter) == 1000);
+}
+
+TEST_LIST = {
+    { "Pool runs every submitted task", test_pool_runs_all_tasks },
+    { "Tasks submitted from pool threads", test_pool_nested_submit },
+    { NULL, NULL }
+};
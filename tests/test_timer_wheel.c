@@ -0,0 +1,132 @@
+#include "../include/timer_wheel.h"
+#include "acutest.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static unsigned long long clock_now;
+static int late;
+
+// Records the tick each timer fired at in its data
+static void record(tw_timer_t* t, void* ctx) {
+    (void)ctx;
+    *(unsigned long long*)t->data = clock_now;
+    if (clock_now != t->expires) late++;
+}
+
+void test_fires_on_time(void) {
+    unsigned long long start = 1000;
+    timer_wheel_t* w = timer_wheel_create(start);
+    unsigned long long delays[] = { 0, 1, 63, 64, 65, 4095, 4096, 4097, 300000, 262144 };
+    size_t n = sizeof(delays) / sizeof(delays[0]);
+    tw_timer_t timers[10] = { { 0 } };
+    unsigned long long fired_at[10] = { 0 };
+    for (size_t i = 0; i < n; i++) {
+        timers[i].data = &fired_at[i];
+        timer_wheel_add(w, &timers[i], start + delays[i]);
+        TEST_CHECK(timer_wheel_pending(&timers[i]));
+    }
+    TEST_CHECK(timer_wheel_count(w) == n);
+
+    // One tick at a time, so every timer must fire exactly on its tick
+    late = 0;
+    for (clock_now = start; clock_now <= start + 300000; clock_now++)
+        timer_wheel_advance(w, clock_now, record, NULL);
+    TEST_CHECK(late == 0);
+    for (size_t i = 0; i < n; i++) {
+        TEST_CHECK(fired_at[i] == start + delays[i]);
+        TEST_MSG("delay %llu fired at %llu", delays[i], fired_at[i] - start);
+        TEST_CHECK(!timer_wheel_pending(&timers[i]));
+    }
+    TEST_CHECK(timer_wheel_count(w) == 0);
+    timer_wheel_destroy(w);
+}
+
+void test_cancel_and_rearm(void) {
+    timer_wheel_t* w = timer_wheel_create(0);
+    tw_timer_t a = { 0 }, b = { 0 };
+    unsigned long long fa = 0, fb = 0;
+    a.data = &fa;
+    b.data = &fb;
+    timer_wheel_add(w, &a, 10);
+    timer_wheel_add(w, &b, 5000);
+    timer_wheel_cancel(w, &a);
+    timer_wheel_cancel(w, &a);  // Already disarmed
+    timer_wheel_add(w, &b, 20);  // Moves it
+    TEST_CHECK(timer_wheel_count(w) == 1);
+
+    clock_now = 100;
+    TEST_CHECK(timer_wheel_advance(w, 100, record, NULL) == 1);
+    TEST_CHECK(fa == 0 && fb == 100);
+
+    // Overdue timers fire on the next advance
+    timer_wheel_add(w, &a, 50);
+    clock_now = 101;
+    TEST_CHECK(timer_wheel_advance(w, 101, record, NULL) == 1);
+    TEST_CHECK(fa == 101);
+    timer_wheel_destroy(w);
+}
+
+static timer_wheel_t* periodic_wheel;
+static int periodic_fired;
+
+// Re-arms itself every 7 ticks, and cancels its sibling once
+static void periodic(tw_timer_t* t, void* ctx) {
+    periodic_fired++;
+    tw_timer_t* sibling = ctx;
+    if (t != sibling) {
+        timer_wheel_cancel(periodic_wheel, sibling);
+        timer_wheel_add(periodic_wheel, t, t->expires + 7);
+    }
+}
+
+void test_rearm_from_callback(void) {
+    periodic_wheel = timer_wheel_create(0);
+    tw_timer_t p = { 0 }, s = { 0 };
+    timer_wheel_add(periodic_wheel, &p, 7);
+    timer_wheel_add(periodic_wheel, &s, 7);  // Same slot, cancelled by p if p comes first
+
+    // Advancing in one big step still fires every period
+    periodic_fired = 0;
+    timer_wheel_advance(periodic_wheel, 700, periodic, &s);
+    TEST_CHECK(periodic_fired == 100 || periodic_fired == 101);
+    TEST_CHECK(timer_wheel_pending(&p) && p.expires == 707);
+    TEST_CHECK(!timer_wheel_pending(&s));
+    TEST_CHECK(timer_wheel_count(periodic_wheel) == 1);
+    timer_wheel_destroy(periodic_wheel);
+}
+
+void test_many_timers(void) {
+    timer_wheel_t* w = timer_wheel_create(0);
+    size_t n = 50000;
+    tw_timer_t* timers = calloc(n, sizeof(*timers));
+    unsigned long long* fired_at = calloc(n, sizeof(*fired_at));
+    unsigned seed = 3;
+    for (size_t i = 0; i < n; i++) {
+        seed = seed * 1103515245 + 12345;
+        timers[i].data = &fired_at[i];
+        timer_wheel_add(w, &timers[i], 1 + (seed >> 8) % 20000);
+    }
+
+    late = 0;
+    for (clock_now = 0; clock_now <= 20000; clock_now += 1 + clock_now % 5)
+        timer_wheel_advance(w, clock_now, record, NULL);
+    timer_wheel_advance(w, clock_now, record, NULL);
+
+    // Coarse advances fire late but never early, and nothing is lost
+    int early = 0;
+    for (size_t i = 0; i < n; i++)
+        if (fired_at[i] < timers[i].expires) early++;
+    TEST_CHECK(early == 0);
+    TEST_CHECK(timer_wheel_count(w) == 0);
+    free(timers);
+    free(fired_at);
+    timer_wheel_destroy(w);
+}
+
+TEST_LIST = {
+    { "Fire timers on time at every level", test_fires_on_time },
+    { "Cancel and re-arm timers", test_cancel_and_rearm },
+    { "Re-arm a timer from its callback", test_rearm_from_callback },
+    { "Fire many random timers on time", test_many_timers },
+    { NULL, NULL }
+};
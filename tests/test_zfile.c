@@ -0,0 +1,220 @@
+#include "../include/zfile.h"
+#include "acutest.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define SRC_PATH "/tmp/fss_test_zfile_src"
+#define DST_PATH "/tmp/fss_test_zfile_dst"
+#define CHUNK 4096
+
+// Mostly compressible data: repeated words with some noise
+static void fill(unsigned char* p, size_t n, unsigned seed) {
+    static const char* words[] = { "alpha ", "beta ", "gamma ", "delta ", "sync ", "file " };
+    size_t i = 0;
+    while (i < n) {
+        seed = seed * 1103515245 + 12345;
+        const char* w = words[(seed >> 16) % 6];
+        for (size_t k = 0; w[k] && i < n; k++) p[i++] = w[k];
+        if ((seed >> 8) % 7 == 0 && i < n) p[i++] = seed & 0xff;
+    }
+}
+
+static void write_source(const unsigned char* data, size_t n) {
+    int fd = open(SRC_PATH, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return;
+    if (n && write(fd, data, n) != (ssize_t)n) perror("write");
+    close(fd);
+}
+
+static int sync_once(zfile_stats_t* st) {
+    int s = open(SRC_PATH, O_RDONLY);
+    int d = open(DST_PATH, O_RDWR | O_CREAT, 0644);
+    int rc = zfile_sync(s, d, CHUNK, st);
+    close(s);
+    close(d);
+    return rc;
+}
+
+// Reads the whole target back through zfile_pread and compares
+static int matches(const unsigned char* data, size_t n) {
+    int fd = open(DST_PATH, O_RDONLY);
+    zfile_t z;
+    if (zfile_open(&z, fd) < 0) {
+        close(fd);
+        return 0;
+    }
+    unsigned char* back = malloc(n + 16);
+    ssize_t got = zfile_pread(&z, back, n + 16, 0);
+    int ok = got == (ssize_t)n && z.footer.size == n && memcmp(back, data, n) == 0;
+    free(back);
+    zfile_close(&z);
+    close(fd);
+    return ok;
+}
+
+void test_block_roundtrip(void) {
+    size_t sizes[] = { 0, 1, 3, 4, 5, 100, 4096, 65536 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        size_t n = sizes[i];
+        unsigned char* in = malloc(n + 1);
+        unsigned char* comp = malloc(zfile_bound(n));
+        unsigned char* out = malloc(n + 1);
+        fill(in, n, i);
+
+        size_t c = zfile_compress_block(in, n, comp, zfile_bound(n));
+        TEST_CHECK(c > 0);
+        TEST_CHECK(zfile_decompress_block(comp, c, out, n) == (ssize_t)n);
+        TEST_CHECK(memcmp(in, out, n) == 0);
+        TEST_MSG("size %zu", n);
+        if (n == 65536) TEST_CHECK(c < n / 2);
+
+        free(in);
+        free(comp);
+        free(out);
+    }
+
+    // Long runs need length continuation bytes
+    unsigned char zeros[10000] = { 0 }, comp[10100], out[10000];
+    size_t c = zfile_compress_block(zeros, sizeof(zeros), comp, sizeof(comp));
+    TEST_CHECK(c > 0 && c < 100);
+    TEST_CHECK(zfile_decompress_block(comp, c, out, sizeof(out)) == sizeof(out));
+    TEST_CHECK(memcmp(zeros, out, sizeof(out)) == 0);
+}
+
+void test_block_rejects_garbage(void) {
+    unsigned char out[256];
+    unsigned char bad_offset[] = { 0x14, 'a', 0x10, 0x00 };  // Offset 16 before any output
+    unsigned char short_lits[] = { 0x50, 'a', 'b' };          // 5 literals announced, 2 given
+    unsigned char overflow[] = { 0xf0, 0xff, 0xff, 0xff, 0x01 };
+    TEST_CHECK(zfile_decompress_block(bad_offset, sizeof(bad_offset), out, sizeof(out)) == -1);
+    TEST_CHECK(zfile_decompress_block(short_lits, sizeof(short_lits), out, sizeof(out)) == -1);
+    TEST_CHECK(zfile_decompress_block(overflow, sizeof(overflow), out, sizeof(out)) == -1);
+
+    // Output larger than the buffer
+    unsigned char in[200], comp[300];
+    fill(in, sizeof(in), 7);
+    size_t c = zfile_compress_block(in, sizeof(in), comp, sizeof(comp));
+    TEST_CHECK(zfile_decompress_block(comp, c, out, 100) == -1);
+}
+
+void test_sync_and_random_access(void) {
+    size_t n = CHUNK * 10 + 123;
+    unsigned char* data = malloc(n);
+    fill(data, n, 1);
+    write_source(data, n);
+    unlink(DST_PATH);
+
+    zfile_stats_t st;
+    TEST_CHECK(sync_once(&st) == 0);
+    TEST_CHECK(st.chunks_written == 11 && st.chunks_kept == 0);
+    TEST_CHECK(matches(data, n));
+
+    // The compressed form is smaller than the source
+    struct stat sb;
+    stat(DST_PATH, &sb);
+    TEST_CHECK(sb.st_size < (off_t)n);
+
+    // Random access across a chunk boundary
+    int fd = open(DST_PATH, O_RDONLY);
+    zfile_t z;
+    TEST_ASSERT(zfile_open(&z, fd) == 0);
+    unsigned char buf[100];
+    TEST_CHECK(zfile_pread(&z, buf, sizeof(buf), CHUNK * 3 - 50) == sizeof(buf));
+    TEST_CHECK(memcmp(buf, data + CHUNK * 3 - 50, sizeof(buf)) == 0);
+    TEST_CHECK(zfile_pread(&z, buf, sizeof(buf), n - 10) == 10);
+    TEST_CHECK(zfile_pread(&z, buf, sizeof(buf), n + 5) == 0);
+    zfile_close(&z);
+    close(fd);
+    free(data);
+}
+
+void test_incremental_and_append(void) {
+    size_t n = CHUNK * 8 + 500;
+    unsigned char* data = malloc(n + CHUNK * 3);
+    fill(data, n + CHUNK * 3, 2);
+    write_source(data, n);
+    unlink(DST_PATH);
+    zfile_stats_t st;
+    TEST_CHECK(sync_once(&st) == 0);
+
+    // Unchanged: nothing is recompressed
+    TEST_CHECK(sync_once(&st) == 0);
+    TEST_CHECK(st.chunks_kept == 9 && st.chunks_written == 0);
+
+    // Append: only the old partial chunk and the new ones
+    write_source(data, n + CHUNK * 3);
+    TEST_CHECK(sync_once(&st) == 0);
+    TEST_CHECK(st.chunks_kept == 8);
+    TEST_CHECK(st.chunks_written == 4);
+    TEST_CHECK(matches(data, n + CHUNK * 3));
+
+    // Edit in chunk 5: chunks 0-4 are kept
+    data[CHUNK * 5 + 7] ^= 0x55;
+    write_source(data, n + CHUNK * 3);
+    TEST_CHECK(sync_once(&st) == 0);
+    TEST_CHECK(st.chunks_kept == 5);
+    TEST_CHECK(matches(data, n + CHUNK * 3));
+
+    // Truncate: the tail chunks are dropped
+    write_source(data, CHUNK * 2);
+    TEST_CHECK(sync_once(&st) == 0);
+    TEST_CHECK(st.chunks_kept == 2 && st.chunks_written == 0);
+    TEST_CHECK(matches(data, CHUNK * 2));
+
+    // Empty source
+    write_source(data, 0);
+    TEST_CHECK(sync_once(&st) == 0);
+    TEST_CHECK(matches(data, 0));
+
+    free(data);
+}
+
+void test_incompressible_and_foreign(void) {
+    size_t n = CHUNK * 2;
+    unsigned char* data = malloc(n);
+    unsigned seed = 99;
+    for (size_t i = 0; i < n; i++) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = seed >> 16;
+    }
+
+    // A plain file in the way is replaced completely
+    int fd = open(DST_PATH, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (write(fd, "plain old copy", 14) != 14) perror("write");
+    close(fd);
+
+    write_source(data, n);
+    zfile_stats_t st;
+    TEST_CHECK(sync_once(&st) == 0);
+    TEST_CHECK(st.chunks_written == 2);
+    TEST_CHECK(matches(data, n));
+
+    fd = open(DST_PATH, O_RDONLY);
+    zfile_t z;
+    TEST_ASSERT(zfile_open(&z, fd) == 0);
+    TEST_CHECK(z.index[0].clen & ZFILE_STORED);
+    zfile_close(&z);
+    close(fd);
+
+    // Not in the format at all
+    fd = open(SRC_PATH, O_RDONLY);
+    TEST_CHECK(zfile_open(&z, fd) == -1);
+    close(fd);
+
+    unlink(SRC_PATH);
+    unlink(DST_PATH);
+    free(data);
+}
+
+TEST_LIST = {
+    { "Compress and decompress blocks of any size", test_block_roundtrip },
+    { "Reject corrupt compressed blocks", test_block_rejects_garbage },
+    { "Sync a compressed file and read it at any offset", test_sync_and_random_access },
+    { "Update a compressed file incrementally and by appending", test_incremental_and_append },
+    { "Store incompressible data and refuse foreign files", test_incompressible_and_foreign },
+    { NULL, NULL }
+};